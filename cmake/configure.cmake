@@ -93,6 +93,10 @@ if(WITH_BOX_PS)
   add_definitions(-DPADDLE_WITH_BOX_PS)
 endif()
 
+if(WITH_SLOTRECORD_ARENA)
+  add_definitions(-DPADDLE_WITH_SLOTRECORD_ARENA)
+endif()
+
 if(WITH_ASCEND)
   add_definitions(-DPADDLE_WITH_ASCEND)
 endif()
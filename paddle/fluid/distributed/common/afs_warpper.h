@@ -66,6 +66,14 @@ class FsReadChannel {
     return 0;
   }
 
+  // read exactly size bytes, for binary files
+  inline int read(char* data, size_t size) {
+    if (size != 0 && fread(data, 1, size, _file.get()) != size) {
+      return -1;
+    }
+    return 0;
+  }
+
  private:
   uint32_t _buffer_size;
   FsChannelConfig _config;
@@ -113,6 +121,13 @@ class FsWriteChannel {
   inline uint32_t write_line(const std::string& data) {
     return write_line(data.c_str(), data.size());
   }
+  // write raw bytes without line break, for binary files
+  inline int write(const char* data, size_t size) {
+    if (fwrite_unlocked(data, 1, size, _file.get()) != size) {
+      return -1;
+    }
+    return 0;
+  }
 
  private:
   uint32_t _buffer_size;
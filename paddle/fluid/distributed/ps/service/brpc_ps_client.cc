@@ -14,11 +14,13 @@
 
 #include "paddle/fluid/distributed/ps/service/brpc_ps_client.h"
 
+#include <algorithm>
 #include <memory>
 #include <sstream>
 #include <string>
 
 #include "paddle/fluid/distributed/ps/service/coordinator_client.h"
+#include "paddle/fluid/distributed/ps/service/sparse_key_codec.h"
 #include "paddle/fluid/framework/archive.h"
 #include "paddle/fluid/string/split.h"
 
@@ -78,6 +80,32 @@ DEFINE_int32(pserver_sparse_table_shard_num,
              1000,
              "sparse table shard for save & load");
 
+DEFINE_bool(pserver_sparse_key_delta_encode,
+            false,
+            "send the sorted keys of pull_sparse and push_sparse_raw_gradient "
+            "delta + varint encoded");
+
+DEFINE_int32(pserver_sparse_partition_thread,
+             8,
+             "threads splitting the keys of pull_sparse and "
+             "push_sparse_raw_gradient by server and sorting them, 0 does it "
+             "in the calling thread");
+
+DEFINE_int64(pserver_sparse_pull_cache_size,
+             0,
+             "keys of a sparse table whose pulled values a worker caches, 0 "
+             "disables the cache");
+
+DEFINE_int32(pserver_sparse_pull_cache_refresh_steps,
+             10,
+             "a cached value serves the pulls of the table in this many "
+             "steps after it was pulled, 0 keeps it until evicted or pushed");
+
+DEFINE_bool(pserver_sparse_pull_cache_invalidate_on_push,
+            false,
+            "drop the cached value of a key when the push of the worker is "
+            "applied");
+
 inline size_t get_sparse_shard(uint32_t shard_num,
                                uint32_t server_num,
                                uint64_t key) {
@@ -87,6 +115,83 @@ inline size_t get_sparse_shard(uint32_t shard_num,
   return (key % shard_num) / local_shard_num;
 }
 
+// smaller batches are split in the calling thread
+static const size_t kParallelPartitionMinKeys = 100000;
+
+// splits (keys[i], values[i]) by the server of the key into parts, keeping
+// their order, and sorts every part by key when sort is set
+template <typename ValueT>
+static void PartitionSparseKeys(
+    ::ThreadPool *pool,
+    uint64_t shard_num,
+    const uint64_t *keys,
+    const ValueT *values,
+    size_t num,
+    bool sort,
+    std::vector<std::vector<std::pair<uint64_t, ValueT>>> *parts) {
+  size_t server_num = parts->size();
+  auto sort_part = [parts](size_t server) {
+    auto &part = parts->at(server);
+    std::sort(part.begin(),
+              part.end(),
+              [](const std::pair<uint64_t, ValueT> &k1,
+                 const std::pair<uint64_t, ValueT> &k2) {
+                return k1.first < k2.first;
+              });
+  };
+  if (pool == nullptr || num < kParallelPartitionMinKeys) {
+    for (size_t i = 0; i < num; ++i) {
+      size_t server = get_sparse_shard(shard_num, server_num, keys[i]);
+      parts->at(server).push_back({keys[i], values[i]});
+    }
+    for (size_t server = 0; sort && server < server_num; ++server) {
+      sort_part(server);
+    }
+    return;
+  }
+  auto run = [pool](size_t task_num, std::function<void(size_t)> func) {
+    std::vector<std::future<void>> wait_futures;
+    for (size_t i = 0; i < task_num; ++i) {
+      wait_futures.emplace_back(pool->enqueue(func, i));
+    }
+    for (auto &fut : wait_futures) {
+      fut.wait();
+    }
+  };
+  size_t chunk_num = FLAGS_pserver_sparse_partition_thread;
+  size_t chunk_size = (num + chunk_num - 1) / chunk_num;
+  std::vector<uint32_t> servers(num);
+  // offsets[chunk * server_num + server], counts first
+  std::vector<size_t> offsets(chunk_num * server_num, 0);
+  run(chunk_num, [&](size_t chunk) {
+    size_t *count = &offsets[chunk * server_num];
+    size_t end = std::min(num, (chunk + 1) * chunk_size);
+    for (size_t i = chunk * chunk_size; i < end; ++i) {
+      servers[i] = get_sparse_shard(shard_num, server_num, keys[i]);
+      ++count[servers[i]];
+    }
+  });
+  for (size_t server = 0; server < server_num; ++server) {
+    size_t total = 0;
+    for (size_t chunk = 0; chunk < chunk_num; ++chunk) {
+      size_t count = offsets[chunk * server_num + server];
+      offsets[chunk * server_num + server] = total;
+      total += count;
+    }
+    parts->at(server).resize(total);
+  }
+  run(chunk_num, [&](size_t chunk) {
+    size_t *offset = &offsets[chunk * server_num];
+    size_t end = std::min(num, (chunk + 1) * chunk_size);
+    for (size_t i = chunk * chunk_size; i < end; ++i) {
+      (*parts)[servers[i]][offset[servers[i]]++] = {keys[i], values[i]};
+    }
+  });
+  if (sort) {
+    run(server_num, sort_part);
+  }
+}
+
 void DownpourPsClientService::service(
     ::google::protobuf::RpcController *controller,
     const PsRequestMessage *request,
@@ -342,6 +447,13 @@ int32_t BrpcPsClient::Initialize() {
       _push_sparse_task_queue_map[table_id] =
           paddle::framework::MakeChannel<SparseAsyncTask *>();
       _push_sparse_merge_count_map[table_id] = 0;
+      if (FLAGS_pserver_sparse_pull_cache_size > 0) {
+        auto *accessor = GetTableAccessor(table_id);
+        _sparse_pull_caches[table_id].reset(new SparsePullCache(
+            FLAGS_pserver_sparse_pull_cache_size,
+            accessor->GetAccessorInfo().select_size,
+            FLAGS_pserver_sparse_pull_cache_refresh_steps));
+      }
     }
   }
 
@@ -363,6 +475,11 @@ int32_t BrpcPsClient::Initialize() {
   profiler.register_profiler("pserver_client_push_dense_rpc");
   profiler.register_profiler("pserver_client_push_dense_send");
 
+  if (FLAGS_pserver_sparse_partition_thread > 0) {
+    _sparse_partition_pool.reset(
+        new ::ThreadPool(FLAGS_pserver_sparse_partition_thread));
+  }
+
   _running = true;
   _flushing = false;
   // 启动异步push线程
@@ -441,8 +558,9 @@ int FlClientBrpcClosure::check_response(size_t request_idx, int cmd_id) {
 
 std::future<int32_t> BrpcPsClient::PrintTableStat(uint32_t table_id) {
   size_t request_call_num = _server_channels.size();
+  auto *cache = GetSparsePullCache(table_id);
   DownpourBrpcClosure *closure = new DownpourBrpcClosure(
-      request_call_num, [request_call_num, table_id](void *done) {
+      request_call_num, [request_call_num, table_id, cache](void *done) {
         int ret = 0;
         uint64_t feasign_size = 0;
         uint64_t mf_size = 0;
@@ -464,6 +582,16 @@ std::future<int32_t> BrpcPsClient::PrintTableStat(uint32_t table_id) {
         std::cout << "table id: " << table_id
                   << ", feasign size: " << feasign_size
                   << ", mf size: " << mf_size << std::endl;
+        if (cache != nullptr) {
+          uint64_t hit_num = cache->HitNum();
+          uint64_t pull_num = hit_num + cache->MissNum();
+          std::cout << "table id: " << table_id
+                    << ", pull cache hit: " << hit_num
+                    << ", pull: " << pull_num << ", hit rate: "
+                    << (pull_num == 0 ? 0.0
+                                      : static_cast<double>(hit_num) / pull_num)
+                    << std::endl;
+        }
       });
   auto promise = std::make_shared<std::promise<int32_t>>();
   closure->add_promise(promise);
@@ -1000,6 +1128,27 @@ std::future<int32_t> BrpcPsClient::PushDenseParam(const Region *regions,
   return fut;
 }
 
+void BrpcPsClient::InvalidateSparsePullCache(DownpourBrpcClosure *closure,
+                                             size_t table_id,
+                                             const uint64_t *keys,
+                                             size_t num) {
+  if (!FLAGS_pserver_sparse_pull_cache_invalidate_on_push || num == 0) {
+    return;
+  }
+  auto *cache = GetSparsePullCache(table_id);
+  if (cache == nullptr) {
+    return;
+  }
+  // a pull served before the push is applied caches the old value, so the
+  // keys are erased when the response arrives
+  auto erase_keys = std::make_shared<std::vector<uint64_t>>(keys, keys + num);
+  closure->add_done_hook([cache, erase_keys]() {
+    for (auto key : *erase_keys) {
+      cache->Erase(key);
+    }
+  });
+}
+
 std::future<int32_t> BrpcPsClient::PushSparseRawGradient(
     size_t table_id,
     const uint64_t *keys,
@@ -1009,15 +1158,14 @@ std::future<int32_t> BrpcPsClient::PushSparseRawGradient(
   auto *accessor = GetTableAccessor(table_id);
   // 发送RPC请求
   DownpourBrpcClosure *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
+  InvalidateSparsePullCache(closure, table_id, keys, num);
   auto promise = std::make_shared<std::promise<int32_t>>();
   closure->add_promise(promise);
   std::future<int> fut = promise->get_future();
 
   size_t request_call_num = _server_channels.size();
-  std::vector<std::vector<uint64_t>> ids;
-  std::vector<std::vector<const float *>> value_ptrs;
-  ids.resize(request_call_num);
-  value_ptrs.resize(request_call_num);
+  std::vector<std::vector<std::pair<uint64_t, const float *>>> shard_kvs(
+      request_call_num);
 
   const auto &server_param = _config.server_param().downpour_server_param();
   uint64_t shard_num = FLAGS_pserver_sparse_table_shard_num;
@@ -1029,15 +1177,17 @@ std::future<int32_t> BrpcPsClient::PushSparseRawGradient(
     }
   }
 
-  for (size_t i = 0; i < num; ++i) {
-    size_t pserver_idx = get_sparse_shard(shard_num, request_call_num, keys[i]);
-    ids[pserver_idx].push_back(keys[i]);
-    value_ptrs[pserver_idx].push_back(update_values[i]);
-  }
+  bool delta_encode = FLAGS_pserver_sparse_key_delta_encode;
+  PartitionSparseKeys(_sparse_partition_pool.get(),
+                      shard_num,
+                      keys,
+                      update_values,
+                      num,
+                      delta_encode,
+                      &shard_kvs);
 
   for (size_t shard_idx = 0; shard_idx < request_call_num; ++shard_idx) {
-    auto kvs = ids[shard_idx];
-    auto value_ptr = value_ptrs[shard_idx];
+    auto &kvs = shard_kvs[shard_idx];
 
     size_t kv_size = kvs.size();
     uint32_t value_size = accessor->GetAccessorInfo().update_size;
@@ -1049,14 +1199,34 @@ std::future<int32_t> BrpcPsClient::PushSparseRawGradient(
     push_request->set_client_id(_client_id);
     push_request->add_params((char *)&kv_size, sizeof(uint32_t));  // NOLINT
     auto *push_data = push_request->mutable_data();
-    push_data->resize(kv_size * (sizeof(uint64_t) + value_size));
-    char *push_data_ptr = const_cast<char *>(push_data->data());
-    memcpy(push_data_ptr, kvs.data(), kv_size * sizeof(uint64_t));
-    push_data_ptr += kv_size * sizeof(uint64_t);
-
-    for (size_t i = 0; i < kv_size; ++i) {
-      memcpy(push_data_ptr, value_ptr[i], value_size);
-      push_data_ptr += value_size;
+    if (delta_encode) {
+      /*
+      Push Content:
+      |---valuesData---|---deltaVarintKeys---|
+      */
+      uint32_t key_format = kSparseKeyDeltaVarint;
+      push_request->add_params((char *)&key_format,  // NOLINT
+                               sizeof(uint32_t));
+      push_data->resize(kv_size * (value_size + kMaxVarint64Bytes));
+      char *push_data_ptr = const_cast<char *>(push_data->data());
+      for (size_t i = 0; i < kv_size; ++i) {
+        memcpy(push_data_ptr, kvs[i].second, value_size);
+        push_data_ptr += value_size;
+      }
+      push_data_ptr = EncodeSortedKeys(
+          [&kvs](size_t i) { return kvs[i].first; }, kv_size, push_data_ptr);
+      push_data->resize(push_data_ptr - push_data->data());
+    } else {
+      push_data->resize(kv_size * (sizeof(uint64_t) + value_size));
+      char *push_data_ptr = const_cast<char *>(push_data->data());
+      for (size_t i = 0; i < kv_size; ++i) {
+        memcpy(push_data_ptr, &kvs[i].first, sizeof(uint64_t));
+        push_data_ptr += sizeof(uint64_t);
+      }
+      for (size_t i = 0; i < kv_size; ++i) {
+        memcpy(push_data_ptr, kvs[i].second, value_size);
+        push_data_ptr += value_size;
+      }
     }
     PsService_Stub rpc_stub(GetSparseChannel(shard_idx));
     closure->cntl(shard_idx)->set_request_compress_type(
@@ -1142,6 +1312,27 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
       std::make_shared<CostTimer>("pserver_client_pull_sparse_local");
   size_t request_call_num = _server_channels.size();
 
+  // the cached keys are served here, only the others go to the servers
+  auto *cache = GetSparsePullCache(table_id);
+  uint64_t cache_step = 0;
+  thread_local std::vector<uint64_t> miss_keys;
+  thread_local std::vector<float *> miss_values;
+  if (cache != nullptr) {
+    cache_step = cache->NextStep();
+    miss_keys.clear();
+    miss_values.clear();
+    for (size_t i = 0; i < num; ++i) {
+      if (!cache->Lookup(keys[i], cache_step, select_values[i])) {
+        miss_keys.push_back(keys[i]);
+        miss_values.push_back(select_values[i]);
+      }
+    }
+    cache->AddStat(num - miss_keys.size(), miss_keys.size());
+    keys = miss_keys.data();
+    select_values = miss_values.data();
+    num = miss_keys.size();
+  }
+
   auto shard_sorted_kvs = std::make_shared<
       std::vector<std::vector<std::pair<uint64_t, float *>>>>();
   shard_sorted_kvs->resize(request_call_num);
@@ -1156,17 +1347,21 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
     }
   }
 
-  for (size_t i = 0; i < num; ++i) {
-    size_t shard_id = get_sparse_shard(shard_num, request_call_num, keys[i]);
-    shard_sorted_kvs->at(shard_id).push_back({keys[i], select_values[i]});
-  }
+  PartitionSparseKeys(_sparse_partition_pool.get(),
+                      shard_num,
+                      keys,
+                      select_values,
+                      num,
+                      true,
+                      shard_sorted_kvs.get());
 
   auto *accessor = GetTableAccessor(table_id);
 
   size_t value_size = accessor->GetAccessorInfo().select_size;
 
   DownpourBrpcClosure *closure = new DownpourBrpcClosure(
-      request_call_num, [shard_sorted_kvs, value_size](void *done) {
+      request_call_num,
+      [shard_sorted_kvs, value_size, cache, cache_step](void *done) {
         int ret = 0;
         auto *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
         for (size_t i = 0; i < shard_sorted_kvs->size(); ++i) {
@@ -1197,6 +1392,9 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
                 ret = -1;
                 break;
               }
+              if (cache != nullptr) {
+                cache->Insert(last_key, cache_step, last_value_data);
+              }
             }
           }
         }
@@ -1207,40 +1405,56 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
   closure->add_promise(promise);
   std::future<int> fut = promise->get_future();
 
+  bool delta_encode = FLAGS_pserver_sparse_key_delta_encode;
+  std::vector<uint64_t> unique_keys;
+  std::vector<uint32_t> keys_counter;
+  std::string encode_buffer;
   for (size_t i = 0; i < request_call_num; ++i) {
     auto &sorted_kvs = shard_sorted_kvs->at(i);
-    std::sort(sorted_kvs.begin(),
-              sorted_kvs.end(),
-              [](const std::pair<uint64_t, float *> &k1,
-                 const std::pair<uint64_t, float *> &k2) {
-                return k1.first < k2.first;
-              });
-
-    uint64_t last_key = UINT64_MAX;
-    uint32_t kv_request_count = 0;
     size_t sorted_kv_size = sorted_kvs.size();
     auto &request_buffer = closure->cntl(i)->request_attachment();
 
-    request_buffer.append(reinterpret_cast<void *>(&is_training), sizeof(bool));
-    std::vector<uint32_t> keys_counter;
-    keys_counter.reserve(sorted_kv_size);
-
+    unique_keys.clear();
+    keys_counter.clear();
     for (size_t kv_idx = 0; kv_idx < sorted_kv_size; ++kv_idx) {
-      ++kv_request_count;
       uint32_t keys = 1;
-      last_key = sorted_kvs[kv_idx].first;
-      request_buffer.append(reinterpret_cast<void *>(&last_key),
-                            sizeof(uint64_t));
+      uint64_t last_key = sorted_kvs[kv_idx].first;
       while (kv_idx < sorted_kv_size - 1 &&
              last_key == sorted_kvs[kv_idx + 1].first) {
         ++kv_idx;
         ++keys;
       }
+      unique_keys.push_back(last_key);
       keys_counter.push_back(keys);
     }
-
-    request_buffer.append(reinterpret_cast<void *>(keys_counter.data()),
-                          sizeof(uint32_t) * keys_counter.size());
+    uint32_t kv_request_count = unique_keys.size();
+
+    if (delta_encode) {
+      /*
+      |---isTraining---|---deltaVarintKeys---|---varintFrequencies---|
+      */
+      encode_buffer.resize(sizeof(bool) +
+                           kv_request_count *
+                               (kMaxVarint64Bytes + kMaxVarint32Bytes));
+      char *encode_ptr = &encode_buffer[0];
+      memcpy(encode_ptr, &is_training, sizeof(bool));
+      encode_ptr = EncodeSortedKeys(
+          [&unique_keys](size_t k) { return unique_keys[k]; },
+          kv_request_count,
+          encode_ptr + sizeof(bool));
+      for (uint32_t count : keys_counter) {
+        encode_ptr = EncodeVarint64(count, encode_ptr);
+      }
+      request_buffer.append(encode_buffer.data(),
+                            encode_ptr - encode_buffer.data());
+    } else {
+      request_buffer.append(reinterpret_cast<void *>(&is_training),
+                            sizeof(bool));
+      request_buffer.append(reinterpret_cast<void *>(unique_keys.data()),
+                            sizeof(uint64_t) * unique_keys.size());
+      request_buffer.append(reinterpret_cast<void *>(keys_counter.data()),
+                            sizeof(uint32_t) * keys_counter.size());
+    }
 
     if (kv_request_count == 0) {
       closure->Run();
@@ -1250,6 +1464,11 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
       closure->request(i)->set_client_id(_client_id);
       closure->request(i)->add_params((char *)&kv_request_count,  // NOLINT
                                       sizeof(uint32_t));
+      if (delta_encode) {
+        uint32_t key_format = kSparseKeyDeltaVarint;
+        closure->request(i)->add_params((char *)&key_format,  // NOLINT
+                                        sizeof(uint32_t));
+      }
       PsService_Stub rpc_stub(GetCmdChannel(i));
       closure->cntl(i)->set_log_id(butil::gettimeofday_ms());
       rpc_stub.service(
@@ -1411,6 +1630,7 @@ std::future<int32_t> BrpcPsClient::PushSparseRawGradientPartial(
   auto *accessor = GetTableAccessor(table_id);
   size_t value_size = accessor->GetAccessorInfo().update_size;
   DownpourBrpcClosure *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
+  InvalidateSparsePullCache(closure, table_id, keys, num);
   auto promise = std::make_shared<std::promise<int32_t>>();
   closure->add_promise(promise);
   std::future<int> fut = promise->get_future();
@@ -1873,6 +2093,8 @@ int BrpcPsClient::PushSparseAsyncShardPush(
            update_size);
     push_data_ptr += update_size;
   }
+  InvalidateSparsePullCache(
+      closure, table_id, merged_key_list.data(), merged_kv_count);
   PsService_Stub rpc_stub(GetSparseChannel(shard_idx));
   closure->cntl(shard_idx)->set_request_compress_type(
       (brpc::CompressType)FLAGS_pserver_communicate_compress_type);
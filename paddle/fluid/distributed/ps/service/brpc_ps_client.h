@@ -16,7 +16,9 @@
 
 #include <ThreadPool.h>
 
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -26,6 +28,7 @@
 #include "paddle/fluid/distributed/ps/service/brpc_utils.h"
 #include "paddle/fluid/distributed/ps/service/ps_client.h"
 #include "paddle/fluid/distributed/ps/service/sendrecv.pb.h"
+#include "paddle/fluid/distributed/ps/service/sparse_pull_cache.h"
 #include "paddle/fluid/framework/channel.h"
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/scope.h"
@@ -138,10 +141,18 @@ class DownpourBrpcClosure : public PSClientClosure {
   virtual ~DownpourBrpcClosure() {}
   void Run() override {
     if (_waiting_num.fetch_sub(1) == 1) {
+      for (auto &hook : _done_hooks) {
+        hook();
+      }
       _callback(this);
       delete this;
     }
   }
+  // runs once all the responses arrive, before the callback sets the promises
+  void add_done_hook(std::function<void()> hook) {
+    std::lock_guard<std::mutex> lock(_hook_mutex);
+    _done_hooks.push_back(std::move(hook));
+  }
   PsRequestMessage *request(size_t i) { return &_requests[i]; }
   PsResponseMessage *response(size_t i) { return &_responses[i]; }
   brpc::Controller *cntl(size_t i) { return _cntls[i].get(); }
@@ -154,6 +165,8 @@ class DownpourBrpcClosure : public PSClientClosure {
   std::vector<PsRequestMessage> _requests;
   std::vector<PsResponseMessage> _responses;
   std::vector<std::shared_ptr<brpc::Controller>> _cntls;
+  std::mutex _hook_mutex;
+  std::vector<std::function<void()>> _done_hooks;
 };
 
 struct SharedSparsePushData {
@@ -379,6 +392,20 @@ class BrpcPsClient : public PSClient {
       ValueAccessor *accessor);
 
   SparseTaskPool _sparse_task_pool;
+  // splits and sorts the keys of large pull_sparse / push_sparse requests
+  std::unique_ptr<::ThreadPool> _sparse_partition_pool;
+  // pulled values of the hot keys, by table id, filled in Initialize
+  std::unordered_map<uint32_t, std::unique_ptr<SparsePullCache>>
+      _sparse_pull_caches;
+  SparsePullCache *GetSparsePullCache(size_t table_id) {
+    auto it = _sparse_pull_caches.find(table_id);
+    return it == _sparse_pull_caches.end() ? nullptr : it->second.get();
+  }
+  // erases the keys from the pull cache once the push of closure is applied
+  void InvalidateSparsePullCache(DownpourBrpcClosure *closure,
+                                 size_t table_id,
+                                 const uint64_t *keys,
+                                 size_t num);
 
   std::vector<std::shared_ptr<brpc::Channel>>
       _client_channels;  // client2client
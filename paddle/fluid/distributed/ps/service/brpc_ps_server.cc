@@ -18,6 +18,7 @@
 
 #include "butil/object_pool.h"
 #include "paddle/fluid/distributed/common/cost_timer.h"
+#include "paddle/fluid/distributed/ps/service/sparse_key_codec.h"
 #include "paddle/fluid/distributed/ps/table/depends/sparse_utils.h"
 #include "paddle/fluid/distributed/ps/table/table.h"
 #include "paddle/fluid/framework/archive.h"
@@ -43,6 +44,14 @@ DEFINE_string(pserver_connection_type_s2s,
 namespace paddle {
 namespace distributed {
 
+// key format sent by the client after the key num, raw keys when absent
+static uint32_t GetSparseKeyFormat(const PsRequestMessage &request) {
+  if (request.params_size() < 2) {
+    return kSparseKeyRaw;
+  }
+  return DecodeSparseKeyFormat(request.params(1));
+}
+
 int32_t BrpcPsServer::Initialize() {
   auto &service_config = _config.downpour_server_param().service_param();
   if (!service_config.has_service_class()) {
@@ -532,7 +541,34 @@ int32_t BrpcPsService::PullSparse(Table *table,
 
   auto value = PullSparseValue(num, dim);
 
-  value.DeserializeFromBytes(const_cast<void *>(data));
+  auto *keys = butil::get_object<std::vector<uint64_t>>();
+  auto *frequencies = butil::get_object<std::vector<uint32_t>>();
+  if (GetSparseKeyFormat(request) == kSparseKeyDeltaVarint) {
+    /*
+    |---isTraining---|---deltaVarintKeys---|---varintFrequencies---|
+    */
+    keys->resize(num);
+    frequencies->resize(num);
+    const char *begin = reinterpret_cast<const char *>(data);
+    const char *end = begin + req_buffer_size;
+    const char *pos =
+        DecodeSortedKeys(begin + sizeof(bool), end, num, keys->data());
+    for (uint32_t i = 0; i < num && pos != nullptr; ++i) {
+      uint64_t frequency = 0;
+      pos = DecodeVarint64(pos, end, &frequency);
+      (*frequencies)[i] = static_cast<uint32_t>(frequency);
+    }
+    if (pos == nullptr) {
+      butil::return_object(keys);
+      butil::return_object(frequencies);
+      set_response_code(response, -1, "req attachment is not in format");
+      return 0;
+    }
+    value = PullSparseValue(*keys, *frequencies, dim);
+    value.is_training_ = *reinterpret_cast<const bool *>(begin);
+  } else {
+    value.DeserializeFromBytes(const_cast<void *>(data));
+  }
 
   auto res_data = butil::get_object<std::vector<float>>();
   res_data->resize(num * dim);
@@ -546,6 +582,8 @@ int32_t BrpcPsService::PullSparse(Table *table,
   cntl->response_attachment().append(reinterpret_cast<char *>(res_data->data()),
                                      res_data->size() * sizeof(float));
   butil::return_object(res_data);
+  butil::return_object(keys);
+  butil::return_object(frequencies);
   return 0;
 }
 
@@ -582,6 +620,29 @@ int32_t BrpcPsService::PushSparse(Table *table,
   table_context.push_context.values =
       (const float *)(push_data.data() + sizeof(uint64_t) * num);
   table_context.num = num;
+  std::vector<uint64_t> *keys = nullptr;
+  if (GetSparseKeyFormat(request) == kSparseKeyDeltaVarint) {
+    /*
+    Push Content:
+    |---valuesData---|---deltaVarintKeys---|
+    */
+    size_t values_size =
+        static_cast<size_t>(num) *
+        table->ValueAccesor()->GetAccessorInfo().update_size;
+    keys = butil::get_object<std::vector<uint64_t>>();
+    keys->resize(num);
+    if (push_data.size() < values_size ||
+        DecodeSortedKeys(push_data.data() + values_size,
+                         push_data.data() + push_data.size(),
+                         num,
+                         keys->data()) == nullptr) {
+      butil::return_object(keys);
+      set_response_code(response, -1, "push sparse data is not in format");
+      return 0;
+    }
+    table_context.push_context.keys = keys->data();
+    table_context.push_context.values = (const float *)push_data.data();
+  }
   // const uint64_t *keys = (const uint64_t *)push_data.data();
   // const float *values = (const float *)(push_data.data() + sizeof(uint64_t) *
   // num);
@@ -589,6 +650,9 @@ int32_t BrpcPsService::PushSparse(Table *table,
     // if (table->PushSparse(keys, values, num) != 0) {
     set_response_code(response, -1, "PushSparse error");
   }
+  if (keys != nullptr) {
+    butil::return_object(keys);
+  }
   return 0;
 }
 
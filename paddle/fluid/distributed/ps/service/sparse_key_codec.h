@@ -0,0 +1,109 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace paddle {
+namespace distributed {
+
+// key format of a pull_sparse / push_sparse request, sent as the last
+// request param, requests without it carry raw 8 byte keys
+enum SparseKeyFormat : uint32_t {
+  kSparseKeyRaw = 0,
+  // keys sorted ascending, each written as the varint of its difference to
+  // the previous key (the first one to 0)
+  kSparseKeyDeltaVarint = 1,
+};
+
+// format of the key format param, a param too short to hold one (from an
+// older or broken client) reads as raw keys
+inline uint32_t DecodeSparseKeyFormat(const std::string& param) {
+  uint32_t format = kSparseKeyRaw;
+  if (param.size() >= sizeof(format)) {
+    memcpy(&format, param.data(), sizeof(format));
+  }
+  return format;
+}
+
+// bytes of the longest varint of a 64 / 32 bit value
+constexpr size_t kMaxVarint64Bytes = 10;
+constexpr size_t kMaxVarint32Bytes = 5;
+
+inline char* EncodeVarint64(uint64_t value, char* out) {
+  uint8_t* p = reinterpret_cast<uint8_t*>(out);
+  while (value >= 0x80) {
+    *p++ = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  *p++ = static_cast<uint8_t>(value);
+  return reinterpret_cast<char*>(p);
+}
+
+// returns the byte after the varint, nullptr when it is truncated or longer
+// than 10 bytes
+inline const char* DecodeVarint64(const char* in,
+                                  const char* end,
+                                  uint64_t* value) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(in);
+  const uint8_t* limit = reinterpret_cast<const uint8_t*>(end);
+  uint64_t result = 0;
+  for (int shift = 0; shift < 64 && p < limit; shift += 7) {
+    uint64_t byte = *p++;
+    result |= (byte & 0x7F) << shift;
+    if (byte < 0x80) {
+      *value = result;
+      return reinterpret_cast<const char*>(p);
+    }
+  }
+  return nullptr;
+}
+
+// writes the sorted keys key_of(0) .. key_of(num - 1) as delta varints,
+// out needs num * kMaxVarint64Bytes bytes, returns the end of the block
+template <typename KeyOf>
+inline char* EncodeSortedKeys(KeyOf&& key_of, size_t num, char* out) {
+  uint64_t last_key = 0;
+  for (size_t i = 0; i < num; ++i) {
+    uint64_t key = key_of(i);
+    out = EncodeVarint64(key - last_key, out);
+    last_key = key;
+  }
+  return out;
+}
+
+// reads num delta varint keys, returns the end of the block or nullptr
+inline const char* DecodeSortedKeys(const char* in,
+                                    const char* end,
+                                    size_t num,
+                                    uint64_t* keys) {
+  uint64_t last_key = 0;
+  for (size_t i = 0; i < num; ++i) {
+    uint64_t delta = 0;
+    in = DecodeVarint64(in, end, &delta);
+    if (in == nullptr) {
+      return nullptr;
+    }
+    last_key += delta;
+    keys[i] = last_key;
+  }
+  return in;
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,171 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// worker side cache of the pulled values of one sparse table. It holds at
+// most capacity keys, a full shard replaces its entries by a clock sweep so
+// the keys pulled by most batches stay. An entry filled by the pull of step
+// s serves the pulls before step s + refresh_steps (forever when it is 0),
+// or until Erase is called on the push of its key. The responses of the
+// pulls started before an Erase are dropped, they may hold the value the
+// push has not updated yet.
+class SparsePullCache {
+ public:
+  SparsePullCache(size_t capacity,
+                  size_t value_size,
+                  uint32_t refresh_steps,
+                  size_t shard_num = 64)
+      : _value_size(value_size), _refresh_steps(refresh_steps) {
+    size_t shard_capacity = (capacity + shard_num - 1) / shard_num;
+    _shards.resize(shard_num);
+    for (auto &shard : _shards) {
+      shard.reset(new Shard());
+      shard->capacity = shard_capacity;
+    }
+  }
+
+  // starts a pull of the table, returns its step
+  uint64_t NextStep() { return _step.fetch_add(1) + 1; }
+
+  // copies the value of key to value, false when it is not cached or stale
+  bool Lookup(uint64_t key, uint64_t step, void *value) {
+    auto &shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      return false;
+    }
+    uint32_t slot = it->second;
+    if (_refresh_steps > 0 && step - shard.steps[slot] >= _refresh_steps) {
+      return false;
+    }
+    shard.referenced[slot] = 1;
+    memcpy(value, &shard.values[slot * _value_size], _value_size);
+    return true;
+  }
+
+  // caches the value of key pulled by step
+  void Insert(uint64_t key, uint64_t step, const void *value) {
+    auto &shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.capacity == 0 || step <= shard.erase_step) {
+      return;
+    }
+    uint32_t slot = 0;
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      slot = it->second;
+      // a slower pull must not replace a newer value
+      if (step < shard.steps[slot]) {
+        return;
+      }
+    } else {
+      slot = shard.Allocate();
+      shard.keys[slot] = key;
+      shard.valid[slot] = 1;
+      shard.referenced[slot] = 0;
+      shard.index.emplace(key, slot);
+      if (shard.values.size() < (slot + 1) * _value_size) {
+        shard.values.resize((slot + 1) * _value_size);
+      }
+    }
+    shard.steps[slot] = step;
+    memcpy(&shard.values[slot * _value_size], value, _value_size);
+  }
+
+  // called once the push of key is applied, the pulls started before it are
+  // not inserted
+  void Erase(uint64_t key) {
+    auto &shard = GetShard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.erase_step = _step.load();
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      return;
+    }
+    shard.valid[it->second] = 0;
+    shard.referenced[it->second] = 0;
+    shard.index.erase(it);
+  }
+
+  void AddStat(uint64_t hit_num, uint64_t miss_num) {
+    _hit_num.fetch_add(hit_num, std::memory_order_relaxed);
+    _miss_num.fetch_add(miss_num, std::memory_order_relaxed);
+  }
+  uint64_t HitNum() const { return _hit_num.load(); }
+  uint64_t MissNum() const { return _miss_num.load(); }
+
+ private:
+  struct Shard {
+    std::mutex mutex;
+    size_t capacity = 0;
+    size_t hand = 0;
+    // the last step started before an Erase of a key of the shard
+    uint64_t erase_step = 0;
+    std::unordered_map<uint64_t, uint32_t> index;
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> steps;
+    std::vector<uint8_t> valid;
+    std::vector<uint8_t> referenced;
+    std::vector<char> values;
+
+    // a new slot while the shard is not full, else the first slot the hand
+    // finds not looked up since its last pass
+    uint32_t Allocate() {
+      if (keys.size() < capacity) {
+        keys.push_back(0);
+        steps.push_back(0);
+        valid.push_back(0);
+        referenced.push_back(0);
+        return keys.size() - 1;
+      }
+      while (referenced[hand]) {
+        referenced[hand] = 0;
+        hand = (hand + 1) % capacity;
+      }
+      uint32_t slot = hand;
+      hand = (hand + 1) % capacity;
+      if (valid[slot]) {
+        index.erase(keys[slot]);
+      }
+      return slot;
+    }
+  };
+
+  Shard &GetShard(uint64_t key) {
+    return *_shards[(key * 0x9E3779B97F4A7C15ULL >> 32) % _shards.size()];
+  }
+
+  size_t _value_size;
+  uint32_t _refresh_steps;
+  std::atomic<uint64_t> _step{0};
+  std::atomic<uint64_t> _hit_num{0};
+  std::atomic<uint64_t> _miss_num{0};
+  std::vector<std::unique_ptr<Shard>> _shards;
+};
+
+}  // namespace distributed
+}  // namespace paddle
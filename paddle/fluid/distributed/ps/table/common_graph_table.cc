@@ -23,6 +23,7 @@
 
 #include "gflags/gflags.h"
 #include "paddle/fluid/distributed/common/utils.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_file_reader.h"
 #include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
 #include "paddle/fluid/framework/generator.h"
 #include "paddle/fluid/framework/io/fs.h"
@@ -31,6 +32,7 @@
 #include "paddle/fluid/string/string_helper.h"
 
 DECLARE_bool(graph_load_in_parallel);
+DECLARE_int32(graph_load_block_size_mb);
 
 namespace paddle {
 namespace distributed {
@@ -981,6 +983,42 @@ void GraphShard::clear() {
   }
   bucket.clear();
   node_location.clear();
+  csr.reset();
+}
+
+void GraphShard::build_csr() {
+  if (csr != nullptr) {
+    return;
+  }
+  csr.reset(new GraphCSR());
+  csr->build(bucket);
+  for (size_t i = 0; i < bucket.size(); i++) {
+    Node *node = new CSRGraphNode(bucket[i]->get_id(), csr.get(), i);
+    delete bucket[i];
+    bucket[i] = node;
+  }
+}
+
+void GraphShard::unpack_csr() {
+  if (csr == nullptr) {
+    return;
+  }
+  VLOG(1) << "unpack csr of " << bucket.size() << " nodes and "
+          << csr->edge_num() << " edges to update the shard";
+  for (size_t i = 0; i < bucket.size(); i++) {
+    uint32_t degree = csr->degree(i);
+    GraphNode *node = new GraphNode(bucket[i]->get_id());
+    node->build_edges(csr->is_weighted());
+    for (uint32_t j = 0; j < degree; j++) {
+      node->add_edge(csr->neighbor_id(i, j), csr->neighbor_weight(i, j));
+    }
+    bool weighted_sampler = csr->sample_type() == "weighted" &&
+                            csr->is_weighted() && degree > 0;
+    node->build_sampler(weighted_sampler ? "weighted" : "random");
+    delete bucket[i];
+    bucket[i] = node;
+  }
+  csr.reset();
 }
 
 GraphShard::~GraphShard() { clear(); }
@@ -988,6 +1026,7 @@ GraphShard::~GraphShard() { clear(); }
 void GraphShard::delete_node(uint64_t id) {
   auto iter = node_location.find(id);
   if (iter == node_location.end()) return;
+  if (csr != nullptr) unpack_csr();
   int pos = iter->second;
   delete bucket[pos];
   if (pos != (int)bucket.size() - 1) {
@@ -998,6 +1037,7 @@ void GraphShard::delete_node(uint64_t id) {
   bucket.pop_back();
 }
 GraphNode *GraphShard::add_graph_node(uint64_t id) {
+  if (csr != nullptr) unpack_csr();
   if (node_location.find(id) == node_location.end()) {
     node_location[id] = bucket.size();
     bucket.push_back(new GraphNode(id));
@@ -1006,6 +1046,7 @@ GraphNode *GraphShard::add_graph_node(uint64_t id) {
 }
 
 GraphNode *GraphShard::add_graph_node(Node *node) {
+  if (csr != nullptr) unpack_csr();
   auto id = node->get_id();
   if (node_location.find(id) == node_location.end()) {
     node_location[id] = bucket.size();
@@ -1028,6 +1069,7 @@ FeatureNode *GraphShard::add_feature_node(uint64_t id, bool is_overlap) {
 }
 
 void GraphShard::add_neighbor(uint64_t id, uint64_t dst_id, float weight) {
+  if (csr != nullptr) unpack_csr();
   find_node(id)->add_edge(dst_id, weight);
 }
 
@@ -1297,7 +1339,23 @@ int32_t GraphTable::load_nodes(const std::string &path, std::string node_type) {
   uint64_t count = 0;
   uint64_t valid_count = 0;
   int idx = 0;
-  if (FLAGS_graph_load_in_parallel) {
+  if (FLAGS_graph_load_block_size_mb > 0) {
+    if (!FLAGS_graph_load_in_parallel && node_type != "") {
+      if (feature_to_id.find(node_type) == feature_to_id.end()) {
+        VLOG(0) << "node_type " << node_type
+                << " is not defined, nothing will be loaded";
+        return 0;
+      }
+      idx = feature_to_id[node_type];
+    }
+    VLOG(0) << "Begin GraphTable::load_nodes() node_type[" << node_type
+            << "] in blocks";
+    bool typed = FLAGS_graph_load_in_parallel;
+    auto res =
+        load_nodes_in_blocks(paths, typed ? "" : node_type, idx, typed);
+    count = res.first;
+    valid_count = res.second;
+  } else if (FLAGS_graph_load_in_parallel) {
     if (node_type == "") {
       VLOG(0) << "Begin GraphTable::load_nodes(), will load all node_type once";
     }
@@ -1341,6 +1399,10 @@ int32_t GraphTable::load_nodes(const std::string &path, std::string node_type) {
 
 int32_t GraphTable::build_sampler(int idx, std::string sample_type) {
   for (auto &shard : edge_shards[idx]) {
+    if (shard->get_csr() != nullptr) {
+      shard->get_csr()->build_sampler(sample_type);
+      continue;
+    }
     auto bucket = shard->get_bucket();
     for (size_t i = 0; i < bucket.size(); i++) {
       bucket[i]->build_sampler(sample_type);
@@ -1349,6 +1411,23 @@ int32_t GraphTable::build_sampler(int idx, std::string sample_type) {
   return 0;
 }
 
+int32_t GraphTable::build_csr(int idx) {
+  auto &shards = edge_shards[idx];
+  std::vector<std::future<int>> tasks;
+  for (size_t i = 0; i < shards.size(); ++i) {
+    // load_edges may run on a shard task pool, packing there could wait on
+    // itself
+    tasks.push_back(load_node_edge_task_pool->enqueue([&shards, i]() -> int {
+      shards[i]->build_csr();
+      return 0;
+    }));
+  }
+  for (auto &task : tasks) {
+    task.get();
+  }
+  return 0;
+}
+
 std::pair<uint64_t, uint64_t> GraphTable::parse_edge_file(
     const std::string &path, int idx, bool reverse) {
   std::string sample_type = "random";
@@ -1407,6 +1486,280 @@ std::pair<uint64_t, uint64_t> GraphTable::parse_edge_file(
   return {local_count, local_valid_count};
 }
 
+namespace {
+
+struct GraphEdgeRecord {
+  uint64_t src_id;
+  uint64_t dst_id;
+  float weight;
+  bool is_weighted;
+};
+
+// the features of the node are the tab separated [feat_begin, feat_end)
+struct GraphNodeRecord {
+  int idx;
+  uint64_t id;
+  const char *feat_begin;
+  const char *feat_end;
+};
+
+// the records a block parsed, by local shard
+template <typename Record>
+struct ParsedGraphBlock {
+  std::vector<std::vector<Record>> shards;
+  uint64_t count = 0;
+  uint64_t valid_count = 0;
+  // the node records point into the block
+  std::shared_ptr<void> holder;
+  size_t file_idx = 0;
+  // an edge line of the block has a weight
+  bool is_weighted = false;
+  // an edge line of an earlier block of the file has a weight
+  bool weighted_before = false;
+};
+
+// the shard of the edges of a FLAGS_graph_load_in_parallel file, the number
+// after the last '-' of its name
+uint64_t GraphFilePartNum(const std::string &path) {
+  auto path_split = paddle::string::split_string<std::string>(path, "/");
+  auto part_name_split = paddle::string::split_string<std::string>(
+      path_split[path_split.size() - 1], "-");
+  return std::stoull(part_name_split[part_name_split.size() - 1]);
+}
+
+}  // namespace
+
+template <typename Record, typename ParseFunc, typename AddFunc>
+std::pair<uint64_t, uint64_t> GraphTable::load_file_blocks(
+    const std::vector<std::string> &paths, ParseFunc parse, AddFunc add) {
+  GraphFileReader reader(
+      paths, static_cast<size_t>(FLAGS_graph_load_block_size_mb) << 20);
+  // a round parses one block per load thread, which bounds the memory
+  size_t round_blocks = load_thread_num;
+  uint64_t count = 0;
+  uint64_t valid_count = 0;
+  // like the line loaders, a weighted edge line turns the rest of its file
+  // weighted
+  size_t weighted_file = paths.size();
+  bool has_next = true;
+  while (has_next) {
+    std::vector<std::unique_ptr<ParsedGraphBlock<Record>>> parsed;
+    std::vector<std::future<int>> tasks;
+    GraphFileBlock block;
+    while (parsed.size() < round_blocks && (has_next = reader.Next(&block))) {
+      parsed.emplace_back(new ParsedGraphBlock<Record>());
+      auto *out = parsed.back().get();
+      out->shards.resize(shard_num_per_server);
+      out->holder = block.holder;
+      out->file_idx = block.file_idx;
+      tasks.push_back(
+          load_node_edge_task_pool->enqueue([block, out, &parse]() -> int {
+            parse(block, out);
+            return 0;
+          }));
+    }
+    for (auto &task : tasks) {
+      task.get();
+    }
+    tasks.clear();
+    for (auto &out : parsed) {
+      out->weighted_before = out->file_idx == weighted_file;
+      if (out->is_weighted) {
+        weighted_file = out->file_idx;
+      }
+    }
+    // every shard takes its records in file order, no locks
+    for (size_t i = 0; i < shard_num_per_server; ++i) {
+      tasks.push_back(
+          load_node_edge_task_pool->enqueue([&parsed, &add, i]() -> int {
+            for (auto &out : parsed) {
+              for (auto &record : out->shards[i]) {
+                add(i, *out, record);
+              }
+            }
+            return 0;
+          }));
+    }
+    for (auto &task : tasks) {
+      task.get();
+    }
+    for (auto &out : parsed) {
+      count += out->count;
+      valid_count += out->valid_count;
+    }
+  }
+  return {count, valid_count};
+}
+
+std::pair<uint64_t, uint64_t> GraphTable::load_edges_in_blocks(
+    const std::vector<std::string> &paths, int idx, bool reverse) {
+  auto parse = [this, reverse](const GraphFileBlock &block,
+                               ParsedGraphBlock<GraphEdgeRecord> *out) {
+    int64_t part_shard_id = -1;
+    if (FLAGS_graph_load_in_parallel) {
+      part_shard_id = GraphFilePartNum(*block.path) % shard_num;
+    }
+    // once a line has a weight the later edges of the block are weighted,
+    // load_file_blocks carries it to the later blocks of the file
+    bool is_weighted = false;
+    const char *end = block.end;
+    const char *line = block.begin;
+    while (line < end) {
+      const char *line_end =
+          static_cast<const char *>(memchr(line, '\n', end - line));
+      if (line_end == nullptr) {
+        line_end = end;
+      }
+      const char *start =
+          static_cast<const char *>(memchr(line, '\t', line_end - line));
+      if (start == nullptr) {
+        line = line_end + 1;
+        continue;
+      }
+      out->count++;
+      const char *p = line;
+      uint64_t src_id = GraphParseUInt64(&p, start);
+      p = start + 1;
+      uint64_t dst_id = GraphParseUInt64(&p, line_end);
+      if (reverse) {
+        std::swap(src_id, dst_id);
+      }
+      size_t src_shard_id = src_id % shard_num;
+      if (part_shard_id >= 0 &&
+          src_shard_id != static_cast<size_t>(part_shard_id)) {
+        line = line_end + 1;
+        continue;
+      }
+      float weight = 1;
+      const char *last = line_end - 1;
+      while (*last != '\t') {
+        --last;
+      }
+      if (last != start) {
+        // the line ends with '\n' or '\0'
+        weight = strtof(last + 1, nullptr);
+        is_weighted = true;
+      }
+      if (src_shard_id >= shard_end || src_shard_id < shard_start) {
+        VLOG(4) << "will not load " << src_id << " from " << *block.path
+                << ", please check id distribution";
+        line = line_end + 1;
+        continue;
+      }
+      out->shards[src_shard_id - shard_start].push_back(
+          {src_id, dst_id, weight, is_weighted});
+      out->valid_count++;
+      line = line_end + 1;
+    }
+    out->is_weighted = is_weighted;
+  };
+  auto &shards = edge_shards[idx];
+  auto add = [&shards](size_t shard_idx,
+                       const ParsedGraphBlock<GraphEdgeRecord> &block,
+                       const GraphEdgeRecord &edge) {
+    auto node = shards[shard_idx]->add_graph_node(edge.src_id);
+    if (node != NULL) {
+      node->build_edges(edge.is_weighted || block.weighted_before);
+      node->add_edge(edge.dst_id, edge.weight);
+    }
+  };
+  return load_file_blocks<GraphEdgeRecord>(paths, parse, add);
+}
+
+std::pair<uint64_t, uint64_t> GraphTable::load_nodes_in_blocks(
+    const std::vector<std::string> &paths,
+    const std::string &node_type,
+    int idx,
+    bool typed) {
+  auto parse = [this, &node_type, idx, typed](
+                   const GraphFileBlock &block,
+                   ParsedGraphBlock<GraphNodeRecord> *out) {
+    size_t n = node_type.length();
+    const char *end = block.end;
+    const char *line = block.begin;
+    for (; line < end; line = std::min(end, line + 1)) {
+      const char *line_end =
+          static_cast<const char *>(memchr(line, '\n', end - line));
+      if (line_end == nullptr) {
+        line_end = end;
+      }
+      const char *p = line;
+      line = line_end;
+      // type\tid\tfeatures, with the repeated tabs skipped like
+      // split_string_ptr. Like parse_node_file the n + 1 bytes of
+      // node_type\t are skipped when the lines are not typed, even for an
+      // empty node_type.
+      int type_idx = idx;
+      if (!typed) {
+        if (static_cast<size_t>(line_end - p) <= n ||
+            strncmp(p, node_type.c_str(), n) != 0) {
+          continue;
+        }
+        p += n + 1;
+      } else {
+        const char *type_end =
+            static_cast<const char *>(memchr(p, '\t', line_end - p));
+        if (type_end == nullptr) {
+          continue;
+        }
+        auto it = feature_to_id.find(std::string(p, type_end - p));
+        if (it == feature_to_id.end()) {
+          VLOG(0) << std::string(p, type_end - p) << "type error, please check";
+          continue;
+        }
+        type_idx = it->second;
+        p = type_end + 1;
+      }
+      while (p < line_end && *p == '\t') {
+        ++p;
+      }
+      if (p == line_end) {
+        continue;
+      }
+      uint64_t id = GraphParseUInt64(&p, line_end);
+      size_t shard_id = id % shard_num;
+      if (shard_id >= shard_end || shard_id < shard_start) {
+        VLOG(4) << "will not load " << id << " from " << *block.path
+                << ", please check id distribution";
+        continue;
+      }
+      out->count++;
+      const char *feat_begin =
+          static_cast<const char *>(memchr(p, '\t', line_end - p));
+      if (feat_begin == nullptr) {
+        feat_begin = line_end;
+      }
+      out->shards[shard_id - shard_start].push_back(
+          {type_idx, id, feat_begin, line_end});
+      out->valid_count++;
+    }
+  };
+  bool set_size = !typed;
+  auto add = [this, set_size](size_t shard_idx,
+                              const ParsedGraphBlock<GraphNodeRecord> &block,
+                              const GraphNodeRecord &rec) {
+    auto node =
+        feature_shards[rec.idx][shard_idx]->add_feature_node(rec.id, false);
+    if (node == NULL) {
+      return;
+    }
+    if (set_size) {
+      node->set_feature_size(feat_name[rec.idx].size());
+    }
+    thread_local std::vector<paddle::string::str_ptr> vals;
+    vals.clear();
+    const char *p = rec.feat_begin;
+    while (p < rec.feat_end && *p == '\t') {
+      ++p;
+    }
+    paddle::string::split_string_ptr(p, rec.feat_end - p, '\t', &vals);
+    for (auto &v : vals) {
+      parse_feature(rec.idx, v.ptr, v.len, node);
+    }
+  };
+  return load_file_blocks<GraphNodeRecord>(paths, parse, add);
+}
+
 int32_t GraphTable::load_edges(const std::string &path,
                                bool reverse_edge,
                                const std::string &edge_type) {
@@ -1432,7 +1785,11 @@ int32_t GraphTable::load_edges(const std::string &path,
   uint64_t valid_count = 0;
 
   VLOG(0) << "Begin GraphTable::load_edges() edge_type[" << edge_type << "]";
-  if (FLAGS_graph_load_in_parallel) {
+  if (FLAGS_graph_load_block_size_mb > 0) {
+    auto res = load_edges_in_blocks(paths, idx, reverse_edge);
+    count = res.first;
+    valid_count = res.second;
+  } else if (FLAGS_graph_load_in_parallel) {
     std::vector<std::future<std::pair<uint64_t, uint64_t>>> tasks;
     for (int i = 0; i < paths.size(); i++) {
       tasks.push_back(load_node_edge_task_pool->enqueue(
@@ -1467,7 +1824,11 @@ int32_t GraphTable::load_edges(const std::string &path,
   }
 #endif
 
-  if (!build_sampler_on_cpu) {
+  if (edge_use_csr[idx]) {
+    // the shards sample from their csr, no node keeps a sampler
+    VLOG(0) << "pack edge_type[" << edge_type << "] into csr ... ";
+    build_csr(idx);
+  } else if (!build_sampler_on_cpu) {
     // To reduce memory overhead, CPU samplers won't be created in gpugraph.
     // In order not to affect the sampler function of other scenario,
     // this optimization is only performed in load_edges function.
@@ -1636,6 +1997,7 @@ int32_t GraphTable::random_sample_neighbors(
       int index = 0;
       std::vector<SampleResult> sample_res;
       std::vector<SampleKey> sample_keys;
+      std::vector<int> res;
       auto &rng = _shards_task_rng_pool[i];
       for (size_t k = 0; k < id_list[i].size(); k++) {
         if (index < (int)r.size() &&
@@ -1667,7 +2029,16 @@ int32_t GraphTable::random_sample_neighbors(
             continue;
           }
           std::shared_ptr<char> &buffer = buffers[idy];
-          std::vector<int> res = node->sample_k(sample_size, rng);
+          // a csr shard samples into res without virtual calls
+          GraphCSR *csr =
+              edge_shards[idx][node_id % shard_num - shard_start]->get_csr();
+          uint32_t csr_pos = 0;
+          if (csr != nullptr) {
+            csr_pos = static_cast<CSRGraphNode *>(node)->get_csr_pos();
+            csr->sample_k(csr_pos, sample_size, rng.get(), &res);
+          } else {
+            res = node->sample_k(sample_size, rng);
+          }
           actual_size =
               res.size() * (need_weight ? (Node::id_size + Node::weight_size)
                                         : Node::id_size);
@@ -1683,11 +2054,13 @@ int32_t GraphTable::random_sample_neighbors(
             buffer.reset(buffer_addr, char_del);
           }
           for (int &x : res) {
-            id = node->get_neighbor_id(x);
+            id = csr != nullptr ? csr->neighbor_id(csr_pos, x)
+                                : node->get_neighbor_id(x);
             memcpy(buffer_addr + offset, &id, Node::id_size);
             offset += Node::id_size;
             if (need_weight) {
-              weight = node->get_neighbor_weight(x);
+              weight = csr != nullptr ? csr->neighbor_weight(csr_pos, x)
+                                      : node->get_neighbor_weight(x);
               memcpy(buffer_addr + offset, &weight, Node::weight_size);
               offset += Node::weight_size;
             }
@@ -2200,6 +2573,13 @@ int32_t GraphTable::Initialize(const GraphParameter &graph) {
   VLOG(0) << "in init graph table shard idx = " << _shard_idx << " shard_start "
           << shard_start << " shard_end " << shard_end;
   edge_shards.resize(id_to_edge.size());
+  edge_use_csr.assign(id_to_edge.size(), false);
+  for (auto &edge_type : graph.csr_edge_types()) {
+    if (edge_to_id.find(edge_type) != edge_to_id.end()) {
+      VLOG(0) << "edge_type " << edge_type << " is kept in csr";
+      edge_use_csr[edge_to_id[edge_type]] = true;
+    }
+  }
   node_weight.resize(2);
   node_weight[0].resize(id_to_edge.size());
 #ifdef PADDLE_WITH_HETERPS
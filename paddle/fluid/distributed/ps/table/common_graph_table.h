@@ -129,10 +129,20 @@ class GraphShard {
   std::unordered_map<uint64_t, int> &get_node_location() {
     return node_location;
   }
+  // packs the edges into an immutable GraphCSR and replaces the nodes by
+  // CSRGraphNode. Adding or deleting nodes or edges unpacks the whole shard
+  // into GraphNode again, O(edges of the shard) once, and the shard stays
+  // unpacked until the next build_csr: load_edges packs again after the file,
+  // add_graph_node and remove_graph_node leave it unpacked, so frequent small
+  // updates should not go to a csr edge type.
+  void build_csr();
+  void unpack_csr();
+  GraphCSR *get_csr() { return csr.get(); }
 
  private:
   std::unordered_map<uint64_t, int> node_location;
   std::vector<Node *> bucket;
+  std::unique_ptr<GraphCSR> csr;
 };
 
 enum LRUResponse { ok = 0, blocked = 1, err = 2 };
@@ -577,6 +587,21 @@ class GraphTable : public Table {
                                                 const std::string &node_type,
                                                 int idx);
   std::pair<uint64_t, uint64_t> parse_node_file(const std::string &path);
+  // the block loaders of FLAGS_graph_load_block_size_mb: the blocks of the
+  // files are parsed in parallel into per shard buffers, then every shard
+  // adds its part of a round of blocks in parallel
+  std::pair<uint64_t, uint64_t> load_edges_in_blocks(
+      const std::vector<std::string> &paths, int idx, bool reverse);
+  // typed reads the node type of every line, else the lines of node_type
+  // are loaded into idx like parse_node_file(path, node_type, idx)
+  std::pair<uint64_t, uint64_t> load_nodes_in_blocks(
+      const std::vector<std::string> &paths,
+      const std::string &node_type,
+      int idx,
+      bool typed);
+  template <typename Record, typename ParseFunc, typename AddFunc>
+  std::pair<uint64_t, uint64_t> load_file_blocks(
+      const std::vector<std::string> &paths, ParseFunc parse, AddFunc add);
   int32_t add_graph_node(int idx,
                          std::vector<uint64_t> &id_list,
                          std::vector<bool> &is_weight_list);
@@ -691,6 +716,8 @@ class GraphTable : public Table {
 #endif
   virtual int32_t add_comm_edge(int idx, uint64_t src_id, uint64_t dst_id);
   virtual int32_t build_sampler(int idx, std::string sample_type = "random");
+  // packs the shards of edge type idx into csr, see GraphShard::build_csr
+  int32_t build_csr(int idx);
   void set_feature_separator(const std::string &ch);
   std::vector<std::vector<GraphShard *>> edge_shards, feature_shards;
   size_t shard_start, shard_end, server_num, shard_num_per_server, shard_num;
@@ -705,6 +732,8 @@ class GraphTable : public Table {
   std::vector<std::vector<int32_t>> feat_shape;
   std::vector<std::unordered_map<std::string, int32_t>> feat_id_map;
   std::unordered_map<std::string, int> feature_to_id, edge_to_id;
+  // edge types kept in csr after load_edges
+  std::vector<bool> edge_use_csr;
   std::vector<std::string> id_to_feature, id_to_edge;
   std::string table_name;
   std::string table_type;
@@ -15,6 +15,8 @@
 #pragma once
 
 #include <mct/hash-map.hpp>
+#include <algorithm>
+#include <utility>
 #include <vector>
 
 #include "gflags/gflags.h"
@@ -26,6 +28,8 @@ namespace distributed {
 static const int CTR_SPARSE_SHARD_BUCKET_NUM_BITS = 6;
 static const size_t CTR_SPARSE_SHARD_BUCKET_NUM =
     static_cast<size_t>(1) << CTR_SPARSE_SHARD_BUCKET_NUM_BITS;
+// keys probed by find_batch before their values are prefetched
+static const size_t SPARSE_SHARD_FIND_GROUP = 16;
 
 class FixedFeatureValue {
  public:
@@ -43,6 +47,7 @@ class FixedFeatureValue {
 template <class KEY, class VALUE>
 struct alignas(64) SparseTableShard {
  public:
+  typedef VALUE value_type;
   typedef typename mct::closed_hash_map<KEY, mct::Pointer, std::hash<KEY>>
       map_type;
   struct iterator {
@@ -99,6 +104,12 @@ struct alignas(64) SparseTableShard {
       _buckets[bucket].max_load_factor(x);
     }
   }
+  // keys spread evenly over the buckets by their high bits
+  void reserve(size_t size) {
+    for (size_t bucket = 0; bucket < CTR_SPARSE_SHARD_BUCKET_NUM; bucket++) {
+      _buckets[bucket].reserve(size / CTR_SPARSE_SHARD_BUCKET_NUM + 1);
+    }
+  }
   size_t bucket_count() { return CTR_SPARSE_SHARD_BUCKET_NUM; }
   size_t bucket_size(size_t bucket) { return _buckets[bucket].size(); }
   void clear() {
@@ -135,6 +146,39 @@ struct alignas(64) SparseTableShard {
     }
     return {it, bucket, _buckets};
   }
+  // values[i] is NULL when keys[i] is missing. The keys of a group are
+  // hashed and their buckets prefetched before any of them is probed, the
+  // value nodes found are prefetched and their data is prefetched while the
+  // next group is probed. The data of the last group is left to the caller.
+  void find_batch(const KEY* keys, size_t num, VALUE** values) {
+    size_t hashes[SPARSE_SHARD_FIND_GROUP];
+    size_t buckets[SPARSE_SHARD_FIND_GROUP];
+    for (size_t group_begin = 0; group_begin < num;
+         group_begin += SPARSE_SHARD_FIND_GROUP) {
+      size_t group_num = std::min(num - group_begin, SPARSE_SHARD_FIND_GROUP);
+      const KEY* group_keys = keys + group_begin;
+      VALUE** group_values = values + group_begin;
+      for (size_t i = 0; i < group_num; ++i) {
+        hashes[i] = _hasher(group_keys[i]);
+        buckets[i] = compute_bucket(hashes[i]);
+        __builtin_prefetch(&_buckets[buckets[i]]);
+      }
+      for (size_t i = 0; i < group_num; ++i) {
+        map_type& data = _buckets[buckets[i]];
+        auto it = data.find_with_hash(group_keys[i], hashes[i]);
+        if (it == data.end()) {
+          group_values[i] = NULL;
+        } else {
+          group_values[i] = (VALUE*)(void*)it->second;  // NOLINT
+          __builtin_prefetch(group_values[i]);
+        }
+      }
+      if (group_begin > 0) {
+        prefetch_data(group_values - SPARSE_SHARD_FIND_GROUP,
+                      SPARSE_SHARD_FIND_GROUP);
+      }
+    }
+  }
   VALUE& operator[](const KEY& key) { return emplace(key).first.value(); }
   std::pair<iterator, bool> insert(const KEY& key, const VALUE& val) {
     return emplace(key, val);
@@ -193,10 +237,50 @@ struct alignas(64) SparseTableShard {
   }
 
  private:
+  static void prefetch_data(VALUE** values, size_t num) {
+    for (size_t i = 0; i < num; ++i) {
+      if (values[i] != NULL) {
+        __builtin_prefetch(values[i]->data());
+      }
+    }
+  }
+
   map_type _buckets[CTR_SPARSE_SHARD_BUCKET_NUM];
   ChunkAllocator<VALUE> _alloc;
   std::hash<KEY> _hasher;
 };
 
+// Looks up the keys of a shard task SPARSE_SHARD_FIND_BATCH at a time with
+// find_batch. Get must be called with increasing index, a NULL value may have
+// been inserted by a duplicate key earlier in the same batch.
+static const size_t SPARSE_SHARD_FIND_BATCH = 256;
+
+template <class SHARD>
+class SparseShardBatchFinder {
+ public:
+  typedef typename SHARD::value_type value_type;
+  SparseShardBatchFinder(SHARD* shard,
+                         const std::vector<std::pair<uint64_t, int>>& keys)
+      : _shard(shard), _keys(keys) {}
+
+  value_type* Get(size_t i) {
+    size_t batch_idx = i % SPARSE_SHARD_FIND_BATCH;
+    if (batch_idx == 0) {
+      size_t batch_num = std::min(SPARSE_SHARD_FIND_BATCH, _keys.size() - i);
+      for (size_t j = 0; j < batch_num; ++j) {
+        _batch_keys[j] = _keys[i + j].first;
+      }
+      _shard->find_batch(_batch_keys, batch_num, _batch_values);
+    }
+    return _batch_values[batch_idx];
+  }
+
+ private:
+  SHARD* _shard;
+  const std::vector<std::pair<uint64_t, int>>& _keys;
+  uint64_t _batch_keys[SPARSE_SHARD_FIND_BATCH];
+  value_type* _batch_values[SPARSE_SHARD_FIND_BATCH];
+};
+
 }  // namespace distributed
 }  // namespace paddle
@@ -0,0 +1,384 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// Feature value kept in a slab slot, the floats follow the header. Values
+// that grow past the inline capacity (e.g. embedx created later) move to an
+// external buffer and come back inline when they shrink again.
+class InlineFeatureValue {
+ public:
+  float* data() { return _ext != nullptr ? _ext : inline_data(); }
+  const float* data() const {
+    return _ext != nullptr ? _ext : inline_data();
+  }
+  size_t size() const { return _size; }
+  size_t inline_capacity() const { return _inline_capacity; }
+  bool is_inline() const { return _ext == nullptr; }
+  // new elements are zero, like std::vector
+  void resize(size_t size) {
+    size_t keep = std::min<size_t>(size, _size);
+    if (size <= _inline_capacity) {
+      if (_ext != nullptr) {
+        memcpy(inline_data(), _ext, keep * sizeof(float));
+        free_ext();
+      }
+    } else if (_ext == nullptr || size > _ext_capacity) {
+      CHECK(size <= std::numeric_limits<uint16_t>::max())
+          << "inline feature value too large: " << size;
+      float* ext = new float[size];
+      memcpy(ext, data(), keep * sizeof(float));
+      free_ext();
+      _ext = ext;
+      _ext_capacity = static_cast<uint16_t>(size);
+    }
+    if (size > keep) {
+      memset(data() + keep, 0, (size - keep) * sizeof(float));
+    }
+    _size = static_cast<uint32_t>(size);
+  }
+  void shrink_to_fit() {}
+
+ private:
+  friend class InlineValueSlab;
+  float* inline_data() { return reinterpret_cast<float*>(this + 1); }
+  const float* inline_data() const {
+    return reinterpret_cast<const float*>(this + 1);
+  }
+  void reset(uint16_t inline_capacity) {
+    _size = 0;
+    _inline_capacity = inline_capacity;
+    _ext_capacity = 0;
+    _ext = nullptr;
+  }
+  void free_ext() {
+    delete[] _ext;
+    _ext = nullptr;
+    _ext_capacity = 0;
+  }
+
+  uint32_t _size;
+  uint16_t _inline_capacity;
+  uint16_t _ext_capacity;
+  float* _ext;
+};
+
+// Fixed size slots carved from large pages, freed slots are reused
+class InlineValueSlab {
+ public:
+  InlineValueSlab() {}
+  InlineValueSlab(const InlineValueSlab&) = delete;
+  ~InlineValueSlab() { clear(); }
+
+  void init(size_t inline_dim) {
+    CHECK(_size == 0) << "init slab after values are acquired";
+    CHECK(inline_dim < 65536) << "inline dim too large: " << inline_dim;
+    _inline_dim = static_cast<uint16_t>(inline_dim);
+    _slot_bytes = sizeof(InlineFeatureValue) + inline_dim * sizeof(float);
+    _slot_bytes = (_slot_bytes + kSlotAlign - 1) / kSlotAlign * kSlotAlign;
+    _slots_per_page = std::max<size_t>(kPageBytes / _slot_bytes, 1);
+  }
+  InlineFeatureValue* acquire() {
+    if (_free_slots == nullptr) {
+      new_page();
+    }
+    FreeSlot* slot = _free_slots;
+    _free_slots = slot->next;
+    auto* value = reinterpret_cast<InlineFeatureValue*>(slot);
+    value->reset(_inline_dim);
+    ++_size;
+    return value;
+  }
+  void release(InlineFeatureValue* value) {
+    value->free_ext();
+    auto* slot = reinterpret_cast<FreeSlot*>(value);
+    slot->next = _free_slots;
+    _free_slots = slot;
+    --_size;
+  }
+  // all values must be released or dropped together with the pages
+  void clear() {
+    for (auto page : _pages) {
+      free(page);
+    }
+    _pages.clear();
+    _free_slots = nullptr;
+    _size = 0;
+  }
+  size_t size() const { return _size; }
+  size_t inline_dim() const { return _inline_dim; }
+
+ private:
+  static const size_t kPageBytes = 1 << 20;
+  static const size_t kSlotAlign = 8;
+  struct FreeSlot {
+    FreeSlot* next;
+  };
+  void new_page() {
+    char* page = nullptr;
+    CHECK(posix_memalign(reinterpret_cast<void**>(&page),
+                         64,
+                         _slot_bytes * _slots_per_page) == 0);
+    _pages.push_back(page);
+    for (size_t i = _slots_per_page; i > 0; --i) {
+      auto* slot = reinterpret_cast<FreeSlot*>(page + (i - 1) * _slot_bytes);
+      slot->next = _free_slots;
+      _free_slots = slot;
+    }
+  }
+
+  uint16_t _inline_dim = 0;
+  size_t _slot_bytes = sizeof(InlineFeatureValue);
+  size_t _slots_per_page = 1;
+  std::vector<char*> _pages;
+  FreeSlot* _free_slots = nullptr;
+  size_t _size = 0;
+};
+
+// uint64 keyed open addressing shard with values in a slab, same interface
+// as SparseTableShard<uint64_t, FixedFeatureValue> used by the tables.
+// Linear probing with backward shift deletion, so there are no tombstones.
+struct alignas(64) InlineSparseTableShard {
+ public:
+  typedef InlineFeatureValue value_type;
+  struct Entry {
+    uint64_t key;
+    InlineFeatureValue* value;
+  };
+  // iteration starts after an empty entry, so entries moved by erase are
+  // always ahead of the iterator and every entry is visited once
+  struct iterator {
+    InlineSparseTableShard* shard;
+    size_t pos;
+    size_t left;
+    friend bool operator==(const iterator& a, const iterator& b) {
+      return (a.left == 0 && b.left == 0) ||
+             (a.left == b.left && a.pos == b.pos);
+    }
+    friend bool operator!=(const iterator& a, const iterator& b) {
+      return !(a == b);
+    }
+    const uint64_t& key() const { return shard->_entries[pos].key; }
+    InlineFeatureValue& value() const { return *shard->_entries[pos].value; }
+    InlineFeatureValue* value_ptr() const {
+      return shard->_entries[pos].value;
+    }
+    iterator& operator++() {
+      if (left > 0) {
+        pos = (pos + 1) & shard->_mask;
+        --left;
+        skip_empty();
+      }
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator ret = *this;
+      ++*this;
+      return ret;
+    }
+    void skip_empty() {
+      while (left > 0 && shard->_entries[pos].value == nullptr) {
+        pos = (pos + 1) & shard->_mask;
+        --left;
+      }
+    }
+  };
+
+  InlineSparseTableShard() { rehash(kMinCapacity); }
+  ~InlineSparseTableShard() { clear(); }
+
+  void init(size_t inline_dim) { _slab.init(inline_dim); }
+  bool empty() { return _size == 0; }
+  size_t size() { return _size; }
+  size_t capacity() { return _entries.size(); }
+  void reserve(size_t size) {
+    size_t capacity = _entries.size();
+    while (size * kMaxLoadDen > capacity * kMaxLoadNum) {
+      capacity *= 2;
+    }
+    if (capacity != _entries.size()) {
+      rehash(capacity);
+    }
+  }
+  void clear() {
+    for (auto& entry : _entries) {
+      if (entry.value != nullptr) {
+        _slab.release(entry.value);
+      }
+    }
+    _slab.clear();
+    _size = 0;
+    _entries.assign(kMinCapacity, Entry{0, nullptr});
+    _mask = kMinCapacity - 1;
+  }
+  iterator begin() {
+    size_t start = 0;
+    while (_entries[start].value != nullptr) {
+      ++start;
+    }
+    iterator it{this, (start + 1) & _mask, _entries.size() - 1};
+    it.skip_empty();
+    return it;
+  }
+  iterator end() { return {this, 0, 0}; }
+  iterator find(const uint64_t& key) {
+    size_t pos = hash(key) & _mask;
+    while (true) {
+      const Entry& entry = _entries[pos];
+      if (entry.value == nullptr) {
+        return end();
+      }
+      if (entry.key == key) {
+        return {this, pos, 1};
+      }
+      pos = (pos + 1) & _mask;
+    }
+  }
+  // same contract as SparseTableShard::find_batch, the home slots of a group
+  // are prefetched before probing and the values before returning
+  void find_batch(const uint64_t* keys,
+                  size_t num,
+                  InlineFeatureValue** values) {
+    size_t pos[kFindGroup];
+    for (size_t group_begin = 0; group_begin < num;
+         group_begin += kFindGroup) {
+      size_t group_num = num - group_begin;
+      if (group_num > kFindGroup) {
+        group_num = kFindGroup;
+      }
+      for (size_t i = 0; i < group_num; ++i) {
+        pos[i] = hash(keys[group_begin + i]) & _mask;
+        __builtin_prefetch(&_entries[pos[i]]);
+      }
+      for (size_t i = 0; i < group_num; ++i) {
+        InlineFeatureValue* value = nullptr;
+        size_t p = pos[i];
+        while (_entries[p].value != nullptr) {
+          if (_entries[p].key == keys[group_begin + i]) {
+            value = _entries[p].value;
+            __builtin_prefetch(value);
+            break;
+          }
+          p = (p + 1) & _mask;
+        }
+        values[group_begin + i] = value;
+      }
+    }
+  }
+  InlineFeatureValue& operator[](const uint64_t& key) {
+    return *emplace(key).first.value_ptr();
+  }
+  std::pair<iterator, bool> emplace(const uint64_t& key) {
+    if ((_size + 1) * kMaxLoadDen > _entries.size() * kMaxLoadNum) {
+      rehash(_entries.size() * 2);
+    }
+    size_t pos = hash(key) & _mask;
+    while (_entries[pos].value != nullptr) {
+      if (_entries[pos].key == key) {
+        return {{this, pos, 1}, false};
+      }
+      pos = (pos + 1) & _mask;
+    }
+    _entries[pos].key = key;
+    _entries[pos].value = _slab.acquire();
+    ++_size;
+    return {{this, pos, 1}, true};
+  }
+  iterator erase(iterator it) {
+    remove_at(it.pos);
+    // a following entry may be shifted into pos
+    it.skip_empty();
+    return it;
+  }
+  void quick_erase(iterator it) { remove_at(it.pos); }
+  size_t erase(const uint64_t& key) {
+    auto it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    remove_at(it.pos);
+    return 1;
+  }
+
+ private:
+  static const size_t kMinCapacity = 1024;
+  static const size_t kFindGroup = 16;
+  // max load factor 7/10
+  static const size_t kMaxLoadNum = 7;
+  static const size_t kMaxLoadDen = 10;
+
+  static size_t hash(uint64_t key) {
+    // keys are routed to shards by modulo, mix the low bits again
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key);
+  }
+  void rehash(size_t capacity) {
+    std::vector<Entry> old;
+    old.swap(_entries);
+    _entries.assign(capacity, Entry{0, nullptr});
+    _mask = capacity - 1;
+    for (auto& entry : old) {
+      if (entry.value == nullptr) {
+        continue;
+      }
+      size_t pos = hash(entry.key) & _mask;
+      while (_entries[pos].value != nullptr) {
+        pos = (pos + 1) & _mask;
+      }
+      _entries[pos] = entry;
+    }
+  }
+  void remove_at(size_t pos) {
+    _slab.release(_entries[pos].value);
+    _entries[pos].value = nullptr;
+    --_size;
+    // backward shift the cluster behind pos
+    size_t hole = pos;
+    size_t next = (pos + 1) & _mask;
+    while (_entries[next].value != nullptr) {
+      size_t home = hash(_entries[next].key) & _mask;
+      // move when home is not cyclically in (hole, next]
+      if (((next - home) & _mask) >= ((next - hole) & _mask)) {
+        _entries[hole] = _entries[next];
+        _entries[next].value = nullptr;
+        hole = next;
+      }
+      next = (next + 1) & _mask;
+    }
+  }
+
+  std::vector<Entry> _entries;
+  size_t _mask = 0;
+  size_t _size = 0;
+  InlineValueSlab _slab;
+};
+
+}  // namespace distributed
+}  // namespace paddle
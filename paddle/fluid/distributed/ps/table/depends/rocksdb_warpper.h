@@ -23,6 +23,8 @@
 
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace paddle {
 namespace distributed {
@@ -115,7 +117,8 @@ class RocksDBHandler {
                 rocksdb::Slice(ssd_values[i].first, ssd_values[i].second));
     }
     rocksdb::Status s = _db->Write(options, &batch);
-    assert(s.ok());
+    // evicted values only live in the batch
+    CHECK(s.ok()) << "rocksdb put_batch failed: " << s.ToString();
     return 0;
   }
 
@@ -131,6 +134,44 @@ class RocksDBHandler {
     return 0;
   }
 
+  // found[i] is false when keys[i] is not in the db, any other error is
+  // fatal: a value taken as missing would be created again and overwrite the
+  // trained one on the next save
+  int multi_get(int id,
+                const std::vector<std::pair<char*, int>>& keys,
+                std::vector<std::string>* values,
+                std::vector<bool>* found) {
+    std::vector<rocksdb::ColumnFamilyHandle*> handles(keys.size(),
+                                                      _handles[id]);
+    std::vector<rocksdb::Slice> slices;
+    slices.reserve(keys.size());
+    for (auto& key : keys) {
+      slices.emplace_back(key.first, key.second);
+    }
+    std::vector<rocksdb::Status> status =
+        _db->MultiGet(rocksdb::ReadOptions(), handles, slices, values);
+    found->resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      CHECK(status[i].ok() || status[i].IsNotFound())
+          << "rocksdb multi_get failed: " << status[i].ToString();
+      (*found)[i] = status[i].ok();
+    }
+    return 0;
+  }
+
+  int del_batch(int id, const std::vector<std::pair<char*, int>>& keys) {
+    rocksdb::WriteOptions options;
+    options.disableWAL = true;
+    rocksdb::WriteBatch batch(keys.size() * 32);
+    for (auto& key : keys) {
+      batch.Delete(_handles[id], rocksdb::Slice(key.first, key.second));
+    }
+    rocksdb::Status s = _db->Write(options, &batch);
+    // a stale value left in the db would come back on the next miss
+    CHECK(s.ok()) << "rocksdb del_batch failed: " << s.ToString();
+    return 0;
+  }
+
   int del_data(int id, const char* key, int key_len) {
     rocksdb::WriteOptions options;
     options.disableWAL = true;
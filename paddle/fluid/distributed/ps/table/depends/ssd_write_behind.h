@@ -0,0 +1,199 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/distributed/ps/table/depends/rocksdb_warpper.h"
+
+namespace paddle {
+namespace distributed {
+
+// Values evicted from the memory tier of SSDSparseTable wait here until a
+// background thread writes them to rocksdb with put_batch. A value is always
+// in exactly one of pending, in flight or the db, so Take never misses a key
+// that was pushed and not yet written.
+class SSDWriteBehindQueue {
+ public:
+  SSDWriteBehindQueue(RocksDBHandler* db, int shard_num, size_t max_pending)
+      : _db(db), _shards(shard_num), _max_pending(max_pending) {
+    for (auto& shard : _shards) {
+      shard.reset(new Shard());
+    }
+    _write_thread = std::thread([this]() { WriteLoop(); });
+  }
+  ~SSDWriteBehindQueue() {
+    {
+      std::lock_guard<std::mutex> lock(_wake_mutex);
+      _stop = true;
+    }
+    _wake_cv.notify_one();
+    _write_thread.join();
+  }
+
+  // blocks while the shard already has max_pending values waiting
+  void Push(int shard_id, uint64_t key, const float* value, size_t size) {
+    auto& shard = *_shards[shard_id];
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    if (shard.pending.size() >= _max_pending) {
+      Wake();
+      shard.cv.wait(lock, [&] { return shard.pending.size() < _max_pending; });
+    }
+    auto& slot = shard.pending[key];
+    slot.assign(reinterpret_cast<const char*>(value), size * sizeof(float));
+    ++_depth;
+    if (shard.pending.size() >= kWriteBatch) {
+      Wake();
+    }
+  }
+
+  // moves a value that is not written yet back to the caller
+  bool Take(int shard_id, uint64_t key, std::string* value) {
+    auto& shard = *_shards[shard_id];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.pending.find(key);
+    if (it != shard.pending.end()) {
+      value->swap(it->second);
+      shard.pending.erase(it);
+      --_depth;
+      return true;
+    }
+    // the writer still reads the in flight value, copy it and drop the db
+    // copy once it is written
+    auto flight = shard.in_flight.find(key);
+    if (flight != shard.in_flight.end() && shard.reclaimed.count(key) == 0) {
+      *value = flight->second;
+      shard.reclaimed.insert(key);
+      return true;
+    }
+    return false;
+  }
+
+  // waits until every pushed value is in the db
+  void Flush() {
+    for (auto& shard_ptr : _shards) {
+      auto& shard = *shard_ptr;
+      std::unique_lock<std::mutex> lock(shard.mutex);
+      while (!shard.pending.empty() || !shard.in_flight.empty()) {
+        Wake();
+        shard.cv.wait_for(lock, std::chrono::milliseconds(10));
+      }
+    }
+  }
+
+  // values pushed and not written yet
+  size_t Depth() const { return _depth.load(); }
+
+ private:
+  struct Shard {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::unordered_map<uint64_t, std::string> pending;
+    std::unordered_map<uint64_t, std::string> in_flight;
+    std::unordered_set<uint64_t> reclaimed;
+  };
+  static const size_t kWriteBatch = 4096;
+
+  void Wake() {
+    {
+      std::lock_guard<std::mutex> lock(_wake_mutex);
+      _wake = true;
+    }
+    _wake_cv.notify_one();
+  }
+
+  void WriteLoop() {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(_wake_mutex);
+        _wake_cv.wait_for(lock, std::chrono::milliseconds(100), [this] {
+          return _wake || _stop;
+        });
+        _wake = false;
+      }
+      bool written = false;
+      for (size_t i = 0; i < _shards.size(); ++i) {
+        written = WriteShard(i) || written;
+      }
+      if (!written && _stop) {
+        break;
+      }
+    }
+  }
+
+  bool WriteShard(int shard_id) {
+    auto& shard = *_shards[shard_id];
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (shard.pending.empty()) {
+        return false;
+      }
+      shard.in_flight.swap(shard.pending);
+    }
+    shard.cv.notify_all();
+    std::vector<std::pair<char*, int>> keys;
+    std::vector<std::pair<char*, int>> values;
+    keys.reserve(shard.in_flight.size());
+    values.reserve(shard.in_flight.size());
+    for (auto& kv : shard.in_flight) {
+      keys.emplace_back(
+          reinterpret_cast<char*>(const_cast<uint64_t*>(&kv.first)),
+          sizeof(uint64_t));
+      values.emplace_back(const_cast<char*>(kv.second.data()),
+                          kv.second.size());
+    }
+    _db->put_batch(shard_id, keys, values, keys.size());
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      if (!shard.reclaimed.empty()) {
+        std::vector<std::pair<char*, int>> reclaimed_keys;
+        for (auto& key : shard.reclaimed) {
+          reclaimed_keys.emplace_back(
+              reinterpret_cast<char*>(const_cast<uint64_t*>(&key)),
+              sizeof(uint64_t));
+        }
+        _db->del_batch(shard_id, reclaimed_keys);
+        shard.reclaimed.clear();
+      }
+      _depth -= shard.in_flight.size();
+      shard.in_flight.clear();
+    }
+    shard.cv.notify_all();
+    return true;
+  }
+
+  RocksDBHandler* _db;
+  std::vector<std::unique_ptr<Shard>> _shards;
+  size_t _max_pending;
+  std::atomic<size_t> _depth{0};
+  std::mutex _wake_mutex;
+  std::condition_variable _wake_cv;
+  bool _wake = false;
+  bool _stop = false;
+  std::thread _write_thread;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,239 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <unordered_set>
+#include <utility>
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
+namespace paddle {
+namespace distributed {
+
+namespace {
+
+// the distinct indexes sampled so far, looked up by a scan while k is small
+class PickedSet {
+ public:
+  PickedSet(std::vector<int> *res, int k) : res_(res), use_set_(k > 32) {
+    if (use_set_) {
+      set().clear();
+    }
+  }
+  bool contains(int x) const {
+    if (use_set_) {
+      return set().count(x) > 0;
+    }
+    return std::find(res_->begin(), res_->end(), x) != res_->end();
+  }
+  void insert(int x) {
+    if (contains(x)) {
+      return;
+    }
+    if (use_set_) {
+      set().insert(x);
+    }
+    res_->push_back(x);
+  }
+
+ private:
+  static std::unordered_set<int> &set() {
+    thread_local std::unordered_set<int> picked;
+    return picked;
+  }
+  std::vector<int> *res_;
+  bool use_set_;
+};
+
+}  // namespace
+
+void GraphCSR::build(const std::vector<Node *> &nodes) {
+  offsets.resize(nodes.size() + 1);
+  offsets[0] = 0;
+  for (size_t v = 0; v < nodes.size(); ++v) {
+    offsets[v + 1] = offsets[v] + nodes[v]->get_neighbor_size();
+  }
+  neighbor_ids.resize(offsets.back());
+  neighbor_ids.shrink_to_fit();
+  weights.resize(offsets.back());
+  bool is_weighted = false;
+  for (size_t v = 0; v < nodes.size(); ++v) {
+    uint64_t pos = offsets[v];
+    size_t degree = offsets[v + 1] - pos;
+    for (size_t i = 0; i < degree; ++i) {
+      neighbor_ids[pos + i] = nodes[v]->get_neighbor_id(i);
+      weights[pos + i] = nodes[v]->get_neighbor_weight(i);
+      is_weighted |= (weights[pos + i] != 1.0);
+    }
+  }
+  if (!is_weighted) {
+    weights.clear();
+  }
+  weights.shrink_to_fit();
+  build_sampler(sample_type_);
+}
+
+void GraphCSR::build_sampler(const std::string &sample_type) {
+  sample_type_ = sample_type;
+  alias_prob.clear();
+  alias_idx.clear();
+  if (sample_type_ != "weighted" || !is_weighted()) {
+    alias_prob.shrink_to_fit();
+    alias_idx.shrink_to_fit();
+    return;
+  }
+  alias_prob.resize(edge_num());
+  alias_idx.resize(edge_num());
+  std::vector<uint32_t> small, large;
+  std::vector<double> scaled;
+  for (size_t v = 0; v < vertex_num(); ++v) {
+    uint64_t pos = offsets[v];
+    uint32_t n = degree(v);
+    double total = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+      total += std::max(weights[pos + i], 0.0f);
+    }
+    scaled.resize(n);
+    small.clear();
+    large.clear();
+    for (uint32_t i = 0; i < n; ++i) {
+      // a vertex without weight samples uniformly
+      scaled[i] =
+          total > 0 ? std::max(weights[pos + i], 0.0f) * n / total : 1.0;
+      (scaled[i] < 1.0 ? small : large).push_back(i);
+      alias_idx[pos + i] = i;
+    }
+    while (!small.empty() && !large.empty()) {
+      uint32_t s = small.back();
+      uint32_t l = large.back();
+      small.pop_back();
+      alias_prob[pos + s] = scaled[s];
+      alias_idx[pos + s] = l;
+      scaled[l] -= 1.0 - scaled[s];
+      if (scaled[l] < 1.0) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    // what is left is 1 up to rounding
+    for (uint32_t i : small) {
+      alias_prob[pos + i] = 1.0;
+    }
+    for (uint32_t i : large) {
+      alias_prob[pos + i] = 1.0;
+    }
+  }
+}
+
+void GraphCSR::sample_k(uint32_t v,
+                        int k,
+                        std::mt19937_64 *rng,
+                        std::vector<int> *res) const {
+  res->clear();
+  int n = degree(v);
+  if (k >= n) {
+    res->resize(n);
+    std::iota(res->begin(), res->end(), 0);
+    return;
+  }
+  if (k <= 0) {
+    return;
+  }
+  if (alias_prob.empty()) {
+    sample_uniform(v, k, rng, res);
+  } else {
+    sample_weighted(v, k, rng, res);
+  }
+}
+
+void GraphCSR::sample_uniform(uint32_t v,
+                              int k,
+                              std::mt19937_64 *rng,
+                              std::vector<int> *res) const {
+  int n = degree(v);
+  if (k * 4 >= n) {
+    // partial Fisher-Yates shuffle
+    thread_local std::vector<int> perm;
+    perm.resize(n);
+    std::iota(perm.begin(), perm.end(), 0);
+    for (int i = 0; i < k; ++i) {
+      std::uniform_int_distribution<int> distrib(i, n - 1);
+      std::swap(perm[i], perm[distrib(*rng)]);
+    }
+    res->assign(perm.begin(), perm.begin() + k);
+    return;
+  }
+  // few draws repeat when k is small against the degree
+  PickedSet picked(res, k);
+  std::uniform_int_distribution<int> distrib(0, n - 1);
+  while (static_cast<int>(res->size()) < k) {
+    picked.insert(distrib(*rng));
+  }
+}
+
+void GraphCSR::sample_weighted(uint32_t v,
+                               int k,
+                               std::mt19937_64 *rng,
+                               std::vector<int> *res) const {
+  int n = degree(v);
+  uint64_t pos = offsets[v];
+  PickedSet picked(res, k);
+  // redrawing a picked neighbor samples the others by their weight, the
+  // same as removing it; stop when the picked ones hold most of the weight
+  if (k * 2 < n) {
+    std::uniform_int_distribution<int> slot_distrib(0, n - 1);
+    std::uniform_real_distribution<float> prob_distrib(0, 1.0);
+    for (int budget = k * 4 + 16;
+         static_cast<int>(res->size()) < k && budget > 0;
+         --budget) {
+      int slot = slot_distrib(*rng);
+      picked.insert(prob_distrib(*rng) < alias_prob[pos + slot]
+                        ? slot
+                        : alias_idx[pos + slot]);
+    }
+  }
+  int left = k - static_cast<int>(res->size());
+  if (left == 0) {
+    return;
+  }
+  // the rest by exponential keys: the largest log(u) / w are a weighted
+  // sample without replacement, in the order they would be drawn
+  thread_local std::vector<std::pair<double, int>> keys;
+  keys.clear();
+  std::uniform_real_distribution<double> key_distrib(0, 1.0);
+  for (int i = 0; i < n; ++i) {
+    if (picked.contains(i)) {
+      continue;
+    }
+    float weight = weights[pos + i];
+    keys.emplace_back(weight > 0 ? std::log(key_distrib(*rng)) / weight
+                                 : -std::numeric_limits<double>::infinity(),
+                      i);
+  }
+  std::partial_sort(keys.begin(),
+                    keys.begin() + left,
+                    keys.end(),
+                    std::greater<std::pair<double, int>>());
+  for (int i = 0; i < left; ++i) {
+    res->push_back(keys[i].second);
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,76 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+namespace paddle {
+namespace distributed {
+
+class Node;
+
+// immutable edges of a graph shard: the neighbors of vertex v are
+// neighbor_ids[offsets[v], offsets[v + 1]), weights is empty when all of
+// them are 1. Weighted sampling draws from per vertex alias tables.
+class GraphCSR {
+ public:
+  // packs the edges of nodes, nodes[v] becomes vertex v
+  void build(const std::vector<Node *> &nodes);
+  // "random" or "weighted", the alias tables are built for weighted
+  void build_sampler(const std::string &sample_type);
+
+  size_t vertex_num() const { return offsets.size() - 1; }
+  size_t edge_num() const { return neighbor_ids.size(); }
+  bool is_weighted() const { return !weights.empty(); }
+  const std::string &sample_type() const { return sample_type_; }
+
+  size_t degree(uint32_t v) const { return offsets[v + 1] - offsets[v]; }
+  uint64_t neighbor_id(uint32_t v, size_t i) const {
+    return neighbor_ids[offsets[v] + i];
+  }
+  float neighbor_weight(uint32_t v, size_t i) const {
+    return weights.empty() ? 1.0 : weights[offsets[v] + i];
+  }
+
+  // min(k, degree(v)) distinct neighbors of v as indexes in [0, degree(v)),
+  // uniformly or by weight like RandomSampler / WeightedSampler
+  void sample_k(uint32_t v,
+                int k,
+                std::mt19937_64 *rng,
+                std::vector<int> *res) const;
+
+ private:
+  void sample_uniform(uint32_t v,
+                      int k,
+                      std::mt19937_64 *rng,
+                      std::vector<int> *res) const;
+  void sample_weighted(uint32_t v,
+                       int k,
+                       std::mt19937_64 *rng,
+                       std::vector<int> *res) const;
+
+  std::vector<uint64_t> offsets{0};
+  std::vector<uint64_t> neighbor_ids;
+  std::vector<float> weights;
+  // alias method: slot i keeps i with alias_prob[i], else alias_idx[i]
+  std::vector<float> alias_prob;
+  std::vector<uint32_t> alias_idx;
+  std::string sample_type_ = "random";
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,162 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_file_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "glog/logging.h"
+#include "paddle/fluid/framework/io/fs.h"
+namespace paddle {
+namespace distributed {
+
+static bool IsMappable(const std::string &path) {
+  return paddle::framework::fs_select_internal(path) == 0 &&
+         (path.size() < 3 || path.compare(path.size() - 3, 3, ".gz") != 0);
+}
+
+bool GraphFileReader::OpenNext() {
+  while (file_idx_ < paths_.size()) {
+    const std::string &path = paths_[file_idx_];
+    if (IsMappable(path)) {
+      int fd = open(path.c_str(), O_RDONLY);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st) != 0) {
+        LOG(WARNING) << "open " << path << " failed";
+        if (fd >= 0) close(fd);
+        ++file_idx_;
+        continue;
+      }
+      size_t size = st.st_size;
+      if (size == 0) {
+        close(fd);
+        ++file_idx_;
+        continue;
+      }
+      void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (addr == MAP_FAILED) {
+        LOG(WARNING) << "mmap " << path << " failed";
+        ++file_idx_;
+        continue;
+      }
+      madvise(addr, size, MADV_SEQUENTIAL);
+      map_.reset(addr, [size](void *p) { munmap(p, size); });
+      map_pos_ = static_cast<const char *>(addr);
+      map_end_ = map_pos_ + size;
+      // a last line without '\n' is copied out to end with a '\0'
+      const char *last = map_end_;
+      while (last > map_pos_ && last[-1] != '\n') {
+        --last;
+      }
+      tail_.assign(last, map_end_ - last);
+      map_end_ = last;
+    } else {
+      int err_no = 0;
+      fp_ = paddle::framework::fs_open_read(path, &err_no, "");
+      if (fp_ == nullptr || err_no != 0) {
+        LOG(WARNING) << "open " << path << " failed";
+        fp_.reset();
+        ++file_idx_;
+        continue;
+      }
+      tail_.clear();
+    }
+    opened_ = true;
+    return true;
+  }
+  return false;
+}
+
+bool GraphFileReader::NextMapped(GraphFileBlock *block) {
+  if (map_pos_ == map_end_) {
+    if (tail_.empty()) {
+      return false;
+    }
+    auto data = std::make_shared<std::string>();
+    data->swap(tail_);
+    block->begin = data->data();
+    block->end = data->data() + data->size();
+    block->holder = data;
+    return true;
+  }
+  const char *end = map_end_;
+  if (static_cast<size_t>(map_end_ - map_pos_) > block_size_) {
+    const char *newline = static_cast<const char *>(memchr(
+        map_pos_ + block_size_, '\n', map_end_ - map_pos_ - block_size_));
+    end = newline == nullptr ? map_end_ : newline + 1;
+  }
+  block->begin = map_pos_;
+  block->end = end;
+  block->holder = map_;
+  map_pos_ = end;
+  return true;
+}
+
+bool GraphFileReader::NextStreamed(GraphFileBlock *block) {
+  auto data = std::make_shared<std::string>();
+  data->swap(tail_);
+  while (true) {
+    size_t len = data->size();
+    data->resize(len + block_size_);
+    size_t read_len = fread(&(*data)[len], 1, block_size_, fp_.get());
+    data->resize(len + read_len);
+    if (read_len == 0) {
+      break;
+    }
+    // keep the part line for the next block
+    size_t last = data->rfind('\n');
+    if (last == std::string::npos) {
+      continue;
+    }
+    if (last + 1 < data->size()) {
+      tail_.assign(*data, last + 1, std::string::npos);
+      data->resize(last + 1);
+    }
+    break;
+  }
+  if (data->empty()) {
+    return false;
+  }
+  block->begin = data->data();
+  block->end = data->data() + data->size();
+  block->holder = data;
+  return true;
+}
+
+bool GraphFileReader::Next(GraphFileBlock *block) {
+  while (true) {
+    if (!opened_ && !OpenNext()) {
+      return false;
+    }
+    bool ok = map_ != nullptr ? NextMapped(block) : NextStreamed(block);
+    if (ok) {
+      block->file_idx = file_idx_;
+      block->path = &paths_[file_idx_];
+      return true;
+    }
+    map_.reset();
+    fp_.reset();
+    opened_ = false;
+    ++file_idx_;
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
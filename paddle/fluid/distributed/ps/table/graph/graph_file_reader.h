@@ -0,0 +1,77 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+namespace paddle {
+namespace distributed {
+
+// whole lines [begin, end) of file path, holder keeps the bytes alive.
+// Every line ends with '\n', or with a '\0' after end in the last block.
+struct GraphFileBlock {
+  size_t file_idx = 0;
+  const std::string *path = nullptr;
+  const char *begin = nullptr;
+  const char *end = nullptr;
+  std::shared_ptr<void> holder;
+};
+
+// splits files into blocks of about block_size bytes of whole lines, in
+// file order. Local files are mmapped and the blocks point into the map,
+// the others (hdfs, afs, .gz) are read by fs_open_read block by block.
+class GraphFileReader {
+ public:
+  GraphFileReader(const std::vector<std::string> &paths, size_t block_size)
+      : paths_(paths), block_size_(block_size) {}
+
+  // false after the last block
+  bool Next(GraphFileBlock *block);
+
+ private:
+  bool OpenNext();
+  bool NextMapped(GraphFileBlock *block);
+  bool NextStreamed(GraphFileBlock *block);
+
+  std::vector<std::string> paths_;
+  size_t block_size_;
+  size_t file_idx_ = 0;
+  bool opened_ = false;
+  // the mmapped file
+  std::shared_ptr<void> map_;
+  const char *map_pos_ = nullptr;
+  const char *map_end_ = nullptr;
+  std::shared_ptr<FILE> fp_;
+  // the part line after the last block
+  std::string tail_;
+};
+
+// reads the decimal number at p, advances p after it
+inline uint64_t GraphParseUInt64(const char **p, const char *end) {
+  uint64_t value = 0;
+  const char *s = *p;
+  while (s < end && static_cast<unsigned>(*s - '0') < 10) {
+    value = value * 10 + (*s - '0');
+    ++s;
+  }
+  *p = s;
+  return value;
+}
+
+}  // namespace distributed
+}  // namespace paddle
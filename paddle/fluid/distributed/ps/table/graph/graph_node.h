@@ -21,6 +21,7 @@
 #include <vector>
 
 #include "glog/logging.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr.h"
 #include "paddle/fluid/distributed/ps/table/graph/graph_weighted_sampler.h"
 #include "paddle/fluid/platform/enforce.h"
 #include "paddle/fluid/string/string_helper.h"
@@ -89,6 +90,32 @@ class GraphNode : public Node {
   GraphEdgeBlob *edges;
 };
 
+// node of a shard packed into a GraphCSR, vertex pos of csr holds its edges
+class CSRGraphNode : public Node {
+ public:
+  CSRGraphNode(uint64_t id, const GraphCSR *csr, uint32_t pos)
+      : Node(id), csr(csr), pos(pos) {}
+  virtual ~CSRGraphNode() {}
+  virtual std::vector<int> sample_k(
+      int k, const std::shared_ptr<std::mt19937_64> rng) {
+    std::vector<int> res;
+    csr->sample_k(pos, k, rng.get(), &res);
+    return res;
+  }
+  virtual uint64_t get_neighbor_id(int idx) {
+    return csr->neighbor_id(pos, idx);
+  }
+  virtual float get_neighbor_weight(int idx) {
+    return csr->neighbor_weight(pos, idx);
+  }
+  virtual size_t get_neighbor_size() { return csr->degree(pos); }
+  uint32_t get_csr_pos() const { return pos; }
+
+ protected:
+  const GraphCSR *csr;
+  uint32_t pos;
+};
+
 class FeatureNode : public Node {
  public:
   FeatureNode() : Node() {}
@@ -20,6 +20,7 @@
 #include "paddle/fluid/distributed/common/local_random.h"
 #include "paddle/fluid/distributed/common/topk_calculator.h"
 #include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
+#include "paddle/fluid/distributed/ps/table/sparse_snapshot.h"
 #include "paddle/fluid/framework/archive.h"
 #include "paddle/fluid/framework/io/fs.h"
 
@@ -40,6 +41,37 @@ DEFINE_int32(pserver_table_save_max_retry, 3, "pserver_table_save_max_retry");
 namespace paddle {
 namespace distributed {
 
+static bool IsSnapshotFile(const std::string& path) {
+  size_t suffix_len = strlen(PSERVER_SNAPSHOT_SUFFIX);
+  return path.size() >= suffix_len &&
+         path.compare(path.size() - suffix_len,
+                      suffix_len,
+                      PSERVER_SNAPSHOT_SUFFIX) == 0;
+}
+
+// writes the values of shard passing SaveCache into writer
+template <class SHARD>
+static int SaveShardCache(
+    SHARD* shard,
+    ValueAccessor* value_accesor,
+    int save_param,
+    double cache_threshold,
+    paddle::framework::ChannelWriter<std::pair<uint64_t, std::string>>*
+        writer) {
+  int feasign_size = 0;
+  for (auto it = shard->begin(); it != shard->end(); ++it) {
+    if (value_accesor->SaveCache(
+            it.value().data(), save_param, cache_threshold)) {
+      std::string format_value =
+          value_accesor->ParseToString(it.value().data(), it.value().size());
+      std::pair<uint64_t, std::string> pkv(it.key(), format_value.c_str());
+      (*writer) << pkv;
+      ++feasign_size;
+    }
+  }
+  return feasign_size;
+}
+
 int32_t MemorySparseTable::Initialize() {
   auto& profiler = CostProfiler::instance();
   profiler.register_profiler("pserver_sparse_update_all");
@@ -73,7 +105,27 @@ int32_t MemorySparseTable::InitializeValue() {
           << " _real_local_shard_num: " << _real_local_shard_num
           << " _task_pool_size:" << _task_pool_size;
 
-  _local_shards.reset(new shard_type[_real_local_shard_num]);
+  if (_config.sparse_value_storage() == VALUE_STORAGE_VECTOR) {
+    _local_shards.reset(new shard_type[_real_local_shard_num]);
+  } else {
+    // values live in per shard slabs, embedx is inline only when asked for
+    auto accessor_info = _value_accesor->GetAccessorInfo();
+    size_t inline_dim = accessor_info.size / sizeof(float);
+    if (_config.sparse_value_storage() == VALUE_STORAGE_INLINE) {
+      inline_dim -= accessor_info.mf_size / sizeof(float);
+    }
+    _inline_shards.reset(new inline_shard_type[_real_local_shard_num]);
+    for (int i = 0; i < _real_local_shard_num; ++i) {
+      _inline_shards[i].init(inline_dim);
+    }
+    if (_config.enable_revert()) {
+      LOG(WARNING) << "revert is not supported by inline value storage, "
+                      "disable it for table "
+                   << _config.table_id();
+      _config.set_enable_revert(false);
+    }
+    VLOG(1) << "memory sparse table inline_dim: " << inline_dim;
+  }
 
   if (_config.enable_revert()) {
     // calculate merged shard number based on config param;
@@ -102,8 +154,10 @@ int32_t MemorySparseTable::InitializeValue() {
   return 0;
 }
 
-int32_t MemorySparseTable::Load(const std::string& path,
-                                const std::string& param) {
+template <class SHARD>
+int32_t MemorySparseTable::LoadImpl(SHARD* shards,
+                                    const std::string& path,
+                                    const std::string& param) {
   std::string table_path = TableDir(path);
   auto file_list = _afs_client.list(table_path);
 
@@ -125,6 +179,8 @@ int32_t MemorySparseTable::Load(const std::string& path,
   }
 
   if (load_param == 5) {
+    CHECK(_inline_shards == nullptr)
+        << "patch model needs vector value storage";
     return LoadPatch(file_list, load_param);
   }
 
@@ -133,6 +189,9 @@ int32_t MemorySparseTable::Load(const std::string& path,
   if (file_start_idx >= file_list.size()) {
     return 0;
   }
+  if (IsSnapshotFile(file_list[file_start_idx])) {
+    return LoadSnapshotImpl(shards, file_list, file_start_idx, load_param);
+  }
 
   size_t feature_value_size =
       _value_accesor->GetAccessorInfo().size / sizeof(float);
@@ -159,7 +218,7 @@ int32_t MemorySparseTable::Load(const std::string& path,
       std::string line_data;
       auto read_channel = _afs_client.open_r(channel_config, 0, &err_no);
       char* end = NULL;
-      auto& shard = _local_shards[i];
+      auto& shard = shards[i];
       try {
         while (read_channel->read_line(line_data) == 0 &&
                line_data.size() > 1) {
@@ -201,6 +260,14 @@ int32_t MemorySparseTable::Load(const std::string& path,
   return 0;
 }
 
+int32_t MemorySparseTable::Load(const std::string& path,
+                                const std::string& param) {
+  if (_inline_shards != nullptr) {
+    return LoadImpl(_inline_shards.get(), path, param);
+  }
+  return LoadImpl(_local_shards.get(), path, param);
+}
+
 int32_t MemorySparseTable::LoadPatch(const std::vector<std::string>& file_list,
                                      int load_param) {
   if (!_config.enable_revert()) {
@@ -302,6 +369,9 @@ int32_t MemorySparseTable::LoadPatch(const std::vector<std::string>& file_list,
 }
 
 void MemorySparseTable::Revert() {
+  if (!_config.enable_revert()) {
+    return;
+  }
   for (size_t i = 0; i < _real_local_shard_num; ++i) {
     _local_shards_new[i].clear();
   }
@@ -311,8 +381,10 @@ void MemorySparseTable::CheckSavePrePatchDone() {
   _save_patch_model_thread.join();
 }
 
-int32_t MemorySparseTable::Save(const std::string& dirname,
-                                const std::string& param) {
+template <class SHARD>
+int32_t MemorySparseTable::SaveImpl(SHARD* shards,
+                                    const std::string& dirname,
+                                    const std::string& param) {
   if (_real_local_shard_num == 0) {
     _local_show_threshold = -1;
     return 0;
@@ -324,6 +396,7 @@ int32_t MemorySparseTable::Save(const std::string& dirname,
 
   // patch model
   if (save_param == 5) {
+    CHECK(_config.enable_revert()) << "patch model needs enable_revert";
     _local_shards_patch_model.reset(_local_shards_new.release());
     _local_shards_new.reset(new shard_type[_real_local_shard_num]);
     _save_patch_model_thread = std::thread(std::bind(
@@ -342,6 +415,14 @@ int32_t MemorySparseTable::Save(const std::string& dirname,
 
   size_t file_start_idx = _avg_local_shard_num * _shard_idx;
 
+  // checkpoints go to binary snapshots, xbox models stay text
+  if (_config.enable_binary_snapshot() &&
+      (save_param == 0 || save_param == 3)) {
+    SaveSnapshotImpl(shards, table_path, save_param);
+    _local_show_threshold = tk.top();
+    return 0;
+  }
+
 #if defined(PADDLE_WITH_MKLML)
 #ifdef PADDLE_WITH_GPU_GRAPH
   int thread_num = _real_local_shard_num;
@@ -372,7 +453,7 @@ int32_t MemorySparseTable::Save(const std::string& dirname,
     int feasign_size = 0;
     int retry_num = 0;
     int err_no = 0;
-    auto& shard = _local_shards[i];
+    auto& shard = shards[i];
     do {
       err_no = 0;
       feasign_size = 0;
@@ -430,6 +511,161 @@ int32_t MemorySparseTable::Save(const std::string& dirname,
   return 0;
 }
 
+template <class SHARD>
+int32_t MemorySparseTable::SaveSnapshotImpl(SHARD* shards,
+                                            const std::string& table_path,
+                                            int save_param) {
+  size_t file_start_idx = _avg_local_shard_num * _shard_idx;
+  std::string accessor_class = _config.accessor().accessor_class();
+  AccessorInfo accessor_info = _value_accesor->GetAccessorInfo();
+  auto save_shard = [&](int i) -> int {
+    FsChannelConfig channel_config;
+    channel_config.path =
+        paddle::string::format_string("%s/part-%03d-%05d%s",
+                                      table_path.c_str(),
+                                      _shard_idx,
+                                      file_start_idx + i,
+                                      PSERVER_SNAPSHOT_SUFFIX);
+    channel_config.converter = _value_accesor->Converter(save_param).converter;
+    channel_config.deconverter =
+        _value_accesor->Converter(save_param).deconverter;
+    auto& shard = shards[i];
+    bool is_write_failed = false;
+    int retry_num = 0;
+    size_t feasign_size = 0;
+    do {
+      int err_no = 0;
+      is_write_failed = false;
+      auto write_channel =
+          _afs_client.open_w(channel_config, 1024 * 1024 * 40, &err_no);
+      SparseSnapshotWriter writer(write_channel, _config.compress_in_save());
+      SparseSnapshotHeader header;
+      InitSparseSnapshotHeader(accessor_class,
+                               accessor_info,
+                               file_start_idx + i,
+                               shard.size(),
+                               &header);
+      int ret = writer.WriteHeader(header);
+      for (auto it = shard.begin(); ret == 0 && it != shard.end(); ++it) {
+        if (_value_accesor->Save(it.value().data(), save_param)) {
+          ret = writer.Append(it.key(), it.value().data(), it.value().size());
+        }
+      }
+      if (ret == 0) {
+        ret = writer.Close();
+      }
+      write_channel->close();
+      feasign_size = writer.RecordNum();
+      if (ret != 0 || err_no == -1) {
+        ++retry_num;
+        is_write_failed = true;
+        LOG(ERROR) << "MemorySparseTable save snapshot failed, retry it! "
+                   << "path:" << channel_config.path
+                   << " , retry_num=" << retry_num;
+        _afs_client.remove(channel_config.path);
+      }
+      if (retry_num > FLAGS_pserver_table_save_max_retry) {
+        LOG(ERROR) << "MemorySparseTable save snapshot failed reach max limit!";
+        exit(-1);
+      }
+    } while (is_write_failed);
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      _value_accesor->UpdateStatAfterSave(it.value().data(), save_param);
+    }
+    LOG(INFO) << "MemorySparseTable save snapshot success, path: "
+              << channel_config.path << " feasign_size: " << feasign_size;
+    return 0;
+  };
+  std::vector<std::future<int>> tasks(_real_local_shard_num);
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    tasks[i] =
+        _shards_task_pool[i % _shards_task_pool.size()]->enqueue(save_shard, i);
+  }
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    tasks[i].wait();
+  }
+  return 0;
+}
+
+template <class SHARD>
+int32_t MemorySparseTable::LoadSnapshotImpl(
+    SHARD* shards,
+    const std::vector<std::string>& file_list,
+    size_t file_start_idx,
+    int load_param) {
+  std::string accessor_class = _config.accessor().accessor_class();
+  AccessorInfo accessor_info = _value_accesor->GetAccessorInfo();
+  auto load_shard = [&](int i) -> int {
+    FsChannelConfig channel_config;
+    channel_config.path = file_list[file_start_idx + i];
+    channel_config.converter = _value_accesor->Converter(load_param).converter;
+    channel_config.deconverter =
+        _value_accesor->Converter(load_param).deconverter;
+    auto& shard = shards[i];
+    bool is_read_failed = false;
+    int retry_num = 0;
+    do {
+      int err_no = 0;
+      is_read_failed = false;
+      auto read_channel = _afs_client.open_r(channel_config, 0, &err_no);
+      SparseSnapshotReader reader(read_channel);
+      SparseSnapshotHeader header;
+      int ret = reader.ReadHeader(&header);
+      if (ret == 0) {
+        if (CheckSparseSnapshotHeader(header, accessor_class, accessor_info) !=
+            0) {
+          LOG(ERROR) << "MemorySparseTable snapshot does not match the "
+                     << "accessor, path:" << channel_config.path;
+          exit(-1);
+        }
+        // one pass of rehashing instead of growing with the keys
+        shard.reserve(shard.size() + header.key_num);
+        uint64_t key = 0;
+        const float* data = nullptr;
+        size_t size = 0;
+        while ((ret = reader.Next(&key, &data, &size)) == 1) {
+          auto& value = shard[key];
+          value.resize(size);
+          memcpy(value.data(), data, size * sizeof(float));
+        }
+      }
+      read_channel->close();
+      if (ret != 0 || err_no == -1) {
+        ++retry_num;
+        is_read_failed = true;
+        LOG(ERROR) << "MemorySparseTable load snapshot failed, retry it! "
+                   << "path:" << channel_config.path
+                   << " , retry_num=" << retry_num;
+      }
+      if (retry_num > FLAGS_pserver_table_save_max_retry) {
+        LOG(ERROR) << "MemorySparseTable load snapshot failed reach max limit!";
+        exit(-1);
+      }
+    } while (is_read_failed);
+    return 0;
+  };
+  std::vector<std::future<int>> tasks(_real_local_shard_num);
+  for (int i = 0; i < _real_local_shard_num; ++i) {
+    tasks[i] =
+        _shards_task_pool[i % _shards_task_pool.size()]->enqueue(load_shard, i);
+  }
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    tasks[i].wait();
+  }
+  LOG(INFO) << "MemorySparseTable load snapshot success, path from "
+            << file_list[file_start_idx] << " to "
+            << file_list[file_start_idx + _real_local_shard_num - 1];
+  return 0;
+}
+
+int32_t MemorySparseTable::Save(const std::string& dirname,
+                                const std::string& param) {
+  if (_inline_shards != nullptr) {
+    return SaveImpl(_inline_shards.get(), dirname, param);
+  }
+  return SaveImpl(_local_shards.get(), dirname, param);
+}
+
 int32_t MemorySparseTable::SavePatch(const std::string& path, int save_param) {
   if (!_config.enable_revert()) {
     LOG(INFO) << "MemorySparseTable should be enabled revert.";
@@ -567,17 +803,21 @@ int64_t MemorySparseTable::CacheShuffle(
     for (size_t idx = 0; idx < table_ptrs.size(); idx++) {
       Table* table_ptr = table_ptrs[idx];
       auto value_accesor = table_ptr->ValueAccesor();
-      shard_type* shard_ptr = static_cast<shard_type*>(table_ptr->GetShard(i));
-
-      for (auto it = shard_ptr->begin(); it != shard_ptr->end(); ++it) {
-        if (value_accesor->SaveCache(
-                it.value().data(), save_param, cache_threshold)) {
-          std::string format_value = value_accesor->ParseToString(
-              it.value().data(), it.value().size());
-          std::pair<uint64_t, std::string> pkv(it.key(), format_value.c_str());
-          writer << pkv;
-          ++feasign_size;
-        }
+      // every table reads its shard by its own value storage
+      auto sparse_table = dynamic_cast<MemorySparseTable*>(table_ptr);
+      if (sparse_table != nullptr && sparse_table->_inline_shards != nullptr) {
+        feasign_size += SaveShardCache(&sparse_table->_inline_shards[i],
+                                       value_accesor.get(),
+                                       save_param,
+                                       cache_threshold,
+                                       &writer);
+      } else {
+        feasign_size +=
+            SaveShardCache(static_cast<shard_type*>(table_ptr->GetShard(i)),
+                           value_accesor.get(),
+                           save_param,
+                           cache_threshold,
+                           &writer);
       }
     }
     writer.Flush();
@@ -685,23 +925,32 @@ int32_t MemorySparseTable::SaveCache(
   return feasign_size;
 }
 
-int64_t MemorySparseTable::LocalSize() {
+template <class SHARD>
+int64_t MemorySparseTable::LocalSizeImpl(SHARD* shards) {
   int64_t local_size = 0;
   for (int i = 0; i < _real_local_shard_num; ++i) {
-    local_size += _local_shards[i].size();
+    local_size += shards[i].size();
   }
   return local_size;
 }
 
-int64_t MemorySparseTable::LocalMFSize() {
+int64_t MemorySparseTable::LocalSize() {
+  if (_inline_shards != nullptr) {
+    return LocalSizeImpl(_inline_shards.get());
+  }
+  return LocalSizeImpl(_local_shards.get());
+}
+
+template <class SHARD>
+int64_t MemorySparseTable::LocalMFSizeImpl(SHARD* shards) {
   std::vector<int64_t> size_arr(_real_local_shard_num, 0);
   std::vector<std::future<int>> tasks(_real_local_shard_num);
   int64_t ret_size = 0;
   for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
     tasks[shard_id] =
         _shards_task_pool[shard_id % _shards_task_pool.size()]->enqueue(
-            [this, shard_id, &size_arr]() -> int {
-              auto& local_shard = _local_shards[shard_id];
+            [this, shards, shard_id, &size_arr]() -> int {
+              auto& local_shard = shards[shard_id];
               for (auto it = local_shard.begin(); it != local_shard.end();
                    ++it) {
                 if (_value_accesor->HasMF(it.value().size())) {
@@ -720,6 +969,13 @@ int64_t MemorySparseTable::LocalMFSize() {
   return ret_size;
 }
 
+int64_t MemorySparseTable::LocalMFSize() {
+  if (_inline_shards != nullptr) {
+    return LocalMFSizeImpl(_inline_shards.get());
+  }
+  return LocalMFSizeImpl(_local_shards.get());
+}
+
 std::pair<int64_t, int64_t> MemorySparseTable::PrintTableStat() {
   int64_t feasign_size = LocalSize();
   int64_t mf_size = LocalMFSize();
@@ -751,8 +1007,10 @@ int32_t MemorySparseTable::Push(TableContext& context) {
   }
 }
 
-int32_t MemorySparseTable::PullSparse(float* pull_values,
-                                      const PullSparseValue& pull_value) {
+template <class SHARD>
+int32_t MemorySparseTable::PullSparseImpl(SHARD* shards,
+                                          float* pull_values,
+                                          const PullSparseValue& pull_value) {
   CostTimer timer("pserver_sparse_select_all");
   std::vector<std::future<int>> tasks(_real_local_shard_num);
 
@@ -776,22 +1034,30 @@ int32_t MemorySparseTable::PullSparse(float* pull_values,
     tasks[shard_id] =
         _shards_task_pool[shard_id % _shards_task_pool.size()]->enqueue(
             [this,
+             shards,
              shard_id,
              &task_keys,
              value_size,
              pull_values,
              mf_value_size,
              select_value_size]() -> int {
-              auto& local_shard = _local_shards[shard_id];
+              auto& local_shard = shards[shard_id];
               float data_buffer[value_size];  // NOLINT
               float* data_buffer_ptr = data_buffer;
 
               auto& keys = task_keys[shard_id];
+              SparseShardBatchFinder<SHARD> finder(&local_shard, keys);
               for (size_t i = 0; i < keys.size(); i++) {
                 uint64_t key = keys[i].first;
-                auto itr = local_shard.find(key);
+                auto* value = finder.Get(i);
+                if (value == NULL) {
+                  auto itr = local_shard.find(key);
+                  if (itr != local_shard.end()) {
+                    value = itr.value_ptr();
+                  }
+                }
                 size_t data_size = value_size - mf_value_size;
-                if (itr == local_shard.end()) {
+                if (value == NULL) {
                   // ++missed_keys;
                   if (FLAGS_pserver_create_value_when_push) {
                     memset(data_buffer, 0, sizeof(float) * data_size);
@@ -804,9 +1070,9 @@ int32_t MemorySparseTable::PullSparse(float* pull_values,
                         data_ptr, data_buffer_ptr, data_size * sizeof(float));
                   }
                 } else {
-                  data_size = itr.value().size();
+                  data_size = value->size();
                   memcpy(data_buffer_ptr,
-                         itr.value().data(),
+                         value->data(),
                          data_size * sizeof(float));
                 }
                 for (size_t mf_idx = data_size; mf_idx < value_size; ++mf_idx) {
@@ -828,9 +1094,20 @@ int32_t MemorySparseTable::PullSparse(float* pull_values,
   return 0;
 }
 
+int32_t MemorySparseTable::PullSparse(float* pull_values,
+                                      const PullSparseValue& pull_value) {
+  if (_inline_shards != nullptr) {
+    return PullSparseImpl(_inline_shards.get(), pull_values, pull_value);
+  }
+  return PullSparseImpl(_local_shards.get(), pull_values, pull_value);
+}
+
 int32_t MemorySparseTable::PullSparsePtr(char** pull_values,
                                          const uint64_t* keys,
                                          size_t num) {
+  CHECK(_inline_shards == nullptr)
+      << "PullSparsePtr needs vector value storage, table_id: "
+      << _config.table_id();
   CostTimer timer("pscore_sparse_select_all");
   size_t value_size = _value_accesor->GetAccessorInfo().size / sizeof(float);
   size_t mf_value_size =
@@ -857,12 +1134,18 @@ int32_t MemorySparseTable::PullSparsePtr(char** pull_values,
               auto& local_shard = _local_shards[shard_id];
               float data_buffer[value_size];  // NOLINT
               float* data_buffer_ptr = data_buffer;
+              SparseShardBatchFinder<shard_type> finder(&local_shard, keys);
               for (size_t i = 0; i < keys.size(); ++i) {
                 uint64_t key = keys[i].first;
-                auto itr = local_shard.find(key);
+                FixedFeatureValue* ret = finder.Get(i);
+                if (ret == NULL) {
+                  auto itr = local_shard.find(key);
+                  if (itr != local_shard.end()) {
+                    ret = itr.value_ptr();
+                  }
+                }
                 size_t data_size = value_size - mf_value_size;
-                FixedFeatureValue* ret = NULL;
-                if (itr == local_shard.end()) {
+                if (ret == NULL) {
                   // ++missed_keys;
                   auto& feature_value = local_shard[key];
                   feature_value.resize(data_size);
@@ -870,8 +1153,6 @@ int32_t MemorySparseTable::PullSparsePtr(char** pull_values,
                   _value_accesor->Create(&data_buffer_ptr, 1);
                   memcpy(data_ptr, data_buffer_ptr, data_size * sizeof(float));
                   ret = &feature_value;
-                } else {
-                  ret = itr.value_ptr();
                 }
                 int pull_data_idx = keys[i].second;
                 pull_values[pull_data_idx] = reinterpret_cast<char*>(ret);
@@ -885,9 +1166,11 @@ int32_t MemorySparseTable::PullSparsePtr(char** pull_values,
   return 0;
 }
 
-int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
-                                      const float* values,
-                                      size_t num) {
+template <class SHARD>
+int32_t MemorySparseTable::PushSparseImpl(SHARD* shards,
+                                          const uint64_t* keys,
+                                          const float* values,
+                                          size_t num) {
   CostTimer timer("pserver_sparse_update_all");
   std::vector<std::future<int>> tasks(_real_local_shard_num);
   std::vector<std::vector<std::pair<uint64_t, int>>> task_keys(
@@ -907,6 +1190,7 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
   for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
     tasks[shard_id] = _shards_task_pool[shard_id % _task_pool_size]->enqueue(
         [this,
+         shards,
          shard_id,
          value_col,
          mf_value_col,
@@ -914,17 +1198,24 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
          values,
          &task_keys]() -> int {
           auto& keys = task_keys[shard_id];
-          auto& local_shard = _local_shards[shard_id];
+          auto& local_shard = shards[shard_id];
           auto& local_shard_new = _local_shards_new[shard_id];
           float data_buffer[value_col];  // NOLINT
           float* data_buffer_ptr = data_buffer;
+          SparseShardBatchFinder<SHARD> finder(&local_shard, keys);
           for (size_t i = 0; i < keys.size(); ++i) {
             uint64_t key = keys[i].first;
             uint64_t push_data_idx = keys[i].second;
             const float* update_data =
                 values + push_data_idx * update_value_col;
-            auto itr = local_shard.find(key);
-            if (itr == local_shard.end()) {
+            auto* value = finder.Get(i);
+            if (value == NULL) {
+              auto itr = local_shard.find(key);
+              if (itr != local_shard.end()) {
+                value = itr.value_ptr();
+              }
+            }
+            if (value == NULL) {
               if (FLAGS_pserver_enable_create_feasign_randomly &&
                   !_value_accesor->CreateValue(1, update_data)) {
                 continue;
@@ -936,10 +1227,10 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
               memcpy(feature_value.data(),
                      data_buffer_ptr,
                      value_size * sizeof(float));
-              itr = local_shard.find(key);
+              value = &feature_value;
             }
 
-            auto& feature_value = itr.value();
+            auto& feature_value = *value;
             float* value_data = feature_value.data();
             size_t value_size = feature_value.size();
 
@@ -977,8 +1268,19 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
 }
 
 int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
-                                      const float** values,
+                                      const float* values,
                                       size_t num) {
+  if (_inline_shards != nullptr) {
+    return PushSparseImpl(_inline_shards.get(), keys, values, num);
+  }
+  return PushSparseImpl(_local_shards.get(), keys, values, num);
+}
+
+template <class SHARD>
+int32_t MemorySparseTable::PushSparseImpl(SHARD* shards,
+                                          const uint64_t* keys,
+                                          const float** values,
+                                          size_t num) {
   std::vector<std::future<int>> tasks(_real_local_shard_num);
   std::vector<std::vector<std::pair<uint64_t, int>>> task_keys(
       _real_local_shard_num);
@@ -996,6 +1298,7 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
   for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
     tasks[shard_id] = _shards_task_pool[shard_id % _task_pool_size]->enqueue(
         [this,
+         shards,
          shard_id,
          value_col,
          mf_value_col,
@@ -1003,15 +1306,22 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
          values,
          &task_keys]() -> int {
           auto& keys = task_keys[shard_id];
-          auto& local_shard = _local_shards[shard_id];
+          auto& local_shard = shards[shard_id];
           float data_buffer[value_col];  // NOLINT
           float* data_buffer_ptr = data_buffer;
+          SparseShardBatchFinder<SHARD> finder(&local_shard, keys);
           for (size_t i = 0; i < keys.size(); ++i) {
             uint64_t key = keys[i].first;
             uint64_t push_data_idx = keys[i].second;
             const float* update_data = values[push_data_idx];
-            auto itr = local_shard.find(key);
-            if (itr == local_shard.end()) {
+            auto* value = finder.Get(i);
+            if (value == NULL) {
+              auto itr = local_shard.find(key);
+              if (itr != local_shard.end()) {
+                value = itr.value_ptr();
+              }
+            }
+            if (value == NULL) {
               if (FLAGS_pserver_enable_create_feasign_randomly &&
                   !_value_accesor->CreateValue(1, update_data)) {
                 continue;
@@ -1023,9 +1333,9 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
               memcpy(feature_value.data(),
                      data_buffer_ptr,
                      value_size * sizeof(float));
-              itr = local_shard.find(key);
+              value = &feature_value;
             }
-            auto& feature_value = itr.value();
+            auto& feature_value = *value;
             float* value_data = feature_value.data();
             size_t value_size = feature_value.size();
             if (value_size == value_col) {  // 已拓展到最大size, 则就地update
@@ -1052,14 +1362,25 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
   return 0;
 }
 
+int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
+                                      const float** values,
+                                      size_t num) {
+  if (_inline_shards != nullptr) {
+    return PushSparseImpl(_inline_shards.get(), keys, values, num);
+  }
+  return PushSparseImpl(_local_shards.get(), keys, values, num);
+}
+
 int32_t MemorySparseTable::Flush() { return 0; }
 
-int32_t MemorySparseTable::Shrink(const std::string& param) {
+template <class SHARD>
+int32_t MemorySparseTable::ShrinkImpl(SHARD* shards,
+                                      const std::string& param) {
   VLOG(0) << "MemorySparseTable::Shrink";
   // TODO(zhaocaibei123): implement with multi-thread
   for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
     // Shrink
-    auto& shard = _local_shards[shard_id];
+    auto& shard = shards[shard_id];
     for (auto it = shard.begin(); it != shard.end();) {
       if (_value_accesor->Shrink(it.value().data())) {
         it = shard.erase(it);
@@ -1071,6 +1392,13 @@ int32_t MemorySparseTable::Shrink(const std::string& param) {
   return 0;
 }
 
+int32_t MemorySparseTable::Shrink(const std::string& param) {
+  if (_inline_shards != nullptr) {
+    return ShrinkImpl(_inline_shards.get(), param);
+  }
+  return ShrinkImpl(_local_shards.get(), param);
+}
+
 void MemorySparseTable::Clear() { VLOG(0) << "clear coming soon"; }
 
 }  // namespace distributed
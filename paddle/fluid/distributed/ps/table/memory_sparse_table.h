@@ -29,6 +29,7 @@
 #include "paddle/fluid/distributed/ps/table/accessor.h"
 #include "paddle/fluid/distributed/ps/table/common_table.h"
 #include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
+#include "paddle/fluid/distributed/ps/table/depends/inline_feature_value.h"
 #include "paddle/fluid/string/string_helper.h"
 
 #define PSERVER_SAVE_SUFFIX ".shard"
@@ -39,6 +40,7 @@ namespace distributed {
 class MemorySparseTable : public Table {
  public:
   typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
+  typedef InlineSparseTableShard inline_shard_type;
   MemorySparseTable() {}
   virtual ~MemorySparseTable() {}
 
@@ -101,6 +103,9 @@ class MemorySparseTable : public Table {
   void Clear() override;
 
   void* GetShard(size_t shard_idx) override {
+    if (_inline_shards != nullptr) {
+      return &_inline_shards[shard_idx];
+    }
     return &_local_shards[shard_idx];
   }
 
@@ -112,12 +117,54 @@ class MemorySparseTable : public Table {
   virtual int32_t LoadPatch(const std::vector<std::string>& file_list,
                             int save_param);
 
+  // implementations shared by vector and inline value storage
+  template <class SHARD>
+  int32_t LoadImpl(SHARD* shards,
+                   const std::string& path,
+                   const std::string& param);
+  template <class SHARD>
+  int32_t SaveImpl(SHARD* shards,
+                   const std::string& path,
+                   const std::string& param);
+  template <class SHARD>
+  int64_t LocalSizeImpl(SHARD* shards);
+  template <class SHARD>
+  int64_t LocalMFSizeImpl(SHARD* shards);
+  template <class SHARD>
+  int32_t PullSparseImpl(SHARD* shards,
+                         float* values,
+                         const PullSparseValue& pull_value);
+  template <class SHARD>
+  int32_t PushSparseImpl(SHARD* shards,
+                         const uint64_t* keys,
+                         const float* values,
+                         size_t num);
+  template <class SHARD>
+  int32_t PushSparseImpl(SHARD* shards,
+                         const uint64_t* keys,
+                         const float** values,
+                         size_t num);
+  template <class SHARD>
+  int32_t ShrinkImpl(SHARD* shards, const std::string& param);
+  // binary shard snapshots, see sparse_snapshot.h
+  template <class SHARD>
+  int32_t SaveSnapshotImpl(SHARD* shards,
+                           const std::string& table_path,
+                           int save_param);
+  template <class SHARD>
+  int32_t LoadSnapshotImpl(SHARD* shards,
+                           const std::vector<std::string>& file_list,
+                           size_t file_start_idx,
+                           int load_param);
+
   int _task_pool_size = 24;
   int _avg_local_shard_num;
   int _real_local_shard_num;
   int _sparse_table_shard_num;
   std::vector<std::shared_ptr<::ThreadPool>> _shards_task_pool;
   std::unique_ptr<shard_type[]> _local_shards;
+  // set when sparse_value_storage is not VALUE_STORAGE_VECTOR
+  std::unique_ptr<inline_shard_type[]> _inline_shards;
 
   // for patch model
   int _m_avg_local_shard_num;
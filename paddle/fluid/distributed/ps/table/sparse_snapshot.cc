@@ -0,0 +1,242 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/sparse_snapshot.h"
+
+#include <snappy.h>
+#include <string.h>
+
+#include "glog/logging.h"
+#include "paddle/fluid/string/string_helper.h"
+
+namespace paddle {
+namespace distributed {
+
+static const char kSnapshotMagic[8] = {'P', 'S', 'S', 'N', 'A', 'P', '0', '1'};
+static const uint32_t kSnapshotVersion = 1;
+// key + size ahead of the floats of a record
+static const size_t kRecordHeadSize = sizeof(uint64_t) + sizeof(uint32_t);
+
+void InitSparseSnapshotHeader(const std::string& accessor_class,
+                              const AccessorInfo& info,
+                              uint32_t shard_id,
+                              uint64_t key_num,
+                              SparseSnapshotHeader* header) {
+  memset(header, 0, sizeof(SparseSnapshotHeader));
+  memcpy(header->magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+  header->version = kSnapshotVersion;
+  header->value_dim = info.size / sizeof(float);
+  header->mf_dim = info.mf_size / sizeof(float);
+  header->shard_id = shard_id;
+  header->key_num = key_num;
+  strncpy(header->accessor_class,
+          accessor_class.c_str(),
+          sizeof(header->accessor_class) - 1);
+}
+
+int CheckSparseSnapshotHeader(const SparseSnapshotHeader& header,
+                              const std::string& accessor_class,
+                              const AccessorInfo& info) {
+  if (memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+      header.version != kSnapshotVersion) {
+    LOG(ERROR) << "not a sparse snapshot or unknown version "
+               << header.version;
+    return -1;
+  }
+  std::string saved_class(
+      header.accessor_class,
+      strnlen(header.accessor_class, sizeof(header.accessor_class)));
+  if ((!accessor_class.empty() && saved_class != accessor_class) ||
+      header.value_dim != info.size / sizeof(float) ||
+      header.mf_dim != info.mf_size / sizeof(float)) {
+    LOG(ERROR) << "sparse snapshot saved by " << saved_class
+               << " value_dim:" << header.value_dim
+               << " mf_dim:" << header.mf_dim << ", table uses "
+               << accessor_class << " value_dim:" << info.size / sizeof(float)
+               << " mf_dim:" << info.mf_size / sizeof(float);
+    return -1;
+  }
+  return 0;
+}
+
+int SparseSnapshotWriter::WriteHeader(const SparseSnapshotHeader& header) {
+  return _channel->write(reinterpret_cast<const char*>(&header),
+                         sizeof(SparseSnapshotHeader));
+}
+
+int SparseSnapshotWriter::Append(uint64_t key,
+                                 const float* value,
+                                 size_t size) {
+  uint32_t value_size = static_cast<uint32_t>(size);
+  _raw.append(reinterpret_cast<const char*>(&key), sizeof(key));
+  _raw.append(reinterpret_cast<const char*>(&value_size), sizeof(value_size));
+  _raw.append(reinterpret_cast<const char*>(value), size * sizeof(float));
+  ++_record_num;
+  ++_total_record_num;
+  if (_raw.size() >= _block_size) {
+    return FlushBlock();
+  }
+  return 0;
+}
+
+int SparseSnapshotWriter::FlushBlock() {
+  if (_record_num == 0) {
+    return 0;
+  }
+  SparseSnapshotBlock block;
+  block.record_num = _record_num;
+  block.raw_size = static_cast<uint32_t>(_raw.size());
+  block.compressed = 0;
+  const std::string* data = &_raw;
+  if (_compress) {
+    snappy::Compress(_raw.data(), _raw.size(), &_compressed);
+    // keep the raw block when it does not shrink
+    if (_compressed.size() < _raw.size()) {
+      block.compressed = 1;
+      data = &_compressed;
+    }
+  }
+  block.stored_size = static_cast<uint32_t>(data->size());
+  if (_channel->write(reinterpret_cast<const char*>(&block), sizeof(block)) !=
+          0 ||
+      _channel->write(data->data(), data->size()) != 0) {
+    return -1;
+  }
+  _raw.clear();
+  _record_num = 0;
+  return 0;
+}
+
+int SparseSnapshotWriter::Close() {
+  if (FlushBlock() != 0) {
+    return -1;
+  }
+  SparseSnapshotBlock end_block;
+  memset(&end_block, 0, sizeof(end_block));
+  return _channel->write(reinterpret_cast<const char*>(&end_block),
+                         sizeof(end_block));
+}
+
+int SparseSnapshotReader::ReadHeader(SparseSnapshotHeader* header) {
+  return _channel->read(reinterpret_cast<char*>(header),
+                        sizeof(SparseSnapshotHeader));
+}
+
+int SparseSnapshotReader::ReadBlock() {
+  SparseSnapshotBlock block;
+  if (_channel->read(reinterpret_cast<char*>(&block), sizeof(block)) != 0) {
+    LOG(ERROR) << "sparse snapshot is truncated, missing end block";
+    return -1;
+  }
+  if (block.record_num == 0) {
+    _end = true;
+    return 0;
+  }
+  if (block.compressed) {
+    _stored.resize(block.stored_size);
+    if (_channel->read(&_stored[0], _stored.size()) != 0) {
+      return -1;
+    }
+    size_t raw_size = 0;
+    if (!snappy::GetUncompressedLength(
+            _stored.data(), _stored.size(), &raw_size) ||
+        raw_size != block.raw_size ||
+        !snappy::Uncompress(_stored.data(), _stored.size(), &_raw)) {
+      LOG(ERROR) << "sparse snapshot block is corrupted";
+      return -1;
+    }
+  } else {
+    if (block.stored_size != block.raw_size) {
+      LOG(ERROR) << "sparse snapshot block is corrupted";
+      return -1;
+    }
+    _raw.resize(block.raw_size);
+    if (_channel->read(&_raw[0], _raw.size()) != 0) {
+      return -1;
+    }
+  }
+  _pos = 0;
+  _left = block.record_num;
+  return 0;
+}
+
+int SparseSnapshotReader::Next(uint64_t* key,
+                               const float** value,
+                               size_t* size) {
+  while (_left == 0) {
+    if (_end) {
+      return 0;
+    }
+    if (ReadBlock() != 0) {
+      return -1;
+    }
+  }
+  if (_pos + kRecordHeadSize > _raw.size()) {
+    LOG(ERROR) << "sparse snapshot record is out of block";
+    return -1;
+  }
+  uint32_t value_size = 0;
+  memcpy(key, _raw.data() + _pos, sizeof(uint64_t));
+  memcpy(&value_size, _raw.data() + _pos + sizeof(uint64_t), sizeof(uint32_t));
+  _pos += kRecordHeadSize;
+  if (_pos + value_size * sizeof(float) > _raw.size()) {
+    LOG(ERROR) << "sparse snapshot record is out of block";
+    return -1;
+  }
+  *value = reinterpret_cast<const float*>(_raw.data() + _pos);
+  *size = value_size;
+  _pos += value_size * sizeof(float);
+  --_left;
+  return 1;
+}
+
+int32_t SparseSnapshotToText(AfsClient* afs_client,
+                             const FsChannelConfig& snapshot_config,
+                             const FsChannelConfig& text_config,
+                             ValueAccessor* accessor) {
+  int err_no = 0;
+  SparseSnapshotReader reader(
+      afs_client->open_r(snapshot_config, 0, &err_no));
+  SparseSnapshotHeader header;
+  if (reader.ReadHeader(&header) != 0 ||
+      CheckSparseSnapshotHeader(header, "", accessor->GetAccessorInfo()) !=
+          0) {
+    LOG(ERROR) << "bad sparse snapshot " << snapshot_config.path;
+    return -1;
+  }
+  auto write_channel =
+      afs_client->open_w(text_config, 1024 * 1024 * 40, &err_no);
+  uint64_t key = 0;
+  const float* value = nullptr;
+  size_t size = 0;
+  int ret = 0;
+  while ((ret = reader.Next(&key, &value, &size)) == 1) {
+    std::string format_value = accessor->ParseToString(value, size);
+    if (0 != write_channel->write_line(paddle::string::format_string(
+                 "%lu %s", key, format_value.c_str()))) {
+      ret = -1;
+      break;
+    }
+  }
+  write_channel->close();
+  if (ret != 0 || err_no == -1) {
+    LOG(ERROR) << "convert sparse snapshot failed, " << snapshot_config.path
+               << " -> " << text_config.path;
+    return -1;
+  }
+  return 0;
+}
+
+}  // namespace distributed
+}  // namespace paddle
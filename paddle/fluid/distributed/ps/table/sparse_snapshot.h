@@ -0,0 +1,122 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/distributed/common/afs_warpper.h"
+#include "paddle/fluid/distributed/ps/table/accessor.h"
+
+#define PSERVER_SNAPSHOT_SUFFIX ".snap"
+
+namespace paddle {
+namespace distributed {
+
+// Binary shard snapshot of a sparse table:
+//   SparseSnapshotHeader
+//   { SparseSnapshotBlock, block data } ... { record_num == 0 }
+// Block data is a run of records {uint64 key, uint32 size, float[size]},
+// snappy compressed when it pays off. Floats are 4 bytes aligned inside a
+// block, keys are not.
+struct SparseSnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  // value floats of the accessor, full size and the mf part
+  uint32_t value_dim;
+  uint32_t mf_dim;
+  // global shard index
+  uint32_t shard_id;
+  // keys in the shard when saved, used to reserve the map on load
+  uint64_t key_num;
+  char accessor_class[64];
+};
+
+struct SparseSnapshotBlock {
+  uint32_t record_num;
+  uint32_t raw_size;
+  uint32_t stored_size;
+  uint32_t compressed;
+};
+
+void InitSparseSnapshotHeader(const std::string& accessor_class,
+                              const AccessorInfo& info,
+                              uint32_t shard_id,
+                              uint64_t key_num,
+                              SparseSnapshotHeader* header);
+// 0 when the snapshot was written with the same accessor layout, an empty
+// accessor_class only checks the dims
+int CheckSparseSnapshotHeader(const SparseSnapshotHeader& header,
+                              const std::string& accessor_class,
+                              const AccessorInfo& info);
+
+class SparseSnapshotWriter {
+ public:
+  SparseSnapshotWriter(std::shared_ptr<FsWriteChannel> channel,
+                       bool compress,
+                       size_t block_size = 4 * 1024 * 1024)
+      : _channel(channel), _compress(compress), _block_size(block_size) {}
+
+  int WriteHeader(const SparseSnapshotHeader& header);
+  int Append(uint64_t key, const float* value, size_t size);
+  // flush the last block and write the end block
+  int Close();
+  size_t RecordNum() const { return _total_record_num; }
+
+ private:
+  int FlushBlock();
+
+  std::shared_ptr<FsWriteChannel> _channel;
+  bool _compress;
+  size_t _block_size;
+  std::string _raw;
+  std::string _compressed;
+  uint32_t _record_num = 0;
+  size_t _total_record_num = 0;
+};
+
+class SparseSnapshotReader {
+ public:
+  explicit SparseSnapshotReader(std::shared_ptr<FsReadChannel> channel)
+      : _channel(channel) {}
+
+  int ReadHeader(SparseSnapshotHeader* header);
+  // 1 and the next record, 0 at the end block, -1 on broken data.
+  // value points into the current block and stays valid until next call.
+  int Next(uint64_t* key, const float** value, size_t* size);
+
+ private:
+  int ReadBlock();
+
+  std::shared_ptr<FsReadChannel> _channel;
+  std::string _stored;
+  std::string _raw;
+  size_t _pos = 0;
+  uint32_t _left = 0;
+  bool _end = false;
+};
+
+// rewrite a snapshot as the text checkpoint written by Save, "key values"
+// per line formatted by the accessor
+int32_t SparseSnapshotToText(AfsClient* afs_client,
+                             const FsChannelConfig& snapshot_config,
+                             const FsChannelConfig& text_config,
+                             ValueAccessor* accessor);
+
+}  // namespace distributed
+}  // namespace paddle
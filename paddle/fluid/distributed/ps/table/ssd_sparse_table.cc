@@ -26,14 +26,67 @@ DECLARE_bool(pserver_enable_create_feasign_randomly);
 DEFINE_bool(pserver_open_strict_check, false, "pserver_open_strict_check");
 DEFINE_string(rocksdb_path, "database", "path of sparse table rocksdb file");
 DEFINE_int32(pserver_load_batch_size, 5000, "load batch size for ssd");
+DEFINE_bool(pserver_ssd_tiered_mode,
+            false,
+            "evict values to ssd through a write behind queue");
+DEFINE_int64(pserver_ssd_mem_shard_capacity,
+             0,
+             "max keys in memory of a shard in tiered mode, 0 is unbounded");
+DEFINE_int32(pserver_ssd_write_behind_max_pending,
+             100000,
+             "max evicted values of a shard waiting for the ssd write");
 
 namespace paddle {
 namespace distributed {
 
+// put_batch the owned keys and values and clear them
+static void PutStrings(RocksDBHandler* db,
+                       int shard_id,
+                       std::vector<std::string>* keys,
+                       std::vector<std::string>* values) {
+  if (keys->empty()) {
+    return;
+  }
+  std::vector<std::pair<char*, int>> key_slices;
+  std::vector<std::pair<char*, int>> value_slices;
+  key_slices.reserve(keys->size());
+  value_slices.reserve(values->size());
+  for (size_t i = 0; i < keys->size(); ++i) {
+    key_slices.emplace_back(&(*keys)[i][0], (*keys)[i].size());
+    value_slices.emplace_back(&(*values)[i][0], (*values)[i].size());
+  }
+  db->put_batch(shard_id, key_slices, value_slices, key_slices.size());
+  keys->clear();
+  values->clear();
+}
+
+static void DelStrings(RocksDBHandler* db,
+                       int shard_id,
+                       std::vector<std::string>* keys) {
+  if (keys->empty()) {
+    return;
+  }
+  std::vector<std::pair<char*, int>> key_slices;
+  key_slices.reserve(keys->size());
+  for (auto& key : *keys) {
+    key_slices.emplace_back(&key[0], key.size());
+  }
+  db->del_batch(shard_id, key_slices);
+  keys->clear();
+}
+
 int32_t SSDSparseTable::Initialize() {
+  CHECK(_config.sparse_value_storage() == VALUE_STORAGE_VECTOR)
+      << "SSDSparseTable only supports vector value storage";
   MemorySparseTable::Initialize();
   _db = paddle::distributed::RocksDBHandler::GetInstance();
   _db->initialize(FLAGS_rocksdb_path, _real_local_shard_num);
+  if (FLAGS_pserver_ssd_tiered_mode) {
+    _write_behind.reset(new SSDWriteBehindQueue(
+        _db, _real_local_shard_num, FLAGS_pserver_ssd_write_behind_max_pending));
+    LOG(INFO) << "SSDSparseTable tiered mode, mem shard capacity:"
+              << FLAGS_pserver_ssd_mem_shard_capacity;
+  }
   return 0;
 }
 
@@ -102,44 +155,22 @@ int32_t SSDSparseTable::PullSparse(float* pull_values,
                 auto& local_shard = _local_shards[shard_id];
                 float data_buffer[value_size];  // NOLINT
                 float* data_buffer_ptr = data_buffer;
+                LoadMissedKeys(shard_id, keys, true);
                 for (size_t i = 0; i < keys.size(); ++i) {
                   uint64_t key = keys[i].first;
                   auto itr = local_shard.find(key);
                   size_t data_size = value_size - mf_value_size;
                   if (itr == local_shard.end()) {
-                    // pull rocksdb
-                    std::string tmp_string("");
-                    if (_db->get(shard_id,
-                                 reinterpret_cast<char*>(&key),
-                                 sizeof(uint64_t),
-                                 tmp_string) > 0) {
-                      ++missed_keys;
-                      if (FLAGS_pserver_create_value_when_push) {
-                        memset(data_buffer, 0, sizeof(float) * data_size);
-                      } else {
-                        auto& feature_value = local_shard[key];
-                        feature_value.resize(data_size);
-                        float* data_ptr =
-                            const_cast<float*>(feature_value.data());
-                        _value_accesor->Create(&data_buffer_ptr, 1);
-                        memcpy(data_ptr,
-                               data_buffer_ptr,
-                               data_size * sizeof(float));
-                      }
+                    ++missed_keys;
+                    if (FLAGS_pserver_create_value_when_push) {
+                      memset(data_buffer, 0, sizeof(float) * data_size);
                     } else {
-                      data_size = tmp_string.size() / sizeof(float);
-                      memcpy(data_buffer_ptr,
-                             paddle::string::str_to_float(tmp_string),
-                             data_size * sizeof(float));
-                      // from rocksdb to mem
                       auto& feature_value = local_shard[key];
                       feature_value.resize(data_size);
-                      memcpy(const_cast<float*>(feature_value.data()),
-                             data_buffer_ptr,
-                             data_size * sizeof(float));
-                      _db->del_data(shard_id,
-                                    reinterpret_cast<char*>(&key),
-                                    sizeof(uint64_t));
+                      float* data_ptr = const_cast<float*>(feature_value.data());
+                      _value_accesor->Create(&data_buffer_ptr, 1);
+                      memcpy(
+                          data_ptr, data_buffer_ptr, data_size * sizeof(float));
                     }
                   } else {
                     data_size = itr.value().size();
@@ -165,7 +196,8 @@ int32_t SSDSparseTable::PullSparse(float* pull_values,
     }
     if (FLAGS_pserver_print_missed_key_num_every_push) {
       LOG(WARNING) << "total pull keys:" << num
-                   << " missed_keys:" << missed_keys.load();
+                   << " missed_keys:" << missed_keys.load() << " queue_depth:"
+                   << (_write_behind != nullptr ? _write_behind->Depth() : 0);
     }
   }
   return 0;
@@ -175,6 +207,9 @@ int32_t SSDSparseTable::PullSparsePtr(char** pull_values,
                                       const uint64_t* keys,
                                       size_t num) {
   CostTimer timer("pserver_ssd_sparse_select_all");
+  // gpu ps keeps the value pointers, evicted values would be freed
+  CHECK(_write_behind == nullptr || FLAGS_pserver_ssd_mem_shard_capacity == 0)
+      << "PullSparsePtr does not support ssd tiered eviction";
   size_t value_size = _value_accesor->GetAccessorInfo().size / sizeof(float);
   size_t mf_value_size =
       _value_accesor->GetAccessorInfo().mf_size / sizeof(float);
@@ -203,43 +238,21 @@ int32_t SSDSparseTable::PullSparsePtr(char** pull_values,
                 auto& local_shard = _local_shards[shard_id];
                 float data_buffer[value_size];  // NOLINT
                 float* data_buffer_ptr = data_buffer;
+                LoadMissedKeys(shard_id, keys, true);
                 for (size_t i = 0; i < keys.size(); ++i) {
                   uint64_t key = keys[i].first;
                   auto itr = local_shard.find(key);
                   size_t data_size = value_size - mf_value_size;
                   FixedFeatureValue* ret = NULL;
                   if (itr == local_shard.end()) {
-                    // pull rocksdb
-                    std::string tmp_string("");
-                    if (_db->get(shard_id,
-                                 reinterpret_cast<char*>(&key),
-                                 sizeof(uint64_t),
-                                 tmp_string) > 0) {
-                      ++missed_keys;
-                      auto& feature_value = local_shard[key];
-                      feature_value.resize(data_size);
-                      float* data_ptr =
-                          const_cast<float*>(feature_value.data());
-                      _value_accesor->Create(&data_buffer_ptr, 1);
-                      memcpy(
-                          data_ptr, data_buffer_ptr, data_size * sizeof(float));
-                      ret = &feature_value;
-                    } else {
-                      data_size = tmp_string.size() / sizeof(float);
-                      memcpy(data_buffer_ptr,
-                             paddle::string::str_to_float(tmp_string),
-                             data_size * sizeof(float));
-                      // from rocksdb to mem
-                      auto& feature_value = local_shard[key];
-                      feature_value.resize(data_size);
-                      memcpy(const_cast<float*>(feature_value.data()),
-                             data_buffer_ptr,
-                             data_size * sizeof(float));
-                      _db->del_data(shard_id,
-                                    reinterpret_cast<char*>(&key),
-                                    sizeof(uint64_t));
-                      ret = &feature_value;
-                    }
+                    ++missed_keys;
+                    auto& feature_value = local_shard[key];
+                    feature_value.resize(data_size);
+                    float* data_ptr = const_cast<float*>(feature_value.data());
+                    _value_accesor->Create(&data_buffer_ptr, 1);
+                    memcpy(
+                        data_ptr, data_buffer_ptr, data_size * sizeof(float));
+                    ret = &feature_value;
                   } else {
                     ret = itr.value_ptr();
                   }
@@ -254,7 +267,8 @@ int32_t SSDSparseTable::PullSparsePtr(char** pull_values,
     }
     if (FLAGS_pserver_print_missed_key_num_every_push) {
       LOG(WARNING) << "total pull keys:" << num
-                   << " missed_keys:" << missed_keys.load();
+                   << " missed_keys:" << missed_keys.load() << " queue_depth:"
+                   << (_write_behind != nullptr ? _write_behind->Depth() : 0);
     }
   }
   return 0;
@@ -292,6 +306,10 @@ int32_t SSDSparseTable::PushSparse(const uint64_t* keys,
                 auto& local_shard = _local_shards[shard_id];
                 float data_buffer[value_col];  // NOLINT
                 float* data_buffer_ptr = data_buffer;
+                // a key evicted after its pull would be created again
+                if (_write_behind != nullptr) {
+                  LoadMissedKeys(shard_id, keys, false);
+                }
                 for (size_t i = 0; i < keys.size(); ++i) {
                   uint64_t key = keys[i].first;
                   uint64_t push_data_idx = keys[i].second;
@@ -335,6 +353,7 @@ int32_t SSDSparseTable::PushSparse(const uint64_t* keys,
                            value_size * sizeof(float));
                   }
                 }
+                EvictShard(shard_id);
                 return 0;
               });
     }
@@ -398,6 +417,10 @@ int32_t SSDSparseTable::PushSparse(const uint64_t* keys,
                 auto& local_shard = _local_shards[shard_id];
                 float data_buffer[value_col];  // NOLINT
                 float* data_buffer_ptr = data_buffer;
+                // a key evicted after its pull would be created again
+                if (_write_behind != nullptr) {
+                  LoadMissedKeys(shard_id, keys, false);
+                }
                 for (size_t i = 0; i < keys.size(); ++i) {
                   uint64_t key = keys[i].first;
                   uint64_t push_data_idx = keys[i].second;
@@ -440,6 +463,7 @@ int32_t SSDSparseTable::PushSparse(const uint64_t* keys,
                            value_size * sizeof(float));
                   }
                 }
+                EvictShard(shard_id);
                 return 0;
               });
     }
@@ -451,6 +475,7 @@ int32_t SSDSparseTable::PushSparse(const uint64_t* keys,
 }
 
 int32_t SSDSparseTable::Shrink(const std::string& param) {
+  FlushWriteBehind();
 #if defined(PADDLE_WITH_MKLML)
   int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
   omp_set_num_threads(thread_num);
@@ -470,21 +495,31 @@ int32_t SSDSparseTable::Shrink(const std::string& param) {
         ++it;
       }
     }
+    // Shrink decays the value in place, write it back. The iterator reuses
+    // its buffers, so the batches keep copies.
+    std::vector<std::string> put_keys;
+    std::vector<std::string> put_values;
+    std::vector<std::string> del_keys;
     auto* it = _db->get_iterator(i);
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
       if (_value_accesor->Shrink(
               paddle::string::str_to_float(it->value().data()))) {
-        _db->del_data(i, it->key().data(), it->key().size());
+        del_keys.emplace_back(it->key().data(), it->key().size());
         ssd_count++;
       } else {
-        _db->put(i,
-                 it->key().data(),
-                 it->key().size(),
-                 it->value().data(),
-                 it->value().size());
+        put_keys.emplace_back(it->key().data(), it->key().size());
+        put_values.emplace_back(it->value().data(), it->value().size());
+      }
+      if (static_cast<int>(put_keys.size()) >= FLAGS_pserver_load_batch_size) {
+        PutStrings(_db, i, &put_keys, &put_values);
+      }
+      if (static_cast<int>(del_keys.size()) >= FLAGS_pserver_load_batch_size) {
+        DelStrings(_db, i, &del_keys);
       }
     }
     delete it;
+    PutStrings(_db, i, &put_keys, &put_values);
+    DelStrings(_db, i, &del_keys);
     LOG(INFO) << "SSDSparseTable shrink success. shard:" << i << " delete MEM["
               << mem_count << "] SSD[" << ssd_count << "]";
     // _db->flush(i);
@@ -494,29 +529,142 @@ int32_t SSDSparseTable::Shrink(const std::string& param) {
 
 int32_t SSDSparseTable::UpdateTable() {
   // TODO implement with multi-thread
+  // reclaimed keys of the queue are deleted from rocksdb by the writer, it
+  // must not race with the puts below
+  FlushWriteBehind();
   int count = 0;
+  std::vector<std::string> put_keys;
+  std::vector<std::string> put_values;
   for (int i = 0; i < _real_local_shard_num; ++i) {
     auto& shard = _local_shards[i];
     // from mem to ssd
     for (auto it = shard.begin(); it != shard.end();) {
       if (_value_accesor->SaveSSD(it.value().data())) {
-        _db->put(i,
-                 (char*)&it.key(),
-                 sizeof(uint64_t),
-                 (char*)it.value().data(),
-                 it.value().size() * sizeof(float));
+        put_keys.emplace_back(reinterpret_cast<const char*>(&it.key()),
+                              sizeof(uint64_t));
+        put_values.emplace_back(
+            reinterpret_cast<const char*>(it.value().data()),
+            it.value().size() * sizeof(float));
         count++;
         it = shard.erase(it);
+        if (static_cast<int>(put_keys.size()) >=
+            FLAGS_pserver_load_batch_size) {
+          PutStrings(_db, i, &put_keys, &put_values);
+        }
       } else {
         ++it;
       }
     }
+    PutStrings(_db, i, &put_keys, &put_values);
     _db->flush(i);
   }
   LOG(INFO) << "Table>> update count: " << count;
   return 0;
 }
 
+void SSDSparseTable::LoadMissedKeys(
+    int shard_id,
+    const std::vector<std::pair<uint64_t, int>>& keys,
+    bool count_stat) {
+  auto& local_shard = _local_shards[shard_id];
+  std::vector<uint64_t> ssd_keys;
+  std::string value;
+  uint64_t mem_hit = 0;
+  uint64_t queue_hit = 0;
+  for (auto& key : keys) {
+    if (local_shard.find(key.first) != local_shard.end()) {
+      ++mem_hit;
+      continue;
+    }
+    if (_write_behind != nullptr &&
+        _write_behind->Take(shard_id, key.first, &value)) {
+      auto& feature_value = local_shard[key.first];
+      feature_value.resize(value.size() / sizeof(float));
+      memcpy(feature_value.data(), value.data(), value.size());
+      ++queue_hit;
+      continue;
+    }
+    ssd_keys.push_back(key.first);
+  }
+  if (count_stat) {
+    _mem_hit_num += mem_hit;
+    _queue_hit_num += queue_hit;
+  }
+  if (ssd_keys.empty()) {
+    return;
+  }
+  std::vector<std::pair<char*, int>> key_slices;
+  key_slices.reserve(ssd_keys.size());
+  for (auto& key : ssd_keys) {
+    key_slices.emplace_back(reinterpret_cast<char*>(&key), sizeof(uint64_t));
+  }
+  std::vector<std::string> values;
+  std::vector<bool> found;
+  _db->multi_get(shard_id, key_slices, &values, &found);
+  // from rocksdb to mem
+  std::vector<std::pair<char*, int>> found_keys;
+  for (size_t i = 0; i < ssd_keys.size(); ++i) {
+    if (!found[i]) {
+      continue;
+    }
+    auto& feature_value = local_shard[ssd_keys[i]];
+    feature_value.resize(values[i].size() / sizeof(float));
+    memcpy(feature_value.data(), values[i].data(), values[i].size());
+    found_keys.push_back(key_slices[i]);
+  }
+  if (!found_keys.empty()) {
+    _db->del_batch(shard_id, found_keys);
+  }
+  if (count_stat) {
+    _ssd_hit_num += found_keys.size();
+    _miss_num += ssd_keys.size() - found_keys.size();
+  }
+}
+
+void SSDSparseTable::EvictShard(int shard_id) {
+  auto& shard = _local_shards[shard_id];
+  size_t capacity = FLAGS_pserver_ssd_mem_shard_capacity;
+  if (_write_behind == nullptr || capacity == 0 || shard.size() <= capacity) {
+    return;
+  }
+  // evict down to 90% so the scan is not repeated on every push
+  size_t target = capacity - capacity / 10;
+  // values the accessor would move to ssd go first, then any value
+  for (int round = 0; round < 2 && shard.size() > target; ++round) {
+    for (auto it = shard.begin(); it != shard.end() && shard.size() > target;) {
+      if (round == 1 || _value_accesor->SaveSSD(it.value().data())) {
+        _write_behind->Push(
+            shard_id, it.key(), it.value().data(), it.value().size());
+        it = shard.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+SSDSparseTable::TierStat SSDSparseTable::GetTierStat() {
+  TierStat stat;
+  stat.mem_hit = _mem_hit_num.load();
+  stat.queue_hit = _queue_hit_num.load();
+  stat.ssd_hit = _ssd_hit_num.load();
+  stat.miss = _miss_num.load();
+  stat.queue_depth = _write_behind != nullptr ? _write_behind->Depth() : 0;
+  return stat;
+}
+
+std::pair<int64_t, int64_t> SSDSparseTable::PrintTableStat() {
+  auto stat = GetTierStat();
+  uint64_t total = stat.mem_hit + stat.queue_hit + stat.ssd_hit + stat.miss;
+  LOG(INFO) << "SSDSparseTable pull keys:" << total
+            << " mem_hit:" << stat.mem_hit << " queue_hit:" << stat.queue_hit
+            << " ssd_hit:" << stat.ssd_hit << " miss:" << stat.miss
+            << " mem_hit_rate:"
+            << (total > 0 ? static_cast<double>(stat.mem_hit) / total : 0.0)
+            << " queue_depth:" << stat.queue_depth;
+  return MemorySparseTable::PrintTableStat();
+}
+
 int64_t SSDSparseTable::LocalSize() {
   int64_t local_size = 0;
   for (int i = 0; i < _real_local_shard_num; ++i) {
@@ -532,6 +680,8 @@ int32_t SSDSparseTable::Save(const std::string& path,
     _local_show_threshold = -1;
     return 0;
   }
+  // evicted values are saved from rocksdb
+  FlushWriteBehind();
   int save_param = atoi(param.c_str());  // batch_model:0  xbox:1
   //    if (save_param == 5) {
   //        return save_patch(path, save_param);
@@ -860,6 +1010,8 @@ int32_t SSDSparseTable::SaveCache(
 
 int32_t SSDSparseTable::Load(const std::string& path,
                              const std::string& param) {
+  // a queued value must not overwrite the loaded one
+  FlushWriteBehind();
   return MemorySparseTable::Load(path, param);
 }
 
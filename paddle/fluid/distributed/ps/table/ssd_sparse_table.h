@@ -14,8 +14,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
 #include "gflags/gflags.h"
 #include "paddle/fluid/distributed/ps/table/depends/rocksdb_warpper.h"
+#include "paddle/fluid/distributed/ps/table/depends/ssd_write_behind.h"
 #include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
 
 namespace paddle {
@@ -42,7 +48,10 @@ class SSDSparseTable : public MemorySparseTable {
   int32_t PushSparse(const uint64_t* keys, const float* values, size_t num);
   int32_t PushSparse(const uint64_t* keys, const float** values, size_t num);
 
-  int32_t Flush() override { return 0; }
+  int32_t Flush() override {
+    FlushWriteBehind();
+    return 0;
+  }
   virtual int32_t Shrink(const std::string& param) override;
   virtual void Clear() override {
     for (int i = 0; i < _real_local_shard_num; ++i) {
@@ -76,9 +85,39 @@ class SSDSparseTable : public MemorySparseTable {
                        const std::vector<std::string>& file_list,
                        const std::string& param);
   int64_t LocalSize();
+  std::pair<int64_t, int64_t> PrintTableStat() override;
+
+  // where the pulled keys were found since the table was created
+  struct TierStat {
+    uint64_t mem_hit;
+    uint64_t queue_hit;
+    uint64_t ssd_hit;
+    uint64_t miss;
+    size_t queue_depth;
+  };
+  TierStat GetTierStat();
 
  private:
+  // moves the keys of a pull or push that are not in memory back from the
+  // write behind queue and rocksdb, rocksdb is read with one multi_get. The
+  // tier stat counts the pulls only.
+  void LoadMissedKeys(int shard_id,
+                      const std::vector<std::pair<uint64_t, int>>& keys,
+                      bool count_stat);
+  // tiered mode keeps a shard under pserver_ssd_mem_shard_capacity keys
+  void EvictShard(int shard_id);
+  void FlushWriteBehind() {
+    if (_write_behind != nullptr) {
+      _write_behind->Flush();
+    }
+  }
+
   RocksDBHandler* _db;
+  std::unique_ptr<SSDWriteBehindQueue> _write_behind;
+  std::atomic<uint64_t> _mem_hit_num{0};
+  std::atomic<uint64_t> _queue_hit_num{0};
+  std::atomic<uint64_t> _ssd_hit_num{0};
+  std::atomic<uint64_t> _miss_num{0};
   int64_t _cache_tk_size;
   double _local_show_threshold{0.0};
 };
@@ -14,8 +14,11 @@ limitations under the License. */
 
 #include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
 
+#include <unordered_map>
 #include <vector>
 
+#include "paddle/fluid/distributed/ps/table/depends/inline_feature_value.h"
+
 #include "gtest/gtest.h"
 
 namespace paddle {
@@ -46,5 +49,102 @@ TEST(BENCHMARK, LargeScaleKV) {
   ASSERT_FLOAT_EQ(value_data[3], 0.3);
 }
 
+template <class SHARD>
+void CheckFindBatch(SHARD* shard) {
+  std::vector<uint64_t> keys;
+  for (uint64_t key = 0; key < 3000; ++key) {
+    if (key % 3 != 0) {
+      auto& value = (*shard)[key];
+      value.resize(4);
+      value.data()[0] = static_cast<float>(key);
+    }
+    keys.push_back(key);
+  }
+  std::vector<typename SHARD::value_type*> values(keys.size());
+  shard->find_batch(keys.data(), keys.size(), values.data());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i] % 3 == 0) {
+      ASSERT_TRUE(values[i] == nullptr);
+    } else {
+      ASSERT_TRUE(values[i] != nullptr);
+      ASSERT_FLOAT_EQ(values[i]->data()[0], static_cast<float>(keys[i]));
+    }
+  }
+
+  std::vector<std::pair<uint64_t, int>> task_keys;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    task_keys.push_back({keys[keys.size() - 1 - i], i});
+  }
+  SparseShardBatchFinder<SHARD> finder(shard, task_keys);
+  for (size_t i = 0; i < task_keys.size(); ++i) {
+    auto* value = finder.Get(i);
+    auto itr = shard->find(task_keys[i].first);
+    if (itr == shard->end()) {
+      ASSERT_TRUE(value == nullptr);
+    } else {
+      ASSERT_EQ(value, itr.value_ptr());
+    }
+  }
+}
+
+TEST(SparseTableShard, FindBatch) {
+  SparseTableShard<uint64_t, FixedFeatureValue> shard;
+  CheckFindBatch(&shard);
+}
+
+TEST(InlineSparseTableShard, FindBatch) {
+  InlineSparseTableShard shard;
+  shard.init(4);
+  CheckFindBatch(&shard);
+}
+
+TEST(InlineSparseTableShard, InsertEraseIterate) {
+  InlineSparseTableShard shard;
+  shard.init(4);
+  std::unordered_map<uint64_t, float> expect;
+  for (uint64_t key = 1; key <= 5000; ++key) {
+    auto& value = shard[key * 1000];
+    // keys above 4000 grow past the inline capacity
+    value.resize(key > 4000 ? 12 : 4);
+    value.data()[value.size() - 1] = static_cast<float>(key);
+    expect[key * 1000] = static_cast<float>(key);
+  }
+  ASSERT_EQ(shard.size(), 5000UL);
+
+  // drop odd keys while iterating, each entry must be seen once
+  size_t visited = 0;
+  for (auto it = shard.begin(); it != shard.end();) {
+    ++visited;
+    ASSERT_FLOAT_EQ(it.value().data()[it.value().size() - 1],
+                    expect[it.key()]);
+    if ((it.key() / 1000) % 2 == 1) {
+      expect.erase(it.key());
+      it = shard.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  ASSERT_EQ(visited, 5000UL);
+  ASSERT_EQ(shard.size(), expect.size());
+  for (auto& kv : expect) {
+    auto it = shard.find(kv.first);
+    ASSERT_TRUE(it != shard.end());
+    ASSERT_FLOAT_EQ(it.value().data()[it.value().size() - 1], kv.second);
+  }
+  ASSERT_TRUE(shard.find(1000) == shard.end());
+
+  // shrinking back to the inline capacity keeps the prefix
+  auto& value = shard[4002 * 1000];
+  ASSERT_FALSE(value.is_inline());
+  value.data()[0] = 1.5;
+  value.resize(4);
+  ASSERT_TRUE(value.is_inline());
+  ASSERT_FLOAT_EQ(value.data()[0], 1.5);
+
+  shard.clear();
+  ASSERT_EQ(shard.size(), 0UL);
+  ASSERT_TRUE(shard.begin() == shard.end());
+}
+
 }  // namespace distributed
 }  // namespace paddle
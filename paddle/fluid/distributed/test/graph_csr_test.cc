@@ -0,0 +1,111 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr.h"
+
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
+
+namespace paddle {
+namespace distributed {
+
+// vertex v has v + 1 edges to 100 * v + j, weighted j + 1 when weighted
+static std::vector<Node *> MakeNodes(int num, bool weighted) {
+  std::vector<Node *> nodes;
+  for (int v = 0; v < num; ++v) {
+    GraphNode *node = new GraphNode(v);
+    node->build_edges(weighted);
+    for (int j = 0; j <= v; ++j) {
+      node->add_edge(100 * v + j, weighted ? j + 1 : 1);
+    }
+    nodes.push_back(node);
+  }
+  return nodes;
+}
+
+TEST(GraphCSR, Build) {
+  auto nodes = MakeNodes(20, false);
+  GraphCSR csr;
+  csr.build(nodes);
+  EXPECT_EQ(csr.vertex_num(), 20UL);
+  EXPECT_EQ(csr.edge_num(), 210UL);
+  EXPECT_FALSE(csr.is_weighted());
+  for (uint32_t v = 0; v < 20; ++v) {
+    CSRGraphNode csr_node(v, &csr, v);
+    ASSERT_EQ(csr_node.get_neighbor_size(), nodes[v]->get_neighbor_size());
+    for (size_t j = 0; j < csr.degree(v); ++j) {
+      EXPECT_EQ(csr_node.get_neighbor_id(j), nodes[v]->get_neighbor_id(j));
+      EXPECT_EQ(csr_node.get_neighbor_weight(j), 1.0f);
+    }
+  }
+  for (auto *node : nodes) {
+    delete node;
+  }
+}
+
+TEST(GraphCSR, SampleDistinct) {
+  for (bool weighted : {false, true}) {
+    auto nodes = MakeNodes(200, weighted);
+    GraphCSR csr;
+    csr.build(nodes);
+    csr.build_sampler(weighted ? "weighted" : "random");
+    std::mt19937_64 rng(0);
+    std::vector<int> res;
+    for (uint32_t v = 0; v < 200; ++v) {
+      for (int k : {1, 5, 40, 150, 300}) {
+        csr.sample_k(v, k, &rng, &res);
+        EXPECT_EQ(res.size(), std::min<size_t>(k, csr.degree(v)));
+        std::set<int> distinct(res.begin(), res.end());
+        EXPECT_EQ(distinct.size(), res.size());
+        for (int x : res) {
+          EXPECT_GE(x, 0);
+          EXPECT_LT(static_cast<size_t>(x), csr.degree(v));
+        }
+      }
+    }
+    for (auto *node : nodes) {
+      delete node;
+    }
+  }
+}
+
+TEST(GraphCSR, SampleByWeight) {
+  // the first of two draws from weights 1, 2, ..., 10 follows the weights
+  auto nodes = MakeNodes(10, true);
+  GraphCSR csr;
+  csr.build(nodes);
+  csr.build_sampler("weighted");
+  std::mt19937_64 rng(0);
+  std::vector<int> res;
+  std::vector<int> count(10, 0);
+  const int kRounds = 200000;
+  for (int i = 0; i < kRounds; ++i) {
+    csr.sample_k(9, 2, &rng, &res);
+    ++count[res[0]];
+  }
+  for (int j = 0; j < 10; ++j) {
+    EXPECT_NEAR(static_cast<double>(count[j]) / kRounds, (j + 1) / 55.0, 0.005);
+  }
+  for (auto *node : nodes) {
+    delete node;
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,83 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/distributed/ps/table/common_graph_table.h"
+#include "paddle/fluid/distributed/the_one_ps.pb.h"
+
+DEFINE_int64(edge_num, 1000000000, "edges of the synthetic edge file.");
+DEFINE_int64(node_num, 100000000, "source and destination id range.");
+DEFINE_string(path,
+              "graph_load_benchmark_edges.txt",
+              "edge file, generated when it does not exist.");
+DEFINE_int32(shard_num, 127, "shards of the graph table.");
+DEFINE_int32(repeat, 1, "repeat times.");
+DECLARE_int32(graph_load_block_size_mb);
+
+// "src\tdst\tweight" lines, written once and reused by later runs
+static void PrepareEdgeFile() {
+  if (std::ifstream(FLAGS_path).good()) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  FILE *fp = fopen(FLAGS_path.c_str(), "w");
+  CHECK(fp != nullptr) << "can not write " << FLAGS_path;
+  std::mt19937_64 rng(0);
+  for (int64_t i = 0; i < FLAGS_edge_num; ++i) {
+    fprintf(fp,
+            "%llu\t%llu\t%.3f\n",
+            static_cast<unsigned long long>(rng() % FLAGS_node_num),  // NOLINT
+            static_cast<unsigned long long>(rng() % FLAGS_node_num),  // NOLINT
+            static_cast<float>(rng() % 1000) / 1000);
+  }
+  fclose(fp);
+  LOG(INFO) << "write " << FLAGS_edge_num << " edges to " << FLAGS_path
+            << " in "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+                   .count()
+            << " s";
+}
+
+int main(int argc, char *argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  PrepareEdgeFile();
+  ::paddle::distributed::GraphParameter table_proto;
+  table_proto.add_edge_types("u2u");
+  table_proto.set_shard_num(FLAGS_shard_num);
+  table_proto.set_task_pool_size(24);
+  ::paddle::distributed::GraphTable graph_table;
+  graph_table.Initialize(table_proto);
+  // FLAGS_graph_load_block_size_mb=0 measures the line by line loader
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    graph_table.load_edges(FLAGS_path, false, "u2u");
+    double cost = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    LOG(INFO) << "graph_load_block_size_mb " << FLAGS_graph_load_block_size_mb
+              << ": load " << FLAGS_edge_num << " edges in " << cost
+              << " s, " << FLAGS_edge_num / cost << " edges/s";
+    graph_table.clear_graph(0);
+  }
+  return 0;
+}
@@ -0,0 +1,176 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/table/common_graph_table.h"
+#include "paddle/fluid/distributed/the_one_ps.pb.h"
+#include "paddle/fluid/framework/io/fs.h"
+
+DECLARE_int32(graph_load_block_size_mb);
+DECLARE_bool(graph_load_in_parallel);
+
+namespace paddle {
+namespace distributed {
+
+// more than a block of 1 MB, without a '\n' after the last line
+static void WriteFile(const std::string &path,
+                      const std::vector<std::string> &lines) {
+  int err_no = 0;
+  auto fp = paddle::framework::fs_open_write(path, &err_no, "");
+  ASSERT_TRUE(fp != nullptr);
+  for (size_t i = 0; i < lines.size(); ++i) {
+    fputs(lines[i].c_str(), fp.get());
+    if (i + 1 < lines.size()) {
+      fputc('\n', fp.get());
+    }
+  }
+}
+
+// 20 edges a source, a weight on every 1000th line only: the sources of the
+// later blocks start unweighted after the file turned weighted
+static std::vector<std::string> EdgeLines() {
+  std::vector<std::string> lines;
+  for (int i = 0; i < 120000; ++i) {
+    std::string line = std::to_string(i / 20) + "\t" + std::to_string(i);
+    if (i % 1000 == 500) {
+      line += "\t0." + std::to_string(i % 7 + 1);
+    }
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// typed lines are type\tid\tfeatures, untyped ones have an empty type
+static std::vector<std::string> NodeLines(bool typed) {
+  std::vector<std::string> lines;
+  for (int i = 0; i < 60000; ++i) {
+    std::string type = typed ? (i % 3 == 0 ? "item" : "user") : "";
+    lines.push_back(type + "\t" + std::to_string(i) + "\ta 0." +
+                    std::to_string(i % 10) + "\tb " + std::to_string(i) + " " +
+                    std::to_string(i % 5));
+  }
+  return lines;
+}
+
+static void InitGraphTable(GraphTable *table) {
+  GraphParameter table_proto;
+  table_proto.add_edge_types("u2u");
+  table_proto.add_node_types("user");
+  table_proto.add_node_types("item");
+  for (int k = 0; k < 2; ++k) {
+    auto *feature = table_proto.add_graph_feature();
+    feature->add_name("a");
+    feature->add_dtype("float32");
+    feature->add_shape(1);
+    feature->add_name("b");
+    feature->add_dtype("int64");
+    feature->add_shape(2);
+  }
+  table_proto.set_shard_num(16);
+  table_proto.set_task_pool_size(4);
+  table->Initialize(table_proto);
+}
+
+static void ExpectSameEdges(GraphTable *table, GraphTable *expect) {
+  for (uint64_t src = 0; src < 120000 / 20; ++src) {
+    Node *node = table->find_node(0, 0, src);
+    Node *expect_node = expect->find_node(0, 0, src);
+    ASSERT_TRUE(node != nullptr);
+    ASSERT_TRUE(expect_node != nullptr);
+    ASSERT_EQ(node->get_neighbor_size(), expect_node->get_neighbor_size());
+    for (size_t i = 0; i < node->get_neighbor_size(); ++i) {
+      ASSERT_EQ(node->get_neighbor_id(i), expect_node->get_neighbor_id(i));
+      ASSERT_FLOAT_EQ(node->get_neighbor_weight(i),
+                      expect_node->get_neighbor_weight(i))
+          << "src " << src;
+    }
+  }
+}
+
+static void ExpectSameNodes(GraphTable *table, GraphTable *expect) {
+  for (int idx = 0; idx < 2; ++idx) {
+    for (uint64_t id = 0; id < 60000; ++id) {
+      Node *node = table->find_node(1, idx, id);
+      Node *expect_node = expect->find_node(1, idx, id);
+      ASSERT_EQ(node == nullptr, expect_node == nullptr) << "id " << id;
+      if (node == nullptr) {
+        continue;
+      }
+      ASSERT_EQ(node->get_feature_size(), expect_node->get_feature_size());
+      for (int i = 0; i < node->get_feature_size(); ++i) {
+        ASSERT_EQ(node->get_feature(i), expect_node->get_feature(i));
+      }
+    }
+  }
+}
+
+// the block loaders load what the line by line loaders load
+TEST(GraphLoad, BlocksMatchLines) {
+  int block_size_mb = FLAGS_graph_load_block_size_mb;
+  bool in_parallel = FLAGS_graph_load_in_parallel;
+  WriteFile("graph_load_test_edges.txt", EdgeLines());
+  // streamed by fs_open_read
+  WriteFile("graph_load_test_edges.txt.gz", EdgeLines());
+  WriteFile("graph_load_test_typed_nodes.txt", NodeLines(true));
+  WriteFile("graph_load_test_untyped_nodes.txt", NodeLines(false));
+
+  FLAGS_graph_load_in_parallel = false;
+  FLAGS_graph_load_block_size_mb = 0;
+  GraphTable expect;
+  InitGraphTable(&expect);
+  expect.load_edges("graph_load_test_edges.txt", false, "u2u");
+  GraphTable expect_typed;
+  InitGraphTable(&expect_typed);
+  expect_typed.load_nodes("graph_load_test_typed_nodes.txt", "user");
+  GraphTable expect_untyped;
+  InitGraphTable(&expect_untyped);
+  expect_untyped.load_nodes("graph_load_test_untyped_nodes.txt", "");
+  FLAGS_graph_load_in_parallel = true;
+  GraphTable expect_all_types;
+  InitGraphTable(&expect_all_types);
+  expect_all_types.load_nodes("graph_load_test_typed_nodes.txt", "");
+
+  FLAGS_graph_load_in_parallel = false;
+  FLAGS_graph_load_block_size_mb = 1;
+  for (auto path :
+       {"graph_load_test_edges.txt", "graph_load_test_edges.txt.gz"}) {
+    GraphTable table;
+    InitGraphTable(&table);
+    table.load_edges(path, false, "u2u");
+    ExpectSameEdges(&table, &expect);
+  }
+  GraphTable typed;
+  InitGraphTable(&typed);
+  typed.load_nodes("graph_load_test_typed_nodes.txt", "user");
+  ExpectSameNodes(&typed, &expect_typed);
+  GraphTable untyped;
+  InitGraphTable(&untyped);
+  untyped.load_nodes("graph_load_test_untyped_nodes.txt", "");
+  ExpectSameNodes(&untyped, &expect_untyped);
+  FLAGS_graph_load_in_parallel = true;
+  GraphTable all_types;
+  InitGraphTable(&all_types);
+  all_types.load_nodes("graph_load_test_typed_nodes.txt", "");
+  ExpectSameNodes(&all_types, &expect_all_types);
+
+  FLAGS_graph_load_block_size_mb = block_size_mb;
+  FLAGS_graph_load_in_parallel = in_parallel;
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -22,6 +22,7 @@ limitations under the License. */
 
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/table/sparse_snapshot.h"
 #include "paddle/fluid/distributed/ps/table/table.h"
 #include "paddle/fluid/distributed/the_one_ps.pb.h"
 
@@ -152,5 +153,117 @@ TEST(MemorySparseTable, SGD) {
   }
 }
 
+static void InitSnapshotTableConfig(TableParameter *table_config) {
+  table_config->set_table_class("MemorySparseTable");
+  table_config->set_shard_num(10);
+  TableAccessorParameter *accessor_config = table_config->mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(8);
+  accessor_config->set_embedx_threshold(0);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  auto *naive_param =
+      accessor_config->mutable_embed_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0.3);
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  naive_param = accessor_config->mutable_embedx_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0.3);
+}
+
+static std::vector<float> PullAll(Table *table,
+                                  const std::vector<uint64_t> &keys,
+                                  int emb_dim) {
+  std::vector<uint32_t> fres(keys.size(), 1);
+  std::vector<float> values(keys.size() * (emb_dim + 3));
+  auto value = PullSparseValue(keys, fres, emb_dim);
+  TableContext table_context;
+  table_context.value_type = Sparse;
+  table_context.pull_context.pull_value = value;
+  table_context.pull_context.values = values.data();
+  table->Pull(table_context);
+  return values;
+}
+
+TEST(MemorySparseTable, BinarySnapshot) {
+  int emb_dim = 8;
+  std::string path = "./memory_sparse_table_snapshot_test";
+  FsClientParameter fs_config;
+
+  TableParameter table_config;
+  InitSnapshotTableConfig(&table_config);
+  table_config.set_enable_binary_snapshot(true);
+  table_config.set_compress_in_save(true);
+
+  Table *table = new MemorySparseTable();
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    keys.push_back(i * 7919);
+  }
+  PullAll(table, keys, emb_dim);
+  // show > embedx_threshold creates embedx for the pushed keys
+  std::vector<float> push_values;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    push_values.push_back(0);
+    push_values.push_back(1);
+    push_values.push_back(1);
+    for (int k = 0; k < emb_dim + 1; ++k) {
+      push_values.push_back(0.01 * k);
+    }
+  }
+  TableContext push_context;
+  push_context.value_type = Sparse;
+  push_context.push_context.keys = keys.data();
+  push_context.push_context.values = push_values.data();
+  push_context.num = keys.size() / 2;
+  table->Push(push_context);
+  auto expect = PullAll(table, keys, emb_dim);
+  ASSERT_EQ(table->Save(path, "0"), 0);
+
+  Table *loaded = new MemorySparseTable();
+  loaded->SetShard(0, 1);
+  ASSERT_EQ(loaded->Initialize(table_config, fs_config), 0);
+  ASSERT_EQ(loaded->Load(path, "0"), 0);
+  ASSERT_EQ(dynamic_cast<MemorySparseTable *>(loaded)->LocalSize(),
+            dynamic_cast<MemorySparseTable *>(table)->LocalSize());
+  ASSERT_EQ(dynamic_cast<MemorySparseTable *>(loaded)->LocalMFSize(),
+            dynamic_cast<MemorySparseTable *>(table)->LocalMFSize());
+  auto values = PullAll(loaded, keys, emb_dim);
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_FLOAT_EQ(values[i], expect[i]);
+  }
+
+  // snapshots convert to the text checkpoint
+  AfsClient afs_client;
+  afs_client.initialize(fs_config);
+  std::string text_path = path + "_text";
+  for (int i = 0; i < table_config.shard_num(); ++i) {
+    FsChannelConfig snapshot_config;
+    snapshot_config.path = paddle::string::format_string(
+        "%s/000/part-000-%05d%s", path.c_str(), i, PSERVER_SNAPSHOT_SUFFIX);
+    FsChannelConfig text_config;
+    text_config.path = paddle::string::format_string(
+        "%s/000/part-000-%05d", text_path.c_str(), i);
+    ASSERT_EQ(SparseSnapshotToText(&afs_client,
+                                   snapshot_config,
+                                   text_config,
+                                   table->ValueAccesor().get()),
+              0);
+  }
+  table_config.set_enable_binary_snapshot(false);
+  Table *text_loaded = new MemorySparseTable();
+  text_loaded->SetShard(0, 1);
+  ASSERT_EQ(text_loaded->Initialize(table_config, fs_config), 0);
+  ASSERT_EQ(text_loaded->Load(text_path, "0"), 0);
+  values = PullAll(text_loaded, keys, emb_dim);
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_NEAR(values[i], expect[i], 1e-4);
+  }
+}
+
 }  // namespace distributed
 }  // namespace paddle
@@ -0,0 +1,79 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/service/sparse_key_codec.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace distributed {
+
+TEST(SparseKeyCodec, RoundTrip) {
+  std::mt19937_64 rng(0);
+  std::vector<uint64_t> keys;
+  for (int i = 0; i < 10000; ++i) {
+    keys.push_back(i % 3 == 0 ? rng() : rng() % 100000);
+  }
+  keys.push_back(0);
+  keys.push_back(UINT64_MAX);
+  keys.push_back(UINT64_MAX);
+  std::sort(keys.begin(), keys.end());
+
+  std::string buf(keys.size() * kMaxVarint64Bytes, '\0');
+  char* end = EncodeSortedKeys(
+      [&keys](size_t i) { return keys[i]; }, keys.size(), &buf[0]);
+  EXPECT_LT(static_cast<size_t>(end - buf.data()),
+            keys.size() * sizeof(uint64_t));
+
+  std::vector<uint64_t> decoded(keys.size());
+  EXPECT_EQ(DecodeSortedKeys(buf.data(), end, keys.size(), decoded.data()),
+            end);
+  EXPECT_EQ(decoded, keys);
+  // a truncated block is rejected
+  EXPECT_EQ(DecodeSortedKeys(buf.data(), end - 1, keys.size(), decoded.data()),
+            nullptr);
+}
+
+TEST(SparseKeyCodec, Varint) {
+  char buf[kMaxVarint64Bytes + 1];
+  for (uint64_t v : std::vector<uint64_t>{
+           0, 1, 127, 128, 16383, 16384, 4294967295ULL, UINT64_MAX}) {
+    char* end = EncodeVarint64(v, buf);
+    uint64_t decoded = 0;
+    EXPECT_EQ(DecodeVarint64(buf, end, &decoded), end);
+    EXPECT_EQ(decoded, v);
+  }
+  // more than 10 bytes is not a varint
+  std::fill(buf, buf + sizeof(buf), static_cast<char>(0xff));
+  uint64_t decoded = 0;
+  EXPECT_EQ(DecodeVarint64(buf, buf + sizeof(buf), &decoded), nullptr);
+}
+
+TEST(SparseKeyCodec, KeyFormat) {
+  uint32_t format = kSparseKeyDeltaVarint;
+  std::string param(reinterpret_cast<const char*>(&format), sizeof(format));
+  EXPECT_EQ(DecodeSparseKeyFormat(param), kSparseKeyDeltaVarint);
+  // a short param is not read past its end
+  for (size_t len = 0; len < sizeof(format); ++len) {
+    EXPECT_EQ(DecodeSparseKeyFormat(std::string(len, '\x01')), kSparseKeyRaw);
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,127 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/service/sparse_pull_cache.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace distributed {
+
+TEST(SparsePullCache, Staleness) {
+  SparsePullCache cache(100, sizeof(float) * 2, 3, 4);
+  float value[2] = {1.0f, 2.0f};
+  float out[2] = {0, 0};
+  uint64_t step = cache.NextStep();
+  EXPECT_FALSE(cache.Lookup(7, step, out));
+  cache.Insert(7, step, value);
+  EXPECT_TRUE(cache.Lookup(7, step, out));
+  EXPECT_EQ(out[1], 2.0f);
+
+  // refreshed after 3 steps
+  cache.NextStep();
+  EXPECT_TRUE(cache.Lookup(7, cache.NextStep(), out));
+  EXPECT_FALSE(cache.Lookup(7, cache.NextStep(), out));
+
+  // a late response of an older pull keeps the newer value
+  step = cache.NextStep();
+  value[1] = 3.0f;
+  cache.Insert(7, step, value);
+  value[1] = 4.0f;
+  cache.Insert(7, step - 1, value);
+  EXPECT_TRUE(cache.Lookup(7, step, out));
+  EXPECT_EQ(out[1], 3.0f);
+
+  cache.Erase(7);
+  EXPECT_FALSE(cache.Lookup(7, step, out));
+}
+
+// the response of a pull started before the push is applied holds the old
+// value, it must not be served after the Erase
+TEST(SparsePullCache, LateResponseAfterErase) {
+  SparsePullCache cache(100, sizeof(float), 0, 4);
+  float value = 1.0f;
+  float out = 0;
+  uint64_t pull_step = cache.NextStep();
+  cache.Erase(7);
+  cache.Insert(7, pull_step, &value);
+  EXPECT_FALSE(cache.Lookup(7, cache.NextStep(), &out));
+
+  // a pull started after the Erase is cached again
+  uint64_t step = cache.NextStep();
+  value = 2.0f;
+  cache.Insert(7, step, &value);
+  EXPECT_TRUE(cache.Lookup(7, cache.NextStep(), &out));
+  EXPECT_EQ(out, 2.0f);
+}
+
+TEST(SparsePullCache, KeepsHotKeys) {
+  const size_t kCapacity = 64;
+  SparsePullCache cache(kCapacity, sizeof(uint64_t), 0, 1);
+  uint64_t step = cache.NextStep();
+  uint64_t out = 0;
+  for (uint64_t key = 0; key < 16; ++key) {
+    cache.Insert(key, step, &key);
+  }
+  for (uint64_t key = 1000; key < 1000 + 10 * kCapacity; ++key) {
+    // the hot keys are looked up by every batch
+    for (uint64_t hot = 0; hot < 16; ++hot) {
+      if (!cache.Lookup(hot, step, &out)) {
+        cache.Insert(hot, step, &hot);
+      }
+    }
+    cache.Insert(key, step, &key);
+  }
+  for (uint64_t key = 0; key < 16; ++key) {
+    EXPECT_TRUE(cache.Lookup(key, step, &out));
+    EXPECT_EQ(out, key);
+  }
+  size_t cached = 0;
+  for (uint64_t key = 1000; key < 1000 + 10 * kCapacity; ++key) {
+    cached += cache.Lookup(key, step, &out);
+  }
+  EXPECT_LE(cached, kCapacity - 16);
+}
+
+TEST(SparsePullCache, MultiThread) {
+  SparsePullCache cache(1000, sizeof(uint64_t), 5);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, t]() {
+      for (uint64_t i = 0; i < 20000; ++i) {
+        uint64_t key = (i * 7919 + t) % 3000;
+        uint64_t step = cache.NextStep();
+        uint64_t out = 0;
+        if (cache.Lookup(key, step, &out)) {
+          EXPECT_EQ(out, key * 3);
+        } else {
+          uint64_t value = key * 3;
+          cache.Insert(key, step, &value);
+        }
+        if (i % 11 == 0) {
+          cache.Erase(key);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
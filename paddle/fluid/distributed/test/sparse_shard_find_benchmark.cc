@@ -0,0 +1,139 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
+#include "paddle/fluid/distributed/ps/table/depends/inline_feature_value.h"
+
+DEFINE_int64(key_num, 100000000, "resident keys of the shard.");
+DEFINE_int32(value_dim, 11, "floats of every value.");
+DEFINE_int64(lookup_num, 10000000, "random lookups of every round.");
+DEFINE_int32(repeat, 3, "repeat times.");
+DEFINE_bool(inline_shard, false, "benchmark InlineSparseTableShard.");
+
+using paddle::distributed::FixedFeatureValue;
+using paddle::distributed::InlineSparseTableShard;
+using paddle::distributed::SPARSE_SHARD_FIND_BATCH;
+using paddle::distributed::SparseTableShard;
+
+// resident keys are a function of their index, no key list is kept
+static uint64_t KeyOf(uint64_t idx) {
+  uint64_t z = idx + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+template <class SHARD>
+static void Fill(SHARD* shard) {
+  auto start = std::chrono::steady_clock::now();
+  for (int64_t i = 0; i < FLAGS_key_num; ++i) {
+    auto& value = (*shard)[KeyOf(i)];
+    value.resize(FLAGS_value_dim);
+    value.data()[0] = static_cast<float>(i);
+  }
+  LOG(INFO) << "fill " << shard->size() << " keys in "
+            << std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+                   .count()
+            << " s";
+}
+
+template <class SHARD, class LookupFunc>
+static double Bench(SHARD* shard,
+                    const std::vector<uint64_t>& keys,
+                    LookupFunc func,
+                    double* checksum) {
+  double best = 0;
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    *checksum = func(shard, keys);
+    double cost = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    if (r == 0 || cost < best) {
+      best = cost;
+    }
+  }
+  return best;
+}
+
+template <class SHARD>
+static double FindOneByOne(SHARD* shard, const std::vector<uint64_t>& keys) {
+  double sum = 0;
+  for (auto key : keys) {
+    auto itr = shard->find(key);
+    if (itr != shard->end()) {
+      sum += itr.value().data()[0];
+    }
+  }
+  return sum;
+}
+
+template <class SHARD>
+static double FindBatch(SHARD* shard, const std::vector<uint64_t>& keys) {
+  typename SHARD::value_type* values[SPARSE_SHARD_FIND_BATCH];
+  double sum = 0;
+  for (size_t i = 0; i < keys.size(); i += SPARSE_SHARD_FIND_BATCH) {
+    size_t num = std::min(SPARSE_SHARD_FIND_BATCH, keys.size() - i);
+    shard->find_batch(keys.data() + i, num, values);
+    for (size_t j = 0; j < num; ++j) {
+      if (values[j] != nullptr) {
+        sum += values[j]->data()[0];
+      }
+    }
+  }
+  return sum;
+}
+
+template <class SHARD>
+static void Run(SHARD* shard) {
+  Fill(shard);
+  std::mt19937_64 rng(0);
+  std::vector<uint64_t> keys(FLAGS_lookup_num);
+  for (auto& key : keys) {
+    key = KeyOf(rng() % FLAGS_key_num);
+  }
+  double scalar_sum = 0;
+  double batch_sum = 0;
+  double scalar = Bench(shard, keys, FindOneByOne<SHARD>, &scalar_sum);
+  double batch = Bench(shard, keys, FindBatch<SHARD>, &batch_sum);
+  CHECK_EQ(scalar_sum, batch_sum);
+  LOG(INFO) << "find: " << scalar / keys.size() * 1e9 << " ns/key";
+  LOG(INFO) << "find_batch: " << batch / keys.size() * 1e9
+            << " ns/key, speedup " << scalar / batch;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  if (FLAGS_inline_shard) {
+    std::unique_ptr<InlineSparseTableShard> shard(new InlineSparseTableShard);
+    shard->init(FLAGS_value_dim);
+    shard->reserve(FLAGS_key_num);
+    Run(shard.get());
+  } else {
+    std::unique_ptr<SparseTableShard<uint64_t, FixedFeatureValue>> shard(
+        new SparseTableShard<uint64_t, FixedFeatureValue>);
+    Run(shard.get());
+  }
+  return 0;
+}
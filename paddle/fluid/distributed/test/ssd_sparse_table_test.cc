@@ -0,0 +1,198 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/distributed/ps/table/ssd_sparse_table.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/table/depends/ssd_write_behind.h"
+#include "paddle/fluid/distributed/ps/table/table.h"
+#include "paddle/fluid/distributed/the_one_ps.pb.h"
+
+DECLARE_bool(pserver_ssd_tiered_mode);
+DECLARE_int64(pserver_ssd_mem_shard_capacity);
+DECLARE_string(rocksdb_path);
+
+namespace paddle {
+namespace distributed {
+
+TEST(SSDWriteBehindQueue, TakeAndFlush) {
+  RocksDBHandler db;
+  db.initialize("./ssd_write_behind_test_db", 2);
+  SSDWriteBehindQueue queue(&db, 2, 64);
+  std::vector<float> value(4);
+  for (uint64_t key = 0; key < 1000; ++key) {
+    for (size_t k = 0; k < value.size(); ++k) {
+      value[k] = key + 0.1 * k;
+    }
+    queue.Push(key % 2, key, value.data(), value.size());
+  }
+  // every tenth key is taken back, pending or in flight, unless it is
+  // already written
+  std::vector<bool> taken(1000, false);
+  for (uint64_t key = 0; key < 1000; key += 10) {
+    std::string data;
+    taken[key] = queue.Take(key % 2, key, &data);
+    if (taken[key]) {
+      ASSERT_EQ(data.size(), value.size() * sizeof(float));
+      ASSERT_FLOAT_EQ(reinterpret_cast<const float *>(data.data())[1],
+                      static_cast<float>(key + 0.1));
+    }
+  }
+  queue.Flush();
+  ASSERT_EQ(queue.Depth(), 0UL);
+  // a value is either taken or in the db
+  for (uint64_t key = 0; key < 1000; ++key) {
+    std::string data;
+    int ret = db.get(
+        key % 2, reinterpret_cast<const char *>(&key), sizeof(key), data);
+    if (taken[key]) {
+      ASSERT_EQ(ret, 1);
+      continue;
+    }
+    ASSERT_EQ(ret, 0);
+    ASSERT_FLOAT_EQ(reinterpret_cast<const float *>(data.data())[1],
+                    static_cast<float>(key + 0.1));
+  }
+}
+
+// zero initial range, so tables created apart hold the same values
+static void InitTableConfig(const std::string &table_class,
+                            TableParameter *table_config) {
+  table_config->set_table_class(table_class);
+  table_config->set_shard_num(10);
+  TableAccessorParameter *accessor_config = table_config->mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(8);
+  accessor_config->set_embedx_threshold(0);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  auto *naive_param =
+      accessor_config->mutable_embed_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0);
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  naive_param = accessor_config->mutable_embedx_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0);
+}
+
+static std::vector<float> PullAll(Table *table,
+                                  const std::vector<uint64_t> &keys,
+                                  int emb_dim) {
+  std::vector<uint32_t> fres(keys.size(), 1);
+  std::vector<float> values(keys.size() * (emb_dim + 3));
+  auto value = PullSparseValue(keys, fres, emb_dim);
+  TableContext table_context;
+  table_context.value_type = Sparse;
+  table_context.pull_context.pull_value = value;
+  table_context.pull_context.values = values.data();
+  table->Pull(table_context);
+  return values;
+}
+
+static void PushAll(Table *table,
+                    const std::vector<uint64_t> &keys,
+                    int emb_dim,
+                    int round) {
+  std::vector<float> push_values;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    push_values.push_back(0);
+    push_values.push_back(1);
+    push_values.push_back(i % 2);
+    for (int k = 0; k < emb_dim + 1; ++k) {
+      push_values.push_back(0.01 * ((i + k + round) % 13));
+    }
+  }
+  TableContext push_context;
+  push_context.value_type = Sparse;
+  push_context.push_context.keys = keys.data();
+  push_context.push_context.values = push_values.data();
+  push_context.num = keys.size();
+  table->Push(push_context);
+}
+
+TEST(SSDSparseTable, TieredMode) {
+  int emb_dim = 8;
+  int64_t capacity = 20;
+  FLAGS_rocksdb_path = "./ssd_sparse_table_test_db";
+  FLAGS_pserver_ssd_tiered_mode = true;
+  FLAGS_pserver_ssd_mem_shard_capacity = capacity;
+  std::string path = "./ssd_sparse_table_test";
+  FsClientParameter fs_config;
+
+  TableParameter ssd_config;
+  InitTableConfig("SSDSparseTable", &ssd_config);
+  Table *table = new SSDSparseTable();
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(ssd_config, fs_config), 0);
+  auto ssd_table = dynamic_cast<SSDSparseTable *>(table);
+
+  // the memory table sees the same pulls and pushes
+  TableParameter mem_config;
+  InitTableConfig("MemorySparseTable", &mem_config);
+  Table *expect_table = new MemorySparseTable();
+  expect_table->SetShard(0, 1);
+  ASSERT_EQ(expect_table->Initialize(mem_config, fs_config), 0);
+
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 2000; ++i) {
+    keys.push_back(i * 7919);
+  }
+  for (int round = 0; round < 3; ++round) {
+    auto values = PullAll(table, keys, emb_dim);
+    auto expect = PullAll(expect_table, keys, emb_dim);
+    for (size_t i = 0; i < values.size(); ++i) {
+      ASSERT_FLOAT_EQ(values[i], expect[i]) << "round " << round;
+    }
+    PushAll(table, keys, emb_dim, round);
+    PushAll(expect_table, keys, emb_dim, round);
+    // the pushes evicted every shard down to its capacity
+    ASSERT_LE(ssd_table->LocalSize(),
+              capacity * ssd_config.shard_num());
+    if (round == 0) {
+      // the next pulls load the evicted values back from rocksdb
+      table->Flush();
+      ASSERT_EQ(ssd_table->GetTierStat().queue_depth, 0UL);
+    }
+  }
+  auto stat = ssd_table->GetTierStat();
+  ASSERT_GT(stat.ssd_hit, 0UL);
+  // only the first pull creates values
+  ASSERT_EQ(stat.miss, keys.size());
+  ASSERT_EQ(stat.mem_hit + stat.queue_hit + stat.ssd_hit + stat.miss,
+            3 * keys.size());
+
+  // pushes without a pull load the evicted values back too, and save
+  // writes the memory tier and rocksdb
+  PushAll(table, keys, emb_dim, 3);
+  PushAll(expect_table, keys, emb_dim, 3);
+  auto expect = PullAll(expect_table, keys, emb_dim);
+  ASSERT_EQ(table->Save(path, "0"), 0);
+  Table *loaded = new MemorySparseTable();
+  loaded->SetShard(0, 1);
+  ASSERT_EQ(loaded->Initialize(mem_config, fs_config), 0);
+  ASSERT_EQ(loaded->Load(path, "0"), 0);
+  ASSERT_EQ(dynamic_cast<MemorySparseTable *>(loaded)->LocalSize(),
+            static_cast<int64_t>(keys.size()));
+  auto values = PullAll(loaded, keys, emb_dim);
+  for (size_t i = 0; i < values.size(); ++i) {
+    ASSERT_NEAR(values[i], expect[i], 1e-4);
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
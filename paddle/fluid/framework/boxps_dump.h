@@ -0,0 +1,501 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "glog/logging.h"
+
+namespace paddle {
+namespace framework {
+
+/**
+ * @Brief formatting of paddlebox dump values, the output is byte identical
+ * to printf ":%.9g" for floats and ":%lu", ":%d" for integers
+ */
+static const char kDumpDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+
+// writes the digits of v backwards from end, returns the first digit
+inline char* DumpFormatUInt(uint64_t v, char* end) {
+  while (v >= 100) {
+    const char* pair = &kDumpDigitPairs[(v % 100) * 2];
+    v /= 100;
+    *--end = pair[1];
+    *--end = pair[0];
+  }
+  if (v >= 10) {
+    const char* pair = &kDumpDigitPairs[v * 2];
+    *--end = pair[1];
+    *--end = pair[0];
+  } else {
+    *--end = static_cast<char>('0' + v);
+  }
+  return end;
+}
+
+inline int DumpFormatUInt64(uint64_t v, char* buf) {
+  char tmp[24];
+  char* end = tmp + sizeof(tmp);
+  char* begin = DumpFormatUInt(v, end);
+  memcpy(buf, begin, end - begin);
+  return static_cast<int>(end - begin);
+}
+
+inline int DumpFormatInt64(int64_t v, char* buf) {
+  if (v < 0) {
+    *buf = '-';
+    return 1 + DumpFormatUInt64(0 - static_cast<uint64_t>(v), buf + 1);
+  }
+  return DumpFormatUInt64(static_cast<uint64_t>(v), buf);
+}
+
+// "%.9g" of v, buf holds at least 32 chars. Values are scaled to nine
+// digits with one rounding, near ties, non finite values and exponents out
+// of the exact powers of ten go to snprintf.
+inline int DumpFormatG9(double v, char* buf) {
+  static const double kPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                  1e18, 1e19, 1e20, 1e21, 1e22};
+  if (!std::isfinite(v) || v == 0) {
+    return snprintf(buf, 32, "%.9g", v);
+  }
+  double a = std::fabs(v);
+  int bin_exp = 0;
+  std::frexp(a, &bin_exp);
+  int e = static_cast<int>(std::floor((bin_exp - 1) * 0.30102999566398120));
+  double scaled = 0;
+  bool in_range = false;
+  for (int iter = 0; iter < 3; ++iter) {
+    int k = 8 - e;
+    if (k > 22 || k < -22) {
+      return snprintf(buf, 32, "%.9g", v);
+    }
+    scaled = k >= 0 ? a * kPow10[k] : a / kPow10[-k];
+    if (scaled >= 1e9) {
+      ++e;
+    } else if (scaled < 1e8) {
+      --e;
+    } else {
+      in_range = true;
+      break;
+    }
+  }
+  double floor_scaled = std::floor(scaled);
+  double frac = scaled - floor_scaled;
+  if (!in_range || std::fabs(frac - 0.5) < 1e-6) {
+    return snprintf(buf, 32, "%.9g", v);
+  }
+  uint64_t digits = static_cast<uint64_t>(floor_scaled) + (frac > 0.5);
+  if (digits >= 1000000000ULL) {
+    digits /= 10;
+    ++e;
+  }
+  char d[9];
+  DumpFormatUInt(digits, d + 9);
+  int len = 9;
+  while (len > 1 && d[len - 1] == '0') {
+    --len;
+  }
+  char* p = buf;
+  if (v < 0) {
+    *p++ = '-';
+  }
+  if (e < -4 || e >= 9) {
+    *p++ = d[0];
+    if (len > 1) {
+      *p++ = '.';
+      memcpy(p, d + 1, len - 1);
+      p += len - 1;
+    }
+    *p++ = 'e';
+    *p++ = e < 0 ? '-' : '+';
+    int abs_e = e < 0 ? -e : e;
+    if (abs_e < 10) {
+      *p++ = '0';
+    }
+    p = p + DumpFormatUInt64(abs_e, p);
+  } else if (e >= 0) {
+    int int_len = e + 1;
+    memcpy(p, d, int_len);
+    p += int_len;
+    if (len > int_len) {
+      *p++ = '.';
+      memcpy(p, d + int_len, len - int_len);
+      p += len - int_len;
+    }
+  } else {
+    *p++ = '0';
+    *p++ = '.';
+    for (int i = -1; i > e; --i) {
+      *p++ = '0';
+    }
+    memcpy(p, d, len);
+    p += len;
+  }
+  return static_cast<int>(p - buf);
+}
+
+// value types of dump tensors
+enum DumpValueType : uint8_t {
+  kDumpNone = 0,
+  kDumpFloat = 1,
+  kDumpUInt64 = 2,
+  kDumpDouble = 3,
+  kDumpInt32 = 4,
+  kDumpInt16 = 5,
+};
+
+inline size_t DumpValueSize(uint8_t type) {
+  switch (type) {
+    case kDumpFloat:
+    case kDumpInt32:
+      return 4;
+    case kDumpUInt64:
+    case kDumpDouble:
+      return 8;
+    case kDumpInt16:
+      return 2;
+    default:
+      return 0;
+  }
+}
+
+template <typename T>
+inline T DumpLoadValue(const void* values, size_t i) {
+  T v;
+  memcpy(&v, reinterpret_cast<const char*>(values) + i * sizeof(T), sizeof(T));
+  return v;
+}
+
+// appends ":value" for every value, the same text as PrintLodTensor. values
+// may be unaligned when read from a binary record.
+inline void DumpAppendValues(uint8_t type,
+                             const void* values,
+                             size_t num,
+                             std::string* out) {
+  const size_t max_len = 32;
+  size_t len = out->size();
+  out->resize(len + num * max_len);
+  char* p = &(*out)[len];
+  char* begin = p;
+  for (size_t i = 0; i < num; ++i) {
+    *p++ = ':';
+    switch (type) {
+      case kDumpFloat:
+        p += DumpFormatG9(DumpLoadValue<float>(values, i), p);
+        break;
+      case kDumpUInt64:
+        p += DumpFormatUInt64(DumpLoadValue<uint64_t>(values, i), p);
+        break;
+      case kDumpDouble:
+        p += DumpFormatG9(DumpLoadValue<double>(values, i), p);
+        break;
+      case kDumpInt32:
+        p += DumpFormatInt64(DumpLoadValue<int32_t>(values, i), p);
+        break;
+      case kDumpInt16:
+        p += DumpFormatInt64(DumpLoadValue<int16_t>(values, i), p);
+        break;
+      default:
+        break;
+    }
+  }
+  out->resize(len + (p - begin));
+}
+
+/**
+ * @Brief binary dump file: kDumpBinaryMagic, then one record for every text
+ * line. A record is "uint32 body length, segments", a segment is "uint16 text
+ * length, text, uint8 value type, uint32 value count, values" and converts to
+ * the text followed by ":value" of every value, the record ends the line.
+ * Text over 64KB is written as segments of no values before the last one.
+ */
+static const char kDumpBinaryMagic[8] = {'P', 'B', 'D', 'U', 'M', 'P', '0', '1'};
+
+inline size_t DumpBinaryBeginRecord(std::string* out) {
+  size_t pos = out->size();
+  out->append(sizeof(uint32_t), '\0');
+  return pos;
+}
+
+inline void DumpBinaryAppendSegment(std::string* out,
+                                    const char* text,
+                                    size_t text_len,
+                                    uint8_t type,
+                                    const void* values,
+                                    uint32_t num) {
+  while (text_len > UINT16_MAX) {
+    DumpBinaryAppendSegment(out, text, UINT16_MAX, kDumpNone, nullptr, 0);
+    text += UINT16_MAX;
+    text_len -= UINT16_MAX;
+  }
+  uint16_t len16 = static_cast<uint16_t>(text_len);
+  out->append(reinterpret_cast<const char*>(&len16), sizeof(len16));
+  out->append(text, text_len);
+  out->append(reinterpret_cast<const char*>(&type), sizeof(type));
+  out->append(reinterpret_cast<const char*>(&num), sizeof(num));
+  if (num > 0) {
+    out->append(reinterpret_cast<const char*>(values),
+                DumpValueSize(type) * num);
+  }
+}
+
+inline void DumpBinaryEndRecord(std::string* out, size_t pos) {
+  uint32_t body_len =
+      static_cast<uint32_t>(out->size() - pos - sizeof(uint32_t));
+  memcpy(&(*out)[pos], &body_len, sizeof(body_len));
+}
+
+// converts the record at data to a text line, returns the bytes used or 0
+// when the record is truncated or malformed
+inline size_t DumpBinaryRecordToText(const char* data,
+                                     size_t len,
+                                     std::string* out) {
+  uint32_t body_len = 0;
+  if (len < sizeof(body_len)) {
+    return 0;
+  }
+  memcpy(&body_len, data, sizeof(body_len));
+  if (len - sizeof(body_len) < body_len) {
+    return 0;
+  }
+  const char* p = data + sizeof(body_len);
+  const char* end = p + body_len;
+  while (p < end) {
+    uint16_t text_len = 0;
+    uint8_t type = 0;
+    uint32_t num = 0;
+    if (end - p < static_cast<ptrdiff_t>(sizeof(text_len))) {
+      return 0;
+    }
+    memcpy(&text_len, p, sizeof(text_len));
+    p += sizeof(text_len);
+    if (end - p < static_cast<ptrdiff_t>(text_len + sizeof(type) + sizeof(num))) {
+      return 0;
+    }
+    out->append(p, text_len);
+    p += text_len;
+    memcpy(&type, p, sizeof(type));
+    p += sizeof(type);
+    memcpy(&num, p, sizeof(num));
+    p += sizeof(num);
+    size_t bytes = DumpValueSize(type) * num;
+    if (static_cast<size_t>(end - p) < bytes) {
+      return 0;
+    }
+    DumpAppendValues(type, p, num, out);
+    p += bytes;
+  }
+  out->append("\n");
+  return sizeof(body_len) + body_len;
+}
+
+/**
+ * @Brief every dump thread appends to its own block, a block is handed to the
+ * writer thread when it is full at a line end, so files never split a line.
+ * Each thread has one block filling and one in flight, the dump threads only
+ * wait when the writer is a whole block behind. writer_num threads write the
+ * blocks of different files in parallel.
+ */
+class AsyncDumpWriter {
+ public:
+  // path of the fileid-th file of thread tid
+  typedef std::function<std::string(int tid, int fileid)> PathFunc;
+
+  AsyncDumpWriter(int thread_num,
+                  PathFunc path_func,
+                  size_t block_size,
+                  size_t max_file_len,
+                  const std::string& file_header,
+                  int writer_num = 1)
+      : files_(thread_num),
+        path_func_(path_func),
+        block_size_(block_size),
+        max_file_len_(max_file_len),
+        file_header_(file_header) {
+    for (auto& file : files_) {
+      file.reset(new File());
+      file->filling.reserve(block_size_ + block_size_ / 4);
+    }
+    for (int i = 0; i < std::max(writer_num, 1); ++i) {
+      write_threads_.emplace_back([this]() { WriteLoop(); });
+    }
+  }
+  ~AsyncDumpWriter() {
+    Flush();
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      stop_ = true;
+    }
+    queue_cond_.notify_all();
+    for (auto& thread : write_threads_) {
+      thread.join();
+    }
+  }
+
+  // line_end is false when a long line is appended in parts
+  void Append(int tid, const std::string& buf, bool line_end = true) {
+    File& file = *files_[tid];
+    file.filling.append(buf);
+    if (line_end && file.filling.size() >= block_size_) {
+      Submit(tid);
+    }
+  }
+
+  // writes all blocks, then syncs and closes the files, the next dump starts
+  // again from the first file of every thread
+  void Flush() {
+    for (size_t tid = 0; tid < files_.size(); ++tid) {
+      if (!files_[tid]->filling.empty()) {
+        Submit(tid);
+      }
+    }
+    for (auto& file_ptr : files_) {
+      File& file = *file_ptr;
+      {
+        std::unique_lock<std::mutex> lock(file.mutex);
+        file.cond.wait(lock, [&file] { return !file.busy; });
+      }
+      if (file.fd < 0) {
+        continue;
+      }
+      if (file.len > 0) {
+        ::fsync(file.fd);
+      }
+      ::close(file.fd);
+      file.fd = -1;
+      file.len = 0;
+      file.fileid = 0;
+    }
+  }
+
+ private:
+  struct File {
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::string filling;
+    std::string writing;
+    bool busy = false;
+    // owned by the writer thread of the block while busy
+    int fd = -1;
+    size_t len = 0;
+    int fileid = 0;
+  };
+
+  void Submit(int tid) {
+    File& file = *files_[tid];
+    {
+      std::unique_lock<std::mutex> lock(file.mutex);
+      file.cond.wait(lock, [&file] { return !file.busy; });
+      file.filling.swap(file.writing);
+      file.busy = true;
+    }
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      queue_.push_back(tid);
+    }
+    queue_cond_.notify_one();
+  }
+
+  void WriteLoop() {
+    while (true) {
+      int tid = -1;
+      {
+        std::unique_lock<std::mutex> lock(queue_mutex_);
+        queue_cond_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+          break;
+        }
+        tid = queue_.front();
+        queue_.pop_front();
+      }
+      File& file = *files_[tid];
+      WriteBlock(tid, &file);
+      file.writing.clear();
+      {
+        std::lock_guard<std::mutex> lock(file.mutex);
+        file.busy = false;
+      }
+      file.cond.notify_all();
+    }
+  }
+
+  void WriteBlock(int tid, File* file) {
+    if (file->fd < 0 || file->len >= max_file_len_) {
+      if (file->fd >= 0) {
+        ::close(file->fd);
+      }
+      std::string filename = path_func_(tid, file->fileid);
+      ++file->fileid;
+      file->fd = ::open(
+          filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_APPEND, 0777);
+      CHECK(file->fd >= 0) << "open " << filename << " failed";
+      file->len = 0;
+      WriteAll(file, file_header_.data(), file_header_.size());
+    }
+    WriteAll(file, file->writing.data(), file->writing.size());
+  }
+
+  void WriteAll(File* file, const char* data, size_t len) {
+    while (len > 0) {
+      ssize_t ret = ::write(file->fd, data, len);
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        LOG(ERROR) << "write dump file failed, errno=" << errno;
+        return;
+      }
+      data += ret;
+      len -= ret;
+      file->len += ret;
+    }
+  }
+
+  std::vector<std::unique_ptr<File>> files_;
+  PathFunc path_func_;
+  size_t block_size_;
+  size_t max_file_len_;
+  std::string file_header_;
+  std::mutex queue_mutex_;
+  std::condition_variable queue_cond_;
+  std::deque<int> queue_;
+  bool stop_ = false;
+  std::vector<std::thread> write_threads_;
+};
+
+}  // namespace framework
+}  // namespace paddle
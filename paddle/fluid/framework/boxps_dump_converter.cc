@@ -0,0 +1,92 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+// converts binary paddlebox dump files (FLAGS_padbox_dump_binary_format) to
+// the text dump, usage: boxps_dump_converter part-00-00000-00000 ... > text
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/framework/boxps_dump.h"
+
+DEFINE_int32(read_buffer_size, 8 * 1024 * 1024, "bytes read at once.");
+
+using paddle::framework::DumpBinaryRecordToText;
+using paddle::framework::kDumpBinaryMagic;
+
+static bool ConvertFile(const char* path, FILE* out) {
+  FILE* in = fopen(path, "rb");
+  if (in == nullptr) {
+    LOG(ERROR) << "open " << path << " failed";
+    return false;
+  }
+  char magic[sizeof(kDumpBinaryMagic)];
+  if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+      memcmp(magic, kDumpBinaryMagic, sizeof(magic)) != 0) {
+    LOG(ERROR) << path << " is not a binary dump file";
+    fclose(in);
+    return false;
+  }
+  std::string buf;
+  std::string text;
+  size_t begin = 0;
+  size_t records = 0;
+  bool eof = false;
+  while (!eof) {
+    // keep the tail of a record that spans two reads
+    buf.erase(0, begin);
+    begin = 0;
+    size_t old_len = buf.size();
+    buf.resize(old_len + FLAGS_read_buffer_size);
+    size_t len = fread(&buf[old_len], 1, FLAGS_read_buffer_size, in);
+    buf.resize(old_len + len);
+    eof = (len == 0);
+    while (begin < buf.size()) {
+      size_t used =
+          DumpBinaryRecordToText(&buf[begin], buf.size() - begin, &text);
+      if (used == 0) {
+        break;
+      }
+      begin += used;
+      ++records;
+    }
+    if (!text.empty()) {
+      fwrite(text.data(), 1, text.size(), out);
+      text.clear();
+    }
+  }
+  fclose(in);
+  if (begin != buf.size()) {
+    LOG(ERROR) << path << " ends with a truncated record, converted "
+               << records << " records";
+    return false;
+  }
+  VLOG(1) << path << " converted " << records << " records";
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  int ret = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (!ConvertFile(argv[i], stdout)) {
+      ret = 1;
+    }
+  }
+  return ret;
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/boxps_dump.h"
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace framework {
+
+TEST(BoxPSDump, FormatSameAsPrintf) {
+  std::mt19937_64 rng(0);
+  char fast[64];
+  char expect[64];
+  auto check = [&](double v) {
+    int len = DumpFormatG9(v, fast);
+    snprintf(expect, sizeof(expect), "%.9g", v);
+    EXPECT_EQ(std::string(fast, len), std::string(expect)) << v;
+  };
+  for (int i = 0; i < 200000; ++i) {
+    uint32_t bits = static_cast<uint32_t>(rng());
+    float f = 0;
+    memcpy(&f, &bits, sizeof(f));
+    check(f);
+    uint64_t bits64 = rng();
+    double d = 0;
+    memcpy(&d, &bits64, sizeof(d));
+    check(d);
+    check(static_cast<float>(static_cast<int>(rng() % 2000001) - 1000000) /
+          1e6f);
+  }
+  for (double v : {0.0, -0.0, 1e9, 999999999.5, 0.0001, 1e-5, 123456789.0,
+                   1234567890.0, 5e-324, 1.7e308, 0.1, -2.5}) {
+    check(v);
+  }
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t u = rng() >> (rng() % 64);
+    int len = DumpFormatUInt64(u, fast);
+    snprintf(expect, sizeof(expect), "%lu", u);
+    EXPECT_EQ(std::string(fast, len), std::string(expect));
+    int32_t x = static_cast<int32_t>(rng());
+    len = DumpFormatInt64(x, fast);
+    snprintf(expect, sizeof(expect), "%d", x);
+    EXPECT_EQ(std::string(fast, len), std::string(expect));
+  }
+}
+
+TEST(BoxPSDump, BinaryRecord) {
+  std::string bin;
+  size_t pos = DumpBinaryBeginRecord(&bin);
+  float fv[3] = {1.5f, -2.25f, 3e-9f};
+  DumpBinaryAppendSegment(&bin, "id\tf:3", 6, kDumpFloat, fv, 3);
+  uint64_t uv[1] = {18446744073709551615ULL};
+  DumpBinaryAppendSegment(&bin, "\tu:1", 4, kDumpUInt64, uv, 1);
+  int16_t sv[2] = {-3, 7};
+  DumpBinaryAppendSegment(&bin, "\ts:2", 4, kDumpInt16, sv, 2);
+  DumpBinaryAppendSegment(&bin, "\text", 4, kDumpNone, nullptr, 0);
+  DumpBinaryEndRecord(&bin, pos);
+
+  std::string text;
+  EXPECT_EQ(DumpBinaryRecordToText(bin.data(), bin.size(), &text),
+            bin.size());
+  EXPECT_EQ(text,
+            "id\tf:3:1.5:-2.25:3.00000003e-09\tu:1:18446744073709551615"
+            "\ts:2:-3:7\text\n");
+  // truncated records are left for the next read
+  for (size_t len = 0; len < bin.size(); ++len) {
+    std::string part;
+    EXPECT_EQ(DumpBinaryRecordToText(bin.data(), len, &part), 0UL);
+  }
+}
+
+TEST(BoxPSDump, BinaryLongText) {
+  // a long lineid or extend info, the text is split into segments
+  for (size_t text_len : {65535UL, 65536UL, 200000UL}) {
+    std::string line(text_len, 'x');
+    for (size_t i = 0; i < text_len; i += 1000) {
+      line[i] = static_cast<char>('a' + i / 1000 % 26);
+    }
+    std::string bin;
+    size_t pos = DumpBinaryBeginRecord(&bin);
+    uint64_t uv[2] = {7, 8};
+    DumpBinaryAppendSegment(&bin, line.data(), line.size(), kDumpUInt64, uv, 2);
+    DumpBinaryEndRecord(&bin, pos);
+    std::string text;
+    EXPECT_EQ(DumpBinaryRecordToText(bin.data(), bin.size(), &text),
+              bin.size());
+    EXPECT_EQ(text, line + ":7:8\n");
+  }
+}
+
+TEST(BoxPSDump, AsyncWriter) {
+  char dir_tmpl[] = "/tmp/boxps_dump_test_XXXXXX";
+  std::string dir = mkdtemp(dir_tmpl);
+  auto path = [&dir](int tid, int fileid) {
+    return dir + "/part-" + std::to_string(tid) + "-" + std::to_string(fileid);
+  };
+  const int kThreadNum = 3;
+  const int kLineNum = 5000;
+  // the blocks of a file stay in order with several writers
+  for (int writer_num : {1, 3}) {
+    {
+      AsyncDumpWriter writer(
+          kThreadNum, path, 1000, 8000, "head\n", writer_num);
+      for (int i = 0; i < kLineNum; ++i) {
+        for (int tid = 0; tid < kThreadNum; ++tid) {
+          // a line written in two parts stays in one file
+          writer.Append(tid, std::to_string(i), false);
+          writer.Append(tid, "\n");
+        }
+      }
+      writer.Flush();
+    }
+    for (int tid = 0; tid < kThreadNum; ++tid) {
+      int next = 0;
+      for (int fileid = 0;; ++fileid) {
+        std::ifstream in(path(tid, fileid));
+        if (!in) {
+          EXPECT_GT(fileid, 1);
+          break;
+        }
+        std::string line;
+        ASSERT_TRUE(static_cast<bool>(std::getline(in, line)));
+        EXPECT_EQ(line, "head");
+        while (std::getline(in, line)) {
+          EXPECT_EQ(line, std::to_string(next)) << "writer_num " << writer_num;
+          ++next;
+        }
+        remove(path(tid, fileid).c_str());
+      }
+      EXPECT_EQ(next, kLineNum);
+    }
+  }
+  rmdir(dir.c_str());
+}
+
+}  // namespace framework
+}  // namespace paddle
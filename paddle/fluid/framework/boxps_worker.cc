@@ -67,17 +67,74 @@ PADDLE_DEFINE_EXPORTED_bool(
     "enable sharding stage step1 only param and grad split, default false");
 PADDLE_DEFINE_EXPORTED_string(
     padbox_dump_debug_lineid, "", "config dump debug lineid, default is empty");
+PADDLE_DEFINE_EXPORTED_bool(
+    padbox_dump_binary_format,
+    false,
+    "write dump fields and params as binary records, convert them to text "
+    "with boxps_dump_converter, default false");
+PADDLE_DEFINE_EXPORTED_int32(
+    padbox_dump_writer_thread_num,
+    1,
+    "threads of a worker writing the dump blocks to the files of the dump "
+    "threads, default 1");
+PADDLE_DEFINE_EXPORTED_int32(
+    padbox_async_dense_thread_num,
+    32,
+    "threads of the async dense table update, 0 uses one per core, "
+    "default 32");
+PADDLE_DEFINE_EXPORTED_int32(
+    padbox_async_dense_max_merge_num,
+    4,
+    "most pushed dense gradients merged by one async update, default 4");
+PADDLE_DEFINE_EXPORTED_double(padbox_async_dense_beta1,
+                              0.99,
+                              "adam beta1 of the async dense table");
+PADDLE_DEFINE_EXPORTED_double(padbox_async_dense_beta2,
+                              0.9999,
+                              "adam beta2 of the async dense table");
+PADDLE_DEFINE_EXPORTED_double(padbox_async_dense_epsilon,
+                              1e-8,
+                              "adam epsilon of the async dense table");
+PADDLE_DEFINE_EXPORTED_int32(
+    padbox_async_dense_stat_interval,
+    0,
+    "log the async dense update time and staleness every this many updates, "
+    "0 only logs them at the end of the pass");
+PADDLE_DEFINE_EXPORTED_bool(
+    padbox_enable_prebind_ops,
+    false,
+    "run per scope copies of the worker ops that keep the variables and "
+    "kernel context of their first run, default false");
+PADDLE_DEFINE_EXPORTED_int32(
+    padbox_feed_pipeline_depth,
+    0,
+    "feed scopes a thread packs the next batches into while the ops run, "
+    "0 or 1 packs every batch before its ops run. Only cpu places use it, "
+    "gpu and xpu readers pack every batch into one shared pack buffer and "
+    "ignore it");
 
 namespace paddle {
 namespace framework {
+// the version of the dense params the worker thread pulled last
+static thread_local uint64_t g_async_dense_pulled_version = 0;
+
 BoxPSAsynDenseTable::BoxPSAsynDenseTable(const int device_num)
     : device_num_(device_num) {
   int buffer_size = device_num * 4;  // magic number
   device_grads_.resize(buffer_size);
+  grad_versions_.resize(buffer_size, 0);
   buffer_poll_.reset(new PSBufferQueue(buffer_size));
   for (int i = 0; i < buffer_size; i++) {
     buffer_poll_->Send(&device_grads_[i]);
   }
+  snapshot_readers_[0] = 0;
+  snapshot_readers_[1] = 0;
+  max_merge_num_ = std::min(
+      static_cast<size_t>(std::max(FLAGS_padbox_async_dense_max_merge_num, 1)),
+      static_cast<size_t>(buffer_size));
+  adam_config_.beta1 = FLAGS_padbox_async_dense_beta1;
+  adam_config_.beta2 = FLAGS_padbox_async_dense_beta2;
+  adam_config_.epsilon = FLAGS_padbox_async_dense_epsilon;
   VLOG(1) << "BoxPSAsynDenseTable init finish ";
 }
 BoxPSAsynDenseTable::~BoxPSAsynDenseTable() {}
@@ -136,6 +193,10 @@ std::set<std::string> BoxPSAsynDenseTable::Init(
   original_ps_.resize(async_param_list_.size());
 
   ps_.mutable_data<float>({total_param_len_, 1}, platform::CPUPlace());
+  ps_snapshot_[0].mutable_data<float>({total_param_len_, 1},
+                                      platform::CPUPlace());
+  ps_snapshot_[1].mutable_data<float>({total_param_len_, 1},
+                                      platform::CPUPlace());
   mom1_.mutable_data<float>({adam_param_len_, 1}, platform::CPUPlace());
   mom2_.mutable_data<float>({adam_param_len_, 1}, platform::CPUPlace());
   for (size_t i = 0; i < device_grads_.size(); ++i) {
@@ -231,6 +292,7 @@ void BoxPSAsynDenseTable::Finalize(void) {
   ps_buffer_->Close();
   update_thread_->join();
   buffer_poll_->Close();
+  PrintUpdateStat();
 
   for (size_t i = 0; i < async_param_list_.size(); ++i) {
     VLOG(3) << "begin to copy back" << async_param_list_[i];
@@ -249,110 +311,137 @@ void BoxPSAsynDenseTable::Finalize(void) {
 
 void BoxPSAsynDenseTable::ThreadUpdate(int thread_id,
                                        const std::vector<LoDTensor*>& grad,
-                                       size_t merge_num) {
-  float* grad_data = grad[0]->mutable_data<float>(platform::CPUPlace());
+                                       size_t merge_num,
+                                       float* param_out) {
+  thread_local std::vector<const float*> grads_data;
+  grads_data.resize(merge_num);
+  for (size_t i = 0; i < merge_num; ++i) {
+    grads_data[i] = grad[i]->data<float>();
+  }
   float* param_data = ps_.mutable_data<float>(platform::CPUPlace());
   float* mom1_data = mom1_.mutable_data<float>(platform::CPUPlace());
   float* mom2_data = mom2_.mutable_data<float>(platform::CPUPlace());
-  // merge grad
   const size_t start = thread_start_index_[thread_id];
   const size_t end = thread_end_index_[thread_id];
-  if (merge_num == 2) {
-    LoDTensor* grad_tensor_1 = grad[1];
-    float* grad_tensor_1_data =
-        grad_tensor_1->mutable_data<float>(platform::CPUPlace());
-    for (size_t j = start; j < end; ++j) {
-      grad_data[j] = (grad_data[j] + grad_tensor_1_data[j]) / 2;
-    }
-  } else if (merge_num == 3) {
-    LoDTensor* grad_tensor_1 = grad[1];
-    LoDTensor* grad_tensor_2 = grad[2];
-    float* grad_tensor_1_data =
-        grad_tensor_1->mutable_data<float>(platform::CPUPlace());
-    float* grad_tensor_2_data =
-        grad_tensor_2->mutable_data<float>(platform::CPUPlace());
-    for (size_t j = start; j < end; ++j) {
-      grad_data[j] =
-          (grad_data[j] + grad_tensor_1_data[j] + grad_tensor_2_data[j]) / 3;
-    }
-  } else if (merge_num == 4) {
-    LoDTensor* grad_tensor_1 = grad[1];
-    LoDTensor* grad_tensor_2 = grad[2];
-    LoDTensor* grad_tensor_3 = grad[3];
-    float* grad_tensor_1_data =
-        grad_tensor_1->mutable_data<float>(platform::CPUPlace());
-    float* grad_tensor_2_data =
-        grad_tensor_2->mutable_data<float>(platform::CPUPlace());
-    float* grad_tensor_3_data =
-        grad_tensor_3->mutable_data<float>(platform::CPUPlace());
-    for (size_t j = start; j < end; ++j) {
-      grad_data[j] = (grad_data[j] + grad_tensor_1_data[j] +
-                      grad_tensor_2_data[j] + grad_tensor_3_data[j]) /
-                     4;
-    }
-  }
   VLOG(3) << "ThreadUpdate[" << thread_id << "] start: " << start
           << ", end: " << end
           << ", adam_param_len_: " << (size_t)adam_param_len_;
-  for (size_t j = start; j < end; ++j) {
-    if (j < (size_t)adam_param_len_) {  // adam
-      mom1_data[j] =
-          0.99 * mom1_data[j] + 0.01 * grad_data[j];  // magic beta and episilon
-      mom2_data[j] =
-          0.9999 * mom2_data[j] + 0.0001 * grad_data[j] * grad_data[j];
-      param_data[j] -=
-          all_lr_[j] * (mom1_data[j] / (sqrt(mom2_data[j]) + 1e-8));
-    } else {  // norm
-      param_data[j] = param_data[j] * 0.9999999 + grad_data[j];
-    }
-  }
-  return;
+  // merge the grads and update in one pass
+  const size_t adam_end = std::min(end, static_cast<size_t>(adam_param_len_));
+  if (start < adam_end) {
+    BoxDenseAdam(grads_data.data(),
+                 merge_num,
+                 all_lr_.data(),
+                 adam_config_,
+                 start,
+                 adam_end,
+                 param_data,
+                 mom1_data,
+                 mom2_data,
+                 param_out);
+  }
+  const size_t norm_start =
+      std::max(start, static_cast<size_t>(adam_param_len_));
+  if (norm_start < end) {
+    BoxDenseNorm(grads_data.data(),
+                 merge_num,
+                 0.9999999,
+                 norm_start,
+                 end,
+                 param_data,
+                 param_out);
+  }
 }
 
 void BoxPSAsynDenseTable::AsyncUpdate() {
   VLOG(0) << "Begin AsyncUpdate";
-  std::vector<LoDTensor*> grad(4, nullptr);  // max package
-
-  auto box_ptr = BoxWrapper::GetInstance();
+  std::vector<LoDTensor*> grad(max_merge_num_, nullptr);  // max package
 
+  platform::Timer timer;
   while (ps_buffer_->Receive(&grad[0])) {
-    size_t merge_num = ps_buffer_->Size() + 1;
-    if (merge_num > 4) {
-      merge_num = 4;
-    }
+    size_t merge_num = std::min(ps_buffer_->Size() + 1, max_merge_num_);
     for (size_t i = 1; i < merge_num; ++i) {
       ps_buffer_->Receive(&grad[i]);
     }
-    phi::AutoWRLock ps_lock(&ps_lock_);
+    timer.Reset();
+    timer.Start();
+    // the snapshot not published may still be copied by a PullDense that
+    // began before the last update published
+    int back = 1 - published_.load();
+    while (snapshot_readers_[back].load() != 0) {
+      std::this_thread::yield();
+    }
+    float* param_out =
+        ps_snapshot_[back].mutable_data<float>(platform::CPUPlace());
     std::vector<std::future<void>> wait_futures;
     for (int64_t i = 0; i < thread_num_; ++i) {
-      wait_futures.emplace_back(thread_pool->Run(
-          [this, i, &grad, merge_num]() { ThreadUpdate(i, grad, merge_num); }));
+      wait_futures.emplace_back(
+          thread_pool->Run([this, i, &grad, merge_num, param_out]() {
+            ThreadUpdate(i, grad, merge_num, param_out);
+          }));
     }
 
     for (int64_t i = 0; i < thread_num_; ++i) {
       wait_futures[i].get();
     }
+    published_.store(back);
+    uint64_t version = version_.fetch_add(1);
+    timer.Pause();
+
     for (size_t i = 0; i < merge_num; ++i) {
+      uint64_t staleness =
+          version - grad_versions_[grad[i] - &device_grads_[0]];
+      staleness_sum_ += staleness;
+      staleness_max_ = std::max(staleness_max_, staleness);
       buffer_poll_->Send(grad[i]);
     }
+    ++update_num_;
+    merged_grad_num_ += merge_num;
+    update_time_sum_ += timer.ElapsedMS();
+    update_time_max_ = std::max(update_time_max_, timer.ElapsedMS());
+    if (FLAGS_padbox_async_dense_stat_interval > 0 &&
+        update_num_ % FLAGS_padbox_async_dense_stat_interval == 0) {
+      PrintUpdateStat();
+    }
   }
 
   VLOG(0) << "Quit AsyncUpdate";
 }
 
+void BoxPSAsynDenseTable::PrintUpdateStat(void) {
+  if (update_num_ == 0) {
+    return;
+  }
+  VLOG(0) << "async dense update num: " << update_num_
+          << ", avg merge num: "
+          << static_cast<double>(merged_grad_num_) / update_num_
+          << ", avg time: " << update_time_sum_ / update_num_
+          << " ms, max time: " << update_time_max_
+          << " ms, avg staleness: "
+          << static_cast<double>(staleness_sum_) / merged_grad_num_
+          << ", max staleness: " << staleness_max_;
+}
+
 // async
 void BoxPSAsynDenseTable::PullDense(const platform::Place& place,
                                     Tensor* tensor) {
-  // while(ps_buffer_->Size() != 0) {//Size have lock, may have perf problem.
-  // And will hang when the lock was removed
-  //   ;
-  // }
-  phi::AutoRDLock ps_lock(&ps_lock_);
-  TensorCopy(
-      *static_cast<const Tensor*>(&ps_), place, static_cast<Tensor*>(tensor));
+  // pin the published snapshot, it is not written until the pin is dropped
+  int idx = 0;
+  while (true) {
+    idx = published_.load();
+    snapshot_readers_[idx].fetch_add(1);
+    if (published_.load() == idx) {
+      break;
+    }
+    snapshot_readers_[idx].fetch_sub(1);
+  }
+  g_async_dense_pulled_version = version_.load();
+  TensorCopy(*static_cast<const Tensor*>(&ps_snapshot_[idx]),
+             place,
+             static_cast<Tensor*>(tensor));
+  snapshot_readers_[idx].fetch_sub(1);
 }
-  
+
 void BoxPSAsynDenseTable::PushDense(const platform::Place& place,
                                     Tensor* tensor) {
   LoDTensor* grad = nullptr;
@@ -360,26 +449,49 @@ void BoxPSAsynDenseTable::PushDense(const platform::Place& place,
   TensorCopy(*static_cast<const Tensor*>(tensor),
              platform::CPUPlace(),
              static_cast<Tensor*>(grad));
+  grad_versions_[grad - &device_grads_[0]] = g_async_dense_pulled_version;
   ps_buffer_->Send(grad);
 }
 
 void BoxPSAsynDenseTable::InitThreadGroup() {
-  thread_num_ = 32;
+  thread_num_ = FLAGS_padbox_async_dense_thread_num;
+  if (thread_num_ <= 0) {
+    thread_num_ = std::max(std::thread::hardware_concurrency(), 1U);
+  }
   thread_start_index_.resize(thread_num_, 0);
   thread_end_index_.resize(thread_num_, 0);
+  // whole cache lines per thread, the threads do not share a line
+  const size_t align = 16;
   size_t prefix_sum = 0;
-  size_t thread_update_avg_len = total_param_len_ / thread_num_;
-  int unalloc_len = total_param_len_ % thread_num_;
+  size_t thread_update_avg_len =
+      (total_param_len_ / thread_num_ + align - 1) / align * align;
   for (int i = 0; i < thread_num_; i++) {
     thread_start_index_[i] = prefix_sum;
-    if (i < unalloc_len) {
-      prefix_sum += thread_update_avg_len + 1;
-    } else {
-      prefix_sum += thread_update_avg_len;
-    }
+    prefix_sum = std::min(prefix_sum + thread_update_avg_len,
+                          static_cast<size_t>(total_param_len_));
     thread_end_index_[i] = prefix_sum;
   }
+  thread_end_index_[thread_num_ - 1] = total_param_len_;
   thread_pool.reset(new paddle::framework::ThreadPool(thread_num_));
+
+  // the update threads touch the snapshots first, their pages are then
+  // allocated on the numa nodes the threads run on
+  const float* param_data = ps_.data<float>();
+  std::vector<std::future<void>> wait_futures;
+  for (int i = 0; i < thread_num_; ++i) {
+    wait_futures.emplace_back(thread_pool->Run([this, i, param_data]() {
+      size_t start = thread_start_index_[i];
+      size_t len = thread_end_index_[i] - start;
+      for (auto& snapshot : ps_snapshot_) {
+        memcpy(snapshot.data<float>() + start,
+               param_data + start,
+               len * sizeof(float));
+      }
+    }));
+  }
+  for (auto& future : wait_futures) {
+    future.get();
+  }
 }
 //======================== BoxPSWorker ======================
 // init
@@ -407,6 +519,10 @@ phi::DenseTensor& BoxPSWorker::MemoryShareTensor::share(
 static const int DenseKStepNode = 1;
 static const int DenseKStepALL = 2;
 static const int DenseDataNormal = 3;
+static const size_t MAX_FILE_LEN = 1UL << 31;
+static const size_t MAX_BUFF_LEN = 4 * 1024 * 1024;
+// dump bytes of a thread handed to the writer at once
+static const size_t DUMP_BLOCK_LEN = 1024 * 1024;
 void BoxPSWorker::Initialize(const TrainerDesc& desc) {
   dev_ctx_ = platform::DeviceContextPool::Instance().Get(place_);
   node_size_ = boxps::MPICluster::Ins().size();
@@ -420,10 +536,22 @@ void BoxPSWorker::Initialize(const TrainerDesc& desc) {
     if (dump_thread_num_ <= 1) {
       dump_thread_num_ = 20;
     }
-    fds_sizes_.resize(dump_thread_num_);
-    for (int i = 0; i  < dump_thread_num_; ++i) {
-      fds_sizes_[i] = {-1, 0, 0};
-    }
+    dump_binary_format_ = FLAGS_padbox_dump_binary_format;
+    dump_writer_.reset(new AsyncDumpWriter(
+        dump_thread_num_,
+        [this](int tid, int fileid) {
+          return string::format_string("%s/part-%02d-%05d-%05d",
+                                       dump_fields_path_.c_str(),
+                                       device_id_,
+                                       tid,
+                                       fileid);
+        },
+        DUMP_BLOCK_LEN,
+        MAX_FILE_LEN,
+        dump_binary_format_
+            ? std::string(kDumpBinaryMagic, sizeof(kDumpBinaryMagic))
+            : std::string(),
+        FLAGS_padbox_dump_writer_thread_num));
     dump_thread_pool_.reset(new paddle::framework::ThreadPool(dump_thread_num_));
     VLOG(0) << "device id=" << device_id_ << ", dump fields path: " << dump_fields_path_ 
             << ", dump thread num: " << dump_thread_num_;
@@ -1192,6 +1320,28 @@ void BoxPSWorker::CreateDeviceResource(const ProgramDesc& main_prog) {
   }
   CreateThreadOperators(main_prog);
 
+  // the vars no op writes are filled by the reader
+  std::unordered_set<std::string> op_outputs;
+  for (auto& op : ops_) {
+    for (auto& o : op->Outputs()) {
+      op_outputs.insert(o.second.begin(), o.second.end());
+    }
+  }
+  std::set<std::string> feed_vars;
+  for (auto& var : main_prog.Block(0).AllVars()) {
+    if (var->Persistable() ||
+        var->GetType() != proto::VarType::LOD_TENSOR ||
+        op_outputs.find(var->Name()) != op_outputs.end()) {
+      continue;
+    }
+    feed_vars.insert(var->Name());
+  }
+  if (device_reader_ != nullptr) {
+    auto& slots = device_reader_->GetUseSlotAlias();
+    feed_vars.insert(slots.begin(), slots.end());
+  }
+  feed_var_names_.assign(feed_vars.begin(), feed_vars.end());
+
   // debug str
   if (FLAGS_enable_dump_main_program) {
     std::ostringstream str_os;
@@ -1294,6 +1444,117 @@ int BoxPSWorker::PackBatchTask(void) {
   return device_reader_->Next();
 }
 
+const std::vector<BoxPSWorker::OpInstruction>& BoxPSWorker::GetInstructions(
+    Scope* scope) {
+  auto it = instructions_.find(scope);
+  if (it != instructions_.end()) {
+    return it->second;
+  }
+  auto& insts = instructions_[scope];
+  insts.resize(ops_.size());
+  for (size_t i = 0; i < ops_.size(); ++i) {
+    auto& op = ops_[i];
+    auto& inst = insts[i];
+    inst.op = op.get();
+    if (FLAGS_padbox_enable_prebind_ops) {
+      // the copy caches the RuntimeContext and phi KernelContext of its
+      // first run, so it must stay with one scope
+      bound_ops_.push_back(OpRegistry::CreateOp(
+          op->Type(), op->Inputs(), op->Outputs(), op->Attrs()));
+      bound_ops_.back()->SetAttr(kEnableCacheRuntimeContext, true);
+      inst.op = bound_ops_.back().get();
+    }
+    inst.sync_before = (sync_points_.find(op.get()) != sync_points_.end());
+    auto gc_it = unused_vars_.find(op.get());
+    if (gc_it == unused_vars_.end()) {
+      continue;
+    }
+    for (auto& name : gc_it->second) {
+      Variable* var = scope->FindVar(name);
+      if (var != nullptr) {
+        inst.gc_vars.push_back(var);
+        inst.gc_var_names.push_back(name);
+      } else {
+        inst.gc_names.push_back(name);
+      }
+    }
+  }
+  return insts;
+}
+
+int BoxPSWorker::NextFeedBatch(Scope** scope) {
+  if (ready_feeds_ == nullptr) {
+    *scope = thread_scope_;
+    return PackBatchTask();
+  }
+  std::pair<Scope*, int> feed(nullptr, 0);
+  feed_wait_timer_.Resume();
+  bool ok = ready_feeds_->Receive(&feed);
+  feed_wait_timer_.Pause();
+  *scope = feed.first;
+  return ok ? feed.second : 0;
+}
+
+void BoxPSWorker::StartFeedPipeline(void) {
+  int depth = FLAGS_padbox_feed_pipeline_depth;
+  if (depth <= 1 || device_reader_ == nullptr) {
+    return;
+  }
+  // the gpu and xpu readers pack every batch synchronously into the one
+  // MiniBatchGpuPack of the device and the feed tensors share its buffers,
+  // so the next batch would overwrite the running one
+  if (!platform::is_cpu_place(place_)) {
+    LOG_FIRST_N(WARNING, 1)
+        << "padbox_feed_pipeline_depth is ignored on " << place_
+        << ", the feed pipeline only runs on cpu places";
+    return;
+  }
+  ready_feeds_.reset(new FeedReadyQueue(depth));
+  free_feeds_.reset(new FeedFreeQueue(depth));
+  for (int i = 0; i < depth; ++i) {
+    Scope* scope = &thread_scope_->NewScope();
+    for (auto& name : feed_var_names_) {
+      scope->Var(name)->GetMutable<LoDTensor>();
+    }
+    free_feeds_->Send(scope);
+  }
+  feed_pack_sec_ = 0;
+  feed_wait_timer_.Reset();
+  feed_thread_ = std::thread([this]() {
+    SetDeviceID(device_id_);
+    platform::Timer pack_timer;
+    pack_timer.Reset();
+    Scope* scope = nullptr;
+    while (free_feeds_->Receive(&scope)) {
+      pack_timer.Resume();
+      device_reader_->AssignFeedVar(*scope);
+      int batch_size = device_reader_->Next();
+      pack_timer.Pause();
+      if (!ready_feeds_->Send(std::make_pair(scope, batch_size)) ||
+          batch_size <= 0) {
+        break;
+      }
+    }
+    feed_pack_sec_ = pack_timer.ElapsedSec();
+  });
+}
+
+void BoxPSWorker::StopFeedPipeline(void) {
+  if (ready_feeds_ == nullptr) {
+    return;
+  }
+  free_feeds_->Close();
+  ready_feeds_->Close();
+  feed_thread_.join();
+  VLOG(0) << "device[" << device_id_ << "] feed pack time="
+          << feed_pack_sec_
+          << "s, wait time=" << feed_wait_timer_.ElapsedSec()
+          << "s, hidden time=" << feed_pack_sec_ - feed_wait_timer_.ElapsedSec()
+          << "s";
+  ready_feeds_ = nullptr;
+  free_feeds_ = nullptr;
+}
+
 /**
  * @brief add auc monitor
  */
@@ -1329,25 +1590,32 @@ void BoxPSWorker::TrainFiles() {
   platform::Timer monitor_timer;
   monitor_timer.Reset();
 
-  while ((batch_size = PackBatchTask()) > 0) {
+  StartFeedPipeline();
+  Scope* scope = thread_scope_;
+  while ((batch_size = NextFeedBatch(&scope)) > 0) {
     VLOG(2) << "[" << device_id_
             << "]begin running ops, batch size:" << batch_size
             << ", batch id=" << step;
     if (dense_table_) {
       dense_table_->PullDense(place_, &param_async_.tensor());
     }
-    for (auto& op : ops_) {
+    for (auto& inst : GetInstructions(scope)) {
       if (FLAGS_padbox_enable_print_op_debug) {
         VLOG(0) << "thread id=" << thread_id_ << ", "
-                << op->DebugStringEx(thread_scope_);
+                << inst.op->DebugStringEx(scope);
       }
       // add stream sync
-      if (sync_points_.find(op.get()) != sync_points_.end()) {
+      if (inst.sync_before) {
         dev_ctx_->Wait();
       }
-      op->Run(*thread_scope_, place_);
+      inst.op->Run(*scope, place_);
       if (gc) {
-        DeleteUnusedTensors(*thread_scope_, op.get(), unused_vars_, gc.get());
+        if (!inst.gc_vars.empty()) {
+          DeleteUnusedTensors(inst.gc_vars, inst.gc_var_names, gc.get());
+        }
+        if (!inst.gc_names.empty()) {
+          DeleteUnusedTensors(*scope, inst.gc_names, gc.get());
+        }
       }
     }
     if (dense_table_) {
@@ -1362,7 +1630,7 @@ void BoxPSWorker::TrainFiles() {
     if (FLAGS_check_nan_inf) {
       // check nan result
       if (framework::details::CheckBatchNanOrInfRet(place_)) {
-        framework::details::DumpAllScope(*thread_scope_, place_);
+        framework::details::DumpAllScope(*scope, place_);
         PADDLE_ENFORCE(false,
                        "ERROR: check INF and NAN, device id=%d, batch id=%d",
                        device_id_,
@@ -1371,14 +1639,18 @@ void BoxPSWorker::TrainFiles() {
     }
 #endif
     monitor_timer.Resume();
-    AddAucMonitor(thread_scope_, place_);
+    AddAucMonitor(scope, place_);
     monitor_timer.Pause();
 
     accum_num += batch_size;
+    // the kids of a feed scope go with its batch
     if (gc) {
-      gc->DirectClearCallback([this]() { thread_scope_->DropKids(); });
+      gc->DirectClearCallback([scope]() { scope->DropKids(); });
     } else {
-      thread_scope_->DropKids();
+      scope->DropKids();
+    }
+    if (free_feeds_ != nullptr) {
+      free_feeds_->Send(scope);
     }
     ++step;
     // std::stringstream ss;
@@ -1388,12 +1660,16 @@ void BoxPSWorker::TrainFiles() {
     // }
     // VLOG(0) << ss.str();
   }
+  StopFeedPipeline();
   VLOG(0) << "AddAucMonitor cost time=" << monitor_timer.ElapsedSec();
   // sync param step
   if (sync_mode_ > 0) {
     SyncParam();
   }
   dev_ctx_->Wait();
+  // the feed scopes go with the kids, a new pass builds its own lists
+  instructions_.clear();
+  bound_ops_.clear();
   thread_scope_->DropKids();
 
   timer.Pause();
@@ -1563,53 +1839,95 @@ inline void format_string_append(
   str->resize(oldlen + len);
 }
 
-static const size_t max_fmt_buff_size = 40;
-
-template <typename T, typename C>
-inline void PrintLodTensorFmtType(const Tensor* tensor,
-                                  const int64_t& start,
-                                  const int64_t& end,
-                                  const char* fmt,
-                                  std::string* str) {
-  int64_t num = end - start;
-  if (num <= 0) {
-    return;
-  }
-
-  size_t oldlen = str->length();
-  // resize string
-  size_t new_len = oldlen + num * max_fmt_buff_size;
-  str->resize(new_len);
-
-  const C* ptr = reinterpret_cast<const C*>(tensor->data<T>());
-  for (int64_t i = start; i < end; ++i) {
-    int ret = snprintf(&(*str)[oldlen], max_fmt_buff_size, fmt, ptr[i]);
-    PADDLE_ENFORCE(ret > 0, "args or buff size error");
-    oldlen = oldlen + ret;
-  }
-  // resize real string
-  str->resize(oldlen);
-  PADDLE_ENFORCE(new_len >= oldlen, "new len %lu must be larger than oldlen %lu", new_len, oldlen);
-}
-inline void PrintLodTensor(const Tensor* tensor,
-                           const int64_t& start,
-                           const int64_t& end,
-                           std::string* out) {
+inline uint8_t GetDumpValueType(const Tensor* tensor) {
   auto dtype = framework::TransToProtoVarType(tensor->dtype());
   if (dtype == proto::VarType::FP32) {
-    PrintLodTensorFmtType<float, float>(tensor, start, end, ":%.9g", out);
+    return kDumpFloat;
   } else if (dtype == proto::VarType::INT64) {
-    PrintLodTensorFmtType<int64_t, uint64_t>(tensor, start, end, ":%lu", out);
+    return kDumpUInt64;
   } else if (dtype == proto::VarType::FP64) {
-    PrintLodTensorFmtType<double, double>(tensor, start, end, ":%.9g", out);
+    return kDumpDouble;
   } else if (dtype == proto::VarType::INT32) {
-    PrintLodTensorFmtType<int, int>(tensor, start, end, ":%d", out);
+    return kDumpInt32;
   } else if (dtype == proto::VarType::INT16) {
-    PrintLodTensorFmtType<int16_t, int16_t>(tensor, start, end, ":%d", out);
-  } else {
+    return kDumpInt16;
+  }
+  return kDumpNone;
+}
+inline void PrintLodTensor(const Tensor* tensor,
+                           const int64_t& start,
+                           const int64_t& end,
+                           std::string* out) {
+  uint8_t type = GetDumpValueType(tensor);
+  if (type == kDumpNone) {
     out->append("unsupported type");
+    return;
+  }
+  if (end <= start) {
+    return;
   }
+  const char* data = reinterpret_cast<const char*>(tensor->data());
+  DumpAppendValues(
+      type, data + start * DumpValueSize(type), end - start, out);
 }
+// builds one dump line in text or binary format, the text pieces wait in
+// head until the next values, a binary record keeps them as the segment text
+class DumpLineBuilder {
+ public:
+  DumpLineBuilder(bool binary, std::string* out)
+      : binary_(binary), out_(out) {}
+  bool binary() const { return binary_; }
+  std::string* head() { return &head_; }
+  void Begin() {
+    if (binary_) {
+      record_pos_ = DumpBinaryBeginRecord(out_);
+    }
+  }
+  void AppendValues(const Tensor* tensor,
+                    const int64_t& start,
+                    const int64_t& end) {
+    if (!binary_) {
+      out_->append(head_);
+      head_.clear();
+      PrintLodTensor(tensor, start, end, out_);
+      return;
+    }
+    uint8_t type = GetDumpValueType(tensor);
+    if (type == kDumpNone || end <= start) {
+      if (type == kDumpNone) {
+        head_.append("unsupported type");
+      }
+      return;
+    }
+    const char* data = reinterpret_cast<const char*>(tensor->data());
+    DumpBinaryAppendSegment(out_,
+                            head_.data(),
+                            head_.size(),
+                            type,
+                            data + start * DumpValueSize(type),
+                            static_cast<uint32_t>(end - start));
+    head_.clear();
+  }
+  void End() {
+    if (!binary_) {
+      out_->append(head_);
+      out_->append("\n");
+    } else {
+      if (!head_.empty()) {
+        DumpBinaryAppendSegment(
+            out_, head_.data(), head_.size(), kDumpNone, nullptr, 0);
+      }
+      DumpBinaryEndRecord(out_, record_pos_);
+    }
+    head_.clear();
+  }
+
+ private:
+  bool binary_;
+  std::string* out_;
+  std::string head_;
+  size_t record_pos_ = 0;
+};
 
 inline bool GetTensorBound(const LoDTensor& tensor,
                            int index,
@@ -1659,46 +1977,12 @@ bool CheckValidTensor(const LoDTensor* tensor, size_t batch_size) {
   }
   return true;
 }
-static const size_t MAX_FILE_LEN = 1UL << 31;
-static const size_t MAX_BUFF_LEN = 4 * 1024 * 1024;
-void BoxPSWorker::OpenDump(const int &tid) {
-  fd_info_t &fd_info = fds_sizes_[tid];
-  if (fd_info.fd >= 0 && fd_info.len < MAX_FILE_LEN) {
-    // already opened, just return
-    return;
-  }
-  // close file and open new one
-  if (fd_info.fd >= 0) {
-    ::close(fd_info.fd);
-  }
-  std::string filename = string::format_string(
-    "%s/part-%02d-%05d-%05d", dump_fields_path_.c_str(), device_id_, tid, fd_info.fileid);
-  ++fd_info.fileid;
-  
-  int fd = ::open(filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_APPEND, 0777);
-  PADDLE_ENFORCE(fd >= 0, "open %s failed", filename.c_str());
-  fd_info.len = 0;
-  fd_info.fd = fd;
-}
-void BoxPSWorker::WriteDump(const int &tid, const std::string& buf) {
-  fd_info_t &fd_info = fds_sizes_[tid];
-  int ret = ::write(fd_info.fd, buf.c_str(), buf.size());
-  fd_info.len += ret;
-}
-void BoxPSWorker::FlushDump(void) {
-  for (auto &fd_info : fds_sizes_) {
-    if (fd_info.fd < 0) {
-      continue;
-    }
-    if (fd_info.len > 0) {
-      ::fsync(fd_info.fd);
-    }
-    ::close(fd_info.fd);
-    fd_info.fd = -1;
-    fd_info.len = 0;
-    fd_info.fileid = 0;
-  }
+void BoxPSWorker::WriteDump(const int &tid,
+                            const std::string& buf,
+                            bool line_end) {
+  dump_writer_->Append(tid, buf, line_end);
 }
+void BoxPSWorker::FlushDump(void) { dump_writer_->Flush(); }
 void BoxPSWorker::DumpParam(const Scope& scope, const int batch_id) {
   platform::Timer timeline;
   timeline.Resume();
@@ -1739,17 +2023,19 @@ void BoxPSWorker::DumpParam(const Scope& scope, const int batch_id) {
       field_num, [this, &scope, batch_id, &cpu_tensors](
         const int &tid, const size_t& start, const size_t &end) {
         thread_local std::string s;
+        DumpLineBuilder line(dump_binary_format_, &s);
         for (size_t i = start; i < end; ++i) {
           auto& cpu_tensor = cpu_tensors[i];
           if (!cpu_tensor.IsInitialized()) {
             continue;
           }
-          OpenDump(tid);
           int64_t len = cpu_tensor.numel();
           auto& name = (*dump_param_)[i];
-          format_string_append(&s, "(%d,%s,%ld)", batch_id, name.c_str(), len);
-          PrintLodTensor(&cpu_tensor, 0, len, &s);
-          s.append("\n");
+          line.Begin();
+          format_string_append(
+              line.head(), "(%d,%s,%ld)", batch_id, name.c_str(), len);
+          line.AppendValues(&cpu_tensor, 0, len);
+          line.End();
           // write to channel
           WriteDump(tid, s);
           s.clear();
@@ -1878,6 +2164,8 @@ void BoxPSWorker::DumpField(const Scope& scope,
         thread_local std::pair<int64_t, int64_t> bound;
         thread_local std::string s;
         s.reserve(1024);
+        DumpLineBuilder line(dump_binary_format_, &s);
+        char num_buf[24];
         size_t r = 0;
         size_t pos = 0;
         size_t num = 0;
@@ -1897,16 +2185,17 @@ void BoxPSWorker::DumpField(const Scope& scope,
             continue;
           }
           ++line_cnt;
-          OpenDump(tid);    
+          line.Begin();
+          std::string* head = line.head();
           if (FLAGS_lineid_have_extend_info) {
             pos = lineid.find(" ");
             if (pos != std::string::npos) {
-              s.append(&lineid[0], pos);
+              head->append(&lineid[0], pos);
             } else {
-              s.append(lineid);
+              head->append(lineid);
             }
           } else {
-            s.append(lineid);
+            head->append(lineid);
           }
           for (size_t k = 0; k < field_num; ++k) {
             auto& tensor = cpu_tensors[k];
@@ -1914,37 +2203,41 @@ void BoxPSWorker::DumpField(const Scope& scope,
             if (!GetTensorBound(tensor, i, &bound)) {
               continue;
             }
-            s.append("\t", 1);
+            head->append("\t", 1);
             num += (bound.second - bound.first);
             if (FLAGS_dump_filed_same_as_aibox) {
               size_t ext_pos = field.find(".");
               if (ext_pos != std::string::npos) {
-                s.append(&field[0], ext_pos);
+                head->append(&field[0], ext_pos);
               } else {
-                s.append(field);
+                head->append(field);
               }
             } else {
-              format_string_append(
-                  &s, "%s:%ld", field.c_str(), bound.second - bound.first);
+              head->append(field);
+              head->append(":", 1);
+              head->append(num_buf,
+                           DumpFormatInt64(bound.second - bound.first,
+                                           num_buf));
             }
             if (FLAGS_enable_print_dump_field_debug) {
               VLOG(0) << "[" << device_id_ << "]tid=" << tid << ", lineid:[" << lineid 
                       << "], name=" << field << ", dims: [" << tensor.dims() << "], len=" << s.length()
                       << ", bound=[" << bound.first << "," << bound.second << "]";
             }
-            PrintLodTensor(&tensor, bound.first, bound.second, &s);
-            if (s.length() > MAX_BUFF_LEN) {
-              WriteDump(tid, s);
+            line.AppendValues(&tensor, bound.first, bound.second);
+            // a binary record is written whole
+            if (!line.binary() && s.length() > MAX_BUFF_LEN) {
+              WriteDump(tid, s, false);
               s.clear();
             }
           }
 
           // append extends tag info
           if (pos > 0) {
-            s.append("\t", 1);
-            s.append(&lineid[pos + 1], lineid.length() - pos - 1);
+            head->append("\t", 1);
+            head->append(&lineid[pos + 1], lineid.length() - pos - 1);
           }
-          s.append("\n");
+          line.End();
           // write to channel
           WriteDump(tid, s);
           s.clear();
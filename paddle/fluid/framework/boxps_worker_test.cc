@@ -0,0 +1,152 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "paddle/fluid/framework/data_feed.h"
+#include "paddle/fluid/framework/device_worker.h"
+#include "paddle/fluid/framework/fleet/box_wrapper.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/framework/program_desc.h"
+#include "paddle/fluid/framework/trainer_desc.pb.h"
+
+DECLARE_int32(padbox_feed_pipeline_depth);
+DECLARE_bool(padbox_enable_prebind_ops);
+
+USE_OP_ITSELF(scale);
+USE_OP_ITSELF(elementwise_add);
+PD_DECLARE_KERNEL(scale, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(add, CPU, ALL_LAYOUT);
+
+namespace paddle {
+namespace framework {
+
+static const int kBatchSize = 4;
+
+// x of batch k is k * 10 + i
+class FakeBatchFeed : public DataFeed {
+ public:
+  explicit FakeBatchFeed(int batch_num) : batch_num_(batch_num) {}
+  void Init(const DataFeedDesc& data_feed_desc) override {}
+  bool Start() override {
+    batch_ = 0;
+    return true;
+  }
+  void AssignFeedVar(const Scope& scope) override {
+    x_ = scope.FindVar("x")->GetMutable<LoDTensor>();
+  }
+  int Next() override {
+    if (batch_ >= batch_num_) {
+      return 0;
+    }
+    float* x = x_->mutable_data<float>({kBatchSize, 1}, platform::CPUPlace());
+    for (int i = 0; i < kBatchSize; ++i) {
+      x[i] = batch_ * 10 + i;
+    }
+    ++batch_;
+    return kBatchSize;
+  }
+
+ private:
+  int batch_num_;
+  int batch_ = 0;
+  LoDTensor* x_ = nullptr;
+};
+
+// acc = acc * 0.5 + x, so the result depends on the batch order, and tmp
+// is collected after every batch
+static void BuildProgram(ProgramDesc* program) {
+  auto* block = program->MutableBlock(0);
+  for (auto* name : {"x", "tmp", "acc"}) {
+    block->Var(name)->SetType(proto::VarType::LOD_TENSOR);
+  }
+  block->Var("acc")->SetPersistable(true);
+  auto* scale = block->AppendOp();
+  scale->SetType("scale");
+  scale->SetInput("X", {"acc"});
+  scale->SetOutput("Out", {"tmp"});
+  scale->SetAttr("scale", 0.5f);
+  auto* add = block->AppendOp();
+  add->SetType("elementwise_add");
+  add->SetInput("X", {"tmp"});
+  add->SetInput("Y", {"x"});
+  add->SetOutput("Out", {"acc"});
+}
+
+// acc after two passes of 20 batches on a cpu worker
+static std::vector<float> RunPasses() {
+  BoxWrapper::SetInstance();
+  ProgramDesc program;
+  BuildProgram(&program);
+  Scope root;
+  float* acc = root.Var("acc")->GetMutable<LoDTensor>()->mutable_data<float>(
+      {kBatchSize, 1}, platform::CPUPlace());
+  std::fill(acc, acc + kBatchSize, 0);
+
+  FakeBatchFeed feed(20);
+  BoxPSWorker worker;
+  worker.SetNeedDumpField(false);
+  worker.SetNeedDumpParam(false);
+  worker.SetPlace(platform::CPUPlace());
+  worker.SetRootScope(&root);
+  worker.SetDeviceIndex(0);
+  worker.SetThreadIndex(0);
+  worker.SetDataFeed(&feed);
+  TrainerDesc desc;
+  desc.set_thread_num(1);
+  worker.Initialize(desc);
+  worker.CreateDeviceResource(program);
+  // the second pass builds the feed scopes again
+  worker.TrainFiles();
+  worker.TrainFiles();
+  worker.Finalize();
+  return std::vector<float>(acc, acc + kBatchSize);
+}
+
+TEST(BoxPSWorker, FeedPipelineMatchesSerial) {
+  int depth = FLAGS_padbox_feed_pipeline_depth;
+  FLAGS_padbox_feed_pipeline_depth = 0;
+  auto expect = RunPasses();
+  FLAGS_padbox_feed_pipeline_depth = 2;
+  auto result = RunPasses();
+  FLAGS_padbox_feed_pipeline_depth = depth;
+  for (int i = 0; i < kBatchSize; ++i) {
+    ASSERT_EQ(result[i], expect[i]);
+  }
+}
+
+TEST(BoxPSWorker, PrebindMatchesUnbound) {
+  int depth = FLAGS_padbox_feed_pipeline_depth;
+  bool prebind = FLAGS_padbox_enable_prebind_ops;
+  // every feed scope of the pipeline binds its own ops
+  for (int pipeline_depth : {0, 2}) {
+    FLAGS_padbox_feed_pipeline_depth = pipeline_depth;
+    FLAGS_padbox_enable_prebind_ops = false;
+    auto expect = RunPasses();
+    FLAGS_padbox_enable_prebind_ops = true;
+    auto result = RunPasses();
+    for (int i = 0; i < kBatchSize; ++i) {
+      ASSERT_EQ(result[i], expect[i]) << "depth " << pipeline_depth;
+    }
+  }
+  FLAGS_padbox_feed_pipeline_depth = depth;
+  FLAGS_padbox_enable_prebind_ops = prebind;
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -22,11 +22,15 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <condition_variable>  // NOLINT
+#include <cstdint>
 #include <deque>
 #include <limits>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <thread>  // NOLINT
 #include <utility>
 #include <vector>
 
@@ -35,6 +39,114 @@
 namespace paddle {
 namespace framework {
 
+// Bounded MPMC ring used by lock free channels. Every slot has a sequence,
+// the slot of position pos is free for a push when seq == pos and holds a
+// value for a pop when seq == pos + 1. A batch claims a run of consecutive
+// slots with one CAS, fills or drains them and then commits the sequences.
+template <class T>
+class ChannelRing {
+ public:
+  // capacity is rounded up to a power of 2
+  explicit ChannelRing(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_.reset(new Slot[size]);
+    for (size_t i = 0; i < size; ++i) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  size_t Capacity() const { return mask_ + 1; }
+
+  // claimed slots are counted, so the size is approximate
+  size_t Size() const {
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+
+  bool Writable() { return Available(&tail_, 0) > 0; }
+  bool Readable() { return Available(&head_, 1) > 0; }
+
+  // claims up to n slots, returns the count and the first position
+  size_t ClaimPush(size_t n, size_t* pos) { return Claim(&tail_, 0, n, pos); }
+  size_t ClaimPop(size_t n, size_t* pos) { return Claim(&head_, 1, n, pos); }
+
+  T& At(size_t pos) { return slots_[pos & mask_].value; }
+
+  void CommitPush(size_t pos, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      slots_[(pos + i) & mask_].seq.store(pos + i + 1,
+                                           std::memory_order_release);
+    }
+  }
+  void CommitPop(size_t pos, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      slots_[(pos + i) & mask_].seq.store(pos + i + mask_ + 1,
+                                           std::memory_order_release);
+    }
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  // ready slots at the cursor, offset is 0 for push and 1 for pop
+  size_t Available(std::atomic<size_t>* cursor, size_t offset) {
+    size_t pos = cursor->load(std::memory_order_relaxed);
+    while (true) {
+      size_t seq = slots_[pos & mask_].seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq - (pos + offset));
+      if (diff == 0) {
+        return 1;
+      }
+      if (diff < 0) {
+        return 0;
+      }
+      // another thread moved the cursor
+      pos = cursor->load(std::memory_order_relaxed);
+    }
+  }
+
+  size_t Claim(std::atomic<size_t>* cursor,
+               size_t offset,
+               size_t n,
+               size_t* pos) {
+    size_t start = cursor->load(std::memory_order_relaxed);
+    while (true) {
+      size_t m = 0;
+      while (m < n && m <= mask_ &&
+             slots_[(start + m) & mask_].seq.load(std::memory_order_acquire) ==
+                 start + m + offset) {
+        ++m;
+      }
+      if (m == 0) {
+        size_t seq = slots_[start & mask_].seq.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq - (start + offset)) < 0) {
+          return 0;
+        }
+        start = cursor->load(std::memory_order_relaxed);
+        continue;
+      }
+      if (cursor->compare_exchange_weak(
+              start, start + m, std::memory_order_relaxed)) {
+        *pos = start;
+        return m;
+      }
+    }
+  }
+
+  size_t mask_ = 0;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
 template <class T>
 class ChannelObject {
  public:
@@ -45,8 +157,36 @@ class ChannelObject {
     capacity_ = (std::min)(MaxCapacity(), capacity);
   }
 
-  const std::deque<T>& GetData() const { return data_; }
+  // lock_free keeps the data in a ChannelRing of capacity slots, readers
+  // and writers only take the mutex to sleep on an empty or full ring
+  ChannelObject(size_t capacity, bool lock_free) : ChannelObject(capacity) {
+    if (lock_free) {
+      CHECK(capacity >= 1 && capacity <= kMaxRingCapacity)
+          << "lock free channel capacity out of range: " << capacity;
+      ring_.reset(new ChannelRing<T>(capacity));
+      capacity_ = ring_->Capacity();
+    }
+  }
+
+  bool LockFree() const { return ring_ != nullptr; }
+
+  const std::deque<T>& GetData() const {
+    CHECK(ring_ == nullptr) << "lock free channel has no deque";
+    return data_;
+  }
   void Clear() {
+    if (ring_ != nullptr) {
+      size_t pos = 0;
+      size_t n = 0;
+      while ((n = ring_->ClaimPop(capacity_, &pos)) != 0) {
+        for (size_t i = 0; i < n; ++i) {
+          ring_->At(pos + i) = T();
+        }
+        ring_->CommitPop(pos, n);
+      }
+      RingNotify(&ring_full_waiters_, &full_cond_);
+      return;
+    }
     std::unique_lock<std::mutex> lock(mutex_);
     data_.clear();
     data_.shrink_to_fit();
@@ -57,6 +197,7 @@ class ChannelObject {
   }
 
   void SetCapacity(size_t x) {  // capacity can be zero
+    CHECK(ring_ == nullptr) << "lock free channel capacity is fixed";
     std::lock_guard<std::mutex> lock(mutex_);
     capacity_ = std::min(MaxCapacity(), x);
     Notify();
@@ -74,6 +215,7 @@ class ChannelObject {
 
   template <class U>
   void InheritFrom(const std::shared_ptr<ChannelObject<U>>& other) {
+    CHECK(ring_ == nullptr) << "lock free channel capacity is fixed";
     std::lock_guard<std::mutex> lock(mutex_);
     capacity_ = other->Capacity();
     block_size_ = other->BlockSize();
@@ -94,19 +236,38 @@ class ChannelObject {
   void Close() {
     std::lock_guard<std::mutex> lock(mutex_);
     closed_ = true;
+    if (ring_ != nullptr) {
+      empty_cond_.notify_all();
+      full_cond_.notify_all();
+      return;
+    }
     Notify();
   }
 
   size_t Size() {
+    if (ring_ != nullptr) {
+      return ring_->Size();
+    }
     std::lock_guard<std::mutex> lock(mutex_);
     return data_.size();
   }
 
   bool Empty() {
+    if (ring_ != nullptr) {
+      return !ring_->Readable();
+    }
     std::lock_guard<std::mutex> lock(mutex_);
     return EmptyUnlocked();
   }
 
+  // seconds readers slept on an empty channel and writers on a full one
+  double ReadWaitSec() { return read_wait_ns_.load() * 1e-9; }
+  double WriteWaitSec() { return write_wait_ns_.load() * 1e-9; }
+  void ResetWaitStat() {
+    read_wait_ns_ = 0;
+    write_wait_ns_ = 0;
+  }
+
   // blocking operation
   bool Get(T& val) { return Read(1, &val) != 0; }  // NOLINT
 
@@ -116,6 +277,9 @@ class ChannelObject {
     if (n == 0) {
       return 0;
     }
+    if (ring_ != nullptr) {
+      return RingRead(n, p, false);
+    }
 
     std::unique_lock<std::mutex> lock(mutex_);
     size_t finished = Read(n, p, lock);
@@ -135,6 +299,9 @@ class ChannelObject {
     if (n == 0) {
       return 0;
     }
+    if (ring_ != nullptr) {
+      return RingWrite(n, [p](T* slot, size_t i) { *slot = p[i]; });
+    }
     std::unique_lock<std::mutex> lock(mutex_);
     size_t finished = Write(n, p, lock);
     Notify();
@@ -146,6 +313,9 @@ class ChannelObject {
     if (n == 0) {
       return 0;
     }
+    if (ring_ != nullptr) {
+      return RingWrite(n, [p](T* slot, size_t i) { *slot = std::move(p[i]); });
+    }
     std::unique_lock<std::mutex> lock(mutex_);
     size_t finished = WriteMove(n, p, lock);
     Notify();
@@ -164,6 +334,12 @@ class ChannelObject {
     if (size == 0) {
       return 0;
     }
+    if (ring_ != nullptr) {
+      p.resize(size);
+      size_t finished = RingRead(size, &p[0], true);
+      p.resize(finished);
+      return finished;
+    }
     std::unique_lock<std::mutex> lock(mutex_);
     p.resize(size);
     size_t finished = Read(size, &p[0], lock, true);
@@ -194,9 +370,11 @@ class ChannelObject {
   size_t Write(std::vector<T>&& p) { return WriteMove(p.size(), &p[0]); }
 
  private:
+  static const size_t kMaxRingCapacity = size_t(1) << 30;
+
   size_t capacity_ = MaxCapacity();
   size_t block_size_ = 1024;
-  bool closed_ = false;
+  std::atomic<bool> closed_{false};
   std::mutex mutex_;
   // use deque to store data
   std::deque<T> data_;
@@ -205,6 +383,20 @@ class ChannelObject {
   int full_waiters_ = 0;
   std::condition_variable empty_cond_;
   std::condition_variable full_cond_;
+  // lock free mode
+  std::unique_ptr<ChannelRing<T>> ring_;
+  std::atomic<int> ring_empty_waiters_{0};
+  std::atomic<int> ring_full_waiters_{0};
+  std::atomic<int> ring_writers_{0};
+  std::atomic<uint64_t> read_wait_ns_{0};
+  std::atomic<uint64_t> write_wait_ns_{0};
+
+  // only called before sleeping, the clock is not read on the fast path
+  static uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
 
   static constexpr size_t MaxCapacity() {
     return (std::numeric_limits<size_t>::max)() / 2;
@@ -219,6 +411,95 @@ class ChannelObject {
     }
   }
 
+  // wake the sleepers of the other side after a commit, the fence pairs
+  // with the one in RingWait
+  void RingNotify(std::atomic<int>* waiters, std::condition_variable* cond) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters->load(std::memory_order_relaxed) != 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cond->notify_all();
+    }
+  }
+
+  // sleeps until ready() or the channel is closed
+  template <class Ready>
+  void RingWait(std::atomic<int>* waiters,
+                std::condition_variable* cond,
+                std::atomic<uint64_t>* wait_ns,
+                Ready ready) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiters->fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!ready() && !closed_) {
+      uint64_t start = NowNs();
+      while (!ready() && !closed_) {
+        cond->wait(lock);
+      }
+      *wait_ns += NowNs() - start;
+    }
+    waiters->fetch_sub(1);
+  }
+
+  size_t RingRead(size_t n, T* p, bool once) {
+    size_t finished = 0;
+    while (finished < n) {
+      size_t pos = 0;
+      size_t m = ring_->ClaimPop(n - finished, &pos);
+      if (m == 0) {
+        if (closed_) {
+          // the writers that saw the channel open commit their claimed slots
+          // before the last values are read
+          if (ring_writers_.load() != 0) {
+            std::this_thread::yield();
+            continue;
+          }
+          if (!ring_->Readable()) {
+            break;
+          }
+          continue;
+        }
+        RingWait(&ring_empty_waiters_, &empty_cond_, &read_wait_ns_, [this] {
+          return ring_->Readable();
+        });
+        continue;
+      }
+      for (size_t i = 0; i < m; ++i) {
+        p[finished++] = std::move(ring_->At(pos + i));
+      }
+      ring_->CommitPop(pos, m);
+      RingNotify(&ring_full_waiters_, &full_cond_);
+      if (once) {
+        break;
+      }
+    }
+    return finished;
+  }
+
+  template <class Assign>
+  size_t RingWrite(size_t n, Assign assign) {
+    size_t finished = 0;
+    // counted before closed_ is read, so a reader that sees the channel
+    // closed and no writer finds every committed value
+    ring_writers_.fetch_add(1);
+    while (finished < n && !closed_) {
+      size_t pos = 0;
+      size_t m = ring_->ClaimPush(n - finished, &pos);
+      if (m == 0) {
+        RingWait(&ring_full_waiters_, &full_cond_, &write_wait_ns_, [this] {
+          return ring_->Writable();
+        });
+        continue;
+      }
+      for (size_t i = 0; i < m; ++i) {
+        assign(&ring_->At(pos + i), finished++);
+      }
+      ring_->CommitPush(pos, m);
+      RingNotify(&ring_empty_waiters_, &empty_cond_);
+    }
+    ring_writers_.fetch_sub(1);
+    return finished;
+  }
+
   bool EmptyUnlocked() { return data_.empty(); }
 
   bool FullUnlocked() { return data_.size() >= capacity_ + reading_count_; }
@@ -233,7 +514,9 @@ class ChannelObject {
         full_cond_.notify_one();
       }
       empty_waiters_++;
+      uint64_t start = NowNs();
       empty_cond_.wait(lock);
+      read_wait_ns_ += NowNs() - start;
       empty_waiters_--;
     }
     return !EmptyUnlocked();
@@ -249,7 +532,9 @@ class ChannelObject {
         empty_cond_.notify_one();
       }
       full_waiters_++;
+      uint64_t start = NowNs();
       full_cond_.wait(lock);
+      write_wait_ns_ += NowNs() - start;
       full_waiters_--;
     }
     return !closed_;
@@ -314,6 +599,12 @@ Channel<T> MakeChannel(size_t capacity = (std::numeric_limits<size_t>::max)()) {
   return std::make_shared<ChannelObject<T>>(capacity);
 }
 
+// bounded lock free channel, writers block while capacity values are unread
+template <class T>
+Channel<T> MakeLockFreeChannel(size_t capacity) {
+  return std::make_shared<ChannelObject<T>>(capacity, true);
+}
+
 template <class T, class U>
 Channel<T> MakeChannel(const Channel<U>& other) {
   CHECK(other != nullptr) << "channel can not be NULL";
@@ -353,7 +644,7 @@ class ChannelReader {
     }
     if (cursor_ >= buffer_.size()) {
       cursor_ = 0;
-      if (channel_->read(buffer_) == 0) {
+      if (channel_->Read(buffer_) == 0) {
         failed_ = true;
         return *this;
       }
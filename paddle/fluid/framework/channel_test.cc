@@ -0,0 +1,167 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/channel.h"
+
+#include <chrono>  // NOLINT
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace framework {
+
+TEST(LockFreeChannel, ReadWrite) {
+  auto chan = MakeLockFreeChannel<int>(5);
+  EXPECT_TRUE(chan->LockFree());
+  EXPECT_EQ(chan->Capacity(), 8UL);
+  EXPECT_TRUE(chan->Empty());
+
+  std::vector<int> data = {1, 2, 3, 4, 5, 6};
+  EXPECT_EQ(chan->Write(data), 6UL);
+  EXPECT_EQ(chan->Size(), 6UL);
+  std::vector<int> out;
+  EXPECT_EQ(chan->ReadOnce(out, 4), 4UL);
+  EXPECT_EQ(out, std::vector<int>({1, 2, 3, 4}));
+  // wraps around the ring
+  EXPECT_EQ(chan->Write(std::vector<int>({7, 8, 9, 10})), 4UL);
+  chan->Close();
+  EXPECT_EQ(chan->Write(data), 0UL);
+  chan->SetBlockSize(3);
+  EXPECT_EQ(chan->ReadAll(out), 6UL);
+  EXPECT_EQ(out, std::vector<int>({5, 6, 7, 8, 9, 10}));
+  int val = 0;
+  EXPECT_FALSE(chan->Get(val));
+
+  chan->Open();
+  EXPECT_TRUE(chan->Put(11));
+  chan->Clear();
+  EXPECT_TRUE(chan->Empty());
+}
+
+TEST(LockFreeChannel, MultiThread) {
+  const int kWriterNum = 8;
+  const int kReaderNum = 8;
+  const int kValueNum = 100000;
+  auto chan = MakeLockFreeChannel<std::unique_ptr<int>>(256);
+  chan->SetBlockSize(64);
+
+  std::vector<std::thread> writers;
+  for (int w = 0; w < kWriterNum; ++w) {
+    writers.emplace_back([&chan, w, kValueNum]() {
+      ChannelWriter<std::unique_ptr<int>> writer(chan.get());
+      for (int i = 0; i < kValueNum; ++i) {
+        writer << std::unique_ptr<int>(new int(w * kValueNum + i));
+      }
+      writer.Flush();
+      EXPECT_TRUE(static_cast<bool>(writer));
+    });
+  }
+  std::vector<std::vector<int>> counts(kReaderNum);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < kReaderNum; ++r) {
+    readers.emplace_back([&chan, &counts, r]() {
+      ChannelReader<std::unique_ptr<int>> reader(chan.get());
+      std::unique_ptr<int> val;
+      while (reader >> val) {
+        counts[r].push_back(*val);
+      }
+    });
+  }
+  for (auto& t : writers) {
+    t.join();
+  }
+  chan->Close();
+  for (auto& t : readers) {
+    t.join();
+  }
+
+  std::vector<int> seen(kWriterNum * kValueNum, 0);
+  for (auto& count : counts) {
+    for (int val : count) {
+      ++seen[val];
+    }
+  }
+  for (int num : seen) {
+    EXPECT_EQ(num, 1);
+  }
+}
+
+// a value slow to copy, the writers hold their claimed slots longer
+struct SlowValue {
+  SlowValue() {}
+  explicit SlowValue(int v) : value(v) {}
+  SlowValue& operator=(const SlowValue& other) {
+    std::this_thread::yield();
+    value = other.value;
+    return *this;
+  }
+  int value = 0;
+};
+
+// the channel is closed while the writers are still writing, the readers
+// read every value a write accepted before they see the end
+TEST(LockFreeChannel, CloseWhileWriting) {
+  const int kWriterNum = 8;
+  const int kReaderNum = 4;
+  const int kBatchSize = 16;
+  for (int round = 0; round < 50; ++round) {
+    auto chan = MakeLockFreeChannel<SlowValue>(64);
+    std::vector<int> accepted(kWriterNum, 0);
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriterNum; ++w) {
+      writers.emplace_back([&chan, &accepted, w]() {
+        std::vector<SlowValue> batch(kBatchSize, SlowValue(w));
+        size_t n = 0;
+        do {
+          n = chan->Write(batch);
+          accepted[w] += n;
+        } while (n == batch.size());
+      });
+    }
+    std::vector<std::vector<int>> counts(kReaderNum,
+                                         std::vector<int>(kWriterNum, 0));
+    std::vector<std::thread> readers;
+    for (int r = 0; r < kReaderNum; ++r) {
+      readers.emplace_back([&chan, &counts, r]() {
+        std::vector<SlowValue> out;
+        while (chan->ReadOnce(out, kBatchSize) != 0) {
+          for (auto& val : out) {
+            ++counts[r][val.value];
+          }
+        }
+      });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    chan->Close();
+    for (auto& t : readers) {
+      t.join();
+    }
+    for (auto& t : writers) {
+      t.join();
+    }
+    for (int w = 0; w < kWriterNum; ++w) {
+      int read = 0;
+      for (auto& count : counts) {
+        read += count[w];
+      }
+      EXPECT_EQ(read, accepted[w]) << "round " << round << " writer " << w;
+    }
+  }
+}
+
+}  // namespace framework
+}  // namespace paddle
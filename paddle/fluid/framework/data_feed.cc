@@ -36,6 +36,7 @@ limitations under the License. */
 
 USE_INT_STAT(STAT_total_feasign_num_in_mem);
 DECLARE_bool(enable_ins_parser_file);
+DECLARE_bool(padbox_slot_text_parser);
 
 #ifdef PADDLE_WITH_BOX_PS
 #include <dlfcn.h>
@@ -52,6 +53,164 @@ DLManager& global_dlmanager_pool() {
   return manager;
 }
 
+// glibc malloc chunk bytes of a request, 8 bytes head and 16 bytes aligned
+inline size_t malloc_chunk_bytes(size_t len) {
+  size_t bytes = (len + 8 + 15) & ~static_cast<size_t>(15);
+  return (bytes < 32) ? 32 : bytes;
+}
+inline size_t arena_align_bytes(size_t len) {
+  return (len + 7) & ~static_cast<size_t>(7);
+}
+static std::atomic<uint64_t> g_slot_arena_gen{0};
+SlotRecordArena::SlotRecordArena() { gen_ = ++g_slot_arena_gen; }
+SlotRecordArena::~SlotRecordArena() { release(); }
+void SlotRecordArena::mark_chunk(const Chunk* chunk, bool used) {
+  uint64_t begin = (reinterpret_cast<uint64_t>(chunk->data) >> kChunkShift);
+  uint64_t end = begin + (chunk->capacity >> kChunkShift);
+  CHECK_LE(end, (1UL << (kAddressBits - kChunkShift)))
+      << "arena chunk address out of range";
+  auto bitmap = chunk_bitmap();
+  for (uint64_t idx = begin; idx < end; ++idx) {
+    uint64_t bit = (1UL << (idx & 63));
+    if (used) {
+      bitmap[idx >> 6].fetch_or(bit, std::memory_order_relaxed);
+    } else {
+      bitmap[idx >> 6].fetch_and(~bit, std::memory_order_relaxed);
+    }
+  }
+}
+SlotRecordArena::Chunk* SlotRecordArena::new_chunk(size_t capacity,
+                                                   bool records) {
+  // round up to chunk size, every chunk holds whole bitmap slots
+  capacity = ((capacity + kChunkSize - 1) >> kChunkShift) << kChunkShift;
+  Chunk* chunk = new Chunk;
+  CHECK_EQ(0,
+           posix_memalign(reinterpret_cast<void**>(&chunk->data),
+                          kChunkSize,
+                          capacity));
+  chunk->capacity = capacity;
+  chunk->records = records;
+  mark_chunk(chunk, true);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  chunks_.push_back(chunk);
+  return chunk;
+}
+SlotRecordArena::ThreadCache& SlotRecordArena::thread_cache(void) {
+  thread_local ThreadCache caches[kThreadCacheNum];
+  thread_local int next = 0;
+  for (auto& cache : caches) {
+    if (cache.gen == gen_) {
+      return cache;
+    }
+  }
+  // the chunks of an evicted slot stay in their arena, only the tails are
+  // left unused
+  ThreadCache& cache = caches[next];
+  next = (next + 1) % kThreadCacheNum;
+  cache.gen = gen_;
+  cache.data_chunk = nullptr;
+  cache.record_chunk = nullptr;
+  return cache;
+}
+void* SlotRecordArena::alloc(size_t len) {
+  size_t bytes = arena_align_bytes(len);
+  ThreadCache& cache = thread_cache();
+  Chunk* chunk = cache.data_chunk;
+  if (chunk == nullptr || chunk->used + bytes > chunk->capacity) {
+    if (bytes > kChunkSize) {
+      // huge buffer owns one chunk
+      chunk = new_chunk(bytes, false);
+    } else {
+      chunk = new_chunk(kChunkSize, false);
+      cache.data_chunk = chunk;
+    }
+  }
+  void* p = &chunk->data[chunk->used];
+  chunk->used += bytes;
+  ++chunk->alloc_num;
+  chunk->saved_bytes += malloc_chunk_bytes(len) - bytes;
+  return p;
+}
+void* SlotRecordArena::alloc_record(size_t byte_size) {
+  // every record leads by its stride, pools of any record size can share
+  // the chunk and release still walks it
+  size_t bytes = sizeof(size_t) + arena_align_bytes(byte_size);
+  ThreadCache& cache = thread_cache();
+  Chunk* chunk = cache.record_chunk;
+  if (chunk == nullptr || chunk->used + bytes > chunk->capacity) {
+    chunk = new_chunk(kChunkSize, true);
+    cache.record_chunk = chunk;
+  }
+  char* p = &chunk->data[chunk->used];
+  *reinterpret_cast<size_t*>(p) = bytes;
+  chunk->used += bytes;
+  ++chunk->alloc_num;
+  chunk->saved_bytes += malloc_chunk_bytes(byte_size) - bytes;
+  return p + sizeof(size_t);
+}
+void SlotRecordArena::release(void) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (chunks_.empty()) {
+    return;
+  }
+  platform::Timer timeline;
+  timeline.Start();
+  size_t saved_bytes = 0;
+  size_t record_num = 0;
+  // destroy records before unmark chunks, arena buffers are skipped by
+  // address, only buffers grown outside arena and id strings go to heap
+  for (auto chunk : chunks_) {
+    if (!chunk->records) {
+      continue;
+    }
+    size_t stride = 0;
+    for (size_t off = 0; off < chunk->used; off += stride) {
+      stride = *reinterpret_cast<const size_t*>(&chunk->data[off]);
+      reinterpret_cast<SlotRecordObject*>(&chunk->data[off + sizeof(size_t)])
+          ->~SlotRecordObject();
+    }
+    record_num += chunk->alloc_num;
+  }
+  for (auto chunk : chunks_) {
+    saved_bytes += chunk->saved_bytes;
+    mark_chunk(chunk, false);
+    free(chunk->data);
+    delete chunk;
+  }
+  size_t chunk_num = chunks_.size();
+  chunks_.clear();
+  total_saved_bytes_ += saved_bytes;
+  // thread caches of old generation become invalid
+  gen_ = ++g_slot_arena_gen;
+  timeline.Pause();
+  VLOG(1) << "release slot record arena chunks=" << chunk_num
+          << ", records=" << record_num << ", saved bytes=" << saved_bytes
+          << ", span=" << timeline.ElapsedSec();
+}
+size_t SlotRecordArena::chunk_num(void) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return chunks_.size();
+}
+size_t SlotRecordArena::record_num(void) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t num = 0;
+  for (auto chunk : chunks_) {
+    if (chunk->records) {
+      num += chunk->alloc_num;
+    }
+  }
+  return num;
+}
+size_t SlotRecordArena::saved_bytes(void) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t bytes = total_saved_bytes_;
+  for (auto chunk : chunks_) {
+    bytes += chunk->saved_bytes;
+  }
+  return bytes;
+}
+
 class BufferedLineFileReader {
   typedef std::function<bool()> SampleFunc;
   static const int MAX_FILE_BUFF_SIZE = 4 * 1024 * 1024;
@@ -1118,6 +1277,18 @@ void MultiSlotInMemoryDataFeed::Init(
   so_parser_name_ = data_feed_desc.so_parser_name();
   finish_init_ = true;
   input_type_ = data_feed_desc.input_type();
+
+  text_layout_.slots.resize(all_slot_num);
+  text_layout_.float_slot_num = static_cast<int>(use_slots_.size());
+  text_layout_.uint64_slot_num = static_cast<int>(use_slots_.size());
+  for (size_t i = 0; i < all_slot_num; ++i) {
+    auto& slot = text_layout_.slots[i];
+    slot.type = all_slots_type_[i][0];
+    slot.value_idx = use_slots_index_[i];
+    slot.used =
+        (slot.value_idx != -1 && (slot.type == 'f' || slot.type == 'u'));
+    slot.dense = slot.used && use_slots_is_dense_[slot.value_idx];
+  }
 }
 
 void MultiSlotInMemoryDataFeed::GetMsgFromLogKey(const std::string& log_key,
@@ -1200,6 +1371,16 @@ bool MultiSlotInMemoryDataFeed::ParseOneInstanceFromPipe(Record* instance) {
       instance->rank = rank;
       pos += len + 1;
     }
+    if (FLAGS_padbox_slot_text_parser && !parse_uid_) {
+      PADDLE_ENFORCE_LE(
+          static_cast<size_t>(pos),
+          line.size(),
+          platform::errors::InvalidArgument(
+              "Bad line header, please check this error line: %s", str));
+      ParseTextFeasigns(str + pos, line.size() - pos, instance);
+      fea_num_ += instance->uint64_feasigns_.size();
+      return true;
+    }
     for (size_t i = 0; i < use_slots_index_.size(); ++i) {
       int idx = use_slots_index_[i];
       int num = strtol(&str[pos], &endptr, 10);
@@ -1278,6 +1459,38 @@ bool MultiSlotInMemoryDataFeed::ParseOneInstanceFromPipe(Record* instance) {
 #endif
 }
 
+void MultiSlotInMemoryDataFeed::ParseTextFeasigns(const char* str,
+                                                  size_t len,
+                                                  Record* instance) {
+  thread_local SlotTextFeasigns feasigns;
+  PADDLE_ENFORCE_EQ(
+      ParseSlotTextFeasigns(str, len, text_layout_, &feasigns),
+      true,
+      platform::errors::InvalidArgument(
+          "The number of ids can not be zero, you need padding "
+          "it in data generator; or if there is something wrong with "
+          "the data, please check if the data contains unresolvable "
+          "characters.\nplease check this error line: %s",
+          str));
+  // the used slots are in line order, so are the feasigns
+  for (size_t idx = 0; idx < feasigns.float_feasigns.size(); ++idx) {
+    for (float feasign : feasigns.float_feasigns[idx]) {
+      FeatureFeasign f;
+      f.float_feasign_ = feasign;
+      instance->float_feasigns_.push_back(FeatureItem(f, idx));
+    }
+  }
+  for (size_t idx = 0; idx < feasigns.uint64_feasigns.size(); ++idx) {
+    for (uint64_t feasign : feasigns.uint64_feasigns[idx]) {
+      FeatureFeasign f;
+      f.uint64_feasign_ = feasign;
+      instance->uint64_feasigns_.push_back(FeatureItem(f, idx));
+    }
+  }
+  instance->float_feasigns_.shrink_to_fit();
+  instance->uint64_feasigns_.shrink_to_fit();
+}
+
 bool MultiSlotInMemoryDataFeed::ParseOneInstance(Record* instance) {
 #ifdef _LINUX
   std::string line;
@@ -2600,8 +2813,11 @@ void SlotRecordInMemoryDataFeed::ExpandSlotRecord(SlotRecord* rec) {
   int float_slot_num =
       static_cast<int>(float_total_dims_without_inductives_.size());
   CHECK(float_slot_num == float_use_slot_size_);
-  std::vector<float> old_values;
-  std::vector<uint32_t> old_offsets;
+  // same allocator, the record keeps growing in its own arena
+  SlotValues<float>::ValueVector old_values(
+      ins->slot_float_feasigns_.slot_values.get_allocator());
+  SlotValues<float>::OffsetVector old_offsets(
+      ins->slot_float_feasigns_.slot_offsets.get_allocator());
   old_values.swap(ins->slot_float_feasigns_.slot_values);
   old_offsets.swap(ins->slot_float_feasigns_.slot_offsets);
 
@@ -2991,6 +3207,346 @@ class BinaryArchiveReader {
   char* buff_ = nullptr;
   size_t capacity_ = 0;
 };
+// columnar archive file: file header, then blocks of at most
+// OBJPOOL_BLOCK_SIZE records, every column is 8 bytes aligned
+static const uint64_t COLUMNAR_FILE_MAGIC = 0x31524c4f43584f42ULL;  // BOXCOLR1
+static const uint32_t COLUMNAR_BLOCK_MAGIC = 0x4b4c4243;  // CBLK
+static const uint32_t COLUMNAR_VERSION = 1;
+struct ColumnarFileHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t reserved;
+};
+struct ColumnarBlockHeader {
+  uint32_t magic;
+  uint32_t ins_num;
+  uint32_t uint64_slot_num;
+  uint32_t float_slot_num;
+  uint64_t uint64_value_num;
+  uint64_t float_value_num;
+  uint64_t str_bytes;
+  uint64_t block_bytes;
+};
+inline size_t columnar_align(size_t len) { return (len + 7) & ~(size_t)7; }
+// block column sizes, shared by writer and reader
+struct ColumnarBlockLayout {
+  size_t search_id;
+  size_t user_id_sign;
+  size_t cur_timestamp;
+  size_t show_timestamp;
+  size_t rank;
+  size_t cmatch;
+  size_t str_offsets;
+  size_t strs;
+  size_t uint64_slot_begin;
+  size_t uint64_offsets;
+  size_t uint64_values;
+  size_t float_slot_begin;
+  size_t float_offsets;
+  size_t float_values;
+  size_t total;
+
+  explicit ColumnarBlockLayout(const ColumnarBlockHeader& h) {
+    size_t n = h.ins_num;
+    size_t off = sizeof(ColumnarBlockHeader);
+    auto next = [&off](size_t len) {
+      size_t pos = off;
+      off += columnar_align(len);
+      return pos;
+    };
+    search_id = next(n * sizeof(uint64_t));
+    user_id_sign = next(n * sizeof(uint64_t));
+    cur_timestamp = next(n * sizeof(uint64_t));
+    show_timestamp = next(n * sizeof(uint64_t));
+    rank = next(n * sizeof(uint32_t));
+    cmatch = next(n * sizeof(uint32_t));
+    str_offsets = next((2 * n + 1) * sizeof(uint32_t));
+    strs = next(h.str_bytes);
+    uint64_slot_begin = next((h.uint64_slot_num + 1) * sizeof(uint64_t));
+    uint64_offsets = next(h.uint64_slot_num * (n + 1) * sizeof(uint32_t));
+    uint64_values = next(h.uint64_value_num * sizeof(uint64_t));
+    float_slot_begin = next((h.float_slot_num + 1) * sizeof(uint64_t));
+    float_offsets = next(h.float_slot_num * (n + 1) * sizeof(uint32_t));
+    float_values = next(h.float_value_num * sizeof(float));
+    total = off;
+  }
+};
+template <typename T>
+static void write_slot_columns(char* base,
+                                size_t begin_pos,
+                                size_t offsets_pos,
+                                size_t values_pos,
+                                const std::vector<std::vector<uint32_t>>& offs,
+                                const std::vector<std::vector<T>>& vals) {
+  uint64_t* slot_begin = reinterpret_cast<uint64_t*>(base + begin_pos);
+  uint32_t* offsets = reinterpret_cast<uint32_t*>(base + offsets_pos);
+  T* values = reinterpret_cast<T*>(base + values_pos);
+  uint64_t total = 0;
+  for (size_t i = 0; i < vals.size(); ++i) {
+    slot_begin[i] = total;
+    memcpy(offsets, offs[i].data(), offs[i].size() * sizeof(uint32_t));
+    offsets += offs[i].size();
+    if (!vals[i].empty()) {
+      memcpy(&values[total], vals[i].data(), vals[i].size() * sizeof(T));
+    }
+    total += vals[i].size();
+  }
+  slot_begin[vals.size()] = total;
+}
+ColumnarArchiveWriter::ColumnarArchiveWriter() {}
+ColumnarArchiveWriter::~ColumnarArchiveWriter() { close(); }
+bool ColumnarArchiveWriter::open(const std::string& path) {
+  fd_ = ::open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0777);
+  if (fd_ < 0) {
+    VLOG(0) << "open [" << path << "] failed";
+    return false;
+  }
+  ColumnarFileHeader head;
+  head.magic = COLUMNAR_FILE_MAGIC;
+  head.version = COLUMNAR_VERSION;
+  head.reserved = 0;
+  if (::write(fd_, &head, sizeof(head)) != sizeof(head)) {
+    VLOG(0) << "write [" << path << "] header failed";
+    return false;
+  }
+  ins_num_ = 0;
+  return true;
+}
+bool ColumnarArchiveWriter::write(const SlotRecord& rec) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& u64 = rec->slot_uint64_feasigns_;
+  auto& f32 = rec->slot_float_feasigns_;
+  uint32_t uint64_slot_num =
+      u64.slot_offsets.empty() ? 0 : (u64.slot_offsets.size() - 1);
+  uint32_t float_slot_num =
+      f32.slot_offsets.empty() ? 0 : (f32.slot_offsets.size() - 1);
+  // all records in one block have the same slot num
+  if (ins_num_ > 0 && (uint64_slot_num != uint64_slot_num_ ||
+                       float_slot_num != float_slot_num_)) {
+    if (!flush_block()) {
+      return false;
+    }
+  }
+  if (ins_num_ == 0) {
+    uint64_slot_num_ = uint64_slot_num;
+    float_slot_num_ = float_slot_num;
+    uint64_columns_.reset(uint64_slot_num_);
+    float_columns_.reset(float_slot_num_);
+    str_offsets_.assign(1, 0);
+    strs_.clear();
+  }
+  search_ids_.push_back(rec->search_id);
+  user_id_signs_.push_back(rec->user_id_sign_);
+  cur_timestamps_.push_back(rec->cur_timestamp_);
+  show_timestamps_.push_back(rec->show_timestamp_);
+  ranks_.push_back(rec->rank);
+  cmatchs_.push_back(rec->cmatch);
+  strs_.append(rec->ins_id_);
+  str_offsets_.push_back(static_cast<uint32_t>(strs_.size()));
+  strs_.append(rec->user_id_);
+  str_offsets_.push_back(static_cast<uint32_t>(strs_.size()));
+  uint64_columns_.add(u64, uint64_slot_num_);
+  float_columns_.add(f32, float_slot_num_);
+  ++ins_num_;
+
+  if (ins_num_ < static_cast<uint32_t>(OBJPOOL_BLOCK_SIZE)) {
+    return true;
+  }
+  return flush_block();
+}
+bool ColumnarArchiveWriter::flush_block(void) {
+  if (ins_num_ == 0) {
+    return true;
+  }
+  ColumnarBlockHeader head;
+  head.magic = COLUMNAR_BLOCK_MAGIC;
+  head.ins_num = ins_num_;
+  head.uint64_slot_num = uint64_slot_num_;
+  head.float_slot_num = float_slot_num_;
+  head.uint64_value_num = uint64_columns_.value_num();
+  head.float_value_num = float_columns_.value_num();
+  head.str_bytes = strs_.size();
+  ColumnarBlockLayout layout(head);
+  head.block_bytes = layout.total;
+
+  block_buf_.assign(layout.total, 0);
+  char* base = block_buf_.data();
+  memcpy(base, &head, sizeof(head));
+  size_t n = ins_num_;
+  memcpy(base + layout.search_id, search_ids_.data(), n * sizeof(uint64_t));
+  memcpy(base + layout.user_id_sign,
+         user_id_signs_.data(),
+         n * sizeof(uint64_t));
+  memcpy(base + layout.cur_timestamp,
+         cur_timestamps_.data(),
+         n * sizeof(uint64_t));
+  memcpy(base + layout.show_timestamp,
+         show_timestamps_.data(),
+         n * sizeof(uint64_t));
+  memcpy(base + layout.rank, ranks_.data(), n * sizeof(uint32_t));
+  memcpy(base + layout.cmatch, cmatchs_.data(), n * sizeof(uint32_t));
+  memcpy(base + layout.str_offsets,
+         str_offsets_.data(),
+         str_offsets_.size() * sizeof(uint32_t));
+  if (!strs_.empty()) {
+    memcpy(base + layout.strs, strs_.data(), strs_.size());
+  }
+  write_slot_columns(base,
+                     layout.uint64_slot_begin,
+                     layout.uint64_offsets,
+                     layout.uint64_values,
+                     uint64_columns_.offsets,
+                     uint64_columns_.values);
+  write_slot_columns(base,
+                     layout.float_slot_begin,
+                     layout.float_offsets,
+                     layout.float_values,
+                     float_columns_.offsets,
+                     float_columns_.values);
+
+  size_t left = layout.total;
+  while (left > 0) {
+    ssize_t ret = ::write(fd_, base, left);
+    if (ret <= 0) {
+      LOG(WARNING) << "write columnar block failed, left bytes=" << left;
+      return false;
+    }
+    base += ret;
+    left -= ret;
+  }
+
+  ins_num_ = 0;
+  search_ids_.clear();
+  user_id_signs_.clear();
+  cur_timestamps_.clear();
+  show_timestamps_.clear();
+  ranks_.clear();
+  cmatchs_.clear();
+  return true;
+}
+void ColumnarArchiveWriter::close(void) {
+  if (fd_ < 0) {
+    return;
+  }
+  mutex_.lock();
+  CHECK(flush_block());
+  mutex_.unlock();
+  ::close(fd_);
+  fd_ = -1;
+}
+class ColumnarArchiveReader {
+ public:
+  ColumnarArchiveReader() {}
+  ~ColumnarArchiveReader() { close(); }
+  // false when the file can not be opened, the caller retries like open
+  static bool probe(const std::string& path, bool* is_columnar) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      VLOG(0) << "open [" << path << "] failed";
+      return false;
+    }
+    ColumnarFileHeader head;
+    *is_columnar = (::read(fd, &head, sizeof(head)) == sizeof(head) &&
+                    head.magic == COLUMNAR_FILE_MAGIC);
+    ::close(fd);
+    return true;
+  }
+  bool open(const std::string& path) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+      VLOG(0) << "open [" << path << "] failed";
+      return false;
+    }
+    struct stat st;
+    CHECK_EQ(fstat(fd_, &st), 0) << "stat [" << path << "] failed";
+    size_ = st.st_size;
+    CHECK_GE(size_, sizeof(ColumnarFileHeader)) << "file: " << path;
+    data_ = reinterpret_cast<char*>(
+        mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0));
+    CHECK(data_ != MAP_FAILED) << "mmap [" << path << "] failed";
+    madvise(data_, size_, MADV_SEQUENTIAL);
+    auto head = reinterpret_cast<const ColumnarFileHeader*>(data_);
+    CHECK(head->magic == COLUMNAR_FILE_MAGIC &&
+          head->version == COLUMNAR_VERSION)
+        << "file: " << path << " is not a columnar archive";
+    return true;
+  }
+  // proc_func(header, layout, block base), returns lines
+  int read_all(std::function<int(const ColumnarBlockHeader&,
+                                 const ColumnarBlockLayout&,
+                                 const char*)> proc_func) {
+    int lines = 0;
+    size_t offset = sizeof(ColumnarFileHeader);
+    size_t released = 0;
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    while (offset + sizeof(ColumnarBlockHeader) <= size_) {
+      const char* base = data_ + offset;
+      auto head = reinterpret_cast<const ColumnarBlockHeader*>(base);
+      CHECK_EQ(head->magic, COLUMNAR_BLOCK_MAGIC) << "offset: " << offset;
+      ColumnarBlockLayout layout(*head);
+      CHECK(layout.total == head->block_bytes &&
+            offset + layout.total <= size_)
+          << "bad block offset: " << offset << ", bytes: " << layout.total
+          << ", file size: " << size_;
+      lines += proc_func(*head, layout, base);
+      offset += layout.total;
+      // drop consumed pages, keep rss flat
+      size_t end = offset - (offset % page_size);
+      if (end > released) {
+        madvise(data_ + released, end - released, MADV_DONTNEED);
+        released = end;
+      }
+    }
+    return lines;
+  }
+  void close(void) {
+    if (data_ != nullptr) {
+      munmap(data_, size_);
+      data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+ private:
+  int fd_ = -1;
+  char* data_ = nullptr;
+  size_t size_ = 0;
+};
+template <typename T>
+static void fill_columnar_slot_values(SlotValues<T>* out,
+                                      const uint32_t slot_num,
+                                      const uint32_t ins_num,
+                                      const uint32_t ins_idx,
+                                      const uint64_t* slot_begin,
+                                      const uint32_t* offsets,
+                                      const T* values) {
+  if (slot_num == 0) {
+    out->slot_values.clear();
+    out->slot_offsets.clear();
+    return;
+  }
+  out->slot_offsets.resize(slot_num + 1);
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < slot_num; ++i) {
+    const uint32_t* offs = &offsets[i * (ins_num + 1) + ins_idx];
+    out->slot_offsets[i] = total;
+    total += offs[1] - offs[0];
+  }
+  out->slot_offsets[slot_num] = total;
+  out->slot_values.resize(total);
+  for (uint32_t i = 0; i < slot_num; ++i) {
+    const uint32_t* offs = &offsets[i * (ins_num + 1) + ins_idx];
+    uint32_t num = offs[1] - offs[0];
+    if (num > 0) {
+      memcpy(&out->slot_values[out->slot_offsets[i]],
+             &values[slot_begin[i] + offs[0]],
+             num * sizeof(T));
+    }
+  }
+}
 void SlotPaddleBoxDataFeed::Init(const DataFeedDesc& data_feed_desc) {
   finish_init_ = false;
   finish_set_filelist_ = false;
@@ -3191,6 +3747,9 @@ int SlotPaddleBoxDataFeed::Next() {
   });
 #endif
   auto& batch = batch_offsets_[offset_index_++];
+  if (feed_stat_ != nullptr) {
+    feed_stat_->Add(batch.second, 0);
+  }
   if (enable_pv_merge_) {
     // join phase : output_pv_channel to consume_pv_channel
     this->batch_size_ = batch.second;
@@ -3362,8 +3921,11 @@ void SlotPaddleBoxDataFeed::ExpandSlotRecord(SlotRecord* rec) {
   int float_slot_num =
       static_cast<int>(float_total_dims_without_inductives_.size());
   CHECK(float_slot_num == float_use_slot_size_);
-  std::vector<float> old_values;
-  std::vector<uint32_t> old_offsets;
+  // same allocator, the record keeps growing in its own arena
+  SlotValues<float>::ValueVector old_values(
+      ins->slot_float_feasigns_.slot_values.get_allocator());
+  SlotValues<float>::OffsetVector old_offsets(
+      ins->slot_float_feasigns_.slot_offsets.get_allocator());
   old_values.swap(ins->slot_float_feasigns_.slot_values);
   old_offsets.swap(ins->slot_float_feasigns_.slot_offsets);
 
@@ -4149,6 +4711,9 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByLine(void) {
     record_vec.clear();
     record_vec.shrink_to_fit();
     timeline.Pause();
+    if (read_stat_ != nullptr) {
+      read_stat_->Add(lines, line_reader.file_size());
+    }
     VLOG(3) << "LoadIntoMemoryByLib() read all lines, file=" << filename
             << ", cost time=" << timeline.ElapsedSec()
             << " seconds, thread_id=" << thread_id_ << ", lines=" << lines
@@ -4246,6 +4811,10 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByFile(void) {
       }
     } while (!is_ok);
     timeline.Pause();
+    // the parser reads the file itself, bytes are unknown
+    if (read_stat_ != nullptr) {
+      read_stat_->Add(lines, 0);
+    }
     VLOG(3) << "LoadIntoMemoryByLib() read all file, file=" << filename
             << ", cost time=" << timeline.ElapsedSec()
             << " seconds, thread_id=" << thread_id_ << ", lines=" << lines;
@@ -4266,6 +4835,21 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByArchive(void) {
     timeline.Start();
 
     int lines = 0;
+    bool is_columnar = false;
+    while (!ColumnarArchiveReader::probe(filename, &is_columnar)) {
+      sleep(1);
+    }
+    if (is_columnar) {
+      lines = LoadColumnarArchiveFile(filename);
+      timeline.Pause();
+      if (read_stat_ != nullptr) {
+        read_stat_->Add(lines, 0);
+      }
+      VLOG(3) << "LoadColumnarArchiveFile() read all file, file=" << filename
+              << ", cost time=" << timeline.ElapsedSec()
+              << " seconds, thread_id=" << thread_id_ << ", lines=" << lines;
+      continue;
+    }
     while (!reader.open(filename)) {
       sleep(1);
     }
@@ -4307,6 +4891,9 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByArchive(void) {
     reader.close();
 
     timeline.Pause();
+    if (read_stat_ != nullptr) {
+      read_stat_->Add(lines, 0);
+    }
 
     VLOG(3) << "LoadIntoMemoryByArchive() read all file, file=" << filename
             << ", cost time=" << timeline.ElapsedSec()
@@ -4314,6 +4901,80 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByArchive(void) {
   }
 }
 
+// load columnar archive file, records are filled from the mapped columns
+int SlotPaddleBoxDataFeed::LoadColumnarArchiveFile(const std::string& filename) {
+  ColumnarArchiveReader reader;
+  while (!reader.open(filename)) {
+    sleep(1);
+  }
+  std::vector<SlotRecord> data;
+  auto func = [this, &data](const ColumnarBlockHeader& head,
+                            const ColumnarBlockLayout& layout,
+                            const char* base) {
+    const uint32_t n = head.ins_num;
+    auto search_ids =
+        reinterpret_cast<const uint64_t*>(base + layout.search_id);
+    auto user_id_signs =
+        reinterpret_cast<const uint64_t*>(base + layout.user_id_sign);
+    auto cur_timestamps =
+        reinterpret_cast<const uint64_t*>(base + layout.cur_timestamp);
+    auto show_timestamps =
+        reinterpret_cast<const uint64_t*>(base + layout.show_timestamp);
+    auto ranks = reinterpret_cast<const uint32_t*>(base + layout.rank);
+    auto cmatchs = reinterpret_cast<const uint32_t*>(base + layout.cmatch);
+    auto str_offsets =
+        reinterpret_cast<const uint32_t*>(base + layout.str_offsets);
+    const char* strs = base + layout.strs;
+    auto uint64_slot_begin =
+        reinterpret_cast<const uint64_t*>(base + layout.uint64_slot_begin);
+    auto uint64_offsets =
+        reinterpret_cast<const uint32_t*>(base + layout.uint64_offsets);
+    auto uint64_values =
+        reinterpret_cast<const uint64_t*>(base + layout.uint64_values);
+    auto float_slot_begin =
+        reinterpret_cast<const uint64_t*>(base + layout.float_slot_begin);
+    auto float_offsets =
+        reinterpret_cast<const uint32_t*>(base + layout.float_offsets);
+    auto float_values =
+        reinterpret_cast<const float*>(base + layout.float_values);
+
+    slot_pool_->get(&data, n);
+    for (uint32_t i = 0; i < n; ++i) {
+      auto& r = data[i];
+      r->search_id = search_ids[i];
+      r->user_id_sign_ = user_id_signs[i];
+      r->cur_timestamp_ = cur_timestamps[i];
+      r->show_timestamp_ = show_timestamps[i];
+      r->rank = ranks[i];
+      r->cmatch = cmatchs[i];
+      r->ins_id_.assign(&strs[str_offsets[2 * i]],
+                        str_offsets[2 * i + 1] - str_offsets[2 * i]);
+      r->user_id_.assign(&strs[str_offsets[2 * i + 1]],
+                         str_offsets[2 * i + 2] - str_offsets[2 * i + 1]);
+      fill_columnar_slot_values(&r->slot_uint64_feasigns_,
+                                head.uint64_slot_num,
+                                n,
+                                i,
+                                uint64_slot_begin,
+                                uint64_offsets,
+                                uint64_values);
+      fill_columnar_slot_values(&r->slot_float_feasigns_,
+                                head.float_slot_num,
+                                n,
+                                i,
+                                float_slot_begin,
+                                float_offsets,
+                                float_values);
+    }
+    CHECK(input_channel_->WriteMove(n, &data[0]) == static_cast<size_t>(n));
+    data.clear();
+    return static_cast<int>(n);
+  };
+  int lines = reader.read_all(func);
+  reader.close();
+  return lines;
+}
+
 void SlotPaddleBoxDataFeed::LoadIntoMemoryByLib(void) {
   if (is_archive_file_) {
     LoadIntoMemoryByArchive();
@@ -4329,6 +4990,11 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByCommand(void) {
   std::string filename;
   BufferedLineFileReader line_reader;
   line_reader.set_sample_rate(sample_rate_);
+  if (FLAGS_padbox_slot_text_parser && text_parser_ == nullptr) {
+    text_parser_.reset(new SlotTextParser(parse_ins_id_, parse_logkey_));
+    text_parser_->Init(all_slots_info_);
+    text_parser_->SetDenseSlots(used_slots_info_);
+  }
 
   while (this->PickOneFile(&filename)) {
     VLOG(3) << "PickOneFile, filename=" << filename
@@ -4383,6 +5049,9 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByCommand(void) {
     record_vec.clear();
     record_vec.shrink_to_fit();
     timeline.Pause();
+    if (read_stat_ != nullptr) {
+      read_stat_->Add(lines, line_reader.file_size());
+    }
     VLOG(3) << "LoadIntoMemory() read all lines, file=" << filename
             << ", lines=" << lines
             << ", sample lines=" << line_reader.get_sample_line()
@@ -4394,9 +5063,111 @@ void SlotPaddleBoxDataFeed::LoadIntoMemoryByCommand(void) {
 
 }
 
+bool SlotTextParser::Init(const std::vector<AllSlotInfo>& slots) {
+  layout_.slots.resize(slots.size());
+  layout_.float_slot_num = 0;
+  layout_.uint64_slot_num = 0;
+  for (size_t i = 0; i < slots.size(); ++i) {
+    auto& info = slots[i];
+    auto& slot = layout_.slots[i];
+    slot.type = info.type[0];
+    slot.used = (info.used_idx != -1);
+    slot.dense = false;
+    slot.value_idx = info.slot_value_idx;
+    if (!slot.used) {
+      continue;
+    }
+    if (slot.type == 'f') {
+      layout_.float_slot_num =
+          std::max(layout_.float_slot_num, slot.value_idx + 1);
+    } else if (slot.type == 'u') {
+      layout_.uint64_slot_num =
+          std::max(layout_.uint64_slot_num, slot.value_idx + 1);
+    } else {
+      slot.used = false;
+    }
+  }
+  return true;
+}
+void SlotTextParser::SetDenseSlots(const std::vector<UsedSlotInfo>& used_slots) {
+  for (auto& info : used_slots) {
+    if (info.idx < 0 || info.idx >= static_cast<int>(layout_.slots.size())) {
+      continue;
+    }
+    layout_.slots[info.idx].dense = info.dense;
+  }
+}
+bool SlotTextParser::ParseOneInstance(
+    const std::string& line,
+    std::function<void(std::vector<SlotRecord>&, int)> GetInsFunc) {
+  std::vector<SlotRecord> recs;
+  GetInsFunc(recs, 1);
+  return ParseOneInstance(line, &recs[0]);
+}
+bool SlotTextParser::ParseOneInstance(const std::string& line,
+                                      SlotRecord* ins) {
+  SlotRecord& rec = (*ins);
+  const char* str = line.c_str();
+  char* endptr = const_cast<char*>(str);
+  size_t pos = 0;
+
+  if (parse_ins_id_) {
+    int num = strtol(&str[pos], &endptr, 10);
+    CHECK(num == 1);  // NOLINT
+    pos = endptr - str + 1;
+    size_t len = 0;
+    while (str[pos + len] != ' ') {
+      ++len;
+    }
+    rec->ins_id_ = std::string(str + pos, len);
+    pos += len + 1;
+  }
+  if (parse_logkey_) {
+    int num = strtol(&str[pos], &endptr, 10);
+    CHECK(num == 1);  // NOLINT
+    pos = endptr - str + 1;
+    size_t len = 0;
+    while (str[pos + len] != ' ') {
+      ++len;
+    }
+    std::string log_key = std::string(str + pos, len);
+    uint64_t search_id;
+    uint32_t cmatch;
+    uint32_t rank;
+    parser_log_key(log_key, &search_id, &cmatch, &rank);
+
+    rec->ins_id_ = log_key;
+    rec->search_id = search_id;
+    rec->cmatch = cmatch;
+    rec->rank = rank;
+    pos += len + 1;
+  }
+  if (pos > line.size()) {
+    return false;
+  }
+
+  thread_local SlotTextFeasigns feasigns;
+  PADDLE_ENFORCE(ParseSlotTextFeasigns(str + pos, line.size() - pos, layout_,
+                                       &feasigns),
+                 "The number of ids can not be zero, you need padding "
+                 "it in data generator; or if there is something wrong with "
+                 "the data, please check if the data contains unresolvable "
+                 "characters.\nplease check this error line: %s",
+                 str);
+  rec->slot_float_feasigns_.add_slot_feasigns(feasigns.float_feasigns,
+                                              feasigns.float_total_num);
+  rec->slot_uint64_feasigns_.add_slot_feasigns(feasigns.uint64_feasigns,
+                                               feasigns.uint64_total_num);
+
+  return (feasigns.uint64_total_num > 0);
+}
+
 bool SlotPaddleBoxDataFeed::ParseOneInstance(const std::string& line,
                                              SlotRecord* ins) {
   SlotRecord& rec = (*ins);
+  if (text_parser_ != nullptr) {
+    return text_parser_->ParseOneInstance(line, ins);
+  }
   // parse line
   const char* str = line.c_str();
   char* endptr = const_cast<char*>(str);
@@ -19,6 +19,8 @@ limitations under the License. */
 #define _LINUX
 #endif
 
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <fstream>
 #include <future>  // NOLINT
 #include <memory>
@@ -36,6 +38,7 @@ limitations under the License. */
 #include "paddle/fluid/framework/blocking_queue.h"
 #include "paddle/fluid/framework/channel.h"
 #include "paddle/fluid/framework/data_feed.pb.h"
+#include "paddle/fluid/framework/data_feed_text_parser.h"
 #include "paddle/fluid/framework/fleet/fleet_wrapper.h"
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/reader.h"
@@ -99,10 +102,160 @@ namespace framework {
 //      // trainer do something
 //   }
 
+/**
+ * @Brief pass scoped arena of SlotRecord, record objects are bump allocated
+ * from per-thread chunks and the whole pass is released in O(chunks). A thread
+ * allocates records from the arena only while it is bound by
+ * SlotRecordArenaGuard, arena records are never returned to pool. Built with
+ * WITH_SLOTRECORD_ARENA, the feasigns and offsets of an arena record also grow
+ * in the arena owning the record.
+ */
+class SlotRecordArena {
+ public:
+  // chunks are aligned to chunk size, so memory owner is found by address
+  static const int kChunkShift = 26;
+  static const size_t kChunkSize = (1UL << kChunkShift);
+  static const int kAddressBits = 48;
+
+  SlotRecordArena();
+  ~SlotRecordArena();
+
+  static SlotRecordArena*& thread_arena(void) {
+    thread_local SlotRecordArena* arena = nullptr;
+    return arena;
+  }
+  static bool is_arena_memory(const void* p) {
+    uint64_t idx = (reinterpret_cast<uint64_t>(p) >> kChunkShift);
+    return (chunk_bitmap()[idx >> 6].load(std::memory_order_relaxed) >>
+            (idx & 63)) & 1;
+  }
+  // feasigns and offsets memory
+  void* alloc(size_t len);
+  // record object memory, construct by caller
+  void* alloc_record(size_t byte_size);
+  // release all chunks, all arena records become invalid
+  void release(void);
+  size_t chunk_num(void);
+  size_t record_num(void);
+  // malloc bytes saved compared with allocating every record and every
+  // slot vector from heap
+  size_t saved_bytes(void);
+
+ private:
+  struct Chunk {
+    char* data = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t alloc_num = 0;
+    size_t saved_bytes = 0;
+    // record objects or feasigns and offsets
+    bool records = false;
+  };
+  struct ThreadCache {
+    uint64_t gen = 0;
+    Chunk* data_chunk = nullptr;
+    Chunk* record_chunk = nullptr;
+  };
+  // a thread may fill several live arenas in turn, e.g. the pass in training
+  // and the pass preloading, each keeps its chunks in its own slot
+  static const int kThreadCacheNum = 4;
+  static std::atomic<uint64_t>* chunk_bitmap(void) {
+    static std::atomic<uint64_t> bitmap[(1UL << (kAddressBits - kChunkShift)) /
+                                        64];
+    return bitmap;
+  }
+  ThreadCache& thread_cache(void);
+  Chunk* new_chunk(size_t capacity, bool records);
+  static void mark_chunk(const Chunk* chunk, bool used);
+
+ private:
+  std::mutex mutex_;
+  uint64_t gen_ = 0;
+  std::vector<Chunk*> chunks_;
+  size_t total_saved_bytes_ = 0;
+};
+// bind current thread to arena
+class SlotRecordArenaGuard {
+ public:
+  explicit SlotRecordArenaGuard(SlotRecordArena* arena)
+      : prev_(SlotRecordArena::thread_arena()) {
+    SlotRecordArena::thread_arena() = arena;
+  }
+  ~SlotRecordArenaGuard() { SlotRecordArena::thread_arena() = prev_; }
+
+ private:
+  SlotRecordArena* prev_;
+};
+#ifdef PADDLE_WITH_SLOTRECORD_ARENA
+// allocates from the arena owning the record whatever thread grows the
+// vector, default constructed it is std::allocator. The arena moves and swaps
+// with the buffer, copies go to heap.
+template <typename T>
+struct SlotArenaAllocator {
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  SlotArenaAllocator() noexcept {}
+  explicit SlotArenaAllocator(SlotRecordArena* arena) noexcept
+      : arena(arena) {}
+  template <typename U>
+  SlotArenaAllocator(const SlotArenaAllocator<U>& other) noexcept  // NOLINT
+      : arena(other.arena) {}
+
+  T* allocate(size_t n) {
+    if (arena != nullptr) {
+      return reinterpret_cast<T*>(arena->alloc(n * sizeof(T)));
+    }
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* p, size_t n) {
+    // released with the arena
+    if (arena != nullptr) {
+      return;
+    }
+    std::allocator<T>().deallocate(p, n);
+  }
+  SlotArenaAllocator select_on_container_copy_construction() const {
+    return SlotArenaAllocator();
+  }
+
+  SlotRecordArena* arena = nullptr;
+};
+template <typename T, typename U>
+inline bool operator==(const SlotArenaAllocator<T>& a,
+                       const SlotArenaAllocator<U>& b) {
+  return a.arena == b.arena;
+}
+template <typename T, typename U>
+inline bool operator!=(const SlotArenaAllocator<T>& a,
+                       const SlotArenaAllocator<U>& b) {
+  return a.arena != b.arena;
+}
+#endif
+
 template <typename T>
 struct SlotValues {
-  std::vector<T> slot_values;
-  std::vector<uint32_t> slot_offsets;
+#ifdef PADDLE_WITH_SLOTRECORD_ARENA
+  using ValueVector = std::vector<T, SlotArenaAllocator<T>>;
+  using OffsetVector = std::vector<uint32_t, SlotArenaAllocator<uint32_t>>;
+
+  SlotValues() {}
+  explicit SlotValues(SlotRecordArena* arena)
+      : slot_values(SlotArenaAllocator<T>(arena)),
+        slot_offsets(SlotArenaAllocator<uint32_t>(arena)) {}
+#else
+  // keeps the layout of plugin ISlotParser libraries
+  using ValueVector = std::vector<T>;
+  using OffsetVector = std::vector<uint32_t>;
+
+  SlotValues() {}
+  explicit SlotValues(SlotRecordArena*) {}
+#endif
+
+  ValueVector slot_values;
+  OffsetVector slot_offsets;
 
   void add_values(const T* values, uint32_t num) {
     if (slot_offsets.empty()) {
@@ -217,7 +370,10 @@ struct SlotRecordObject {
   uint64_t cur_timestamp_;
   uint64_t show_timestamp_;
 
-
+  SlotRecordObject() {}
+  // record allocated from arena, see SlotValues
+  explicit SlotRecordObject(SlotRecordArena* arena)
+      : slot_uint64_feasigns_(arena), slot_float_feasigns_(arena) {}
   ~SlotRecordObject() { clear(true); }
   void reset(void) { clear(FLAGS_enable_slotrecord_reset_shrink); }
   void clear(bool shrink) {
@@ -313,6 +469,54 @@ class SlotObjAllocator {
   std::function<void(T*)> deleter_ = nullptr;
 };
 static const int OBJPOOL_BLOCK_SIZE = 10000;
+
+// Counters of one PadBoxSlotDataset pipeline stage in a pass. The stage
+// time runs from Begin() to the last Add(), so a running stage reports its
+// current rate.
+class PipelineStageStat {
+ public:
+  void Reset() {
+    records_ = 0;
+    bytes_ = 0;
+    begin_us_ = 0;
+    end_us_ = 0;
+  }
+  void Begin() {
+    uint64_t now = NowUs();
+    begin_us_ = now;
+    end_us_ = now;
+  }
+  // the first Add() begins a stage that was not begun explicitly
+  void Add(uint64_t records, uint64_t bytes) {
+    uint64_t now = NowUs();
+    uint64_t zero = 0;
+    begin_us_.compare_exchange_strong(zero, now);
+    records_ += records;
+    bytes_ += bytes;
+    uint64_t end = end_us_.load();
+    while (end < now && !end_us_.compare_exchange_weak(end, now)) {
+    }
+  }
+  uint64_t records() const { return records_.load(); }
+  uint64_t bytes() const { return bytes_.load(); }
+  double seconds() const {
+    uint64_t begin = begin_us_.load();
+    uint64_t end = end_us_.load();
+    return end > begin ? (end - begin) * 1e-6 : 0;
+  }
+
+ private:
+  static uint64_t NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  std::atomic<uint64_t> records_{0};
+  std::atomic<uint64_t> bytes_{0};
+  std::atomic<uint64_t> begin_us_{0};
+  std::atomic<uint64_t> end_us_{0};
+};
 class SlotObjPool {
  public:
   SlotObjPool()
@@ -344,11 +548,22 @@ class SlotObjPool {
     return get(&(*output)[0], n);
   }
   void get(SlotRecord* output, size_t n) {
+    SlotRecordArena* arena = SlotRecordArena::thread_arena();
+    if (arena != nullptr) {
+      for (size_t i = 0; i < n; ++i) {
+        output[i] = new (arena->alloc_record(slot_record_byte_size_))
+            SlotRecordObject(arena);
+      }
+      arena_num_ += n;
+      return;
+    }
     size_t size = 0;
     mutex_.lock();
     size = alloc_.get(n, output);
     count_ += n;
     mutex_.unlock();
+    hit_num_ += size;
+    miss_num_ += n - size;
 
     if (size == n) {
       return;
@@ -366,9 +581,19 @@ class SlotObjPool {
     input->clear();
   }
   void put(SlotRecord* input, size_t num) {
+    size_t pool_num = 0;
     for (size_t i = 0; i < num; ++i) {
+      // arena records are released with arena
+      if (SlotRecordArena::is_arena_memory(input[i])) {
+        continue;
+      }
       input[i]->reset();
+      input[pool_num++] = input[i];
     }
+    if (pool_num == 0) {
+      return;
+    }
+    num = pool_num;
     // pool empty add to pool
     mutex_.lock();
     size_t capacity = alloc_.put(num, input);
@@ -415,6 +640,10 @@ class SlotObjPool {
     mutex_.unlock();
     return total;
   }
+  // records reused from the pool, newly allocated and taken from arenas
+  uint64_t hit_count(void) const { return hit_num_.load(); }
+  uint64_t miss_count(void) const { return miss_num_.load(); }
+  uint64_t arena_count(void) const { return arena_num_.load(); }
   // print pool info
   void print_info(const char* name = "pool") {
     LOG(INFO) << "[" << name << "]slot alloc object count=" << count_
@@ -431,6 +660,9 @@ class SlotObjPool {
   size_t count_;  // NOLINT
   std::condition_variable cond_;
   size_t slot_record_byte_size_ = 0;
+  std::atomic<uint64_t> hit_num_{0};
+  std::atomic<uint64_t> miss_num_{0};
+  std::atomic<uint64_t> arena_num_{0};
 };
 
 inline SlotObjPool& SlotRecordPool() {
@@ -1767,6 +1999,11 @@ class MultiSlotInMemoryDataFeed : public InMemoryDataFeed<Record> {
                                 uint32_t* cmatch,
                                 uint32_t* rank);
   virtual void PutToFeedVec(const Record* ins_vec, int num);
+  // parse the slots of a pipe line with the builtin text parser
+  void ParseTextFeasigns(const char* str, size_t len, Record* instance);
+
+  // value_idx of a used slot is its index in use_slots_
+  SlotTextLayout text_layout_;
 };
 
 class SlotRecordInMemoryDataFeed : public InMemoryDataFeed<SlotRecord> {
@@ -2165,16 +2402,49 @@ protected:
   std::pair<uint64_t, uint64_t> test_timestamp_range_;
 };
 
+/**
+ * @Brief builtin slot text parser, vectorized delimiter scan and batch
+ * digits conversion, used when no parser so is configured
+ */
+class SlotTextParser : public ISlotParser {
+ public:
+  SlotTextParser(bool parse_ins_id, bool parse_logkey)
+      : parse_ins_id_(parse_ins_id), parse_logkey_(parse_logkey) {}
+  virtual ~SlotTextParser() {}
+  virtual bool Init(const std::vector<AllSlotInfo>& slots);
+  void SetDenseSlots(const std::vector<UsedSlotInfo>& used_slots);
+  virtual bool ParseOneInstance(
+      const std::string& line,
+      std::function<void(std::vector<SlotRecord>&, int)>
+          GetInsFunc);  // NOLINT
+  bool ParseOneInstance(const std::string& line, SlotRecord* ins);
+
+ private:
+  bool parse_ins_id_ = false;
+  bool parse_logkey_ = false;
+  SlotTextLayout layout_;
+};
+
+/**
+ * @Brief archive file writer interface
+ */
+class ArchiveFileWriter {
+ public:
+  virtual ~ArchiveFileWriter() {}
+  virtual bool open(const std::string& path) = 0;
+  virtual bool write(const SlotRecord& rec) = 0;
+  virtual void close(void) = 0;
+};
 /**
  * @Brief binary archive file
  */
-class BinaryArchiveWriter {
+class BinaryArchiveWriter : public ArchiveFileWriter {
  public:
   BinaryArchiveWriter();
-  ~BinaryArchiveWriter();
-  bool open(const std::string& path);
-  bool write(const SlotRecord& rec);
-  void close(void);
+  virtual ~BinaryArchiveWriter();
+  virtual bool open(const std::string& path);
+  virtual bool write(const SlotRecord& rec);
+  virtual void close(void);
 
  private:
   std::mutex mutex_;
@@ -2184,6 +2454,71 @@ class BinaryArchiveWriter {
   int capacity_ = 0;
   char* head_ = nullptr;
 };
+/**
+ * @Brief columnar archive file, records are grouped into blocks, every block
+ * keeps one column per record field and one column per slot, the reader
+ * mmaps the file and fills records straight from the mapped columns
+ */
+class ColumnarArchiveWriter : public ArchiveFileWriter {
+ public:
+  ColumnarArchiveWriter();
+  virtual ~ColumnarArchiveWriter();
+  virtual bool open(const std::string& path);
+  virtual bool write(const SlotRecord& rec);
+  virtual void close(void);
+
+ private:
+  template <typename T>
+  struct SlotColumns {
+    std::vector<std::vector<uint32_t>> offsets;
+    std::vector<std::vector<T>> values;
+
+    void reset(uint32_t slot_num) {
+      offsets.resize(slot_num);
+      values.resize(slot_num);
+      for (uint32_t i = 0; i < slot_num; ++i) {
+        offsets[i].assign(1, 0);
+        values[i].clear();
+      }
+    }
+    void add(const SlotValues<T>& rec, uint32_t slot_num) {
+      const T* vals = rec.slot_values.data();
+      for (uint32_t i = 0; i < slot_num; ++i) {
+        values[i].insert(values[i].end(),
+                         vals + rec.slot_offsets[i],
+                         vals + rec.slot_offsets[i + 1]);
+        offsets[i].push_back(static_cast<uint32_t>(values[i].size()));
+      }
+    }
+    size_t value_num(void) const {
+      size_t total = 0;
+      for (auto& v : values) {
+        total += v.size();
+      }
+      return total;
+    }
+  };
+  bool flush_block(void);
+
+ private:
+  std::mutex mutex_;
+  int fd_ = -1;
+  uint32_t ins_num_ = 0;
+  uint32_t uint64_slot_num_ = 0;
+  uint32_t float_slot_num_ = 0;
+  std::vector<uint64_t> search_ids_;
+  std::vector<uint64_t> user_id_signs_;
+  std::vector<uint64_t> cur_timestamps_;
+  std::vector<uint64_t> show_timestamps_;
+  std::vector<uint32_t> ranks_;
+  std::vector<uint32_t> cmatchs_;
+  // ins_id and user_id of record i are [2i, 2i + 1) and [2i + 1, 2i + 2)
+  std::vector<uint32_t> str_offsets_;
+  std::string strs_;
+  SlotColumns<uint64_t> uint64_columns_;
+  SlotColumns<float> float_columns_;
+  std::vector<char> block_buf_;
+};
 class SlotPaddleBoxDataFeed : public DataFeed {
  public:
   SlotPaddleBoxDataFeed() { finish_start_ = false; }
@@ -2286,6 +2621,13 @@ class SlotPaddleBoxDataFeed : public DataFeed {
   int GetPackInstance(SlotRecord** ins);
   int GetPackPvInstance(SlotPvInstance** pv_ins);
   void SetSlotRecordPool(SlotObjPool* pool) { slot_pool_ = pool; }
+  // stage counters of the dataset, the reader adds the records and bytes of
+  // every loaded file and the batches it feeds
+  void SetPipelineStat(PipelineStageStat* read_stat,
+                       PipelineStageStat* feed_stat) {
+    read_stat_ = read_stat;
+    feed_stat_ = feed_stat;
+  }
 
  public:
   virtual void Init(const DataFeedDesc& data_feed_desc);
@@ -2316,6 +2658,8 @@ class SlotPaddleBoxDataFeed : public DataFeed {
   virtual void LoadIntoMemoryByFile(void);
   // load local archive file
   virtual void LoadIntoMemoryByArchive(void);
+  // load local columnar archive file by mmap
+  int LoadColumnarArchiveFile(const std::string& filename);
 
  private:
   void CalRankOffsetCPU(const SlotPvInstance* pv_vec, int pv_num, int ins_number, 
@@ -2393,6 +2737,7 @@ class SlotPaddleBoxDataFeed : public DataFeed {
   std::vector<AllSlotInfo> all_slots_info_;
   std::vector<UsedSlotInfo> used_slots_info_;
   std::string parser_so_path_;
+  std::unique_ptr<SlotTextParser> text_parser_ = nullptr;
 
   platform::Timer next_timer_;
   platform::Timer batch_timer_;
@@ -2402,6 +2747,8 @@ class SlotPaddleBoxDataFeed : public DataFeed {
   platform::Timer trans_timer_;
   platform::Timer copy_timer_;
   SlotObjPool* slot_pool_ = nullptr;
+  PipelineStageStat* read_stat_ = nullptr;
+  PipelineStageStat* feed_stat_ = nullptr;
 };
 
 class SlotPaddleBoxDataFeedWithGpuReplicaCache : public SlotPaddleBoxDataFeed {
@@ -0,0 +1,386 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PADDLE_SLOT_TEXT_SIMD
+#endif
+
+namespace paddle {
+namespace framework {
+
+/**
+ * @Brief slot text line layout: "num v1 ... vnum num v1 ..." for every
+ * slot, slot type is 'u'(uint64) or 'f'(float), unused slots are skipped
+ */
+struct SlotTextLayout {
+  struct Slot {
+    char type = 0;           // 'u', 'f'
+    bool used = false;       // parse value or skip
+    bool dense = false;      // dense slot keeps zero values
+    int value_idx = -1;      // index in float/uint64 feasigns
+  };
+  std::vector<Slot> slots;
+  int float_slot_num = 0;
+  int uint64_slot_num = 0;
+};
+
+/**
+ * @Brief parsed slot values of one line, reused across lines to avoid
+ * reallocation
+ */
+struct SlotTextFeasigns {
+  std::vector<std::vector<float>> float_feasigns;
+  std::vector<std::vector<uint64_t>> uint64_feasigns;
+  int float_total_num = 0;
+  int uint64_total_num = 0;
+  // delimiter positions, scratch of the vector path
+  std::vector<uint32_t> delims;
+
+  void Reset(const SlotTextLayout& layout) {
+    float_feasigns.resize(layout.float_slot_num);
+    uint64_feasigns.resize(layout.uint64_slot_num);
+    for (auto& fea : float_feasigns) {
+      fea.clear();
+    }
+    for (auto& fea : uint64_feasigns) {
+      fea.clear();
+    }
+    float_total_num = 0;
+    uint64_total_num = 0;
+  }
+};
+
+namespace slot_text {
+
+// scalar reference, same conversion as strtol/strtoull/strtof line parsing
+inline bool ParseFeasignsScalar(const char* str, size_t len,
+                                const SlotTextLayout& layout,
+                                SlotTextFeasigns* out) {
+  out->Reset(layout);
+  const char* end = str + len;
+  char* endptr = const_cast<char*>(str);
+  for (auto& slot : layout.slots) {
+    const char* beg = endptr;
+    int num = static_cast<int>(strtol(beg, &endptr, 10));
+    if (num <= 0 || endptr == beg || endptr > end) {
+      return false;
+    }
+    if (!slot.used) {
+      for (int j = 0; j < num; ++j) {
+        while (endptr < end && *endptr == ' ') {
+          ++endptr;
+        }
+        while (endptr < end && *endptr != ' ') {
+          ++endptr;
+        }
+      }
+    } else if (slot.type == 'f') {
+      auto& slot_fea = out->float_feasigns[slot.value_idx];
+      for (int j = 0; j < num; ++j) {
+        float feasign = strtof(endptr, &endptr);
+        if (fabs(feasign) < 1e-6 && !slot.dense) {
+          continue;
+        }
+        slot_fea.push_back(feasign);
+        ++out->float_total_num;
+      }
+    } else {
+      auto& slot_fea = out->uint64_feasigns[slot.value_idx];
+      for (int j = 0; j < num; ++j) {
+        uint64_t feasign = static_cast<uint64_t>(strtoull(endptr, &endptr, 10));
+        if (feasign == 0 && !slot.dense) {
+          continue;
+        }
+        slot_fea.push_back(feasign);
+        ++out->uint64_total_num;
+      }
+    }
+    if (endptr > end) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// collect the positions of ' ' in [0, len), out must hold len entries
+inline size_t FindSpacesScalar(const char* p, size_t len, uint32_t* out) {
+  size_t n = 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (p[i] == ' ') {
+      out[n++] = static_cast<uint32_t>(i);
+    }
+  }
+  return n;
+}
+
+#ifdef PADDLE_SLOT_TEXT_SIMD
+inline size_t FindSpacesSSE(const char* p, size_t len, uint32_t* out) {
+  const __m128i sp = _mm_set1_epi8(' ');
+  size_t n = 0;
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    uint32_t mask =
+        static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(c, sp)));
+    while (mask) {
+      out[n++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  for (; i < len; ++i) {
+    if (p[i] == ' ') {
+      out[n++] = static_cast<uint32_t>(i);
+    }
+  }
+  return n;
+}
+
+__attribute__((target("avx2"))) inline size_t FindSpacesAVX2(const char* p,
+                                                             size_t len,
+                                                             uint32_t* out) {
+  const __m256i sp = _mm256_set1_epi8(' ');
+  size_t n = 0;
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+    uint32_t mask =
+        static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(c, sp)));
+    while (mask) {
+      out[n++] = static_cast<uint32_t>(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+  for (; i < len; ++i) {
+    if (p[i] == ' ') {
+      out[n++] = static_cast<uint32_t>(i);
+    }
+  }
+  return n;
+}
+#endif
+
+inline size_t FindSpaces(const char* p, size_t len, uint32_t* out) {
+#ifdef PADDLE_SLOT_TEXT_SIMD
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    return FindSpacesAVX2(p, len, out);
+  }
+  return FindSpacesSSE(p, len, out);
+#else
+  return FindSpacesScalar(p, len, out);
+#endif
+}
+
+// convert eight ascii digits at once, returns false if any is not a digit
+inline bool ParseEightDigits(const char* p, uint64_t* val) {
+  uint64_t v = 0;
+  memcpy(&v, p, sizeof(v));
+  if (((v & 0xF0F0F0F0F0F0F0F0ULL) |
+       (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) !=
+      0x3333333333333333ULL) {
+    return false;
+  }
+  v -= 0x3030303030303030ULL;
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+       (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >>
+      32;
+  *val = v;
+  return true;
+}
+
+// plain decimal token to uint64, false on non digit or overflow
+inline bool ParseUint64Token(const char* p, size_t len, uint64_t* val) {
+  if (len == 0 || len > 20) {
+    return false;
+  }
+  size_t head = (len > 19) ? 19 : len;
+  uint64_t v = 0;
+  size_t i = 0;
+  for (; i + 8 <= head; i += 8) {
+    uint64_t digits = 0;
+    if (!ParseEightDigits(p + i, &digits)) {
+      return false;
+    }
+    v = v * 100000000ULL + digits;
+  }
+  for (; i < head; ++i) {
+    uint32_t d = static_cast<uint32_t>(p[i] - '0');
+    if (d > 9) {
+      return false;
+    }
+    v = v * 10 + d;
+  }
+  if (head < len) {
+    uint32_t d = static_cast<uint32_t>(p[head] - '0');
+    if (d > 9 || v > (UINT64_MAX - d) / 10) {
+      return false;
+    }
+    v = v * 10 + d;
+  }
+  *val = v;
+  return true;
+}
+
+// "[-]digits[.digits]" with exactly representable mantissa, correctly
+// rounded like strtof, other forms go to strtof
+inline bool ParseFloatToken(const char* p, size_t len, float* val) {
+  static const float kPow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+  const char* s = p;
+  const char* end = p + len;
+  bool neg = false;
+  if (s < end && *s == '-') {
+    neg = true;
+    ++s;
+  }
+  uint32_t mant = 0;
+  int digits = 0;
+  int frac = -1;
+  for (; s < end; ++s) {
+    uint32_t d = static_cast<uint32_t>(*s - '0');
+    if (d <= 9) {
+      if (++digits > 7) {
+        break;
+      }
+      mant = mant * 10 + d;
+      if (frac >= 0) {
+        ++frac;
+      }
+    } else if (*s == '.' && frac < 0) {
+      frac = 0;
+    } else {
+      break;
+    }
+  }
+  if (s == end && digits > 0) {
+    float f = static_cast<float>(mant);
+    if (frac > 0) {
+      f /= kPow10[frac];
+    }
+    *val = neg ? -f : f;
+    return true;
+  }
+  // exponent, long mantissa, inf/nan: the token is followed by ' ' or '\0'
+  char* endptr = nullptr;
+  *val = strtof(p, &endptr);
+  return endptr == end;
+}
+
+/**
+ * @Brief vector path, index all delimiters of the line first and then convert
+ * tokens in batches; false means the line is not in the plain form and the
+ * caller should use ParseFeasignsScalar, str must be '\0' terminated
+ */
+inline bool ParseFeasignsFast(const char* str, size_t len,
+                              const SlotTextLayout& layout,
+                              SlotTextFeasigns* out) {
+  out->Reset(layout);
+  auto& delims = out->delims;
+  if (delims.size() < len + 1) {
+    delims.resize(len + 1);
+  }
+  size_t delim_num = FindSpaces(str, len, delims.data());
+  delims[delim_num] = static_cast<uint32_t>(len);
+
+  size_t di = 0;
+  size_t tok_beg = 0;
+  // next non empty token [*beg, *beg + *tlen)
+  auto next_token = [&](const char** beg, size_t* tlen) {
+    while (di <= delim_num) {
+      size_t tok_end = delims[di++];
+      size_t start = tok_beg;
+      tok_beg = tok_end + 1;
+      if (tok_end > start) {
+        *beg = str + start;
+        *tlen = tok_end - start;
+        return true;
+      }
+    }
+    return false;
+  };
+
+  const char* tok = nullptr;
+  size_t tlen = 0;
+  for (auto& slot : layout.slots) {
+    uint64_t num = 0;
+    if (!next_token(&tok, &tlen) || !ParseUint64Token(tok, tlen, &num) ||
+        num == 0 || num > len) {
+      return false;
+    }
+    if (!slot.used) {
+      for (uint64_t j = 0; j < num; ++j) {
+        if (!next_token(&tok, &tlen)) {
+          return false;
+        }
+      }
+    } else if (slot.type == 'f') {
+      auto& slot_fea = out->float_feasigns[slot.value_idx];
+      for (uint64_t j = 0; j < num; ++j) {
+        float feasign = 0;
+        if (!next_token(&tok, &tlen) || !ParseFloatToken(tok, tlen, &feasign)) {
+          return false;
+        }
+        if (fabs(feasign) < 1e-6 && !slot.dense) {
+          continue;
+        }
+        slot_fea.push_back(feasign);
+        ++out->float_total_num;
+      }
+    } else {
+      auto& slot_fea = out->uint64_feasigns[slot.value_idx];
+      slot_fea.reserve(slot_fea.size() + num);
+      for (uint64_t j = 0; j < num; ++j) {
+        uint64_t feasign = 0;
+        if (!next_token(&tok, &tlen) ||
+            !ParseUint64Token(tok, tlen, &feasign)) {
+          return false;
+        }
+        if (feasign == 0 && !slot.dense) {
+          continue;
+        }
+        slot_fea.push_back(feasign);
+        ++out->uint64_total_num;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace slot_text
+
+/**
+ * @Brief parse slot values of one line, vector path first and scalar path
+ * when the line has forms the vector path does not handle
+ */
+inline bool ParseSlotTextFeasigns(const char* str, size_t len,
+                                  const SlotTextLayout& layout,
+                                  SlotTextFeasigns* out) {
+  if (slot_text::ParseFeasignsFast(str, len, layout, out)) {
+    return true;
+  }
+  return slot_text::ParseFeasignsScalar(str, len, layout, out);
+}
+
+}  // namespace framework
+}  // namespace paddle
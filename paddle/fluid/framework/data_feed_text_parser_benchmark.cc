@@ -0,0 +1,127 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <chrono>  // NOLINT
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/framework/data_feed_text_parser.h"
+
+DEFINE_int32(slot_num, 1000, "slot number of every line.");
+DEFINE_int32(max_feasign_num, 8, "max feasign number of every slot.");
+DEFINE_int32(float_slot_step, 20, "every step slots has one float slot.");
+DEFINE_int32(line_num, 20000, "line number of the corpus.");
+DEFINE_int32(repeat, 5, "repeat times.");
+
+using paddle::framework::SlotTextFeasigns;
+using paddle::framework::SlotTextLayout;
+
+static SlotTextLayout MakeLayout() {
+  SlotTextLayout layout;
+  for (int i = 0; i < FLAGS_slot_num; ++i) {
+    SlotTextLayout::Slot slot;
+    slot.used = true;
+    if (i % FLAGS_float_slot_step == 0) {
+      slot.type = 'f';
+      slot.value_idx = layout.float_slot_num++;
+    } else {
+      slot.type = 'u';
+      slot.value_idx = layout.uint64_slot_num++;
+    }
+    layout.slots.push_back(slot);
+  }
+  return layout;
+}
+
+static std::vector<std::string> MakeCorpus(const SlotTextLayout& layout) {
+  std::mt19937_64 rng(0);
+  std::vector<std::string> lines(FLAGS_line_num);
+  for (auto& line : lines) {
+    for (auto& slot : layout.slots) {
+      int num = 1 + rng() % FLAGS_max_feasign_num;
+      line += std::to_string(num);
+      for (int j = 0; j < num; ++j) {
+        line += ' ';
+        if (slot.type == 'f') {
+          line += std::to_string(static_cast<int>(rng() % 100000) / 1000.0)
+                      .substr(0, 6);
+        } else {
+          line += std::to_string(rng());
+        }
+      }
+      line += ' ';
+    }
+    line.pop_back();
+  }
+  return lines;
+}
+
+template <typename ParseFunc>
+static double Bench(const std::vector<std::string>& lines,
+                    const SlotTextLayout& layout, ParseFunc func,
+                    size_t* feasign_num) {
+  SlotTextFeasigns out;
+  double best = 0;
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    size_t num = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto& line : lines) {
+      CHECK(func(line.c_str(), line.size(), layout, &out));
+      num += out.uint64_total_num + out.float_total_num;
+    }
+    double cost = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    if (r == 0 || cost < best) {
+      best = cost;
+    }
+    *feasign_num = num;
+  }
+  return best;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  SlotTextLayout layout = MakeLayout();
+  std::vector<std::string> lines = MakeCorpus(layout);
+  size_t bytes = 0;
+  for (auto& line : lines) {
+    bytes += line.size();
+  }
+  LOG(INFO) << "corpus lines: " << lines.size() << ", slots: "
+            << FLAGS_slot_num << ", size: " << bytes / 1024.0 / 1024.0
+            << " MB";
+
+  size_t scalar_num = 0;
+  size_t fast_num = 0;
+  double scalar = Bench(lines, layout,
+                        paddle::framework::slot_text::ParseFeasignsScalar,
+                        &scalar_num);
+  double fast = Bench(lines, layout, paddle::framework::ParseSlotTextFeasigns,
+                      &fast_num);
+  CHECK_EQ(scalar_num, fast_num);
+
+  LOG(INFO) << "scalar parser: " << scalar << " s, "
+            << bytes / scalar / 1024 / 1024 << " MB/s, "
+            << lines.size() / scalar << " lines/s";
+  LOG(INFO) << "vector parser: " << fast << " s, "
+            << bytes / fast / 1024 / 1024 << " MB/s, "
+            << lines.size() / fast << " lines/s, speedup " << scalar / fast;
+  return 0;
+}
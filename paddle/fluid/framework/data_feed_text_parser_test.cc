@@ -0,0 +1,127 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/data_feed_text_parser.h"
+
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace framework {
+
+static SlotTextLayout MakeLayout(int slot_num) {
+  SlotTextLayout layout;
+  for (int i = 0; i < slot_num; ++i) {
+    SlotTextLayout::Slot slot;
+    slot.type = (i % 10 == 0) ? 'f' : 'u';
+    slot.used = (i % 7 != 3);
+    slot.dense = (i % 13 == 0);
+    if (slot.used) {
+      slot.value_idx = (slot.type == 'f') ? layout.float_slot_num++
+                                          : layout.uint64_slot_num++;
+    }
+    layout.slots.push_back(slot);
+  }
+  return layout;
+}
+
+static void ExpectSame(const SlotTextFeasigns& a, const SlotTextFeasigns& b) {
+  EXPECT_EQ(a.float_total_num, b.float_total_num);
+  EXPECT_EQ(a.uint64_total_num, b.uint64_total_num);
+  ASSERT_EQ(a.float_feasigns.size(), b.float_feasigns.size());
+  ASSERT_EQ(a.uint64_feasigns.size(), b.uint64_feasigns.size());
+  for (size_t i = 0; i < a.float_feasigns.size(); ++i) {
+    EXPECT_EQ(a.float_feasigns[i], b.float_feasigns[i]);
+  }
+  for (size_t i = 0; i < a.uint64_feasigns.size(); ++i) {
+    EXPECT_EQ(a.uint64_feasigns[i], b.uint64_feasigns[i]);
+  }
+}
+
+TEST(SlotTextParser, Tokens) {
+  uint64_t u = 0;
+  EXPECT_TRUE(slot_text::ParseUint64Token("0", 1, &u));
+  EXPECT_EQ(u, 0UL);
+  EXPECT_TRUE(slot_text::ParseUint64Token("1234567890123", 13, &u));
+  EXPECT_EQ(u, 1234567890123UL);
+  EXPECT_TRUE(slot_text::ParseUint64Token("18446744073709551615", 20, &u));
+  EXPECT_EQ(u, 18446744073709551615UL);
+  EXPECT_FALSE(slot_text::ParseUint64Token("18446744073709551616", 20, &u));
+  EXPECT_FALSE(slot_text::ParseUint64Token("12345a78", 8, &u));
+  EXPECT_FALSE(slot_text::ParseUint64Token("-1", 2, &u));
+
+  float f = 0;
+  EXPECT_TRUE(slot_text::ParseFloatToken("0.1", 3, &f));
+  EXPECT_EQ(f, strtof("0.1", nullptr));
+  EXPECT_TRUE(slot_text::ParseFloatToken("-12.375", 7, &f));
+  EXPECT_EQ(f, -12.375f);
+  EXPECT_TRUE(slot_text::ParseFloatToken("1e-3", 4, &f));
+  EXPECT_EQ(f, strtof("1e-3", nullptr));
+  EXPECT_TRUE(slot_text::ParseFloatToken("123456789.123", 13, &f));
+  EXPECT_EQ(f, strtof("123456789.123", nullptr));
+  EXPECT_FALSE(slot_text::ParseFloatToken("1.2.3", 5, &f));
+}
+
+TEST(SlotTextParser, SameAsScalar) {
+  const char* floats[] = {"0.5", "-1.25", "3",  "1e-3", "0",
+                          "1.5e8", "0.000001", "7.", "-0", "0.3333333"};
+  SlotTextLayout layout = MakeLayout(200);
+  std::mt19937_64 rng(0);
+  SlotTextFeasigns fast;
+  SlotTextFeasigns scalar;
+  for (int l = 0; l < 200; ++l) {
+    std::string line;
+    for (auto& slot : layout.slots) {
+      int num = 1 + rng() % 5;
+      line += std::to_string(num);
+      for (int j = 0; j < num; ++j) {
+        line += (l % 20 == 1 && j == 0) ? "  " : " ";
+        if (slot.type == 'f') {
+          line += floats[rng() % 10];
+        } else {
+          uint64_t v = rng();
+          int k = rng() % 4;
+          if (k == 0) {
+            v = 0;
+          } else if (k == 1) {
+            v %= 100000;
+          }
+          line += std::to_string(v);
+        }
+      }
+      line += ' ';
+    }
+    line.pop_back();
+    if (l % 50 == 7) {
+      // malformed token, the vector path gives up
+      line[line.size() / 2] = 'x';
+    }
+    bool ret = ParseSlotTextFeasigns(line.c_str(), line.size(), layout, &fast);
+    EXPECT_EQ(ret, slot_text::ParseFeasignsScalar(line.c_str(), line.size(),
+                                                  layout, &scalar));
+    ExpectSame(fast, scalar);
+  }
+}
+
+TEST(SlotTextParser, ZeroCount) {
+  SlotTextLayout layout = MakeLayout(2);
+  SlotTextFeasigns out;
+  std::string line = "1 0.5 0";
+  EXPECT_FALSE(ParseSlotTextFeasigns(line.c_str(), line.size(), layout, &out));
+}
+
+}  // namespace framework
+}  // namespace paddle
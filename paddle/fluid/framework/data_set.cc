@@ -37,6 +37,7 @@
 #endif
 
 USE_INT_STAT(STAT_total_feasign_num_in_mem);
+USE_INT_STAT(STAT_slotrecord_arena_saved_bytes);
 DECLARE_bool(graph_get_neighbor_id);
 DECLARE_bool(dump_pv_ins);
 DECLARE_bool(padbox_dataset_enable_unrollinstance);
@@ -44,6 +45,8 @@ DECLARE_bool(compute_batch_by_seq_length);
 DECLARE_int32(pv_max_batch_size);
 DECLARE_bool(enable_pv_merge_in_update);
 DECLARE_bool(enable_update_filter_ins);
+DECLARE_bool(padbox_archive_columnar_format);
+DECLARE_bool(padbox_slotrecord_arena);
 PADDLE_DEFINE_EXPORTED_bool(enable_update_filter_ins,
                             false,
                             "paddle disable ins shuffle ,default false");
@@ -65,6 +68,11 @@ PADDLE_DEFINE_EXPORTED_int32(
     pv_max_batch_size,
     -1,
     "paddle compute batch by pv_size and max_batch_size, -1 means no work");
+PADDLE_DEFINE_EXPORTED_int32(
+    padbox_dataset_merge_dedup_size,
+    0,
+    "keys deduplicated by every merge thread before they are added to the "
+    "ps agent, 0 adds the keys of every record, default 0");
 namespace paddle {
 namespace framework {
 
@@ -2102,14 +2110,27 @@ PadBoxSlotDataset::PadBoxSlotDataset() {
 PadBoxSlotDataset::~PadBoxSlotDataset() {}
 // create input channel and output channel
 void PadBoxSlotDataset::CreateChannel() {
+  // the input channel always has merge or shuffle threads reading while the
+  // readers write, so it can be bounded. The shuffle channel is written by
+  // the rpc server threads, which must not block on a full channel
+  const size_t lock_free_size =
+      static_cast<size_t>(FLAGS_padbox_dataset_lock_free_channel_size);
+  std::lock_guard<std::mutex> lock(channel_mutex_);
   if (input_channel_ == nullptr) {
-    input_channel_ = MakeChannel<SlotRecord>();
+    if (lock_free_size > 0) {
+      input_channel_ = MakeLockFreeChannel<SlotRecord>(lock_free_size);
+    } else {
+      input_channel_ = MakeChannel<SlotRecord>();
+    }
     input_channel_->SetBlockSize(OBJPOOL_BLOCK_SIZE);
   }
   if (shuffle_channel_ == nullptr) {
     shuffle_channel_ = MakeChannel<SlotRecord>();
     shuffle_channel_->SetBlockSize(OBJPOOL_BLOCK_SIZE);
   }
+  if (shuffle_block_channel_ == nullptr) {
+    shuffle_block_channel_ = MakeChannel<ShuffleBlockPtr>();
+  }
 }
 // set filelist, file_idx_ will reset to zero.
 void PadBoxSlotDataset::SetFileList(const std::vector<std::string>& filelist) {
@@ -2246,16 +2267,23 @@ void PadBoxSlotDataset::PreLoadIntoDisk(const std::string& path,
   pass_id_ = BoxWrapper::GetInstance()->GetRoundId();
 
   CheckDownThreadPool();
+  ResetPipelineStat();
   binary_files_.resize(file_num);
 
   total_ins_num_ = 0;
 
   char szpath[1024] = {0};
   for (int k = 0; k < file_num; ++k) {
-    binary_files_[k] = std::make_shared<BinaryArchiveWriter>();
+    if (FLAGS_padbox_archive_columnar_format) {
+      binary_files_[k] = std::make_shared<ColumnarArchiveWriter>();
+    } else {
+      binary_files_[k] = std::make_shared<BinaryArchiveWriter>();
+    }
     snprintf(szpath, sizeof(szpath), "%s/%d", path.c_str(), k);
     CHECK(binary_files_[k]->open(szpath)) << "open failed, path: " << szpath;
   }
+  // dump reads shuffle_channel_ directly
+  shuffle_block_mode_ = false;
   // dualbox global data shuffle
   if (!disable_shuffle_ && mpi_size_ > 1) {
     finished_counter_ = mpi_size_;
@@ -2375,7 +2403,12 @@ void PadBoxSlotDataset::DumpIntoDisk(const Channel<SlotRecord>& in,
 void PadBoxSlotDataset::PreLoadIntoMemory() {
   pass_id_ = BoxWrapper::GetInstance()->GetDataSetId();
   CheckThreadPool();
+  ResetPipelineStat();
   LoadIndexIntoMemory();
+  if (FLAGS_padbox_slotrecord_arena && arena_ == nullptr) {
+    arena_ = std::make_shared<SlotRecordArena>();
+  }
+  shuffle_block_mode_ = (FLAGS_padbox_dataset_shuffle_block_size > 0);
   // dualbox global data shuffle
   if (!disable_shuffle_ && mpi_size_ > 1) {
     finished_counter_ = mpi_size_;
@@ -2392,6 +2425,7 @@ void PadBoxSlotDataset::PreLoadIntoMemory() {
   read_ins_ref_ = read_thread_num;
   for (int64_t i = 0; i < read_thread_num; ++i) {
     wait_futures_.emplace_back(thread_pool_->Run([this, i]() {
+      SlotRecordArenaGuard arena_guard(arena_.get());
       platform::Timer timer;
       timer.Start();
       readers_[i]->LoadIntoMemory();
@@ -2416,7 +2450,13 @@ void PadBoxSlotDataset::PreLoadIntoMemory() {
   // dualbox global data shuffle
   if (!disable_shuffle_ && mpi_size_ > 1) {
     ShuffleData(shuffle_thread_num_);
-    MergeInsKeys(shuffle_channel_);
+    if (shuffle_block_mode_) {
+      MergeInsKeys([this](std::vector<SlotRecord>* datas) {
+        return ReadShuffleBlock(datas);
+      });
+    } else {
+      MergeInsKeys(shuffle_channel_);
+    }
   } else {
     MergeInsKeys(input_channel_);
   }
@@ -2435,6 +2475,7 @@ void PadBoxSlotDataset::WaitPreLoadDone() {
   platform::Timer timeline;
   timeline.Start();
   if (FLAGS_padbox_dataset_enable_unrollinstance) {
+    SlotRecordArenaGuard arena_guard(arena_.get());
     UnrollInstance();
   }
   timeline.Pause();
@@ -2451,41 +2492,130 @@ void PadBoxSlotDataset::LoadIntoMemory() {
   PreLoadIntoMemory();
   WaitPreLoadDone();
 }
+// Feasigns of one merge thread that are not handed to the ps agent yet.
+// Open addressing on a power of two table, the keys are flushed in a block
+// when the table is half full.
+class FeasignDedupSet {
+ public:
+  explicit FeasignDedupSet(size_t capacity) {
+    size_t table_size = 1024;
+    while (table_size < capacity * 2) {
+      table_size <<= 1;
+    }
+    table_.assign(table_size, 0);
+    mask_ = table_size - 1;
+    keys_.reserve(table_size / 2);
+  }
+  // returns true when the set is full and must be flushed
+  bool Insert(uint64_t key) {
+    if (key == 0) {
+      // 0 marks an empty slot
+      if (!has_zero_) {
+        has_zero_ = true;
+        keys_.push_back(key);
+      }
+    } else {
+      size_t pos = Hash(key) & mask_;
+      while (table_[pos] != 0) {
+        if (table_[pos] == key) {
+          return false;
+        }
+        pos = (pos + 1) & mask_;
+      }
+      table_[pos] = key;
+      keys_.push_back(key);
+    }
+    return keys_.size() * 2 >= table_.size();
+  }
+  std::vector<uint64_t>& keys() { return keys_; }
+  void Clear() {
+    std::fill(table_.begin(), table_.end(), 0);
+    keys_.clear();
+    has_zero_ = false;
+  }
+
+ private:
+  static size_t Hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key);
+  }
+
+  std::vector<uint64_t> table_;
+  size_t mask_ = 0;
+  std::vector<uint64_t> keys_;
+  bool has_zero_ = false;
+};
 // add fea keys
 void PadBoxSlotDataset::MergeInsKeys(const Channel<SlotRecord>& in) {
+  CHECK(in != nullptr);
+  MergeInsKeys([in](std::vector<SlotRecord>* datas) {
+    return (in->ReadOnce(*datas, OBJPOOL_BLOCK_SIZE) > 0);
+  });
+}
+void PadBoxSlotDataset::MergeInsKeys(
+    std::function<bool(std::vector<SlotRecord>*)> read_func) {
   merge_ins_ref_ = merge_thread_num_;
   input_records_.clear();
+  merge_thread_records_.clear();
+  merge_thread_records_.resize(merge_thread_num_);
   min_merge_ins_span_ = 1000;
+  merge_stat_.Begin();
   CHECK(p_agent_ != nullptr);
   for (int tid = 0; tid < merge_thread_num_; ++tid) {
-    wait_futures_.emplace_back(merge_pool_->Run([this, &in, tid]() {
+    wait_futures_.emplace_back(merge_pool_->Run([this, read_func, tid]() {
       //      VLOG(0) << "merge thread id: " << tid << "start";
+      SlotRecordArenaGuard arena_guard(arena_.get());
       platform::Timer timer;
       auto feed_obj =
           reinterpret_cast<SlotPaddleBoxDataFeed*>(readers_[0].get());
-      CHECK(feed_obj != nullptr && in != nullptr);
+      CHECK(feed_obj != nullptr);
       size_t num = 0;
       std::vector<SlotRecord> datas;
-      while (in->ReadOnce(datas, OBJPOOL_BLOCK_SIZE)) {
+      auto& records = merge_thread_records_[tid];
+      std::unique_ptr<FeasignDedupSet> dedup = nullptr;
+      if (FLAGS_padbox_dataset_merge_dedup_size > 0) {
+        dedup.reset(new FeasignDedupSet(FLAGS_padbox_dataset_merge_dedup_size));
+      }
+      auto flush_keys = [this, &dedup, tid]() {
+        auto& keys = dedup->keys();
+        if (!keys.empty()) {
+          p_agent_->AddKeys(keys.data(), keys.size(), tid);
+        }
+        dedup->Clear();
+      };
+      while (read_func(&datas)) {
         timer.Resume();
         for (auto& rec : datas) {
           for (auto& idx : used_fea_index_) {
             uint64_t* feas = rec->slot_uint64_feasigns_.get_values(idx, &num);
-            if (num > 0) {
+            if (num == 0) {
+              continue;
+            }
+            if (dedup == nullptr) {
               p_agent_->AddKeys(feas, num, tid);
+              continue;
+            }
+            for (size_t k = 0; k < num; ++k) {
+              if (dedup->Insert(feas[k])) {
+                flush_keys();
+              }
             }
           }
           feed_obj->ExpandSlotRecord(&rec);
         }
 
-        merge_mutex_.lock();
-        for (auto& t : datas) {
-          input_records_.push_back(std::move(t));
-        }
-        merge_mutex_.unlock();
+        records.insert(records.end(), datas.begin(), datas.end());
+        merge_stat_.Add(datas.size(), 0);
         datas.clear();
         timer.Pause();
       }
+      if (dedup != nullptr) {
+        timer.Resume();
+        flush_keys();
+        timer.Pause();
+      }
       datas.shrink_to_fit();
 
       double span = timer.ElapsedSec();
@@ -2495,8 +2625,19 @@ void PadBoxSlotDataset::MergeInsKeys(const Channel<SlotRecord>& in) {
       if (min_merge_ins_span_ > span) {
         min_merge_ins_span_ = span;
       }
-      // end merge thread
+      // end merge thread, the last one splices the records of all threads
       if (--merge_ins_ref_ == 0) {
+        size_t total = 0;
+        for (auto& thread_records : merge_thread_records_) {
+          total += thread_records.size();
+        }
+        input_records_.reserve(total);
+        for (auto& thread_records : merge_thread_records_) {
+          input_records_.insert(input_records_.end(),
+                                thread_records.begin(),
+                                thread_records.end());
+          std::vector<SlotRecord>().swap(thread_records);
+        }
         other_timer_.Pause();
         VLOG(0) << "passid = " << pass_id_ << ", merge thread id: " << tid
                 << ", span time: " << span << ", max:" << max_merge_ins_span_
@@ -2515,15 +2656,25 @@ void PadBoxSlotDataset::ReleaseMemory() {
   platform::Timer timeline;
   timeline.Start();
 
-  if (input_channel_) {
-    input_channel_->Clear();
-    input_channel_ = nullptr;
+  {
+    // GetPipelineStat may be reading the channels
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    if (input_channel_) {
+      input_channel_->Clear();
+      input_channel_ = nullptr;
+    }
+    if (shuffle_channel_) {
+      shuffle_channel_->Clear();
+      shuffle_channel_ = nullptr;
+    }
   }
 
-  if (shuffle_channel_) {
-    shuffle_channel_->Clear();
-    shuffle_channel_ = nullptr;
+  if (shuffle_block_channel_) {
+    shuffle_block_channel_->Clear();
+    shuffle_block_channel_ = nullptr;
   }
+  free_shuffle_blocks_.clear();
+  free_shuffle_blocks_.shrink_to_fit();
 
   readers_.clear();
   readers_.shrink_to_fit();
@@ -2543,6 +2694,13 @@ void PadBoxSlotDataset::ReleaseMemory() {
     filter_input_records_.clear();
     filter_input_records_.shrink_to_fit();
   }
+  // release whole pass records
+  if (arena_ != nullptr) {
+    size_t saved_bytes = arena_->saved_bytes();
+    arena_->release();
+    arena_ = nullptr;
+    STAT_ADD(STAT_slotrecord_arena_saved_bytes, saved_bytes);
+  }
   timeline.Pause();
   VLOG(1) << "DatasetImpl<T>::ReleaseMemory() end, cost time="
           << timeline.ElapsedSec()
@@ -2585,6 +2743,50 @@ class ShuffleResultWaitGroup : public boxps::ResultCallback {
   std::condition_variable cond_;
   int counter_ = 0;
 };
+ShuffleBlockSender::ShuffleBlockSender(int rank_num,
+                                       size_t block_size,
+                                       SendFunc send_func)
+    : block_size_(block_size),
+      send_func_(std::move(send_func)),
+      ars_(rank_num),
+      send_ars_(rank_num),
+      send_wgs_(new ShuffleResultWaitGroup[rank_num]) {}
+ShuffleBlockSender::~ShuffleBlockSender() {}
+size_t ShuffleBlockSender::Add(int rank, const SlotRecord& rec) {
+  auto& ar = ars_[rank];
+  size_t pos = ar.Length();
+  // size prefixed record
+  ar << static_cast<uint32_t>(0);
+  ar << rec;
+  uint32_t len = static_cast<uint32_t>(ar.Length() - pos - sizeof(uint32_t));
+  memcpy(ar.Buffer() + pos, &len, sizeof(len));
+  size_t bytes = ar.Length() - pos;
+  if (ar.Length() >= block_size_) {
+    Send(rank);
+  }
+  return bytes;
+}
+void ShuffleBlockSender::Flush() {
+  for (size_t i = 0; i < ars_.size(); ++i) {
+    if (ars_[i].Length() > 0) {
+      Send(i);
+    }
+  }
+  for (size_t i = 0; i < ars_.size(); ++i) {
+    send_wgs_[i].wait();
+  }
+}
+void ShuffleBlockSender::Send(int rank) {
+  // the previous message of rank still reads send_ars_[rank]
+  send_wgs_[rank].wait();
+  std::swap(ars_[rank], send_ars_[rank]);
+  ars_[rank].Clear();
+  send_wgs_[rank].add(1);
+  send_func_(rank,
+             send_ars_[rank].Buffer(),
+             send_ars_[rank].Length(),
+             &send_wgs_[rank]);
+}
 std::function<uint64_t(const SlotRecord&)>
 PadBoxSlotDataset::general_shuffle_func(void) {
   if (enable_pv_merge_ || FLAGS_enable_shuffle_by_searchid) {  // shuffle by pv
@@ -2611,8 +2813,10 @@ void PadBoxSlotDataset::ShuffleData(int thread_num) {
   VLOG(3) << "start global shuffle threads, num = " << thread_num;
   shuffle_counter_ = thread_num;
   min_shuffle_span_ = 1000;
+  shuffle_stat_.Begin();
   for (int tid = 0; tid < thread_num; ++tid) {
     wait_futures_.emplace_back(shuffle_pool_->Run([this, tid]() {
+      SlotRecordArenaGuard arena_guard(arena_.get());
       platform::Timer timer;
       std::vector<SlotRecord> data;
       std::vector<SlotRecord> loc_datas;
@@ -2625,6 +2829,19 @@ void PadBoxSlotDataset::ShuffleData(int thread_num) {
       auto idx_func = general_shuffle_func();
 
       ShuffleResultWaitGroup wg;
+      std::unique_ptr<ShuffleBlockSender> sender = nullptr;
+      if (shuffle_block_mode_) {
+        sender.reset(new ShuffleBlockSender(
+            mpi_size_,
+            static_cast<size_t>(FLAGS_padbox_dataset_shuffle_block_size),
+            [handler](int rank,
+                      const char* buf,
+                      int len,
+                      boxps::ResultCallback* callback) {
+              handler->send_message_callback(rank, buf, len, callback);
+            }));
+      }
+      size_t send_bytes = 0;
       while (input_channel_->Read(data)) {
         timer.Resume();
         for (auto& t : data) {
@@ -2633,11 +2850,31 @@ void PadBoxSlotDataset::ShuffleData(int thread_num) {
             loc_datas.push_back(std::move(t));
             continue;
           }
-          ars[client_id] << t;
+          if (shuffle_block_mode_) {
+            send_bytes += sender->Add(client_id, t);
+          } else {
+            auto& ar = ars[client_id];
+            size_t pos = ar.Length();
+            ar << t;
+            send_bytes += ar.Length() - pos;
+          }
           releases.push_back(t);
         }
         slot_pool_->put(&releases);
         releases.clear();
+        shuffle_stat_.Add(data.size(), send_bytes);
+        send_bytes = 0;
+        if (shuffle_block_mode_) {
+          if (!loc_datas.empty()) {
+            auto block = GetShuffleBlock();
+            block->records.swap(loc_datas);
+            CHECK(shuffle_block_channel_->Put(std::move(block)));
+          }
+          data.clear();
+          loc_datas.clear();
+          timer.Pause();
+          continue;
+        }
         size_t loc_len = loc_datas.size();
         CHECK(shuffle_channel_->Write(std::move(loc_datas)) == loc_len);
 
@@ -2662,6 +2899,9 @@ void PadBoxSlotDataset::ShuffleData(int thread_num) {
         timer.Pause();
       }
       timer.Resume();
+      if (shuffle_block_mode_) {
+        sender->Flush();
+      }
       wg.wait();
       timer.Pause();
 
@@ -2705,7 +2945,7 @@ void PadBoxSlotDataset::ShuffleData(int thread_num) {
           while (receiver_cnt_ > 0) {
             usleep(100);
           }
-          shuffle_channel_->Close();
+          CloseShuffleChannel();
           LOG(WARNING) << "passid = " << pass_id_
                        << ", ShuffleData rank_id=" << mpi_rank_
                        << " close channel";
@@ -2732,14 +2972,23 @@ void PadBoxSlotDataset::ReceiveSuffleData(int client_id,
       while (receiver_cnt_ > 0) {
         usleep(100);
       }
-      shuffle_channel_->Close();
+      CloseShuffleChannel();
       LOG(WARNING) << "passid = " << pass_id_
                    << ", ReceiveFromClient client_id=" << client_id
                    << " close channel";
     }
     return;
   }
+  // keep the raw message, merge threads decode it
+  if (shuffle_block_mode_) {
+    auto block = GetShuffleBlock();
+    block->buffer.assign(buf, buf + len);
+    CHECK(shuffle_block_channel_->Put(std::move(block)));
+    --receiver_cnt_;
+    return;
+  }
 
+  SlotRecordArenaGuard arena_guard(arena_.get());
   paddle::framework::BinaryArchive ar;
   ar.SetReadBuffer(const_cast<char*>(buf), len, nullptr);
 
@@ -2772,7 +3021,127 @@ void PadBoxSlotDataset::ReceiveSuffleData(int client_id,
   data.shrink_to_fit();
   --receiver_cnt_;
 }
+void PadBoxSlotDataset::CloseShuffleChannel(void) {
+  if (shuffle_block_mode_) {
+    shuffle_block_channel_->Close();
+  } else {
+    shuffle_channel_->Close();
+  }
+}
+PadBoxSlotDataset::ShuffleBlockPtr PadBoxSlotDataset::GetShuffleBlock(void) {
+  std::lock_guard<std::mutex> lock(shuffle_block_mutex_);
+  if (free_shuffle_blocks_.empty()) {
+    return std::make_shared<ShuffleBlock>();
+  }
+  auto block = std::move(free_shuffle_blocks_.back());
+  free_shuffle_blocks_.pop_back();
+  return block;
+}
+void PadBoxSlotDataset::PutShuffleBlock(ShuffleBlockPtr&& block) {
+  // keep the buffer capacity for the next message
+  block->records.clear();
+  block->buffer.clear();
+  std::lock_guard<std::mutex> lock(shuffle_block_mutex_);
+  free_shuffle_blocks_.push_back(std::move(block));
+}
+void PadBoxSlotDataset::DecodeShuffleBlock(const std::vector<char>& buffer,
+                                           std::vector<SlotRecord>* records) {
+  const char* begin = buffer.data();
+  const char* end = begin + buffer.size();
+  size_t num = 0;
+  uint32_t len = 0;
+  for (const char* p = begin; p < end; p += len) {
+    CHECK(static_cast<size_t>(end - p) >= sizeof(len));
+    memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    ++num;
+  }
+  slot_pool_->get(records, num);
+
+  paddle::framework::BinaryArchive ar;
+  const char* p = begin;
+  for (size_t i = 0; i < num; ++i) {
+    memcpy(&len, p, sizeof(len));
+    p += sizeof(len);
+    CHECK(static_cast<size_t>(end - p) >= len);
+    ar.SetReadBuffer(const_cast<char*>(p), len, nullptr);
+    ar >> (*records)[i];
+    CHECK(ar.Cursor() == ar.Finish()) << "shuffle record size mismatch";
+    p += len;
+  }
+}
+bool PadBoxSlotDataset::ReadShuffleBlock(std::vector<SlotRecord>* records) {
+  ShuffleBlockPtr block = nullptr;
+  while (shuffle_block_channel_->Get(block)) {
+    if (block->buffer.empty()) {
+      records->swap(block->records);
+    } else {
+      DecodeShuffleBlock(block->buffer, records);
+    }
+    PutShuffleBlock(std::move(block));
+    if (!records->empty()) {
+      return true;
+    }
+  }
+  return false;
+}
 // create readers
+void PadBoxSlotDataset::ResetPipelineStat(void) {
+  read_stat_.Reset();
+  merge_stat_.Reset();
+  shuffle_stat_.Reset();
+  read_stat_.Begin();
+  if (input_channel_ != nullptr) {
+    input_channel_->ResetWaitStat();
+  }
+  if (shuffle_channel_ != nullptr) {
+    shuffle_channel_->ResetWaitStat();
+  }
+}
+std::map<std::string, double> PadBoxSlotDataset::GetPipelineStat() {
+  std::map<std::string, double> stat;
+  auto add_stage = [&stat](const std::string& name,
+                           const PipelineStageStat& stage) {
+    double records = static_cast<double>(stage.records());
+    double bytes = static_cast<double>(stage.bytes());
+    double seconds = stage.seconds();
+    stat[name + ".records"] = records;
+    stat[name + ".bytes"] = bytes;
+    stat[name + ".seconds"] = seconds;
+    stat[name + ".records_per_sec"] = seconds > 0 ? records / seconds : 0;
+    stat[name + ".bytes_per_sec"] = seconds > 0 ? bytes / seconds : 0;
+  };
+  add_stage("read", read_stat_);
+  add_stage("merge", merge_stat_);
+  add_stage("shuffle", shuffle_stat_);
+  add_stage("feed", feed_stat_);
+  auto add_channel = [&stat](const std::string& name,
+                             const Channel<SlotRecord>& chan) {
+    if (chan == nullptr) {
+      return;
+    }
+    stat[name + ".size"] = static_cast<double>(chan->Size());
+    stat[name + ".read_wait_sec"] = chan->ReadWaitSec();
+    stat[name + ".write_wait_sec"] = chan->WriteWaitSec();
+  };
+  Channel<SlotRecord> input_channel;
+  Channel<SlotRecord> shuffle_channel;
+  {
+    // the snapshot keeps the channels of a concurrent ReleaseMemory alive
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    input_channel = input_channel_;
+    shuffle_channel = shuffle_channel_;
+  }
+  add_channel("input_channel", input_channel);
+  add_channel("shuffle_channel", shuffle_channel);
+  if (slot_pool_ != nullptr) {
+    stat["slot_pool.hit"] = static_cast<double>(slot_pool_->hit_count());
+    stat["slot_pool.miss"] = static_cast<double>(slot_pool_->miss_count());
+    stat["slot_pool.arena"] = static_cast<double>(slot_pool_->arena_count());
+    stat["slot_pool.size"] = static_cast<double>(slot_pool_->capacity());
+  }
+  return stat;
+}
 void PadBoxSlotDataset::CreateReaders() {
   VLOG(3) << "Calling CreateReaders()"
           << "thread num in Dataset: " << thread_num_
@@ -2807,6 +3176,10 @@ void PadBoxSlotDataset::CreateReaders() {
     }
     // disk archive file
     readers_[i]->SetLoadArchiveFile(is_archive_file_);
+    auto feed = dynamic_cast<SlotPaddleBoxDataFeed*>(readers_[i].get());
+    if (feed != nullptr) {
+      feed->SetPipelineStat(&read_stat_, &feed_stat_);
+    }
   }
   VLOG(3) << "readers size: " << readers_.size();
 }
@@ -2857,6 +3230,123 @@ static void compute_split_num_and_mask(
 
 // merge pv instance
 
+// runs func(tid) for tid in [0, thread_num) on pool and waits for all
+static void RunParallel(paddle::framework::ThreadPool* pool,
+                        int thread_num,
+                        const std::function<void(int)>& func) {
+  if (pool == nullptr || thread_num <= 1) {
+    for (int tid = 0; tid < thread_num; ++tid) {
+      func(tid);
+    }
+    return;
+  }
+  std::vector<std::future<void>> futures;
+  futures.reserve(thread_num);
+  for (int tid = 0; tid < thread_num; ++tid) {
+    futures.emplace_back(pool->Run([&func, tid]() { func(tid); }));
+  }
+  for (auto& f : futures) {
+    f.get();
+  }
+}
+// the sort key is copied next to the record, so sorting never touches the
+// records themselves
+struct SortRecordKey {
+  uint64_t key;
+  SlotRecord rec;
+};
+// stable LSD radix sort on 8 bit digits, every pass counts the digits of each
+// thread's chunk and scatters the chunks to their precomputed offsets. Passes
+// where all keys share the digit are skipped.
+static void ParallelRadixSort(std::vector<SortRecordKey>* items,
+                              paddle::framework::ThreadPool* pool,
+                              int thread_num) {
+  const size_t num = items->size();
+  const int kDigitBits = 8;
+  const int kBuckets = 1 << kDigitBits;
+  const int kPasses = 64 / kDigitBits;
+  if (num < 2) {
+    return;
+  }
+  if (num < static_cast<size_t>(thread_num) * kBuckets * 16) {
+    thread_num = 1;
+  }
+  auto chunk_begin = [num, thread_num](int tid) {
+    return num * tid / thread_num;
+  };
+  // digits of all passes from one read, to find the passes to skip
+  std::vector<std::vector<size_t>> totals(
+      thread_num, std::vector<size_t>(kPasses * kBuckets, 0));
+  RunParallel(pool, thread_num, [&](int tid) {
+    auto& count = totals[tid];
+    for (size_t i = chunk_begin(tid); i < chunk_begin(tid + 1); ++i) {
+      uint64_t key = (*items)[i].key;
+      for (int pass = 0; pass < kPasses; ++pass) {
+        ++count[pass * kBuckets + ((key >> (pass * kDigitBits)) & 0xFF)];
+      }
+    }
+  });
+  std::vector<SortRecordKey> buffer(num);
+  std::vector<SortRecordKey>* src = items;
+  std::vector<SortRecordKey>* dst = &buffer;
+  std::vector<std::vector<size_t>> offsets(thread_num,
+                                           std::vector<size_t>(kBuckets, 0));
+  for (int pass = 0; pass < kPasses; ++pass) {
+    const int shift = pass * kDigitBits;
+    bool skip = false;
+    for (int d = 0; d < kBuckets && !skip; ++d) {
+      size_t total = 0;
+      for (int tid = 0; tid < thread_num; ++tid) {
+        total += totals[tid][pass * kBuckets + d];
+      }
+      skip = (total == num);
+    }
+    if (skip) {
+      continue;
+    }
+    RunParallel(pool, thread_num, [&](int tid) {
+      auto& count = offsets[tid];
+      std::fill(count.begin(), count.end(), 0);
+      for (size_t i = chunk_begin(tid); i < chunk_begin(tid + 1); ++i) {
+        ++count[((*src)[i].key >> shift) & 0xFF];
+      }
+    });
+    size_t pos = 0;
+    for (int d = 0; d < kBuckets; ++d) {
+      for (int tid = 0; tid < thread_num; ++tid) {
+        size_t count = offsets[tid][d];
+        offsets[tid][d] = pos;
+        pos += count;
+      }
+    }
+    RunParallel(pool, thread_num, [&](int tid) {
+      auto& offset = offsets[tid];
+      for (size_t i = chunk_begin(tid); i < chunk_begin(tid + 1); ++i) {
+        const SortRecordKey& item = (*src)[i];
+        (*dst)[offset[(item.key >> shift) & 0xFF]++] = item;
+      }
+    });
+    std::swap(src, dst);
+  }
+  if (src != items) {
+    items->swap(buffer);
+  }
+}
+// splits [0, num) into thread_num ranges that begin at group heads, so a
+// group is never split between threads
+static std::vector<size_t> SplitGroupRanges(
+    size_t num, int thread_num, const std::function<bool(size_t)>& is_head) {
+  std::vector<size_t> bounds(thread_num + 1, num);
+  bounds[0] = 0;
+  for (int tid = 1; tid < thread_num; ++tid) {
+    size_t pos = std::max(num * tid / thread_num, bounds[tid - 1]);
+    while (pos < num && !is_head(pos)) {
+      ++pos;
+    }
+    bounds[tid] = pos;
+  }
+  return bounds;
+}
 // merge pv instance
 void PadBoxSlotDataset::PreprocessInstance() {
   if (input_records_.empty()) {
@@ -2877,103 +3367,164 @@ void PadBoxSlotDataset::PreprocessInstance() {
   }
 
   size_t all_records_num = input_records_.size();
-  if (merge_by_uid_){
-    std::sort(input_records_.begin(), input_records_.end(),
-              [](const SlotRecord& lhs, const SlotRecord& rhs) {
-                return lhs->user_id_sign_ < rhs->user_id_sign_ ||
-                       lhs->user_id_sign_ == rhs->user_id_sign_ && lhs->user_id_ < rhs->user_id_ ||
-                       lhs->user_id_sign_ == rhs->user_id_sign_ && lhs->user_id_ == rhs->user_id_ && lhs->show_timestamp_ < rhs->show_timestamp_;
-            }
-    );
-    merge_by_sid_ = false;
-  }
-  else {
-    std::sort(input_records_.data(), input_records_.data() + all_records_num,
-              [](const SlotRecord& lhs, const SlotRecord& rhs) {
-                return lhs->search_id < rhs->search_id;
-              });
+  int thread_num = std::max(merge_thread_num_, 1);
+  auto chunk_begin = [all_records_num, thread_num](int tid) {
+    return all_records_num * tid / thread_num;
+  };
+  {
+    // sort (key, record) pairs instead of dereferencing records in compare
+    std::vector<SortRecordKey> keys(all_records_num);
+    RunParallel(merge_pool_, thread_num, [&](int tid) {
+      for (size_t i = chunk_begin(tid); i < chunk_begin(tid + 1); ++i) {
+        auto& rec = input_records_[i];
+        keys[i].key = merge_by_uid_ ? rec->user_id_sign_ : rec->search_id;
+        keys[i].rec = rec;
+      }
+    });
+    ParallelRadixSort(&keys, merge_pool_, thread_num);
+    if (merge_by_uid_) {
+      // records of the same sign are ordered by user id and show time
+      auto bounds = SplitGroupRanges(
+          all_records_num, thread_num, [&keys](size_t i) {
+            return i == 0 || keys[i].key != keys[i - 1].key;
+          });
+      RunParallel(merge_pool_, thread_num, [&](int tid) {
+        size_t begin = bounds[tid];
+        while (begin < bounds[tid + 1]) {
+          size_t end = begin + 1;
+          while (end < all_records_num && keys[end].key == keys[begin].key) {
+            ++end;
+          }
+          if (end - begin > 1) {
+            std::sort(keys.begin() + begin,
+                      keys.begin() + end,
+                      [](const SortRecordKey& lhs, const SortRecordKey& rhs) {
+                        return lhs.rec->user_id_ < rhs.rec->user_id_ ||
+                               lhs.rec->user_id_ == rhs.rec->user_id_ &&
+                                   lhs.rec->show_timestamp_ <
+                                       rhs.rec->show_timestamp_;
+                      });
+          }
+          begin = end;
+        }
+      });
+      merge_by_sid_ = false;
+    }
+    RunParallel(merge_pool_, thread_num, [&](int tid) {
+      for (size_t i = chunk_begin(tid); i < chunk_begin(tid + 1); ++i) {
+        input_records_[i] = keys[i].rec;
+      }
+    });
   }
 
+  // every thread groups a range of whole pvs, the ranges are appended in order
+  std::function<bool(size_t)> is_head = [](size_t i) { return true; };
   if (merge_by_sid_) {
-    uint64_t last_search_id = 0;
-    for (size_t i = 0; i < all_records_num; ++i) {
-      auto& ins = input_records_[i];
-      if (i == 0 || last_search_id != ins->search_id) {
-        SlotPvInstance pv_instance = make_slotpv_instance();
-        pv_instance->merge_instance(ins);
-        input_pv_ins_.push_back(pv_instance);
-        last_search_id = ins->search_id;
-        continue;
-      }
-      input_pv_ins_.back()->merge_instance(ins);
-    }
+    is_head = [this](size_t i) {
+      return i == 0 ||
+             input_records_[i]->search_id != input_records_[i - 1]->search_id;
+    };
   } else if (merge_by_uid_) {
-    size_t i = 0;
-    size_t ins_count = 0;
-    for (i = 0; i < all_records_num; i += ins_count) {
-      std::string now_user_id = input_records_[i]->user_id_;
-      if (invalid_users_.find(now_user_id) != invalid_users_.end()) {
-        SlotPvInstance pv_instance = make_slotpv_instance();
-        input_pv_ins_.push_back(pv_instance);
-        input_pv_ins_.back()->merge_instance(input_records_[i]);
-        ins_count = 1;
-        input_pv_ins_.back()->set_zero_mask_num(0);
-        continue;
+    is_head = [this](size_t i) {
+      return i == 0 ||
+             input_records_[i]->user_id_ != input_records_[i - 1]->user_id_;
+    };
+  }
+  auto bounds = SplitGroupRanges(all_records_num, thread_num, is_head);
+  std::vector<std::vector<SlotPvInstance>> range_pv_ins(thread_num);
+  RunParallel(merge_pool_, thread_num, [&](int tid) {
+    auto& pv_ins = range_pv_ins[tid];
+    const size_t begin = bounds[tid];
+    const size_t end = bounds[tid + 1];
+    if (merge_by_sid_) {
+      uint64_t last_search_id = 0;
+      for (size_t i = begin; i < end; ++i) {
+        auto& ins = input_records_[i];
+        if (i == begin || last_search_id != ins->search_id) {
+          SlotPvInstance pv_instance = make_slotpv_instance();
+          pv_instance->merge_instance(ins);
+          pv_ins.push_back(pv_instance);
+          last_search_id = ins->search_id;
+          continue;
+        }
+        pv_ins.back()->merge_instance(ins);
       }
-      for (ins_count = 1;
-           i + ins_count < all_records_num &&
-           now_user_id == input_records_[i + ins_count]->user_id_;
-           ++ins_count) {
-      }  // get ins count
-      if (merge_by_uid_split_method_ == 1 && merge_by_uid_split_size_ > 0) {
-        SlotPvInstance pv_instance = make_slotpv_instance();
-        input_pv_ins_.push_back(pv_instance);
-        for (size_t j = 0; j < ins_count; ++j) {
-          if (j > 0 && ((ins_count - j) % merge_by_uid_split_size_ == 0)) {
+    } else if (merge_by_uid_) {
+      size_t i = 0;
+      size_t ins_count = 0;
+      for (i = begin; i < end; i += ins_count) {
+        const std::string& now_user_id = input_records_[i]->user_id_;
+        if (invalid_users_.find(now_user_id) != invalid_users_.end()) {
+          SlotPvInstance pv_instance = make_slotpv_instance();
+          pv_ins.push_back(pv_instance);
+          pv_ins.back()->merge_instance(input_records_[i]);
+          ins_count = 1;
+          pv_ins.back()->set_zero_mask_num(0);
+          continue;
+        }
+        for (ins_count = 1;
+             i + ins_count < end &&
+             now_user_id == input_records_[i + ins_count]->user_id_;
+             ++ins_count) {
+        }  // get ins count
+        if (merge_by_uid_split_method_ == 1 && merge_by_uid_split_size_ > 0) {
+          SlotPvInstance pv_instance = make_slotpv_instance();
+          pv_ins.push_back(pv_instance);
+          for (size_t j = 0; j < ins_count; ++j) {
+            if (j > 0 && ((ins_count - j) % merge_by_uid_split_size_ == 0)) {
+              SlotPvInstance pv_instance = make_slotpv_instance();
+              pv_ins.push_back(pv_instance);
+            }
+            pv_ins.back()->merge_instance(input_records_[i + j]);
+          }
+        } else if (merge_by_uid_split_method_ == 2 &&
+                   merge_by_uid_split_size_ > 0 &&
+                   merge_by_uid_split_size_ < ins_count) {
+          std::vector<std::pair<size_t, size_t>> offset;
+          std::vector<int> zero_mask;
+          compute_split_num_and_mask(ins_count,
+                                     merge_by_uid_split_size_,
+                                     merge_by_uid_split_train_size_,
+                                     offset,
+                                     zero_mask);
+          for (size_t j = 0; j < offset.size(); ++j) {
+            const auto& pair = offset[j];
             SlotPvInstance pv_instance = make_slotpv_instance();
-            input_pv_ins_.push_back(pv_instance);
+            pv_ins.push_back(pv_instance);
+            for (size_t j = pair.first; j < pair.second; ++j) {
+              pv_ins.back()->merge_instance(input_records_[i + j]);
+            }
+            pv_ins.back()->set_zero_mask_num(zero_mask[j]);
           }
-          input_pv_ins_.back()->merge_instance(input_records_[i + j]);
-        }
-      } else if (merge_by_uid_split_method_ == 2 &&
-                 merge_by_uid_split_size_ > 0 &&
-                 merge_by_uid_split_size_ < ins_count) {
-        std::vector<std::pair<size_t, size_t>> offset;
-        std::vector<int> zero_mask;
-        compute_split_num_and_mask(ins_count,
-                                   merge_by_uid_split_size_,
-                                   merge_by_uid_split_train_size_,
-                                   offset,
-                                   zero_mask);
-        for (size_t j = 0; j < offset.size(); ++j) {
-          const auto& pair = offset[j];
+          VLOG(1) << "split the seq of " << now_user_id << " into "
+                  << zero_mask.size() << " seqs.";
+        } else {
           SlotPvInstance pv_instance = make_slotpv_instance();
-          input_pv_ins_.push_back(pv_instance);
-          for (size_t j = pair.first; j < pair.second; ++j) {
-            input_pv_ins_.back()->merge_instance(input_records_[i + j]);
+          pv_ins.push_back(pv_instance);
+          for (size_t j = 0; j < ins_count; ++j) {
+            pv_ins.back()->merge_instance(input_records_[i + j]);
           }
-          input_pv_ins_.back()->set_zero_mask_num(zero_mask[j]);
+          pv_ins.back()->set_zero_mask_num(0);
         }
-        VLOG(1) << "split the seq of " << now_user_id << " into "
-                << zero_mask.size() << " seqs.";
-      } else {
+      }
+    } else {
+      for (size_t i = begin; i < end; ++i) {
+        auto& ins = input_records_[i];
         SlotPvInstance pv_instance = make_slotpv_instance();
-        input_pv_ins_.push_back(pv_instance);
-        for (size_t j = 0; j < ins_count; ++j) {
-          input_pv_ins_.back()->merge_instance(input_records_[i + j]);
-        }
-        input_pv_ins_.back()->set_zero_mask_num(0);
+        pv_instance->merge_instance(ins);
+        pv_ins.push_back(pv_instance);
       }
     }
-  } else {
-    for (size_t i = 0; i < all_records_num; ++i) {
-      auto& ins = input_records_[i];
-      SlotPvInstance pv_instance = make_slotpv_instance();
-      pv_instance->merge_instance(ins);
-      input_pv_ins_.push_back(pv_instance);
-    }
+  });
+  size_t all_pv_num = 0;
+  for (auto& pv_ins : range_pv_ins) {
+    all_pv_num += pv_ins.size();
   }
-  
+  input_pv_ins_.reserve(all_pv_num);
+  for (auto& pv_ins : range_pv_ins) {
+    input_pv_ins_.insert(input_pv_ins_.end(), pv_ins.begin(), pv_ins.end());
+  }
+
   if (FLAGS_enable_update_filter_ins){
     for (size_t i = 0; i < all_records_num; ++i) {
       auto& ins = input_records_[i];
@@ -3224,6 +3775,8 @@ void PadBoxSlotDataset::SortPvInsInSameUid(void) {
 // prepare train do something
 void PadBoxSlotDataset::PrepareTrain(void) {
   auto box_ptr = paddle::framework::BoxWrapper::GetInstance();
+  // the next pass may load while this one trains, so feeding is reset here
+  feed_stat_.Reset();
 
   std::vector<std::pair<int, int>> offset;
   // join or aucrunner mode enable pv
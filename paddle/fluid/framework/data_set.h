@@ -17,6 +17,8 @@
 #include <ThreadPool.h>
 
 #include <fstream>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>  // NOLINT
 #include <set>
@@ -35,6 +37,8 @@
 #include "paddle/fluid/framework/threadpool.h"
 DECLARE_int32(padbox_dataset_shuffle_thread_num);
 DECLARE_int32(padbox_dataset_merge_thread_num);
+DECLARE_int32(padbox_dataset_shuffle_block_size);
+DECLARE_int32(padbox_dataset_lock_free_channel_size);
 DECLARE_int32(padbox_max_shuffle_wait_count);
 DECLARE_bool(enable_shuffle_by_searchid);
 DECLARE_bool(padbox_dataset_disable_shuffle);
@@ -43,6 +47,7 @@ DECLARE_bool(enable_update_filter_ins);
 DECLARE_bool(padbox_dataset_disable_random_update);
 namespace boxps {
 class PSAgentBase;
+class ResultCallback;
 }
 namespace paddle {
 namespace framework {
@@ -196,6 +201,8 @@ class Dataset {
   virtual void PreLoadIntoDisk(const std::string& path, const int file_num) = 0;
   virtual void WaitLoadDiskDone(void) = 0;
   virtual void SetLoadArchiveFile(bool archive) = 0;
+  // throughput and stall counters of the loading pipeline
+  virtual std::map<std::string, double> GetPipelineStat() = 0;
 
  protected:
   virtual int ReceiveFromClient(int msg_type,
@@ -333,6 +340,7 @@ class DatasetImpl : public Dataset {
   virtual void PreLoadIntoDisk(const std::string& path, const int file_num) {}
   virtual void WaitLoadDiskDone(void) {}
   virtual void SetLoadArchiveFile(bool archive) {}
+  virtual std::map<std::string, double> GetPipelineStat() { return {}; }
 
  protected:
   virtual int ReceiveFromClient(int msg_type,
@@ -474,6 +482,34 @@ class SlotRecordDataset : public DatasetImpl<SlotRecord> {
 };
 
 #ifdef PADDLE_WITH_BOX_PS
+class ShuffleResultWaitGroup;
+// block mode sender of one shuffle thread. The records of a rank are size
+// prefixed into its archive, which is sent once it holds block_size bytes.
+// Every rank has the filling archive and an in flight one, the in flight one
+// is reused after the callback of its message
+class ShuffleBlockSender {
+ public:
+  typedef std::function<void(
+      int rank, const char* buf, int len, boxps::ResultCallback* callback)>
+      SendFunc;
+  ShuffleBlockSender(int rank_num, size_t block_size, SendFunc send_func);
+  ~ShuffleBlockSender();
+  // returns the bytes rec takes in the block
+  size_t Add(int rank, const SlotRecord& rec);
+  // sends the partial blocks and waits for the callbacks of all messages, so
+  // the close message can follow
+  void Flush();
+
+ private:
+  void Send(int rank);
+
+  size_t block_size_;
+  SendFunc send_func_;
+  std::vector<BinaryArchive> ars_;
+  std::vector<BinaryArchive> send_ars_;
+  std::unique_ptr<ShuffleResultWaitGroup[]> send_wgs_;
+};
+
 class PadBoxSlotDataset : public DatasetImpl<SlotRecord> {
  public:
   PadBoxSlotDataset();
@@ -534,10 +570,19 @@ class PadBoxSlotDataset : public DatasetImpl<SlotRecord> {
   virtual void PreLoadIntoDisk(const std::string& path, const int file_num);
   virtual void WaitLoadDiskDone(void);
   virtual void SetLoadArchiveFile(bool archive) { is_archive_file_ = archive; }
+  // records/bytes per second of every stage, channel wait time and slot pool
+  // hit counts of the current pass, safe to call while loading
+  virtual std::map<std::string, double> GetPipelineStat();
 
  protected:
   // shuffle data
   virtual void ShuffleData(int thread_num = -1);
+  // shuffle block, local records or a raw message of size prefixed records
+  struct ShuffleBlock {
+    std::vector<SlotRecord> records;
+    std::vector<char> buffer;
+  };
+  typedef std::shared_ptr<ShuffleBlock> ShuffleBlockPtr;
 
  public:
   void SetPSAgent(boxps::PSAgentBase* agent) { p_agent_ = agent; }
@@ -567,14 +612,33 @@ class PadBoxSlotDataset : public DatasetImpl<SlotRecord> {
 
  protected:
   void MergeInsKeys(const Channel<SlotRecord>& in);
+  void MergeInsKeys(std::function<bool(std::vector<SlotRecord>*)> read_func);
+  void CloseShuffleChannel(void);
+  ShuffleBlockPtr GetShuffleBlock(void);
+  void PutShuffleBlock(ShuffleBlockPtr&& block);
+  void DecodeShuffleBlock(const std::vector<char>& buffer,
+                          std::vector<SlotRecord>* records);
+  // the records of the next shuffle block, false once the channel is closed
+  // and empty
+  bool ReadShuffleBlock(std::vector<SlotRecord>* records);
   void CheckThreadPool(void);
   void CheckDownThreadPool(void);
   void DumpIntoDisk(const Channel<SlotRecord>& in, const std::string& path,
                     const int pass_num);
   std::function<uint64_t(const SlotRecord&)> general_shuffle_func(void);
+  // clear the load stages and channel wait time at pass start
+  void ResetPipelineStat(void);
 
  protected:
   Channel<SlotRecord> shuffle_channel_ = nullptr;
+  // guards setting input_channel_ and shuffle_channel_ against the reads of
+  // GetPipelineStat from another thread
+  std::mutex channel_mutex_;
+  // block shuffle, receivers keep raw messages and merge threads decode
+  bool shuffle_block_mode_ = false;
+  Channel<ShuffleBlockPtr> shuffle_block_channel_ = nullptr;
+  std::mutex shuffle_block_mutex_;
+  std::vector<ShuffleBlockPtr> free_shuffle_blocks_;
   std::vector<int> mpi_flags_;
   std::atomic<int> finished_counter_{0};
   int mpi_size_ = 1;
@@ -594,7 +658,8 @@ class PadBoxSlotDataset : public DatasetImpl<SlotRecord> {
   double min_merge_ins_span_ = 0;
   std::atomic<int> read_ins_ref_{0};
   std::atomic<int> merge_ins_ref_{0};
-  std::mutex merge_mutex_;
+  // records of every merge thread, spliced into input_records_ at the end
+  std::vector<std::vector<SlotRecord>> merge_thread_records_;
   std::vector<int> used_fea_index_;
   int merge_thread_num_ = FLAGS_padbox_dataset_merge_thread_num;
   paddle::framework::ThreadPool* merge_pool_ = nullptr;
@@ -605,12 +670,19 @@ class PadBoxSlotDataset : public DatasetImpl<SlotRecord> {
   bool disable_shuffle_ = FLAGS_padbox_dataset_disable_shuffle;
   bool disable_polling_ = FLAGS_padbox_dataset_disable_polling;
   bool disable_random_update_ = FLAGS_padbox_dataset_disable_random_update;
-  std::vector<std::shared_ptr<BinaryArchiveWriter>> binary_files_;
+  std::vector<std::shared_ptr<ArchiveFileWriter>> binary_files_;
   bool is_archive_file_ = false;
   std::atomic<int64_t> total_ins_num_{0};
   paddle::framework::ThreadPool* down_pool_ = nullptr;
   paddle::framework::ThreadPool* dump_pool_ = nullptr;
   SlotObjPool* slot_pool_ = nullptr;
+  // pass scoped record memory, released in ReleaseMemory
+  std::shared_ptr<SlotRecordArena> arena_ = nullptr;
+  // pipeline stages: read files, merge keys, shuffle send, feed batches
+  PipelineStageStat read_stat_;
+  PipelineStageStat merge_stat_;
+  PipelineStageStat shuffle_stat_;
+  PipelineStageStat feed_stat_;
 };
 
 class InputTableDataset : public PadBoxSlotDataset {
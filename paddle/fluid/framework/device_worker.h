@@ -33,6 +33,7 @@ limitations under the License. */
 
 #include <map>
 
+#include "paddle/fluid/framework/boxps_dump.h"
 #include "paddle/fluid/framework/data_feed.h"
 #include "paddle/fluid/framework/executor_gc_helper.h"
 #include "paddle/fluid/framework/heter_util.h"
@@ -48,7 +49,7 @@ limitations under the License. */
 #include "paddle/phi/backends/dynload/port.h"
 
 #ifdef PADDLE_WITH_BOX_PS
-#include "paddle/phi/core/utils/rw_lock.h"
+#include "paddle/fluid/framework/fleet/box_dense_adam.h"
 #endif
 
 namespace paddle {
@@ -817,9 +818,11 @@ class BoxPSAsynDenseTable {
   void InitThreadGroup();
   void ThreadUpdate(int thread_id,
                     const std::vector<LoDTensor*>& grad,
-                    size_t merge_num);
+                    size_t merge_num,
+                    float* param_out);
   void AsyncUpdate();
   int64_t GetParamTotalLen(void) { return total_param_len_; }
+  void PrintUpdateStat(void);
 
  private:
   int device_num_ = 0;
@@ -841,9 +844,27 @@ class BoxPSAsynDenseTable {
   std::vector<size_t> thread_end_index_;
   std::shared_ptr<paddle::framework::ThreadPool> thread_pool = nullptr;
   int thread_num_ = 0;
-  phi::RWLock ps_lock_;
   std::thread* update_thread_ = nullptr;
   float base_lr_ = -1;
+  BoxDenseAdamConfig adam_config_;
+  size_t max_merge_num_ = 4;
+
+  // PullDense copies the published snapshot of ps_ without waiting, the
+  // update writes the other one and waits only for its late readers
+  LoDTensor ps_snapshot_[2];
+  std::atomic<int> published_{0};
+  std::atomic<int> snapshot_readers_[2];
+  // updates published so far, and the version each gradient was computed on
+  std::atomic<uint64_t> version_{0};
+  std::vector<uint64_t> grad_versions_;
+
+  // update stat, by the update thread
+  uint64_t update_num_ = 0;
+  uint64_t merged_grad_num_ = 0;
+  double update_time_sum_ = 0;
+  double update_time_max_ = 0;
+  uint64_t staleness_sum_ = 0;
+  uint64_t staleness_max_ = 0;
 };
 
 class BoxPSWorker : public DeviceWorker {
@@ -866,12 +887,6 @@ class BoxPSWorker : public DeviceWorker {
     int64_t numel(void) { return data_tensor_->numel(); }
   };
 
-  struct fd_info_t {
-    int fd;
-    size_t len;
-    int fileid;
-  };
-
  public:
   BoxPSWorker() {}
   ~BoxPSWorker() override {}
@@ -900,6 +915,21 @@ class BoxPSWorker : public DeviceWorker {
 
  protected:
   int PackBatchTask(void);
+  // ops_ bound to the vars of one scope with their sync and gc points
+  struct OpInstruction {
+    OperatorBase* op = nullptr;
+    bool sync_before = false;
+    std::vector<Variable*> gc_vars;
+    // the names of gc_vars, for the gc logs and errors
+    std::vector<std::string> gc_var_names;
+    // the gc vars not created yet when the list was built
+    std::vector<std::string> gc_names;
+  };
+  const std::vector<OpInstruction>& GetInstructions(Scope* scope);
+  // the batch to run and the scope it was packed into
+  int NextFeedBatch(Scope** scope);
+  void StartFeedPipeline(void);
+  void StopFeedPipeline(void);
   int CheckNeedParam(VarDesc* var);
   int64_t AllocParamTensor(const ProgramDesc& program, int64_t* pad_len);
   int64_t AllocParamTensorAsync(const ProgramDesc& program);
@@ -917,8 +947,7 @@ protected:
                          int dump_mode,
                          int dump_interval = 10000);
  private:
-  void OpenDump(const int &tid);
-  void WriteDump(const int &tid, const std::string& buf);
+  void WriteDump(const int &tid, const std::string& buf, bool line_end = true);
   void FlushDump(void);
 
  protected:
@@ -962,10 +991,30 @@ protected:
   // op extend
   std::unordered_set<const OperatorBase*> sync_points_;
 
+  // the instructions of the scopes run in this pass, with
+  // FLAGS_padbox_enable_prebind_ops every scope runs its own copies of ops_
+  std::unordered_map<const Scope*, std::vector<OpInstruction>> instructions_;
+  std::vector<std::unique_ptr<OperatorBase>> bound_ops_;
+
+  // feed pipeline of cpu places, a thread packs the next batches into child
+  // scopes of thread_scope_ while the ops run on the current one
+  typedef operators::reader::BlockingQueue<std::pair<Scope*, int>>
+      FeedReadyQueue;
+  typedef operators::reader::BlockingQueue<Scope*> FeedFreeQueue;
+  // the vars the reader fills, every feed scope has its own
+  std::vector<std::string> feed_var_names_;
+  std::unique_ptr<FeedReadyQueue> ready_feeds_ = nullptr;
+  std::unique_ptr<FeedFreeQueue> free_feeds_ = nullptr;
+  std::thread feed_thread_;
+  double feed_pack_sec_ = 0;
+  platform::Timer feed_wait_timer_;
+
   // dump file
   int dump_thread_num_ = 20;
   std::string dump_fields_path_ = "";
-  std::vector<fd_info_t> fds_sizes_;
+  // writes the dump files of all dump threads in the background
+  std::unique_ptr<AsyncDumpWriter> dump_writer_ = nullptr;
+  bool dump_binary_format_ = false;
   // dump thread
   std::shared_ptr<paddle::framework::ThreadPool> dump_thread_pool_ =
       nullptr;
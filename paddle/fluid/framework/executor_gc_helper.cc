@@ -176,39 +176,59 @@ GetUnusedVars(const BlockDesc &block,
   return result;
 }
 
+static void CollectUnusedTensor(
+    Variable *var,
+    const std::string &var_name,
+    std::deque<std::shared_ptr<memory::Allocation>> *garbages) {
+  if (var == nullptr || !(var->IsInitialized())) {
+    return;
+  }
+
+  VLOG(2) << "Erase variable " << var_name;
+  if (var->IsType<LoDTensor>()) {
+    garbages->emplace_back(var->GetMutable<LoDTensor>()->MoveMemoryHolder());
+  } else if (var->IsType<phi::SelectedRows>()) {
+    garbages->emplace_back(var->GetMutable<phi::SelectedRows>()
+                               ->mutable_value()
+                               ->MoveMemoryHolder());
+  } else if (var->IsType<LoDTensorArray>()) {
+    auto *lod_tensor_arr = var->GetMutable<LoDTensorArray>();
+    for (auto &t : *lod_tensor_arr) {
+      garbages->emplace_back(t.MoveMemoryHolder());
+    }
+    // NOTE(wangxi): need clear the vector, otherwise lod_tensor_arr.size() is
+    // wrong, if size() decrease in next step, an error maybe occur.
+    lod_tensor_arr->clear();
+  } else if (var->IsType<Strings>()) {
+  } else {
+    PADDLE_THROW(platform::errors::Unimplemented(
+        "Type %s of variable %s is not supported eager deletion.",
+        framework::ToTypeName(var->Type()),
+        var_name));
+  }
+}
+
 void DeleteUnusedTensors(const Scope &scope,
                          const std::vector<std::string> &delete_vars,
                          GarbageCollector *gc) {
   std::deque<std::shared_ptr<memory::Allocation>> garbages;
 
   for (auto &var_name : delete_vars) {
-    auto *var = scope.FindVar(var_name);
-    if (var == nullptr || !(var->IsInitialized())) {
-      continue;
-    }
+    CollectUnusedTensor(scope.FindVar(var_name), var_name, &garbages);
+  }
 
-    VLOG(2) << "Erase variable " << var_name;
-    if (var->IsType<LoDTensor>()) {
-      garbages.emplace_back(var->GetMutable<LoDTensor>()->MoveMemoryHolder());
-    } else if (var->IsType<phi::SelectedRows>()) {
-      garbages.emplace_back(var->GetMutable<phi::SelectedRows>()
-                                ->mutable_value()
-                                ->MoveMemoryHolder());
-    } else if (var->IsType<LoDTensorArray>()) {
-      auto *lod_tensor_arr = var->GetMutable<LoDTensorArray>();
-      for (auto &t : *lod_tensor_arr) {
-        garbages.emplace_back(t.MoveMemoryHolder());
-      }
-      // NOTE(wangxi): need clear the vector, otherwise lod_tensor_arr.size() is
-      // wrong, if size() decrease in next step, an error maybe occur.
-      lod_tensor_arr->clear();
-    } else if (var->IsType<Strings>()) {
-    } else {
-      PADDLE_THROW(platform::errors::Unimplemented(
-          "Type %s of variable %s is not supported eager deletion.",
-          framework::ToTypeName(var->Type()),
-          var_name));
-    }
+  if (!garbages.empty()) {
+    gc->Add(std::move(garbages));
+  }
+}
+
+void DeleteUnusedTensors(const std::vector<Variable *> &delete_vars,
+                         const std::vector<std::string> &delete_var_names,
+                         GarbageCollector *gc) {
+  std::deque<std::shared_ptr<memory::Allocation>> garbages;
+
+  for (size_t i = 0; i < delete_vars.size(); ++i) {
+    CollectUnusedTensor(delete_vars[i], delete_var_names[i], &garbages);
   }
 
   if (!garbages.empty()) {
@@ -56,6 +56,12 @@ void DeleteUnusedTensors(const Scope &scope,
                          const std::vector<std::string> &delete_vars,
                          GarbageCollector *gc);
 
+// Collect unused tensors of variables looked up before, delete_var_names[i]
+// is the name of delete_vars[i]
+void DeleteUnusedTensors(const std::vector<Variable *> &delete_vars,
+                         const std::vector<std::string> &delete_var_names,
+                         GarbageCollector *gc);
+
 // Collect unused tensors after op runs
 void DeleteUnusedTensors(
     const Scope &scope,
@@ -0,0 +1,202 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PADDLE_BOX_DENSE_SIMD
+#endif
+
+namespace paddle {
+namespace framework {
+
+struct BoxDenseAdamConfig {
+  float beta1 = 0.99;
+  float beta2 = 0.9999;
+  float epsilon = 1e-8;
+};
+
+/**
+ * @Brief the async dense table update of [begin, end): the grad is the mean of
+ * grads[0, merge_num), then
+ *   mom1 = beta1 * mom1 + (1 - beta1) * grad
+ *   mom2 = beta2 * mom2 + (1 - beta2) * grad * grad
+ *   param -= lr * mom1 / (sqrt(mom2) + epsilon)
+ * The new param is stored to both param and param_out.
+ */
+inline void BoxDenseAdamScalar(const float* const* grads,
+                               int merge_num,
+                               const float* lr,
+                               const BoxDenseAdamConfig& config,
+                               size_t begin,
+                               size_t end,
+                               float* param,
+                               float* mom1,
+                               float* mom2,
+                               float* param_out) {
+  const float scale = 1.0f / merge_num;
+  for (size_t i = begin; i < end; ++i) {
+    float g = grads[0][i];
+    for (int k = 1; k < merge_num; ++k) {
+      g += grads[k][i];
+    }
+    g *= scale;
+    mom1[i] = config.beta1 * mom1[i] + (1 - config.beta1) * g;
+    mom2[i] = config.beta2 * mom2[i] + (1 - config.beta2) * g * g;
+    param[i] -= lr[i] * (mom1[i] / (std::sqrt(mom2[i]) + config.epsilon));
+    param_out[i] = param[i];
+  }
+}
+
+#ifdef PADDLE_BOX_DENSE_SIMD
+__attribute__((target("avx2,fma"))) inline void BoxDenseAdamAVX2(
+    const float* const* grads,
+    int merge_num,
+    const float* lr,
+    const BoxDenseAdamConfig& config,
+    size_t begin,
+    size_t end,
+    float* param,
+    float* mom1,
+    float* mom2,
+    float* param_out) {
+  const __m256 scale = _mm256_set1_ps(1.0f / merge_num);
+  const __m256 beta1 = _mm256_set1_ps(config.beta1);
+  const __m256 rest1 = _mm256_set1_ps(1 - config.beta1);
+  const __m256 beta2 = _mm256_set1_ps(config.beta2);
+  const __m256 rest2 = _mm256_set1_ps(1 - config.beta2);
+  const __m256 epsilon = _mm256_set1_ps(config.epsilon);
+  size_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 g = _mm256_loadu_ps(grads[0] + i);
+    for (int k = 1; k < merge_num; ++k) {
+      g = _mm256_add_ps(g, _mm256_loadu_ps(grads[k] + i));
+    }
+    g = _mm256_mul_ps(g, scale);
+    __m256 m1 = _mm256_fmadd_ps(
+        beta1, _mm256_loadu_ps(mom1 + i), _mm256_mul_ps(rest1, g));
+    __m256 m2 = _mm256_fmadd_ps(beta2,
+                                _mm256_loadu_ps(mom2 + i),
+                                _mm256_mul_ps(rest2, _mm256_mul_ps(g, g)));
+    __m256 w = _mm256_fnmadd_ps(
+        _mm256_loadu_ps(lr + i),
+        _mm256_div_ps(m1, _mm256_add_ps(_mm256_sqrt_ps(m2), epsilon)),
+        _mm256_loadu_ps(param + i));
+    _mm256_storeu_ps(mom1 + i, m1);
+    _mm256_storeu_ps(mom2 + i, m2);
+    _mm256_storeu_ps(param + i, w);
+    _mm256_storeu_ps(param_out + i, w);
+  }
+  BoxDenseAdamScalar(
+      grads, merge_num, lr, config, i, end, param, mom1, mom2, param_out);
+}
+
+__attribute__((target("avx512f"))) inline void BoxDenseAdamAVX512(
+    const float* const* grads,
+    int merge_num,
+    const float* lr,
+    const BoxDenseAdamConfig& config,
+    size_t begin,
+    size_t end,
+    float* param,
+    float* mom1,
+    float* mom2,
+    float* param_out) {
+  const __m512 scale = _mm512_set1_ps(1.0f / merge_num);
+  const __m512 beta1 = _mm512_set1_ps(config.beta1);
+  const __m512 rest1 = _mm512_set1_ps(1 - config.beta1);
+  const __m512 beta2 = _mm512_set1_ps(config.beta2);
+  const __m512 rest2 = _mm512_set1_ps(1 - config.beta2);
+  const __m512 epsilon = _mm512_set1_ps(config.epsilon);
+  size_t i = begin;
+  for (; i + 16 <= end; i += 16) {
+    __m512 g = _mm512_loadu_ps(grads[0] + i);
+    for (int k = 1; k < merge_num; ++k) {
+      g = _mm512_add_ps(g, _mm512_loadu_ps(grads[k] + i));
+    }
+    g = _mm512_mul_ps(g, scale);
+    __m512 m1 = _mm512_fmadd_ps(
+        beta1, _mm512_loadu_ps(mom1 + i), _mm512_mul_ps(rest1, g));
+    __m512 m2 = _mm512_fmadd_ps(beta2,
+                                _mm512_loadu_ps(mom2 + i),
+                                _mm512_mul_ps(rest2, _mm512_mul_ps(g, g)));
+    __m512 w = _mm512_fnmadd_ps(
+        _mm512_loadu_ps(lr + i),
+        _mm512_div_ps(m1, _mm512_add_ps(_mm512_sqrt_ps(m2), epsilon)),
+        _mm512_loadu_ps(param + i));
+    _mm512_storeu_ps(mom1 + i, m1);
+    _mm512_storeu_ps(mom2 + i, m2);
+    _mm512_storeu_ps(param + i, w);
+    _mm512_storeu_ps(param_out + i, w);
+  }
+  BoxDenseAdamScalar(
+      grads, merge_num, lr, config, i, end, param, mom1, mom2, param_out);
+}
+#endif
+
+inline void BoxDenseAdam(const float* const* grads,
+                         int merge_num,
+                         const float* lr,
+                         const BoxDenseAdamConfig& config,
+                         size_t begin,
+                         size_t end,
+                         float* param,
+                         float* mom1,
+                         float* mom2,
+                         float* param_out) {
+#ifdef PADDLE_BOX_DENSE_SIMD
+  static const bool has_avx512 = __builtin_cpu_supports("avx512f");
+  static const bool has_avx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if (has_avx512) {
+    BoxDenseAdamAVX512(
+        grads, merge_num, lr, config, begin, end, param, mom1, mom2, param_out);
+    return;
+  }
+  if (has_avx2) {
+    BoxDenseAdamAVX2(
+        grads, merge_num, lr, config, begin, end, param, mom1, mom2, param_out);
+    return;
+  }
+#endif
+  BoxDenseAdamScalar(
+      grads, merge_num, lr, config, begin, end, param, mom1, mom2, param_out);
+}
+
+// the data norm summaries of [begin, end) decay instead:
+// param = param * decay + grad, the decay in double like before
+inline void BoxDenseNorm(const float* const* grads,
+                         int merge_num,
+                         double decay,
+                         size_t begin,
+                         size_t end,
+                         float* param,
+                         float* param_out) {
+  for (size_t i = begin; i < end; ++i) {
+    float g = grads[0][i];
+    for (int k = 1; k < merge_num; ++k) {
+      g += grads[k][i];
+    }
+    g /= merge_num;
+    param[i] = param[i] * decay + g;
+    param_out[i] = param[i];
+  }
+}
+
+}  // namespace framework
+}  // namespace paddle
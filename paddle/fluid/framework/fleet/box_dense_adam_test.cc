@@ -0,0 +1,137 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/fleet/box_dense_adam.h"
+
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace framework {
+
+using BoxDenseAdamFunc = std::function<void(const float* const*,
+                                            int,
+                                            const float*,
+                                            const BoxDenseAdamConfig&,
+                                            size_t,
+                                            size_t,
+                                            float*,
+                                            float*,
+                                            float*,
+                                            float*)>;
+
+// the table of a dense update, the buffers start one float after an
+// allocation so no vector load of the kernels is aligned
+struct DenseTable {
+  DenseTable(size_t size, int merge_num, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (auto* buf : {&param, &mom1, &mom2, &lr, &param_out}) {
+      buf->resize(size + 1);
+    }
+    grads.resize(merge_num, std::vector<float>(size + 1));
+    for (size_t i = 1; i <= size; ++i) {
+      param[i] = dist(rng);
+      mom1[i] = dist(rng) * 0.1f;
+      mom2[i] = std::fabs(dist(rng)) * 0.01f;
+      lr[i] = 1e-3f * (1.0f + std::fabs(dist(rng)));
+    }
+    for (auto& grad : grads) {
+      for (size_t i = 1; i <= size; ++i) {
+        grad[i] = dist(rng);
+      }
+      grad_ptrs.push_back(grad.data() + 1);
+    }
+  }
+  void Update(const BoxDenseAdamFunc& func, size_t begin, size_t end) {
+    func(grad_ptrs.data(),
+         static_cast<int>(grads.size()),
+         lr.data() + 1,
+         BoxDenseAdamConfig(),
+         begin,
+         end,
+         param.data() + 1,
+         mom1.data() + 1,
+         mom2.data() + 1,
+         param_out.data() + 1);
+  }
+  std::vector<float> param;
+  std::vector<float> mom1;
+  std::vector<float> mom2;
+  std::vector<float> lr;
+  std::vector<float> param_out;
+  std::vector<std::vector<float>> grads;
+  std::vector<const float*> grad_ptrs;
+};
+
+// a few steps of the kernel over [begin, end) of unaligned starts and
+// lengths of no full vector, full vectors only and a tail, the rows out of
+// the range stay untouched
+static void ExpectSameAdam(const BoxDenseAdamFunc& func) {
+  const size_t size = 200;
+  for (int merge_num : {1, 2, 3}) {
+    for (size_t begin : {0, 1, 3, 7, 9, 17}) {
+      for (size_t len : {0, 1, 5, 8, 15, 16, 31, 32, 33, 100, 183}) {
+        size_t end = begin + len;
+        if (end > size) {
+          continue;
+        }
+        DenseTable expect(size, merge_num, merge_num);
+        DenseTable table(size, merge_num, merge_num);
+        for (int step = 0; step < 5; ++step) {
+          expect.Update(BoxDenseAdamScalar, begin, end);
+          table.Update(func, begin, end);
+        }
+        for (size_t i = 1; i <= size; ++i) {
+          // the simd kernels fuse the multiply adds
+          ASSERT_NEAR(table.mom1[i], expect.mom1[i], 1e-6)
+              << "begin " << begin << " len " << len << " row " << i;
+          ASSERT_NEAR(table.mom2[i], expect.mom2[i], 1e-6)
+              << "begin " << begin << " len " << len << " row " << i;
+          ASSERT_NEAR(table.param[i], expect.param[i], 1e-5)
+              << "begin " << begin << " len " << len << " row " << i;
+          bool in_range = i - 1 >= begin && i - 1 < end;
+          ASSERT_EQ(table.param_out[i], in_range ? table.param[i] : 0.0f)
+              << "begin " << begin << " len " << len << " row " << i;
+        }
+      }
+    }
+  }
+}
+
+TEST(BoxDenseAdam, Dispatch) { ExpectSameAdam(BoxDenseAdam); }
+
+#ifdef PADDLE_BOX_DENSE_SIMD
+// the kernels the cpu can not run pass
+TEST(BoxDenseAdam, AVX2) {
+  if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma")) {
+    return;
+  }
+  ExpectSameAdam(BoxDenseAdamAVX2);
+}
+
+TEST(BoxDenseAdam, AVX512) {
+  if (!__builtin_cpu_supports("avx512f")) {
+    return;
+  }
+  ExpectSameAdam(BoxDenseAdamAVX512);
+}
+#endif
+
+}  // namespace framework
+}  // namespace paddle
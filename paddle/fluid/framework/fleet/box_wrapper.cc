@@ -507,18 +507,26 @@ class MultiTaskMetricMsg : public MetricMsg {
               batch_size,
               pred_data_list[i].size()));
     }
-    auto cal = GetCalculator();
-    std::lock_guard<std::mutex> lock(cal->table_mutex());
+    std::vector<float> pred_data(batch_size, 0);
+    std::vector<int64_t> mask_data(batch_size, 0);
     for (size_t i = 0; i < batch_size; ++i) {
       auto cmatch_rank_it = std::find(cmatch_rank_v.begin(),
                                       cmatch_rank_v.end(),
                                       parse_cmatch_rank(cmatch_rank_data[i]));
       if (cmatch_rank_it != cmatch_rank_v.end()) {
-        cal->add_unlock_data(pred_data_list[std::distance(cmatch_rank_v.begin(),
-                                                          cmatch_rank_it)][i],
-                             label_data[i]);
+        pred_data[i] = pred_data_list[std::distance(cmatch_rank_v.begin(),
+                                                    cmatch_rank_it)][i];
+        mask_data[i] = 1;
       }
     }
+    auto cal = GetCalculator();
+    cal->add_mask_data(pred_data.data(),
+                       label_data.data(),
+                       mask_data.data(),
+                       batch_size,
+                       platform::CPUPlace(),
+                       platform::CPUPlace(),
+                       platform::CPUPlace());
   }
 
  protected:
@@ -582,8 +590,7 @@ class CmatchRankMetricMsg : public MetricMsg {
             "illegal batch size: cmatch_rank[%lu] and pred_data[%lu]",
             batch_size,
             pred_data.size()));
-    auto cal = GetCalculator();
-    std::lock_guard<std::mutex> lock(cal->table_mutex());
+    std::vector<int64_t> mask_data(batch_size, 0);
     for (size_t i = 0; i < batch_size; ++i) {
       const auto& cur_cmatch_rank = parse_cmatch_rank(cmatch_rank_data[i]);
       for (size_t j = 0; j < cmatch_rank_v.size(); ++j) {
@@ -594,11 +601,19 @@ class CmatchRankMetricMsg : public MetricMsg {
           is_matched = cmatch_rank_v[j] == cur_cmatch_rank;
         }
         if (is_matched) {
-          cal->add_unlock_data(pred_data[i], label_data[i]);
+          mask_data[i] = 1;
           break;
         }
       }
     }
+    auto cal = GetCalculator();
+    cal->add_mask_data(pred_data.data(),
+                       label_data.data(),
+                       mask_data.data(),
+                       batch_size,
+                       platform::CPUPlace(),
+                       platform::CPUPlace(),
+                       platform::CPUPlace());
   }
 
  protected:
@@ -722,24 +737,26 @@ class MultiMaskMetricMsg : public MetricMsg {
               label_data.size(),
               mask_value_data_list[name_idx].size()));
     }
-    auto cal = GetCalculator();
-    std::lock_guard<std::mutex> lock(cal->table_mutex());
     size_t batch_size = label_data.size();
-    bool flag = true;
+    std::vector<int64_t> mask_data(batch_size, 1);
     for (size_t ins_idx = 0; ins_idx < batch_size; ++ins_idx) {
-      flag = true;
       for (size_t val_idx = 0; val_idx < mask_varvalue_list_.size();
            ++val_idx) {
         if (mask_value_data_list[val_idx][ins_idx] !=
             mask_varvalue_list_[val_idx]) {
-          flag = false;
+          mask_data[ins_idx] = 0;
           break;
         }
       }
-      if (flag) {
-        cal->add_unlock_data(pred_data[ins_idx], label_data[ins_idx]);
-      }
     }
+    auto cal = GetCalculator();
+    cal->add_mask_data(pred_data.data(),
+                       label_data.data(),
+                       mask_data.data(),
+                       batch_size,
+                       platform::CPUPlace(),
+                       platform::CPUPlace(),
+                       platform::CPUPlace());
   }
 
  protected:
@@ -902,25 +919,26 @@ class ContinueMultiMaskMetricMsg : public MetricMsg {
               label_data.size(),
               mask_value_data_list[name_idx].size()));
     }
-    auto cal = GetCalculator();
-    std::lock_guard<std::mutex> lock(cal->table_mutex());
     size_t batch_size = label_data.size();
-    bool flag = true;
+    std::vector<int64_t> mask_data(batch_size, 1);
     for (size_t ins_idx = 0; ins_idx < batch_size; ++ins_idx) {
-      flag = true;
       for (size_t val_idx = 0; val_idx < mask_varvalue_list_.size();
            ++val_idx) {
         if (mask_value_data_list[val_idx][ins_idx] !=
             mask_varvalue_list_[val_idx]) {
-          flag = false;
+          mask_data[ins_idx] = 0;
           break;
         }
       }
-      if (flag) {
-        cal->add_unlock_data_with_continue_label(pred_data[ins_idx],
-                                                 label_data[ins_idx]);
-      }
     }
+    auto cal = GetCalculator();
+    cal->add_continue_mask_data(pred_data.data(),
+                                label_data.data(),
+                                mask_data.data(),
+                                batch_size,
+                                platform::CPUPlace(),
+                                platform::CPUPlace(),
+                                platform::CPUPlace());
   }
 
  protected:
@@ -1084,14 +1102,13 @@ class CmatchRankMaskMetricMsg : public MetricMsg {
               mask_data.size()));
     }
 
-    auto cal = GetCalculator();
-    std::lock_guard<std::mutex> lock(cal->table_mutex());
+    std::vector<int64_t> add_mask(batch_size, 0);
     for (size_t i = 0; i < batch_size; ++i) {
+      if (!mask_data.empty() && !mask_data[i]) {
+        continue;
+      }
       const auto& cur_cmatch_rank = parse_cmatch_rank(cmatch_rank_data[i]);
       for (size_t j = 0; j < cmatch_rank_v.size(); ++j) {
-        if (!mask_data.empty() && !mask_data[i]) {
-          continue;
-        }
         bool is_matched = false;
         if (ignore_rank_) {
           is_matched = cmatch_rank_v[j].first == cur_cmatch_rank.first;
@@ -1099,11 +1116,19 @@ class CmatchRankMaskMetricMsg : public MetricMsg {
           is_matched = cmatch_rank_v[j] == cur_cmatch_rank;
         }
         if (is_matched) {
-          cal->add_unlock_data(pred_data[i], label_data[i]);
+          add_mask[i] = 1;
           break;
         }
       }
     }
+    auto cal = GetCalculator();
+    cal->add_mask_data(pred_data.data(),
+                       label_data.data(),
+                       add_mask.data(),
+                       batch_size,
+                       platform::CPUPlace(),
+                       platform::CPUPlace(),
+                       platform::CPUPlace());
   }
 
  protected:
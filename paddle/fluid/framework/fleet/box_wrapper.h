@@ -50,6 +50,7 @@ limitations under the License. */
 #include "paddle/phi/common/data_type.h"
 #include "paddle/fluid/framework/fleet/metrics.h"
 #include "paddle/fluid/framework/fleet/box_wrapper_kernel.h"
+#include "paddle/fluid/framework/fleet/box_wrapper_dedup.h"
 
 #if defined(TRACE_PROFILE) && (defined(PADDLE_WITH_XPU_KP) || defined(PADDLE_WITH_XPU))
 // The producer side.
@@ -442,6 +443,8 @@ class BoxWrapper {
 
     int64_t total_key_length = 0;
     int64_t dedup_key_length = 0;
+    // pull keys dedup of cpu places
+    CPUKeyDedup cpu_dedup;
 
     void ResetTimer(void) {
       all_pull_timer.Reset();
@@ -0,0 +1,268 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define PADDLE_BOX_DEDUP_SIMD
+#endif
+
+namespace paddle {
+namespace framework {
+
+/**
+ * @Brief dedup the pull keys of one cpu device, the outputs are the same as
+ * boxps DedupKeysAndFillIdx: merged_keys in ascending order, restore_idx[i]
+ * the merged index of keys[i], sorted_idx the key indices in key order and
+ * offset[j], merged_cnts[j] the range of merged key j in sorted_idx.
+ * The (key, index) pairs are sorted by a parallel LSD radix sort, the
+ * buffers are kept between batches.
+ */
+class CPUKeyDedup {
+ public:
+  // runs func(i) for every i in [0, num), in parallel
+  typedef std::function<void(size_t, const std::function<void(const size_t&)>&)>
+      ParallelFunc;
+
+  explicit CPUKeyDedup(int max_part_num = 16) : max_part_num_(max_part_num) {}
+
+  int Dedup(const ParallelFunc& parallel,
+            int64_t len,
+            const uint64_t* keys,
+            uint64_t* merged_keys,
+            uint32_t* restore_idx,
+            uint32_t* sorted_idx,
+            uint32_t* offset,
+            uint32_t* merged_cnts) {
+    if (len <= 0) {
+      return 0;
+    }
+    const size_t num = static_cast<size_t>(len);
+    const size_t part_num = std::max<size_t>(
+        1, std::min<size_t>(max_part_num_, num / kMinPartLen));
+    auto part_begin = [num, part_num](size_t part) {
+      return num * part / part_num;
+    };
+    items_.resize(num);
+    buffer_.resize(num);
+    counts_.resize(part_num * kPasses * kBuckets);
+
+    // pairs and the digits of all passes, to skip the passes where every
+    // key has the same digit
+    parallel(part_num, [&](const size_t& part) {
+      size_t* count = &counts_[part * kPasses * kBuckets];
+      std::fill(count, count + kPasses * kBuckets, 0);
+      for (size_t i = part_begin(part); i < part_begin(part + 1); ++i) {
+        uint64_t key = keys[i];
+        items_[i].key = key;
+        items_[i].idx = static_cast<uint32_t>(i);
+        for (int pass = 0; pass < kPasses; ++pass) {
+          ++count[pass * kBuckets + ((key >> (pass * kDigitBits)) & kMask)];
+        }
+      }
+    });
+    std::vector<int> passes;
+    for (int pass = 0; pass < kPasses; ++pass) {
+      bool same = false;
+      for (int d = 0; d < kBuckets && !same; ++d) {
+        size_t total = 0;
+        for (size_t part = 0; part < part_num; ++part) {
+          total += counts_[(part * kPasses + pass) * kBuckets + d];
+        }
+        same = (total == num);
+      }
+      if (!same) {
+        passes.push_back(pass);
+      }
+    }
+    KeyIdx* src = items_.data();
+    KeyIdx* dst = buffer_.data();
+    for (size_t p = 0; p < passes.size(); ++p) {
+      const int shift = passes[p] * kDigitBits;
+      // the first pass reuses the counts of the fill, the chunks of the
+      // later passes hold other keys
+      if (p > 0) {
+        parallel(part_num, [&](const size_t& part) {
+          size_t* count = &counts_[part * kPasses * kBuckets];
+          std::fill(count, count + kBuckets, 0);
+          for (size_t i = part_begin(part); i < part_begin(part + 1); ++i) {
+            ++count[(src[i].key >> shift) & kMask];
+          }
+        });
+      } else if (passes[p] != 0) {
+        for (size_t part = 0; part < part_num; ++part) {
+          size_t* count = &counts_[part * kPasses * kBuckets];
+          std::copy(count + passes[p] * kBuckets,
+                    count + (passes[p] + 1) * kBuckets,
+                    count);
+        }
+      }
+      size_t pos = 0;
+      for (int d = 0; d < kBuckets; ++d) {
+        for (size_t part = 0; part < part_num; ++part) {
+          size_t& count = counts_[part * kPasses * kBuckets + d];
+          size_t n = count;
+          count = pos;
+          pos += n;
+        }
+      }
+      parallel(part_num, [&](const size_t& part) {
+        size_t* next = &counts_[part * kPasses * kBuckets];
+        for (size_t i = part_begin(part); i < part_begin(part + 1); ++i) {
+          dst[next[(src[i].key >> shift) & kMask]++] = src[i];
+        }
+      });
+      std::swap(src, dst);
+    }
+
+    // merged index of the first pair of every chunk
+    heads_.assign(part_num + 1, 0);
+    parallel(part_num, [&](const size_t& part) {
+      size_t head_num = 0;
+      for (size_t i = part_begin(part); i < part_begin(part + 1); ++i) {
+        if (i == 0 || src[i].key != src[i - 1].key) {
+          ++head_num;
+        }
+      }
+      heads_[part + 1] = head_num;
+    });
+    for (size_t part = 0; part < part_num; ++part) {
+      heads_[part + 1] += heads_[part];
+    }
+    const uint32_t merged_num = static_cast<uint32_t>(heads_[part_num]);
+    parallel(part_num, [&](const size_t& part) {
+      // the pairs before the first head of the chunk belong to the last
+      // merged key of the previous chunk
+      uint32_t merged = static_cast<uint32_t>(heads_[part]) - 1;
+      for (size_t i = part_begin(part); i < part_begin(part + 1); ++i) {
+        if (i == 0 || src[i].key != src[i - 1].key) {
+          ++merged;
+          merged_keys[merged] = src[i].key;
+          offset[merged] = static_cast<uint32_t>(i);
+        }
+        sorted_idx[i] = src[i].idx;
+        restore_idx[src[i].idx] = merged;
+      }
+    });
+    parallel(part_num, [&](const size_t& part) {
+      uint32_t begin = static_cast<uint32_t>(heads_[part]);
+      uint32_t end = static_cast<uint32_t>(heads_[part + 1]);
+      for (uint32_t j = begin; j < end; ++j) {
+        uint32_t next = (j + 1 < merged_num) ? offset[j + 1]
+                                             : static_cast<uint32_t>(num);
+        merged_cnts[j] = next - offset[j];
+      }
+    });
+    return static_cast<int>(merged_num);
+  }
+
+ private:
+  struct KeyIdx {
+    uint64_t key;
+    uint32_t idx;
+  };
+  static const int kDigitBits = 8;
+  static const int kBuckets = 1 << kDigitBits;
+  static const uint64_t kMask = kBuckets - 1;
+  static const int kPasses = 64 / kDigitBits;
+  static const size_t kMinPartLen = 8192;
+
+  int max_part_num_;
+  std::vector<KeyIdx> items_;
+  std::vector<KeyIdx> buffer_;
+  std::vector<size_t> counts_;
+  std::vector<size_t> heads_;
+};
+
+// dst[i] += src[i], the merge of duplicate key gradients
+inline void DedupAddToScalar(float* dst, const float* src, int n) {
+  for (int i = 0; i < n; ++i) {
+    dst[i] += src[i];
+  }
+}
+
+// dst[i] *= scale
+inline void DedupScaleScalar(float* dst, float scale, int n) {
+  for (int i = 0; i < n; ++i) {
+    dst[i] *= scale;
+  }
+}
+
+#ifdef PADDLE_BOX_DEDUP_SIMD
+__attribute__((target("avx2"))) inline void DedupAddToAVX2(float* dst,
+                                                           const float* src,
+                                                           int n) {
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256 a0 = _mm256_loadu_ps(dst + i);
+    __m256 a1 = _mm256_loadu_ps(dst + i + 8);
+    __m256 b0 = _mm256_loadu_ps(src + i);
+    __m256 b1 = _mm256_loadu_ps(src + i + 8);
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(a0, b0));
+    _mm256_storeu_ps(dst + i + 8, _mm256_add_ps(a1, b1));
+  }
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(
+        dst + i,
+        _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+  }
+  for (; i < n; ++i) {
+    dst[i] += src[i];
+  }
+}
+
+__attribute__((target("avx2"))) inline void DedupScaleAVX2(float* dst,
+                                                           float scale,
+                                                           int n) {
+  const __m256 s = _mm256_set1_ps(scale);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(dst + i), s));
+  }
+  for (; i < n; ++i) {
+    dst[i] *= scale;
+  }
+}
+#endif
+
+inline void DedupAddTo(float* dst, const float* src, int n) {
+#ifdef PADDLE_BOX_DEDUP_SIMD
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    DedupAddToAVX2(dst, src, n);
+    return;
+  }
+#endif
+  DedupAddToScalar(dst, src, n);
+}
+
+inline void DedupScale(float* dst, float scale, int n) {
+#ifdef PADDLE_BOX_DEDUP_SIMD
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    DedupScaleAVX2(dst, scale, n);
+    return;
+  }
+#endif
+  DedupScaleScalar(dst, scale, n);
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,164 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <future>  // NOLINT
+#include <random>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/framework/fleet/box_wrapper_dedup.h"
+#include "paddle/fluid/framework/threadpool.h"
+
+DEFINE_int32(batch_size, 2048, "instances of a batch.");
+DEFINE_int32(slot_num, 400, "sparse slots of an instance.");
+DEFINE_int32(keys_per_slot, 3, "average keys of a slot.");
+DEFINE_int64(key_space, 2000000, "distinct keys the batch is drawn from.");
+DEFINE_int32(thread_num, 16, "dedup threads.");
+DEFINE_int32(embedx_dim, 64, "gradient floats merged per key.");
+DEFINE_int32(repeat, 5, "repeat times.");
+
+using paddle::framework::CPUKeyDedup;
+
+template <class Func>
+static double Best(Func func) {
+  double best = 0;
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    double cost = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    if (r == 0 || cost < best) {
+      best = cost;
+    }
+  }
+  return best;
+}
+
+// serial sort of (key, index) pairs, the way the outputs are built without
+// the radix sort
+static int SortDedup(const std::vector<uint64_t>& keys,
+                     std::vector<std::pair<uint64_t, uint32_t>>* pairs,
+                     uint64_t* merged_keys,
+                     uint32_t* restore_idx,
+                     uint32_t* sorted_idx,
+                     uint32_t* offset,
+                     uint32_t* merged_cnts) {
+  pairs->resize(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    (*pairs)[i] = std::make_pair(keys[i], static_cast<uint32_t>(i));
+  }
+  std::sort(pairs->begin(), pairs->end());
+  int merged = -1;
+  for (size_t i = 0; i < pairs->size(); ++i) {
+    if (i == 0 || (*pairs)[i].first != (*pairs)[i - 1].first) {
+      ++merged;
+      merged_keys[merged] = (*pairs)[i].first;
+      offset[merged] = static_cast<uint32_t>(i);
+      merged_cnts[merged] = 0;
+    }
+    ++merged_cnts[merged];
+    sorted_idx[i] = (*pairs)[i].second;
+    restore_idx[(*pairs)[i].second] = merged;
+  }
+  return merged + 1;
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  const size_t len = static_cast<size_t>(FLAGS_batch_size) *
+                     FLAGS_slot_num * FLAGS_keys_per_slot;
+  std::mt19937_64 rng(0);
+  // skewed draw, hot keys repeat across instances like real features
+  std::vector<uint64_t> keys(len);
+  for (auto& key : keys) {
+    uint64_t r = rng() % FLAGS_key_space;
+    key = ((r * r) / FLAGS_key_space) * 0x9e3779b97f4a7c15ULL;
+  }
+  std::vector<uint64_t> merged_keys(len);
+  std::vector<uint32_t> restore_idx(len);
+  std::vector<uint32_t> sorted_idx(len);
+  std::vector<uint32_t> offset(len);
+  std::vector<uint32_t> merged_cnts(len);
+
+  paddle::framework::ThreadPool pool(FLAGS_thread_num);
+  CPUKeyDedup::ParallelFunc parallel =
+      [&pool](size_t num, const std::function<void(const size_t&)>& func) {
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < num; ++i) {
+          futures.emplace_back(pool.Run([&func, i]() { func(i); }));
+        }
+        for (auto& f : futures) {
+          f.get();
+        }
+      };
+
+  CPUKeyDedup dedup;
+  int radix_num = 0;
+  double radix = Best([&]() {
+    radix_num = dedup.Dedup(parallel,
+                            len,
+                            keys.data(),
+                            merged_keys.data(),
+                            restore_idx.data(),
+                            sorted_idx.data(),
+                            offset.data(),
+                            merged_cnts.data());
+  });
+  std::vector<std::pair<uint64_t, uint32_t>> pairs;
+  int sort_num = 0;
+  double sort = Best([&]() {
+    sort_num = SortDedup(keys,
+                         &pairs,
+                         merged_keys.data(),
+                         restore_idx.data(),
+                         sorted_idx.data(),
+                         offset.data(),
+                         merged_cnts.data());
+  });
+  CHECK_EQ(radix_num, sort_num);
+  LOG(INFO) << "keys: " << len << ", merged: " << radix_num;
+  LOG(INFO) << "std::sort dedup: " << sort * 1e3 << " ms";
+  LOG(INFO) << "radix dedup: " << radix * 1e3 << " ms, speedup "
+            << sort / radix;
+
+  // merge the gradients of the duplicate keys in key order
+  const int dim = FLAGS_embedx_dim;
+  std::vector<float> grads(len * dim, 0.5f);
+  std::vector<float> merged(static_cast<size_t>(radix_num) * dim);
+  auto merge = [&](void (*add)(float*, const float*, int)) {
+    for (int j = 0; j < radix_num; ++j) {
+      float* dst = &merged[static_cast<size_t>(j) * dim];
+      const float* src = &grads[static_cast<size_t>(sorted_idx[offset[j]]) * dim];
+      std::copy(src, src + dim, dst);
+      for (uint32_t k = 1; k < merged_cnts[j]; ++k) {
+        add(dst,
+            &grads[static_cast<size_t>(sorted_idx[offset[j] + k]) * dim],
+            dim);
+      }
+    }
+  };
+  double scalar =
+      Best([&]() { merge(paddle::framework::DedupAddToScalar); });
+  double vec = Best([&]() { merge(paddle::framework::DedupAddTo); });
+  LOG(INFO) << "gradient merge scalar: " << scalar * 1e3 << " ms";
+  LOG(INFO) << "gradient merge: " << vec * 1e3 << " ms, speedup "
+            << scalar / vec;
+  return 0;
+}
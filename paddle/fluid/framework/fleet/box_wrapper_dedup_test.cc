@@ -0,0 +1,140 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/fleet/box_wrapper_dedup.h"
+
+#include <algorithm>
+#include <future>  // NOLINT
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace framework {
+
+// the dedup outputs built by std::sort of (key, index) pairs
+static int SortDedup(const std::vector<uint64_t>& keys,
+                     uint64_t* merged_keys,
+                     uint32_t* restore_idx,
+                     uint32_t* sorted_idx,
+                     uint32_t* offset,
+                     uint32_t* merged_cnts) {
+  std::vector<std::pair<uint64_t, uint32_t>> pairs(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    pairs[i] = std::make_pair(keys[i], static_cast<uint32_t>(i));
+  }
+  std::sort(pairs.begin(), pairs.end());
+  int merged = -1;
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    if (i == 0 || pairs[i].first != pairs[i - 1].first) {
+      ++merged;
+      merged_keys[merged] = pairs[i].first;
+      offset[merged] = static_cast<uint32_t>(i);
+      merged_cnts[merged] = 0;
+    }
+    ++merged_cnts[merged];
+    sorted_idx[i] = pairs[i].second;
+    restore_idx[pairs[i].second] = merged;
+  }
+  return merged + 1;
+}
+
+static void ParallelRun(size_t num,
+                        const std::function<void(const size_t&)>& func) {
+  std::vector<std::future<void>> futures;
+  for (size_t i = 0; i < num; ++i) {
+    futures.emplace_back(std::async(std::launch::async, [&func, i]() {
+      func(i);
+    }));
+  }
+  for (auto& f : futures) {
+    f.get();
+  }
+}
+
+static void ExpectSameDedup(CPUKeyDedup* dedup,
+                            const std::vector<uint64_t>& keys) {
+  size_t len = keys.size();
+  std::vector<uint64_t> merged_keys(len), expect_merged_keys(len);
+  std::vector<uint32_t> restore_idx(len), expect_restore_idx(len);
+  std::vector<uint32_t> sorted_idx(len), expect_sorted_idx(len);
+  std::vector<uint32_t> offset(len), expect_offset(len);
+  std::vector<uint32_t> merged_cnts(len), expect_merged_cnts(len);
+  int num = dedup->Dedup(ParallelRun,
+                         len,
+                         keys.data(),
+                         merged_keys.data(),
+                         restore_idx.data(),
+                         sorted_idx.data(),
+                         offset.data(),
+                         merged_cnts.data());
+  int expect_num = SortDedup(keys,
+                             expect_merged_keys.data(),
+                             expect_restore_idx.data(),
+                             expect_sorted_idx.data(),
+                             expect_offset.data(),
+                             expect_merged_cnts.data());
+  ASSERT_EQ(num, expect_num);
+  for (int j = 0; j < num; ++j) {
+    ASSERT_EQ(merged_keys[j], expect_merged_keys[j]) << "merged " << j;
+    ASSERT_EQ(offset[j], expect_offset[j]) << "merged " << j;
+    ASSERT_EQ(merged_cnts[j], expect_merged_cnts[j]) << "merged " << j;
+  }
+  for (size_t i = 0; i < len; ++i) {
+    ASSERT_EQ(restore_idx[i], expect_restore_idx[i]) << "key " << i;
+    ASSERT_EQ(sorted_idx[i], expect_sorted_idx[i]) << "key " << i;
+  }
+}
+
+TEST(CPUKeyDedup, Empty) {
+  CPUKeyDedup dedup;
+  int num = dedup.Dedup(ParallelRun,
+                        0,
+                        nullptr,
+                        nullptr,
+                        nullptr,
+                        nullptr,
+                        nullptr,
+                        nullptr);
+  ASSERT_EQ(num, 0);
+}
+
+TEST(CPUKeyDedup, MatchSortDedup) {
+  std::mt19937_64 rng(0);
+  // the same dedup is reused across batches like in BoxWrapper
+  CPUKeyDedup dedup;
+  // one part below 8192 keys, several parts above
+  for (size_t len : {1, 7, 100, 8191, 8192, 50000, 200000}) {
+    std::vector<uint64_t> keys(len);
+    for (auto& key : keys) {
+      key = (rng() % (len / 3 + 1)) * 0x9e3779b97f4a7c15ULL;
+    }
+    keys[0] = 0;
+    keys[len / 2] = 0;
+    ExpectSameDedup(&dedup, keys);
+    // only the low digit differs, the other passes are skipped
+    for (auto& key : keys) {
+      key = rng() % 200;
+    }
+    ExpectSameDedup(&dedup, keys);
+    // every pass is skipped
+    ExpectSameDedup(&dedup, std::vector<uint64_t>(len, 0x1234567890ULL));
+    ExpectSameDedup(&dedup, std::vector<uint64_t>(len, 0));
+  }
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -143,8 +143,9 @@ inline void PushMergeCopyData(
       for (int k = 0; k < cvm_offset; ++k) {
         optr[k + skip_offset] = src_val[k];
       }
+      float* embedx_g = &dest_val[info.embedx_g];
       for (int col = 0; col < embedx_dim; ++col) {
-        dest_val[info.embedx_g + col] = src_val[cvm_offset + col];
+        embedx_g[col] = src_val[cvm_offset + col];
       }
       // merge same key in diffent slot id
       for (uint32_t j = 1; j < count; ++j) {
@@ -156,16 +157,12 @@ inline void PushMergeCopyData(
           optr[k + skip_offset] += src_val[k];
         }
         // add embedx
-        for (int col = 0; col < embedx_dim; ++col) {
-          dest_val[info.embedx_g + col] += src_val[cvm_offset + col];
-        }
+        DedupAddTo(embedx_g, src_val + cvm_offset, embedx_dim);
       }
       for (int k = 0; k < info.embed_num; ++k) {
         dest_val[info.embed_g + k] *= -1. * bs;
       }
-      for (int col = 0; col < embedx_dim; ++col) {
-        dest_val[info.embedx_g + col] *= -1. * bs;
-      }
+      DedupScale(embedx_g, -1. * bs, embedx_dim);
     }
   });
 }
@@ -30,6 +30,7 @@ limitations under the License. */
 #endif
 
 DECLARE_bool(enable_pullpush_dedup_keys);
+DECLARE_bool(padbox_cpu_native_dedup);
 
 namespace paddle {
 namespace framework {
@@ -303,15 +304,31 @@ void BoxWrapper::PullSparseCaseCPU(const paddle::platform::Place& place,
       reinterpret_cast<uint64_t*>(&total_keys[total_length]);
 
   pull_dedup_timer.Resume();
-  int dedup_size =
-      boxps_ptr_->DedupKeysAndFillIdx(device_id,
-                                      total_length,
-                                      total_keys,     // input
-                                      d_merged_keys,  // output
-                                      d_restore_idx,  // pull fill idx
-                                      d_sorted_idx,   // sort old idx
-                                      d_offset,       // offset
-                                      d_merged_cnts);
+  int dedup_size = 0;
+  if (FLAGS_padbox_cpu_native_dedup) {
+    dedup_size = dev.cpu_dedup.Dedup(
+        [this, &place](size_t num,
+                       const std::function<void(const size_t&)>& func) {
+          this->ExecuteFunc(place, num, func);
+        },
+        total_length,
+        total_keys,
+        d_merged_keys,
+        d_restore_idx,
+        d_sorted_idx,
+        d_offset,
+        d_merged_cnts);
+  } else {
+    dedup_size =
+        boxps_ptr_->DedupKeysAndFillIdx(device_id,
+                                        total_length,
+                                        total_keys,     // input
+                                        d_merged_keys,  // output
+                                        d_restore_idx,  // pull fill idx
+                                        d_sorted_idx,   // sort old idx
+                                        d_offset,       // offset
+                                        d_merged_cnts);
+  }
   pull_dedup_timer.Pause();
   PADDLE_ENFORCE_GT(dedup_size,
                     0,
@@ -13,13 +13,19 @@
 // limitations under the License.
 #include "paddle/fluid/framework/fleet/metrics.h"
 
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <ctime>
 #include <memory>
 #include <numeric>
+#include <type_traits>
 
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/tensor_util.h"
+#include "paddle/fluid/framework/threadpool.h"
 #ifdef PADDLE_WITH_BOX_PS
 #include <boxps_extends.h>
 #endif
@@ -29,12 +35,44 @@
 PADDLE_DEFINE_EXPORTED_bool(enable_debug_print_metrics_info,
                             false,
                             "enable debug print metrics info, default false");
+PADDLE_DEFINE_EXPORTED_int32(
+    auc_calculator_shard_num,
+    4,
+    "number of per thread tables a auc calculator accumulates the batches "
+    "in, each holds two tables of bucket_size doubles, 0 adds into the "
+    "shared table under its lock, default 4");
+PADDLE_DEFINE_EXPORTED_int32(
+    wuauc_partition_num,
+    64,
+    "number of uid hash partitions the wuauc records are kept in and "
+    "computed in parallel, 0 keeps all records in one list sorted at the end "
+    "of the pass, default 64");
+PADDLE_DEFINE_EXPORTED_int64(
+    wuauc_spill_records,
+    0,
+    "wuauc records a partition keeps in memory before spilling them to a "
+    "temp file under wuauc_spill_dir, 0 never spills, default 0");
+PADDLE_DEFINE_EXPORTED_string(wuauc_spill_dir,
+                              "/tmp",
+                              "directory of the wuauc spill files");
 
 namespace paddle {
 namespace framework {
 
 std::shared_ptr<Metric> Metric::s_instance_ = nullptr;
 
+// partition of the wuauc records of uid
+static size_t WuaucPartitionOf(uint64_t uid, size_t partition_num) {
+  return ((uid * 0x9E3779B97F4A7C15ULL) >> 32) % partition_num;
+}
+
+// ordinal of the calling thread, maps the thread to its auc shard
+static size_t AucShardOrdinal() {
+  static std::atomic<size_t> next_ordinal{0};
+  thread_local size_t ordinal = next_ordinal.fetch_add(1);
+  return ordinal;
+}
+
 void BasicAucCalculator::add_unlock_data(double pred, int label) {
   PADDLE_ENFORCE_GE(pred, 0.0,
       platform::errors::PreconditionNotMet("pred should be greater than 0, pred=%f", pred));
@@ -122,6 +160,145 @@ void BasicAucCalculator::add_nan_inf_unlock_data(float pred, int label){
   }
 }
 
+template <typename LabelT>
+void BasicAucCalculator::add_shard_data(const float* pred,
+                                        const LabelT* label,
+                                        const int64_t* mask,
+                                        const float* weight,
+                                        int batch_size,
+                                        bool with_table) {
+  thread_local std::vector<double> h_pred;
+  thread_local std::vector<double> h_label;
+  thread_local std::vector<double> h_weight;
+  thread_local std::vector<int> h_pos;
+  h_pred.resize(batch_size);
+  h_label.resize(batch_size);
+  h_weight.resize(batch_size);
+  h_pos.resize(batch_size);
+  int len = 0;
+  for (int i = 0; i < batch_size; ++i) {
+    if (mask != nullptr && !mask[i]) {
+      continue;
+    }
+    h_pred[len] = pred[i];
+    h_label[len] = label[i];
+    h_weight[len] = weight != nullptr ? weight[i] : 1.0;
+    ++len;
+  }
+  if (with_table) {
+    bool valid = true;
+    for (int i = 0; i < len; ++i) {
+      valid &= (h_pred[i] >= 0.0) & (h_pred[i] <= 1.0);
+    }
+    if (std::is_integral<LabelT>::value) {
+      for (int i = 0; i < len; ++i) {
+        valid &= (h_label[i] == 0.0) | (h_label[i] == 1.0);
+      }
+    }
+    if (!valid) {
+      // report the first bad row the same way as the single adds
+      for (int i = 0; i < len; ++i) {
+        PADDLE_ENFORCE_GE(h_pred[i], 0.0,
+            platform::errors::PreconditionNotMet("pred should be greater than 0, pred=%f", h_pred[i]));
+        PADDLE_ENFORCE_LE(h_pred[i], 1.0,
+            platform::errors::PreconditionNotMet("pred should be lower than 1, pred=%f", h_pred[i]));
+        if (std::is_integral<LabelT>::value) {
+          PADDLE_ENFORCE_EQ(h_label[i] * h_label[i], h_label[i],
+              platform::errors::PreconditionNotMet(
+                  "label must be equal to 0 or 1, but its value is: %f", h_label[i]));
+        }
+      }
+    }
+    for (int i = 0; i < len; ++i) {
+      h_pos[i] = std::min(static_cast<int>(h_pred[i] * _table_size),
+                          _table_size - 1);
+    }
+  }
+  double abserr = 0;
+  double sqrerr = 0;
+  double pred_sum = 0;
+  double label_sum = 0;
+  double total_num = 0;
+  for (int i = 0; i < len; ++i) {
+    double err = h_pred[i] - h_label[i];
+    abserr += fabs(err);
+    sqrerr += err * err;
+    pred_sum += h_pred[i] * h_weight[i];
+    label_sum += h_label[i];
+    total_num += h_weight[i];
+  }
+  // h_weight becomes the negative and h_label the positive weight of the row
+  for (int i = 0; i < len; ++i) {
+    double w = h_weight[i];
+    h_weight[i] = (1.0 - h_label[i]) * w;
+    h_label[i] *= w;
+  }
+  auto add_to_table = [len](std::vector<double>* table) {
+    double* neg = table[0].data();
+    double* pos = table[1].data();
+    for (int i = 0; i < len; ++i) {
+      neg[h_pos[i]] += h_weight[i];
+      pos[h_pos[i]] += h_label[i];
+    }
+  };
+  if (_shards.empty()) {
+    std::lock_guard<std::mutex> lock(_table_mutex);
+    if (with_table) {
+      add_to_table(_table);
+    }
+    _local_abserr += abserr;
+    _local_sqrerr += sqrerr;
+    _local_pred += pred_sum;
+    _local_label += label_sum;
+    _local_total_num += total_num;
+    return;
+  }
+  auto& shard = *_shards[AucShardOrdinal() % _shards.size()];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (with_table) {
+    if (shard.table[0].empty()) {
+      shard.table[0].assign(_table_size, 0.0);
+      shard.table[1].assign(_table_size, 0.0);
+    }
+    add_to_table(shard.table);
+  }
+  shard.abserr += abserr;
+  shard.sqrerr += sqrerr;
+  shard.pred += pred_sum;
+  shard.label += label_sum;
+  shard.total_num += total_num;
+  shard.dirty = true;
+}
+
+void BasicAucCalculator::merge_shards() {
+  std::lock_guard<std::mutex> table_lock(_table_mutex);
+  for (auto& shard : _shards) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    if (!shard->dirty) {
+      continue;
+    }
+    for (int i = 0; i < 2 && !shard->table[i].empty(); ++i) {
+      double* dst = _table[i].data();
+      double* src = shard->table[i].data();
+      for (int j = 0; j < _table_size; ++j) {
+        dst[j] += src[j];
+        src[j] = 0.0;
+      }
+    }
+    _local_abserr += shard->abserr;
+    _local_sqrerr += shard->sqrerr;
+    _local_pred += shard->pred;
+    _local_label += shard->label;
+    _local_total_num += shard->total_num;
+    shard->abserr = 0;
+    shard->sqrerr = 0;
+    shard->pred = 0;
+    shard->label = 0;
+    shard->total_num = 0;
+    shard->dirty = false;
+  }
+}
+
 void BasicAucCalculator::add_data(const float* d_pred,
                                   const int64_t* d_label,
                                   int batch_size,
@@ -141,10 +318,7 @@ void BasicAucCalculator::add_data(const float* d_pred,
     SyncCopyD2H(h_label.data(), d_label, batch_size, place_label);
     add_label = h_label.data();
   }
-  std::lock_guard<std::mutex> lock(_table_mutex);
-  for (int i = 0; i < batch_size; ++i) {
-    add_unlock_data(add_pred[i], add_label[i]);
-  }
+  add_shard_data(add_pred, add_label, nullptr, nullptr, batch_size, true);
 }
 
 void BasicAucCalculator::add_sample_data(
@@ -168,10 +342,8 @@ void BasicAucCalculator::add_sample_data(
     SyncCopyD2H(h_label.data(), d_label, batch_size, place_label);
     add_label = h_label.data();
   }
-  std::lock_guard<std::mutex> lock(_table_mutex);
-  for (int i = 0; i < batch_size; ++i) {
-    add_unlock_data(add_pred[i], add_label[i], d_sample_scale[i]);
-  }
+  add_shard_data(
+      add_pred, add_label, nullptr, d_sample_scale.data(), batch_size, true);
 }
 
 // add mask data
@@ -203,12 +375,7 @@ void BasicAucCalculator::add_mask_data(const float* d_pred,
     SyncCopyD2H(h_mask.data(), d_mask, batch_size, place_mask);
     add_mask = h_mask.data();
   }
-  std::lock_guard<std::mutex> lock(_table_mutex);
-  for (int i = 0; i < batch_size; ++i) {
-    if (add_mask[i]) {
-      add_unlock_data(add_pred[i], add_label[i]);
-    }
-  }
+  add_shard_data(add_pred, add_label, add_mask, nullptr, batch_size, true);
 }
 // add float mask data
 void BasicAucCalculator::add_float_mask_data(const float* d_pred,
@@ -238,12 +405,7 @@ void BasicAucCalculator::add_float_mask_data(const float* d_pred,
     SyncCopyD2H(h_mask.data(), d_mask, batch_size, place_mask);
     add_mask = h_mask.data();
   }
-  std::lock_guard<std::mutex> lock(_table_mutex);
-  for (int i = 0; i < batch_size; ++i) {
-    if (add_mask[i]) {
-      add_unlock_data_with_float_label(add_pred[i], add_label[i]);
-    }
-  }
+  add_shard_data(add_pred, add_label, add_mask, nullptr, batch_size, true);
 }
 
 // add continue mask data
@@ -276,12 +438,7 @@ void BasicAucCalculator::add_continue_mask_data(
     SyncCopyD2H(h_mask.data(), d_mask, batch_size, place_mask);
     add_mask = h_mask.data();
   }
-  std::lock_guard<std::mutex> lock(_table_mutex);
-  for (int i = 0; i < batch_size; ++i) {
-    if (add_mask[i]) {
-      add_unlock_data_with_continue_label(add_pred[i], add_label[i]);
-    }
-  }
+  add_shard_data(add_pred, add_label, add_mask, nullptr, batch_size, false);
 }
 
 void BasicAucCalculator::init(int table_size, int max_batch_size) {
@@ -291,6 +448,10 @@ void BasicAucCalculator::init(int table_size, int max_batch_size) {
   for (int i = 0; i < 2; i++) {
     _table[i] = std::vector<double>();
   }
+  _shards.clear();
+  for (int i = 0; i < FLAGS_auc_calculator_shard_num; ++i) {
+    _shards.emplace_back(new AucShard());
+  }
   // reset
   reset();
 }
@@ -300,6 +461,19 @@ void BasicAucCalculator::reset() {
   for (int i = 0; i < 2; i++) {
     _table[i].assign(_table_size, 0.0);
   }
+  // the shard tables keep their memory for the next pass
+  for (auto& shard : _shards) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    for (int i = 0; i < 2; i++) {
+      std::fill(shard->table[i].begin(), shard->table[i].end(), 0.0);
+    }
+    shard->abserr = 0;
+    shard->sqrerr = 0;
+    shard->pred = 0;
+    shard->label = 0;
+    shard->total_num = 0;
+    shard->dirty = false;
+  }
   _local_abserr = 0;
   _local_sqrerr = 0;
   _local_pred = 0;
@@ -308,6 +482,7 @@ void BasicAucCalculator::reset() {
 }
 
 void BasicAucCalculator::compute() {
+  merge_shards();
   int node_size = 1;
   double* table[2] = {&_table[0][0], &_table[1][0]};
 #ifdef PADDLE_WITH_BOX_PS
@@ -437,6 +612,15 @@ void BasicAucCalculator::calculate_bucket_error(
 void BasicAucCalculator::reset_records() {
   // reset wuauc_records_
   wuauc_records_.clear();
+  for (auto& part : wuauc_partitions_) {
+    std::lock_guard<std::mutex> lock(part->mutex);
+    part->records.clear();
+    if (part->spill_file != nullptr) {
+      fclose(part->spill_file);
+      part->spill_file = nullptr;
+    }
+    part->spill_num = 0;
+  }
   _user_cnt = 0;
   _size = 0;
   _uauc = 0;
@@ -469,9 +653,13 @@ void BasicAucCalculator::add_uid_data(const float* d_pred,
   }
   if (platform::is_gpu_place(place_uid) || platform::is_xpu_place(place_uid)) {
     h_uid.resize(batch_size);
-    SyncCopyD2H(h_uid.data(), d_label, batch_size, place_uid);
+    SyncCopyD2H(h_uid.data(), d_uid, batch_size, place_uid);
     add_uid = h_uid.data();
   }
+  if (FLAGS_wuauc_partition_num > 0) {
+    add_uid_partition_data(add_pred, add_label, add_uid, batch_size);
+    return;
+  }
   std::lock_guard<std::mutex> lock(_table_mutex);
   for (int i = 0; i < batch_size; ++i) {
       add_uid_unlock_data(add_pred[i], add_label[i],
@@ -480,6 +668,89 @@ void BasicAucCalculator::add_uid_data(const float* d_pred,
 }
 
 
+void BasicAucCalculator::add_uid_partition_data(const float* pred,
+                                                const int64_t* label,
+                                                const int64_t* uid,
+                                                int batch_size) {
+  std::call_once(wuauc_partition_once_, [this]() {
+    for (int i = 0; i < FLAGS_wuauc_partition_num; ++i) {
+      wuauc_partitions_.emplace_back(new WuaucPartition());
+    }
+  });
+  bool valid = true;
+  for (int i = 0; i < batch_size; ++i) {
+    valid &= (pred[i] >= 0.0f) & (pred[i] <= 1.0f) &
+             ((label[i] == 0) | (label[i] == 1));
+  }
+  if (!valid) {
+    for (int i = 0; i < batch_size; ++i) {
+      PADDLE_ENFORCE_GE(
+          static_cast<double>(pred[i]),
+          0.0,
+          platform::errors::PreconditionNotMet("pred should be greater than 0"));
+      PADDLE_ENFORCE_LE(
+          static_cast<double>(pred[i]),
+          1.0,
+          platform::errors::PreconditionNotMet("pred should be lower than 1"));
+      PADDLE_ENFORCE_EQ(
+          label[i] * label[i],
+          label[i],
+          platform::errors::PreconditionNotMet(
+              "label must be equal to 0 or 1, but its value is: %d", label[i]));
+    }
+  }
+  // bucket the batch by partition first, each partition is locked once
+  const size_t partition_num = wuauc_partitions_.size();
+  thread_local std::vector<std::vector<WuaucRecord>> staged;
+  staged.resize(partition_num);
+  for (int i = 0; i < batch_size; ++i) {
+    WuaucRecord record;
+    record.uid_ = static_cast<uint64_t>(uid[i]);
+    record.label_ = static_cast<int>(label[i]);
+    record.pred_ = pred[i];
+    staged[WuaucPartitionOf(record.uid_, partition_num)].push_back(record);
+  }
+  const size_t spill_records = static_cast<size_t>(FLAGS_wuauc_spill_records);
+  for (size_t p = 0; p < partition_num; ++p) {
+    auto& records = staged[p];
+    if (records.empty()) {
+      continue;
+    }
+    auto& part = *wuauc_partitions_[p];
+    std::lock_guard<std::mutex> lock(part.mutex);
+    part.records.insert(part.records.end(), records.begin(), records.end());
+    records.clear();
+    if (spill_records == 0 || part.records.size() < spill_records) {
+      continue;
+    }
+    if (part.spill_file == nullptr) {
+      std::string path = FLAGS_wuauc_spill_dir + "/wuauc_spill_XXXXXX";
+      int fd = mkstemp(&path[0]);
+      PADDLE_ENFORCE_GE(fd,
+                        0,
+                        platform::errors::Unavailable(
+                            "create wuauc spill file %s failed", path));
+      unlink(path.c_str());
+      part.spill_file = fdopen(fd, "w+b");
+      PADDLE_ENFORCE_NOT_NULL(part.spill_file,
+                              platform::errors::Unavailable(
+                                  "open wuauc spill file %s failed", path));
+    }
+    size_t written = fwrite(part.records.data(),
+                            sizeof(WuaucRecord),
+                            part.records.size(),
+                            part.spill_file);
+    PADDLE_ENFORCE_EQ(written,
+                      part.records.size(),
+                      platform::errors::Unavailable(
+                          "write wuauc spill file failed, %lu of %lu records",
+                          written,
+                          part.records.size()));
+    part.spill_num += written;
+    part.records.clear();
+  }
+}
+
 void BasicAucCalculator::add_nan_inf_data(const float* d_pred,
                                           const int64_t* d_label,
                                           int batch_size,
@@ -499,10 +770,16 @@ void BasicAucCalculator::add_nan_inf_data(const float* d_pred,
     SyncCopyD2H(h_label.data(), d_label, batch_size, place_label);
     add_label = h_label.data();
   }
-  std::lock_guard<std::mutex> lock(_table_mutex);
+  double nan_cnt = 0;
+  double inf_cnt = 0;
   for (int i = 0; i < batch_size; ++i) {
-    add_nan_inf_unlock_data(add_pred[i], add_label[i]);
+    nan_cnt += std::isnan(add_pred[i]);
+    inf_cnt += std::isinf(add_pred[i]);
   }
+  std::lock_guard<std::mutex> lock(_table_mutex);
+  _size += batch_size;
+  _nan_cnt += nan_cnt;
+  _inf_cnt += inf_cnt;
 }
 
 void BasicAucCalculator::add_uid_unlock_data(double pred,
@@ -530,6 +807,10 @@ void BasicAucCalculator::add_uid_unlock_data(double pred,
 }
 
 void BasicAucCalculator::computeWuAuc() {
+  if (!wuauc_partitions_.empty()) {
+    computePartitionWuAuc();
+    return;
+  }
   std::sort(wuauc_records_.begin(),
             wuauc_records_.end(),
             [](const WuaucRecord& lhs, const WuaucRecord& rhs) {
@@ -543,42 +824,90 @@ void BasicAucCalculator::computeWuAuc() {
                 return lhs.uid_ > rhs.uid_;
               }
             });
+  double sum[4] = {0, 0, 0, 0};
+  reduceUserAuc(wuauc_records_.data(),
+                wuauc_records_.data() + wuauc_records_.size(),
+                sum);
+  _user_cnt += sum[0];
+  _size += sum[1];
+  _uauc += sum[2];
+  _wuauc += sum[3];
+}
 
-  WuaucRocData roc_data;
-  uint64_t prev_uid = 0;
-  size_t prev_pos = 0;
-  for (size_t i = 0; i < wuauc_records_.size(); ++i) {
-    if (wuauc_records_[i].uid_ != prev_uid) {
-      std::vector<WuaucRecord> single_user_recs(
-          wuauc_records_.begin() + prev_pos, wuauc_records_.begin() + i);
-      roc_data = computeSingelUserAuc(single_user_recs);
-      if (roc_data.auc_ != -1) {
-        double ins_num = (roc_data.tp_ + roc_data.fp_);
-        _user_cnt += 1;
-        _size += ins_num;
-        _uauc += roc_data.auc_;
-        _wuauc += roc_data.auc_ * ins_num;
-      }
-
-      prev_uid = wuauc_records_[i].uid_;
-      prev_pos = i;
+void BasicAucCalculator::computePartitionWuAuc() {
+  // the users of a partition are all in it, the partitions are sorted and
+  // reduced in parallel, the spilled ones are read back one by one
+  const size_t partition_num = wuauc_partitions_.size();
+  std::vector<double> sums(partition_num * 4, 0.0);
+  parallel_run_dynamic(partition_num, [this, &sums](size_t p) {
+    auto& part = *wuauc_partitions_[p];
+    std::lock_guard<std::mutex> lock(part.mutex);
+    std::vector<WuaucRecord> spilled;
+    std::vector<WuaucRecord>* records = &part.records;
+    if (part.spill_num > 0) {
+      spilled.resize(part.spill_num + part.records.size());
+      fseek(part.spill_file, 0, SEEK_SET);
+      size_t read = fread(
+          spilled.data(), sizeof(WuaucRecord), part.spill_num, part.spill_file);
+      PADDLE_ENFORCE_EQ(read,
+                        part.spill_num,
+                        platform::errors::Unavailable(
+                            "read wuauc spill file failed, %lu of %lu records",
+                            read,
+                            part.spill_num));
+      fseek(part.spill_file, 0, SEEK_END);
+      std::copy(part.records.begin(),
+                part.records.end(),
+                spilled.begin() + part.spill_num);
+      records = &spilled;
     }
+    std::sort(records->begin(),
+              records->end(),
+              [](const WuaucRecord& lhs, const WuaucRecord& rhs) {
+                if (lhs.uid_ != rhs.uid_) {
+                  return lhs.uid_ > rhs.uid_;
+                }
+                return lhs.pred_ > rhs.pred_;
+              });
+    reduceUserAuc(
+        records->data(), records->data() + records->size(), &sums[p * 4]);
+  });
+  for (size_t p = 0; p < partition_num; ++p) {
+    _user_cnt += sums[p * 4];
+    _size += sums[p * 4 + 1];
+    _uauc += sums[p * 4 + 2];
+    _wuauc += sums[p * 4 + 3];
   }
+}
 
-  std::vector<WuaucRecord> single_user_recs(wuauc_records_.begin() + prev_pos,
-                                            wuauc_records_.end());
-  roc_data = computeSingelUserAuc(single_user_recs);
-  if (roc_data.auc_ != -1) {
-    double ins_num = (roc_data.tp_ + roc_data.fp_);
-    _user_cnt += 1;
-    _size += ins_num;
-    _uauc += roc_data.auc_;
-    _wuauc += roc_data.auc_ * ins_num;
+void BasicAucCalculator::reduceUserAuc(const WuaucRecord* begin,
+                                       const WuaucRecord* end,
+                                       double* sum) {
+  while (begin < end) {
+    const WuaucRecord* user_end = begin + 1;
+    while (user_end < end && user_end->uid_ == begin->uid_) {
+      ++user_end;
+    }
+    WuaucRocData roc_data = computeSingelUserAuc(begin, user_end);
+    if (roc_data.auc_ != -1) {
+      double ins_num = (roc_data.tp_ + roc_data.fp_);
+      sum[0] += 1;
+      sum[1] += ins_num;
+      sum[2] += roc_data.auc_;
+      sum[3] += roc_data.auc_ * ins_num;
+    }
+    begin = user_end;
   }
 }
 
 BasicAucCalculator::WuaucRocData BasicAucCalculator::computeSingelUserAuc(
     const std::vector<WuaucRecord>& records) {
+  return computeSingelUserAuc(records.data(), records.data() + records.size());
+}
+
+BasicAucCalculator::WuaucRocData BasicAucCalculator::computeSingelUserAuc(
+    const WuaucRecord* records, const WuaucRecord* end) {
+  const size_t size = end - records;
   double tp = 0.0;
   double fp = 0.0;
   double newtp = 0.0;
@@ -587,7 +916,7 @@ BasicAucCalculator::WuaucRocData BasicAucCalculator::computeSingelUserAuc(
   double auc = -1;
   size_t i = 0;
 
-  while (i < records.size()) {
+  while (i < size) {
     newtp = tp;
     newfp = fp;
     if (records[i].label_ == 1) {
@@ -596,7 +925,7 @@ BasicAucCalculator::WuaucRocData BasicAucCalculator::computeSingelUserAuc(
       newfp += 1;
     }
     // check i+1
-    while (i < records.size() - 1 && records[i].pred_ == records[i + 1].pred_) {
+    while (i + 1 < size && records[i].pred_ == records[i + 1].pred_) {
       if (records[i + 1].label_ == 1) {
         newtp += 1;
       } else {
@@ -627,6 +956,7 @@ void BasicAucCalculator::reset_nan_inf() {
 }
 
 void BasicAucCalculator::computeContinueMsg() {
+  merge_shards();
   int node_size = 1;
 #ifdef PADDLE_WITH_BOX_PS
   node_size = boxps::MPICluster::Ins().size();
@@ -15,9 +15,11 @@ limitations under the License. */
 #pragma once
 
 #include <atomic>
+#include <cstdio>
 #include <ctime>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <random>
 #include <string>
 #include <unordered_map>
@@ -79,6 +81,8 @@ class BasicAucCalculator {
                           std::vector<double>& value,
                           const paddle::platform::Place& place);
   void add_nan_inf_unlock_data(float pred, int label);
+  // the batch adds below bucketize into the shard of the calling thread, the
+  // shards are merged into the table by compute() and computeContinueMsg()
   // add batch data
   void add_data(const float* d_pred,
                 const int64_t* d_label,
@@ -162,6 +166,8 @@ class BasicAucCalculator {
   void add_uid_unlock_data(double pred, int label, uint64_t uid);
   void computeWuAuc();
   WuaucRocData computeSingelUserAuc(const std::vector<WuaucRecord>& records);
+  WuaucRocData computeSingelUserAuc(const WuaucRecord* begin,
+                                    const WuaucRecord* end);
   void computeNanInfMsg();
   double uauc() const { return _uauc; }
   double wuauc() const { return _wuauc; }
@@ -180,6 +186,25 @@ class BasicAucCalculator {
                           const int64_t* mask,
                           int len);
   void calculate_bucket_error(const double* neg_table, const double* pos_table);
+  void add_uid_partition_data(const float* pred,
+                              const int64_t* label,
+                              const int64_t* uid,
+                              int batch_size);
+  void computePartitionWuAuc();
+  // adds user_cnt, size, uauc and wuauc of the records grouped by uid to sum
+  void reduceUserAuc(const WuaucRecord* begin,
+                     const WuaucRecord* end,
+                     double* sum);
+  // adds the rows i with a nonzero mask[i] (all rows when mask is null) with
+  // weight[i] (1 when weight is null), with_table false only sums the errors
+  template <typename LabelT>
+  void add_shard_data(const float* pred,
+                      const LabelT* label,
+                      const int64_t* mask,
+                      const float* weight,
+                      int batch_size,
+                      bool with_table);
+  void merge_shards();
 
  protected:
   double _local_abserr = 0;
@@ -201,6 +226,21 @@ class BasicAucCalculator {
   double _uauc = 0;
   double _wuauc = 0;
   std::vector<WuaucRecord> wuauc_records_;
+  // records of the uids hashed to the partition, the records over
+  // FLAGS_wuauc_spill_records are appended to an unlinked temp file
+  struct WuaucPartition {
+    ~WuaucPartition() {
+      if (spill_file != nullptr) {
+        fclose(spill_file);
+      }
+    }
+    std::mutex mutex;
+    std::vector<WuaucRecord> records;
+    FILE* spill_file = nullptr;
+    size_t spill_num = 0;
+  };
+  std::vector<std::unique_ptr<WuaucPartition>> wuauc_partitions_;
+  std::once_flag wuauc_partition_once_;
 
   double _nan_cnt = 0;
   double _inf_cnt = 0;
@@ -215,9 +255,22 @@ class BasicAucCalculator {
   }
   void collect_data_nccl();
   void copy_data_d2h(int device);
+  // partial table and sums of the threads mapped to it, the table is
+  // allocated on the first add and kept across passes
+  struct AucShard {
+    std::mutex mutex;
+    std::vector<double> table[2];
+    double abserr = 0;
+    double sqrerr = 0;
+    double pred = 0;
+    double label = 0;
+    double total_num = 0;
+    bool dirty = false;
+  };
   int _table_size = 0;
   int _max_batch_size = 0;
   std::vector<double> _table[2];
+  std::vector<std::unique_ptr<AucShard>> _shards;
   static constexpr double kRelativeErrorBound = 0.05;
   static constexpr double kMaxSpan = 0.01;
   std::mutex _table_mutex;
@@ -430,18 +483,26 @@ class Metric {
                 batch_size,
                 pred_data_list[i].size()));
       }
-      auto cal = GetCalculator();
-      std::lock_guard<std::mutex> lock(cal->table_mutex());
+      std::vector<float> pred_data(batch_size, 0);
+      std::vector<int64_t> mask_data(batch_size, 0);
       for (size_t i = 0; i < batch_size; ++i) {
         auto cmatch_rank_it = std::find(cmatch_rank_v.begin(),
                                         cmatch_rank_v.end(),
                                         parse_cmatch_rank(cmatch_rank_data[i]));
         if (cmatch_rank_it != cmatch_rank_v.end()) {
-          cal->add_unlock_data(pred_data_list[std::distance(
-                                   cmatch_rank_v.begin(), cmatch_rank_it)][i],
-                               label_data[i]);
+          pred_data[i] = pred_data_list[std::distance(cmatch_rank_v.begin(),
+                                                      cmatch_rank_it)][i];
+          mask_data[i] = 1;
         }
       }
+      auto cal = GetCalculator();
+      cal->add_mask_data(pred_data.data(),
+                         label_data.data(),
+                         mask_data.data(),
+                         batch_size,
+                         platform::CPUPlace(),
+                         platform::CPUPlace(),
+                         platform::CPUPlace());
     }
 
    protected:
@@ -506,8 +567,7 @@ class Metric {
               "illegal batch size: cmatch_rank[%lu] and pred_data[%lu]",
               batch_size,
               pred_data.size()));
-      auto cal = GetCalculator();
-      std::lock_guard<std::mutex> lock(cal->table_mutex());
+      std::vector<int64_t> mask_data(batch_size, 0);
       for (size_t i = 0; i < batch_size; ++i) {
         const auto& cur_cmatch_rank = parse_cmatch_rank(cmatch_rank_data[i]);
         for (size_t j = 0; j < cmatch_rank_v.size(); ++j) {
@@ -518,11 +578,19 @@ class Metric {
             is_matched = cmatch_rank_v[j] == cur_cmatch_rank;
           }
           if (is_matched) {
-            cal->add_unlock_data(pred_data[i], label_data[i]);
+            mask_data[i] = 1;
             break;
           }
         }
       }
+      auto cal = GetCalculator();
+      cal->add_mask_data(pred_data.data(),
+                         label_data.data(),
+                         mask_data.data(),
+                         batch_size,
+                         platform::CPUPlace(),
+                         platform::CPUPlace(),
+                         platform::CPUPlace());
     }
 
    protected:
@@ -646,14 +714,13 @@ class Metric {
                 mask_data.size()));
       }
 
-      auto cal = GetCalculator();
-      std::lock_guard<std::mutex> lock(cal->table_mutex());
+      std::vector<int64_t> add_mask(batch_size, 0);
       for (size_t i = 0; i < batch_size; ++i) {
+        if (!mask_data.empty() && !mask_data[i]) {
+          continue;
+        }
         const auto& cur_cmatch_rank = parse_cmatch_rank(cmatch_rank_data[i]);
         for (size_t j = 0; j < cmatch_rank_v.size(); ++j) {
-          if (!mask_data.empty() && !mask_data[i]) {
-            continue;
-          }
           bool is_matched = false;
           if (ignore_rank_) {
             is_matched = cmatch_rank_v[j].first == cur_cmatch_rank.first;
@@ -661,11 +728,19 @@ class Metric {
             is_matched = cmatch_rank_v[j] == cur_cmatch_rank;
           }
           if (is_matched) {
-            cal->add_unlock_data(pred_data[i], label_data[i]);
+            add_mask[i] = 1;
             break;
           }
         }
       }
+      auto cal = GetCalculator();
+      cal->add_mask_data(pred_data.data(),
+                         label_data.data(),
+                         add_mask.data(),
+                         batch_size,
+                         platform::CPUPlace(),
+                         platform::CPUPlace(),
+                         platform::CPUPlace());
     }
 
    protected:
@@ -0,0 +1,226 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include "paddle/fluid/framework/fleet/metrics.h"
+
+#include <functional>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+
+DECLARE_int32(auc_calculator_shard_num);
+DECLARE_int32(wuauc_partition_num);
+DECLARE_int64(wuauc_spill_records);
+DECLARE_string(wuauc_spill_dir);
+
+namespace paddle {
+namespace framework {
+
+static const int kBatchNum = 64;
+static const int kBatchSize = 1000;
+static const int kThreadNum = 8;
+
+// the preds, labels and weights are multiples of 1/256, so the sums are
+// exact whatever order the shards add them in
+struct AucBatch {
+  std::vector<float> pred;
+  std::vector<int64_t> label;
+  std::vector<float> float_label;
+  std::vector<float> continue_label;
+  std::vector<int64_t> mask;
+  std::vector<float> scale;
+  std::vector<int64_t> uid;
+};
+
+static AucBatch MakeBatch(int b) {
+  AucBatch batch;
+  for (int i = 0; i < kBatchSize; ++i) {
+    int k = b * kBatchSize + i;
+    int bucket = (k * 7919) % 257;
+    batch.pred.push_back(bucket / 256.0f);
+    batch.label.push_back((k % 5 < bucket % 3) ? 1 : 0);
+    batch.float_label.push_back((k % 5) / 4.0f);
+    batch.continue_label.push_back((k % 13) / 8.0f);
+    batch.mask.push_back(k % 3 != 0);
+    batch.scale.push_back((k % 4 + 1) / 2.0f);
+    // users of a few to a few hundred records, some of one label only
+    batch.uid.push_back((k * 31) % (k % 7 == 0 ? 97 : 3001));
+  }
+  return batch;
+}
+
+using AddBatch = std::function<void(BasicAucCalculator*, const AucBatch&)>;
+
+// adds the kBatchNum batches from thread_num threads
+static void RunPass(BasicAucCalculator* cal,
+                    const AddBatch& add,
+                    int thread_num) {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([cal, &add, t, thread_num]() {
+      for (int b = t; b < kBatchNum; b += thread_num) {
+        add(cal, MakeBatch(b));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+// two passes, the shard tables are reused by the second one. continue_value
+// compares the msg of computeContinueMsg instead of compute
+static void ExpectSameAuc(const AddBatch& add, bool continue_value = false) {
+  int shard_num = FLAGS_auc_calculator_shard_num;
+  FLAGS_auc_calculator_shard_num = 0;
+  BasicAucCalculator expect;
+  expect.init(1000000);
+  FLAGS_auc_calculator_shard_num = 4;
+  BasicAucCalculator cal;
+  cal.init(1000000);
+  FLAGS_auc_calculator_shard_num = shard_num;
+  for (int pass = 0; pass < 2; ++pass) {
+    expect.reset();
+    cal.reset();
+    RunPass(&expect, add, 1);
+    RunPass(&cal, add, kThreadNum);
+    if (continue_value) {
+      expect.computeContinueMsg();
+      cal.computeContinueMsg();
+      ASSERT_EQ(cal.actual_value(), expect.actual_value());
+      ASSERT_EQ(cal.predicted_value(), expect.predicted_value());
+    } else {
+      expect.compute();
+      cal.compute();
+      ASSERT_EQ(cal.auc(), expect.auc());
+      ASSERT_EQ(cal.bucket_error(), expect.bucket_error());
+      ASSERT_EQ(cal.actual_ctr(), expect.actual_ctr());
+      ASSERT_EQ(cal.predicted_ctr(), expect.predicted_ctr());
+    }
+    ASSERT_EQ(cal.size(), expect.size());
+    ASSERT_EQ(cal.mae(), expect.mae());
+    ASSERT_EQ(cal.rmse(), expect.rmse());
+  }
+}
+
+TEST(BasicAucCalculator, ShardedAddData) {
+  platform::CPUPlace place;
+  ExpectSameAuc([place](BasicAucCalculator* cal, const AucBatch& batch) {
+    cal->add_data(
+        batch.pred.data(), batch.label.data(), kBatchSize, place, place);
+  });
+}
+
+TEST(BasicAucCalculator, ShardedAddSampleData) {
+  platform::CPUPlace place;
+  ExpectSameAuc([place](BasicAucCalculator* cal, const AucBatch& batch) {
+    cal->add_sample_data(batch.pred.data(),
+                         batch.label.data(),
+                         batch.scale,
+                         kBatchSize,
+                         place,
+                         place);
+  });
+}
+
+TEST(BasicAucCalculator, ShardedAddMaskData) {
+  platform::CPUPlace place;
+  ExpectSameAuc([place](BasicAucCalculator* cal, const AucBatch& batch) {
+    cal->add_mask_data(batch.pred.data(),
+                       batch.label.data(),
+                       batch.mask.data(),
+                       kBatchSize,
+                       place,
+                       place,
+                       place);
+  });
+}
+
+TEST(BasicAucCalculator, ShardedAddFloatMaskData) {
+  platform::CPUPlace place;
+  ExpectSameAuc([place](BasicAucCalculator* cal, const AucBatch& batch) {
+    cal->add_float_mask_data(batch.pred.data(),
+                             batch.float_label.data(),
+                             batch.mask.data(),
+                             kBatchSize,
+                             place,
+                             place,
+                             place);
+  });
+}
+
+TEST(BasicAucCalculator, ShardedAddContinueMaskData) {
+  platform::CPUPlace place;
+  ExpectSameAuc(
+      [place](BasicAucCalculator* cal, const AucBatch& batch) {
+        cal->add_continue_mask_data(batch.pred.data(),
+                                    batch.continue_label.data(),
+                                    batch.mask.data(),
+                                    kBatchSize,
+                                    place,
+                                    place,
+                                    place);
+      },
+      true);
+}
+
+// the uid records kept in partitions and spilled to files give the uauc of
+// the records kept in one list
+TEST(BasicAucCalculator, PartitionWuAuc) {
+  int partition_num = FLAGS_wuauc_partition_num;
+  int64_t spill_records = FLAGS_wuauc_spill_records;
+  std::string spill_dir = FLAGS_wuauc_spill_dir;
+  platform::CPUPlace place;
+  AddBatch add = [place](BasicAucCalculator* cal, const AucBatch& batch) {
+    cal->add_uid_data(batch.pred.data(),
+                      batch.label.data(),
+                      batch.uid.data(),
+                      kBatchSize,
+                      place,
+                      place,
+                      place);
+  };
+  FLAGS_wuauc_spill_dir = ::testing::TempDir();
+  // the partitions are created on the first add
+  for (int64_t spill : {0, 100}) {
+    FLAGS_wuauc_spill_records = spill;
+    BasicAucCalculator expect;
+    expect.init(1000000);
+    BasicAucCalculator cal;
+    cal.init(1000000);
+    for (int pass = 0; pass < 2; ++pass) {
+      expect.reset_records();
+      cal.reset_records();
+      FLAGS_wuauc_partition_num = 0;
+      RunPass(&expect, add, 1);
+      FLAGS_wuauc_partition_num = 8;
+      RunPass(&cal, add, kThreadNum);
+      expect.computeWuAuc();
+      cal.computeWuAuc();
+      ASSERT_EQ(cal.user_cnt(), expect.user_cnt()) << "spill " << spill;
+      ASSERT_EQ(cal.size(), expect.size()) << "spill " << spill;
+      ASSERT_NEAR(cal.uauc(), expect.uauc(), 1e-9 * expect.user_cnt());
+      ASSERT_NEAR(cal.wuauc(), expect.wuauc(), 1e-9 * expect.size());
+    }
+  }
+  FLAGS_wuauc_partition_num = partition_num;
+  FLAGS_wuauc_spill_records = spill_records;
+  FLAGS_wuauc_spill_dir = spill_dir;
+}
+
+}  // namespace framework
+}  // namespace paddle
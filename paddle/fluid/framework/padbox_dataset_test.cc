@@ -0,0 +1,392 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_set>
+#include <vector>
+
+#include "paddle/fluid/framework/data_set.h"
+#include "paddle/fluid/framework/fleet/box_wrapper.h"
+#include "paddle/fluid/framework/threadpool.h"
+
+namespace paddle {
+namespace framework {
+
+// the stat is read from another thread while the passes create and release
+// the channels
+TEST(PadBoxSlotDataset, PipelineStatWhileRelease) {
+  BoxWrapper::SetInstance();
+  PadBoxSlotDataset dataset;
+  dataset.CreateChannel();
+  auto stat = dataset.GetPipelineStat();
+  ASSERT_EQ(stat.count("input_channel.size"), 1UL);
+  ASSERT_EQ(stat.count("shuffle_channel.size"), 1UL);
+  ASSERT_EQ(stat["input_channel.size"], 0);
+
+  std::atomic<bool> done{false};
+  std::thread reader([&dataset, &done]() {
+    while (!done) {
+      auto stat = dataset.GetPipelineStat();
+      ASSERT_EQ(stat.count("read.records"), 1UL);
+    }
+  });
+  for (int pass = 0; pass < 1000; ++pass) {
+    dataset.ReleaseMemory();
+    dataset.CreateChannel();
+  }
+  done = true;
+  reader.join();
+
+  dataset.ReleaseMemory();
+  stat = dataset.GetPipelineStat();
+  ASSERT_EQ(stat.count("input_channel.size"), 0UL);
+  ASSERT_EQ(stat.count("shuffle_channel.size"), 0UL);
+}
+
+// records of empty slots, slots of a few keys and a slot larger than the
+// shuffle block
+static std::vector<std::unique_ptr<SlotRecordObject>> MakeShuffleRecords(
+    int num) {
+  std::vector<std::unique_ptr<SlotRecordObject>> records;
+  for (int i = 0; i < num; ++i) {
+    records.emplace_back(new SlotRecordObject());
+    auto* rec = records.back().get();
+    std::vector<std::vector<uint64_t>> uint64_feasigns(3);
+    for (int k = 0; k < i % 5; ++k) {
+      uint64_feasigns[0].push_back(i * 100 + k);
+    }
+    if (i % 97 == 0) {
+      uint64_feasigns[2].resize(1000, i);
+    }
+    std::vector<std::vector<float>> float_feasigns(2);
+    if (i % 3 != 0) {
+      float_feasigns[1].push_back(i * 0.5f);
+    }
+    rec->slot_uint64_feasigns_.add_slot_feasigns(uint64_feasigns, 0);
+    rec->slot_float_feasigns_.add_slot_feasigns(float_feasigns, 0);
+    rec->ins_id_ = (i % 7 == 0) ? "" : "ins_" + std::to_string(i);
+    rec->search_id = i * 7919ULL;
+    rec->rank = i % 4;
+    rec->cmatch = 222;
+    rec->user_id_ = "u" + std::to_string(i % 13);
+    rec->user_id_sign_ = i % 13;
+    rec->cur_timestamp_ = 1000 + i;
+    rec->show_timestamp_ = 2000 + i;
+  }
+  return records;
+}
+
+static void ExpectSameRecord(const SlotRecord& rec, const SlotRecord& expect) {
+  EXPECT_EQ(rec->ins_id_, expect->ins_id_);
+  EXPECT_EQ(rec->search_id, expect->search_id);
+  EXPECT_EQ(rec->rank, expect->rank);
+  EXPECT_EQ(rec->cmatch, expect->cmatch);
+  EXPECT_EQ(rec->user_id_, expect->user_id_);
+  EXPECT_EQ(rec->user_id_sign_, expect->user_id_sign_);
+  EXPECT_EQ(rec->cur_timestamp_, expect->cur_timestamp_);
+  EXPECT_EQ(rec->show_timestamp_, expect->show_timestamp_);
+  EXPECT_TRUE(rec->slot_uint64_feasigns_.slot_values ==
+              expect->slot_uint64_feasigns_.slot_values);
+  EXPECT_TRUE(rec->slot_uint64_feasigns_.slot_offsets ==
+              expect->slot_uint64_feasigns_.slot_offsets);
+  EXPECT_TRUE(rec->slot_float_feasigns_.slot_values ==
+              expect->slot_float_feasigns_.slot_values);
+  EXPECT_TRUE(rec->slot_float_feasigns_.slot_offsets ==
+              expect->slot_float_feasigns_.slot_offsets);
+}
+
+// rank 0 of two, the shuffle threads of rank 0 are done and rank 1 sends
+// its blocks
+class BlockShuffleDataset : public PadBoxSlotDataset {
+ public:
+  BlockShuffleDataset() {
+    mpi_size_ = 2;
+    mpi_rank_ = 0;
+    shuffle_block_mode_ = true;
+    finished_counter_ = 1;
+    mpi_flags_.assign(mpi_size_, 1);
+    CreateChannel();
+  }
+  void Decode(const std::vector<char>& buffer,
+              std::vector<SlotRecord>* records) {
+    DecodeShuffleBlock(buffer, records);
+  }
+  bool Read(std::vector<SlotRecord>* records) {
+    return ReadShuffleBlock(records);
+  }
+};
+
+// the size prefixed records of the sent blocks decode to the same records
+TEST(PadBoxSlotDataset, ShuffleBlockRoundTrip) {
+  BoxWrapper::SetInstance();
+  BlockShuffleDataset dataset;
+  auto records = MakeShuffleRecords(500);
+  std::vector<std::vector<char>> messages;
+  ShuffleBlockSender sender(
+      2,
+      1024,
+      [&messages](int rank,
+                  const char* buf,
+                  int len,
+                  boxps::ResultCallback* callback) {
+        EXPECT_EQ(rank, 1);
+        messages.emplace_back(buf, buf + len);
+        callback->on_notify();
+      });
+  for (auto& rec : records) {
+    sender.Add(1, rec.get());
+  }
+  sender.Flush();
+  ASSERT_GT(messages.size(), 1UL);
+
+  std::vector<SlotRecord> decoded;
+  for (auto& message : messages) {
+    std::vector<SlotRecord> block;
+    dataset.Decode(message, &block);
+    decoded.insert(decoded.end(), block.begin(), block.end());
+  }
+  ASSERT_EQ(decoded.size(), records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    ExpectSameRecord(decoded[i], records[i].get());
+  }
+  SlotRecordPool().put(&decoded);
+}
+
+// the callbacks come late, so the in flight block must not be reused before
+// them. The partial last block is received before the close message
+TEST(PadBoxSlotDataset, ShuffleBlockPartialBlockAndClose) {
+  BoxWrapper::SetInstance();
+  BlockShuffleDataset dataset;
+  auto records = MakeShuffleRecords(1000);
+  std::mutex mutex;
+  std::vector<std::thread> receivers;
+  ShuffleBlockSender sender(
+      2,
+      4096,
+      [&dataset, &mutex, &receivers](int rank,
+                                     const char* buf,
+                                     int len,
+                                     boxps::ResultCallback* callback) {
+        std::lock_guard<std::mutex> lock(mutex);
+        receivers.emplace_back([&dataset, buf, len, callback]() {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          dataset.ReceiveSuffleData(1, buf, len);
+          callback->on_notify();
+        });
+      });
+  for (auto& rec : records) {
+    sender.Add(1, rec.get());
+  }
+  sender.Flush();
+  dataset.ReceiveSuffleData(1, nullptr, 0);
+  for (auto& receiver : receivers) {
+    receiver.join();
+  }
+
+  std::vector<SlotRecord> decoded;
+  std::vector<SlotRecord> block;
+  while (dataset.Read(&block)) {
+    decoded.insert(decoded.end(), block.begin(), block.end());
+    block.clear();
+  }
+  ASSERT_EQ(decoded.size(), records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    ExpectSameRecord(decoded[i], records[i].get());
+  }
+  SlotRecordPool().put(&decoded);
+}
+
+class ColumnarArchiveFeed : public SlotPaddleBoxDataFeed {
+ public:
+  int Load(const std::string& filename) {
+    return LoadColumnarArchiveFile(filename);
+  }
+};
+
+// the records written to a columnar archive load back the same, the blocks
+// are split by the block size and by the slot num changing
+TEST(SlotPaddleBoxDataFeed, ColumnarArchiveRoundTrip) {
+  auto records = MakeShuffleRecords(2 * OBJPOOL_BLOCK_SIZE + 500);
+  for (size_t i = records.size() - 3; i < records.size(); ++i) {
+    records[i]->slot_float_feasigns_.clear(true);
+  }
+  std::string path = ::testing::TempDir() + "columnar_archive_test";
+  {
+    ColumnarArchiveWriter writer;
+    ASSERT_TRUE(writer.open(path));
+    for (auto& rec : records) {
+      ASSERT_TRUE(writer.write(rec.get()));
+    }
+    writer.close();
+  }
+
+  auto chan = MakeChannel<SlotRecord>();
+  ColumnarArchiveFeed feed;
+  feed.SetSlotRecordPool(&SlotRecordPool());
+  feed.SetInputChannel(chan.get());
+  EXPECT_EQ(feed.Load(path), static_cast<int>(records.size()));
+  chan->Close();
+  std::vector<SlotRecord> loaded;
+  chan->ReadAll(loaded);
+  ASSERT_EQ(loaded.size(), records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    ExpectSameRecord(loaded[i], records[i].get());
+  }
+  SlotRecordPool().put(&loaded);
+  std::remove(path.c_str());
+}
+
+// exposes the records and pvs of the merge
+class PvMergeDataset : public PadBoxSlotDataset {
+ public:
+  PvMergeDataset(ThreadPool* pool, int thread_num) {
+    merge_pool_ = pool;
+    merge_thread_num_ = thread_num;
+    SetEnablePvMerge(true);
+  }
+  ~PvMergeDataset() {
+    for (auto pv : input_pv_ins_) {
+      delete pv;
+    }
+  }
+  std::vector<SlotRecord>& records() { return input_records_; }
+  std::vector<SlotPvInstance>& pv_ins() { return input_pv_ins_; }
+};
+
+struct PvMergeConfig {
+  bool by_uid;
+  int split_method;
+  size_t split_size;
+  bool invalid_users;
+};
+
+static void SetPvMergeConfig(const PvMergeConfig& config,
+                             PvMergeDataset* dataset) {
+  if (config.by_uid) {
+    dataset->SetMergeByUid(true, config.split_method, config.split_size, 0);
+  }
+  if (config.invalid_users) {
+    dataset->SetInvalidUsers({"u3", "u42", "u1000"});
+  }
+}
+
+// the records sorted by std::sort and grouped by one thread give the same
+// pvs as the radix sort and the grouping of threads on whole pvs
+static void ExpectSamePvs(const PvMergeConfig& config) {
+  const int kRecordNum = 50000;
+  const int kThreadNum = 8;
+  std::mt19937_64 rng(config.split_method * 2 + config.by_uid);
+  std::vector<uint64_t> timestamps(kRecordNum);
+  for (int i = 0; i < kRecordNum; ++i) {
+    timestamps[i] = i + 1;
+  }
+  std::shuffle(timestamps.begin(), timestamps.end(), rng);
+  std::vector<std::unique_ptr<SlotRecordObject>> owner;
+  std::vector<SlotRecord> records;
+  for (int i = 0; i < kRecordNum; ++i) {
+    owner.emplace_back(new SlotRecordObject());
+    SlotRecord rec = owner.back().get();
+    // pvs of a few records, the keys differ in every byte
+    rec->search_id = (rng() % 6000) * 0x9E3779B97F4A7C15ULL;
+    // users of up to a few hundred records, users of one sign collide
+    int user = (i % 5 == 0) ? rng() % 50 : rng() % 3000;
+    rec->user_id_ = "u" + std::to_string(user);
+    rec->user_id_sign_ = (user % 997 + 1) * 0x9E3779B97F4A7C15ULL;
+    rec->show_timestamp_ = timestamps[i];
+    records.push_back(rec);
+  }
+
+  PvMergeDataset expect(nullptr, 1);
+  SetPvMergeConfig(config, &expect);
+  expect.records() = records;
+  if (config.by_uid) {
+    std::sort(expect.records().begin(),
+              expect.records().end(),
+              [](const SlotRecord& lhs, const SlotRecord& rhs) {
+                if (lhs->user_id_sign_ != rhs->user_id_sign_) {
+                  return lhs->user_id_sign_ < rhs->user_id_sign_;
+                }
+                if (lhs->user_id_ != rhs->user_id_) {
+                  return lhs->user_id_ < rhs->user_id_;
+                }
+                return lhs->show_timestamp_ < rhs->show_timestamp_;
+              });
+  } else {
+    std::sort(expect.records().begin(),
+              expect.records().end(),
+              [](const SlotRecord& lhs, const SlotRecord& rhs) {
+                return lhs->search_id < rhs->search_id;
+              });
+  }
+  expect.PreprocessInstance();
+
+  ThreadPool pool(kThreadNum);
+  PvMergeDataset dataset(&pool, kThreadNum);
+  SetPvMergeConfig(config, &dataset);
+  dataset.records() = records;
+  dataset.PreprocessInstance();
+
+  auto& expect_pvs = expect.pv_ins();
+  auto& pvs = dataset.pv_ins();
+  ASSERT_EQ(pvs.size(), expect_pvs.size());
+  if (config.by_uid) {
+    ASSERT_EQ(dataset.records(), expect.records());
+  }
+  for (size_t i = 0; i < pvs.size(); ++i) {
+    auto ads = pvs[i]->ads;
+    auto expect_ads = expect_pvs[i]->ads;
+    // std::sort does not keep the order of the records of one search id
+    if (!config.by_uid) {
+      std::sort(ads.begin(), ads.end());
+      std::sort(expect_ads.begin(), expect_ads.end());
+    }
+    ASSERT_EQ(ads, expect_ads) << "pv " << i;
+    ASSERT_EQ(pvs[i]->get_zero_mask_num(), expect_pvs[i]->get_zero_mask_num())
+        << "pv " << i;
+  }
+  expect.records().clear();
+  dataset.records().clear();
+}
+
+TEST(PadBoxSlotDataset, MergeBySid) {
+  BoxWrapper::SetInstance();
+  ExpectSamePvs({false, 0, 0, false});
+}
+
+TEST(PadBoxSlotDataset, MergeByUid) {
+  BoxWrapper::SetInstance();
+  ExpectSamePvs({true, 0, 0, false});
+  ExpectSamePvs({true, 0, 0, true});
+}
+
+TEST(PadBoxSlotDataset, MergeByUidSplit) {
+  BoxWrapper::SetInstance();
+  ExpectSamePvs({true, 1, 8, false});
+  ExpectSamePvs({true, 2, 8, false});
+  ExpectSamePvs({true, 2, 8, true});
+}
+
+}  // namespace framework
+}  // namespace paddle
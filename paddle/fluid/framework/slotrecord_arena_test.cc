@@ -0,0 +1,198 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/data_feed.h"
+
+namespace paddle {
+namespace framework {
+
+// the bytes glibc malloc takes for a request and the bytes the arena takes
+static size_t MallocBytes(size_t len) {
+  size_t bytes = (len + 8 + 15) & ~static_cast<size_t>(15);
+  return bytes < 32 ? 32 : bytes;
+}
+static size_t ArenaBytes(size_t len) {
+  return (len + 7) & ~static_cast<size_t>(7);
+}
+
+TEST(SlotRecordArena, Guard) {
+  SlotRecordArena outer;
+  SlotRecordArena inner;
+  EXPECT_EQ(SlotRecordArena::thread_arena(), nullptr);
+  {
+    SlotRecordArenaGuard outer_guard(&outer);
+    {
+      SlotRecordArenaGuard inner_guard(&inner);
+      EXPECT_EQ(SlotRecordArena::thread_arena(), &inner);
+    }
+    EXPECT_EQ(SlotRecordArena::thread_arena(), &outer);
+  }
+  EXPECT_EQ(SlotRecordArena::thread_arena(), nullptr);
+}
+
+// records taken in a guarded thread are arena memory, the others are heap
+TEST(SlotRecordArena, PoolGet) {
+  auto& pool = SlotRecordPool();
+  SlotRecordArena arena;
+  std::vector<SlotRecord> records;
+  uint64_t arena_count = pool.arena_count();
+  {
+    SlotRecordArenaGuard guard(&arena);
+    pool.get(&records, 100);
+  }
+  EXPECT_EQ(pool.arena_count(), arena_count + 100);
+  EXPECT_EQ(arena.record_num(), 100UL);
+  EXPECT_EQ(arena.chunk_num(), 1UL);
+  for (auto record : records) {
+    EXPECT_TRUE(SlotRecordArena::is_arena_memory(record));
+  }
+
+  std::vector<SlotRecord> heap_records;
+  pool.get(&heap_records, 10);
+  for (auto record : heap_records) {
+    EXPECT_FALSE(SlotRecordArena::is_arena_memory(record));
+  }
+  int value = 0;
+  EXPECT_FALSE(SlotRecordArena::is_arena_memory(&value));
+  EXPECT_EQ(pool.arena_count(), arena_count + 100);
+  pool.put(&heap_records);
+}
+
+// put keeps the heap records only, the arena records stay valid until the
+// arena is released
+TEST(SlotRecordArena, PoolPutSkipsArenaRecords) {
+  SlotObjPool pool;
+  SlotRecordArena arena;
+  std::vector<SlotRecord> records;
+  {
+    SlotRecordArenaGuard guard(&arena);
+    pool.get(&records, 50);
+  }
+  std::vector<SlotRecord> heap_records;
+  pool.get(&heap_records, 20);
+  records.insert(records.end(), heap_records.begin(), heap_records.end());
+  size_t capacity = pool.capacity();
+  pool.put(&records);
+  EXPECT_TRUE(records.empty());
+  EXPECT_EQ(pool.capacity(), capacity + 20);
+  EXPECT_EQ(arena.record_num(), 50UL);
+
+  // the pool hands back the heap records only
+  pool.get(&records, 20);
+  for (auto record : records) {
+    EXPECT_FALSE(SlotRecordArena::is_arena_memory(record));
+  }
+  pool.put(&records);
+}
+
+TEST(SlotRecordArena, Release) {
+  SlotRecordArena arena;
+  std::vector<SlotRecord> records;
+  {
+    SlotRecordArenaGuard guard(&arena);
+    SlotRecordPool().get(&records, 10);
+  }
+  for (auto record : records) {
+    record->ins_id_ = "a record id too long for the small string buffer";
+    record->slot_uint64_feasigns_.add_slot_feasigns(
+        std::vector<std::vector<uint64_t>>{{1, 2, 3}, {}, {4}}, 5);
+  }
+  void* data = arena.alloc(100);
+  EXPECT_TRUE(SlotRecordArena::is_arena_memory(data));
+  EXPECT_EQ(arena.chunk_num(), 2UL);
+
+  arena.release();
+  EXPECT_EQ(arena.chunk_num(), 0UL);
+  EXPECT_EQ(arena.record_num(), 0UL);
+  EXPECT_FALSE(SlotRecordArena::is_arena_memory(data));
+  for (auto record : records) {
+    EXPECT_FALSE(SlotRecordArena::is_arena_memory(record));
+  }
+  arena.release();
+
+  // the arena is filled again after a release
+  {
+    SlotRecordArenaGuard guard(&arena);
+    SlotRecordPool().get(&records, 10);
+  }
+  EXPECT_EQ(arena.record_num(), 10UL);
+  for (auto record : records) {
+    EXPECT_TRUE(SlotRecordArena::is_arena_memory(record));
+  }
+}
+
+// the saved bytes are the malloc chunks the allocations would take less the
+// arena bytes, records also pay their stride. The bytes of released chunks
+// are kept.
+TEST(SlotRecordArena, SavedBytes) {
+  SlotRecordArena arena;
+  size_t expect = 0;
+  for (size_t len : {1, 10, 24, 100, 1000}) {
+    arena.alloc(len);
+    expect += MallocBytes(len) - ArenaBytes(len);
+  }
+  size_t record_size = sizeof(SlotRecordObject);
+  for (int i = 0; i < 3; ++i) {
+    new (arena.alloc_record(record_size)) SlotRecordObject(&arena);
+    expect += MallocBytes(record_size) - sizeof(size_t) -
+              ArenaBytes(record_size);
+  }
+  EXPECT_EQ(arena.saved_bytes(), expect);
+
+  arena.release();
+  EXPECT_EQ(arena.saved_bytes(), expect);
+  arena.alloc(10);
+  expect += MallocBytes(10) - ArenaBytes(10);
+  EXPECT_EQ(arena.saved_bytes(), expect);
+}
+
+// every thread fills its own chunks of the arena
+TEST(SlotRecordArena, MultiThread) {
+  const int kThreadNum = 4;
+  const size_t kRecordNum = 1000;
+  SlotRecordArena arena;
+  std::vector<std::vector<SlotRecord>> records(kThreadNum);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreadNum; ++t) {
+    threads.emplace_back([&arena, &records, t]() {
+      SlotRecordArenaGuard guard(&arena);
+      SlotRecordPool().get(&records[t], kRecordNum);
+      for (auto record : records[t]) {
+        record->slot_uint64_feasigns_.add_slot_feasigns(
+            std::vector<std::vector<uint64_t>>{{static_cast<uint64_t>(t)}},
+            1);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(arena.record_num(), kThreadNum * kRecordNum);
+  EXPECT_GE(arena.chunk_num(), static_cast<size_t>(kThreadNum));
+  for (int t = 0; t < kThreadNum; ++t) {
+    for (auto record : records[t]) {
+      ASSERT_TRUE(SlotRecordArena::is_arena_memory(record));
+      ASSERT_EQ(record->slot_uint64_feasigns_.slot_values.size(), 1UL);
+      ASSERT_EQ(record->slot_uint64_feasigns_.slot_values[0],
+                static_cast<uint64_t>(t));
+    }
+  }
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,248 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+// cpu timings of the fused_seqpool_cvm op family, the plain op is checked
+// against and compared with sequence_pool + cvm of every slot
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/framework/operator.h"
+#include "paddle/fluid/framework/scope.h"
+#include "paddle/fluid/platform/init.h"
+
+USE_OP_ITSELF(fused_seqpool_cvm);
+USE_OP_DEVICE_KERNEL(fused_seqpool_cvm, CPU);
+USE_OP_ITSELF(fused_seqpool_cvm_with_conv);
+USE_OP_DEVICE_KERNEL(fused_seqpool_cvm_with_conv, CPU);
+USE_OP_ITSELF(fused_seqpool_cvm_with_credit);
+USE_OP_DEVICE_KERNEL(fused_seqpool_cvm_with_credit, CPU);
+USE_OP_ITSELF(fused_seqpool_cvm_with_diff_thres);
+USE_OP_DEVICE_KERNEL(fused_seqpool_cvm_with_diff_thres, CPU);
+USE_OP_ITSELF(fused_seqpool_cvm_with_pcoc);
+USE_OP_DEVICE_KERNEL(fused_seqpool_cvm_with_pcoc, CPU);
+USE_OP_ITSELF(fused_seqpool_cvm_tradew);
+USE_OP_DEVICE_KERNEL(fused_seqpool_cvm_tradew, CPU);
+USE_OP_ITSELF(sequence_pool);
+USE_OP_DEVICE_KERNEL(sequence_pool, CPU);
+USE_OP_ITSELF(cvm);
+USE_OP_DEVICE_KERNEL(cvm, CPU);
+
+DEFINE_int32(batch_size, 512, "instances of a batch.");
+DEFINE_int32(slot_num, 200, "sparse slots of an instance.");
+DEFINE_int32(feasigns_per_slot, 3, "average feasigns of a slot.");
+DEFINE_int32(embedx_dim, 8, "embedx width of a feasign.");
+DEFINE_int32(repeat, 10, "repeat times.");
+
+namespace framework = paddle::framework;
+namespace platform = paddle::platform;
+
+template <class Func>
+static double Best(Func func) {
+  double best = 0;
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    double cost = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    if (r == 0 || cost < best) {
+      best = cost;
+    }
+  }
+  return best;
+}
+
+static std::vector<std::string> SlotNames(const std::string& prefix) {
+  std::vector<std::string> names(FLAGS_slot_num);
+  for (int i = 0; i < FLAGS_slot_num; ++i) {
+    names[i] = prefix + std::to_string(i);
+  }
+  return names;
+}
+
+// lod inputs of every slot with show >= click
+static void CreateInputs(framework::Scope* scope,
+                         const std::vector<std::string>& names,
+                         int width,
+                         std::mt19937* rng) {
+  std::uniform_real_distribution<float> value(0, 1);
+  for (auto& name : names) {
+    framework::LoD lod(1, std::vector<size_t>(1, 0));
+    for (int j = 0; j < FLAGS_batch_size; ++j) {
+      lod[0].push_back(lod[0].back() +
+                       (*rng)() % (2 * FLAGS_feasigns_per_slot + 1));
+    }
+    auto* tensor = scope->Var(name)->GetMutable<framework::LoDTensor>();
+    tensor->Resize({static_cast<int64_t>(lod[0].back()), width});
+    tensor->set_lod(lod);
+    float* data = tensor->mutable_data<float>(platform::CPUPlace());
+    for (size_t k = 0; k < lod[0].back(); ++k) {
+      float* row = data + k * width;
+      for (int d = 0; d < width; ++d) {
+        row[d] = value(*rng);
+      }
+      row[0] += 1;
+    }
+  }
+}
+
+static void CreateTensor(framework::Scope* scope,
+                         const std::string& name,
+                         const framework::DDim& dims,
+                         float value) {
+  auto* tensor = scope->Var(name)->GetMutable<framework::LoDTensor>();
+  tensor->Resize(dims);
+  float* data = tensor->mutable_data<float>(platform::CPUPlace());
+  std::fill(data, data + tensor->numel(), value);
+}
+
+static void CreateOutputs(framework::Scope* scope,
+                          const std::vector<std::string>& names) {
+  for (auto& name : names) {
+    scope->Var(name)->GetMutable<framework::LoDTensor>();
+  }
+}
+
+struct FusedCase {
+  std::string type;
+  std::string cvm_name;
+  int cvm_width;
+  int input_width;
+  framework::AttributeMap attrs;
+};
+
+// forward and backward time of one fused op over all slots
+static void RunFused(framework::Scope* scope,
+                     const FusedCase& c,
+                     std::mt19937* rng) {
+  const std::string prefix = c.type + "_";
+  auto xs = SlotNames(prefix + "x");
+  auto outs = SlotNames(prefix + "out");
+  std::vector<std::string> out_grads;
+  std::vector<std::string> x_grads;
+  for (size_t i = 0; i < xs.size(); ++i) {
+    out_grads.push_back(framework::GradVarName(outs[i]));
+    x_grads.push_back(framework::GradVarName(xs[i]));
+  }
+  CreateInputs(scope, xs, c.input_width, rng);
+  CreateTensor(scope, prefix + c.cvm_name, {FLAGS_batch_size, c.cvm_width}, 1);
+  CreateOutputs(scope, outs);
+  CreateOutputs(scope, x_grads);
+  auto op = framework::OpRegistry::CreateOp(
+      c.type, {{"X", xs}, {c.cvm_name, {prefix + c.cvm_name}}},
+      {{"Out", outs}}, c.attrs);
+  platform::CPUPlace place;
+  double forward = Best([&]() { op->Run(*scope, place); });
+  for (size_t i = 0; i < outs.size(); ++i) {
+    CreateTensor(scope, out_grads[i],
+                 scope->FindVar(outs[i])->Get<framework::LoDTensor>().dims(),
+                 0.5);
+  }
+  auto grad_op = framework::OpRegistry::CreateOp(
+      c.type + "_grad",
+      {{"X", xs},
+       {c.cvm_name, {prefix + c.cvm_name}},
+       {framework::GradVarName("Out"), out_grads}},
+      {{framework::GradVarName("X"), x_grads}}, c.attrs);
+  double backward = Best([&]() { grad_op->Run(*scope, place); });
+  LOG(INFO) << c.type << " forward: " << forward * 1e3
+            << " ms, backward: " << backward * 1e3 << " ms";
+}
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  paddle::framework::InitDevices();
+
+  framework::Scope scope;
+  platform::CPUPlace place;
+  std::mt19937 rng(0);
+  const int width = 2 + FLAGS_embedx_dim;
+
+  // fused_seqpool_cvm against sequence_pool + cvm of every slot
+  auto xs = SlotNames("x");
+  auto outs = SlotNames("out");
+  CreateInputs(&scope, xs, width, &rng);
+  CreateTensor(&scope, "cvm", {FLAGS_batch_size, 2}, 1);
+  CreateOutputs(&scope, outs);
+  auto fused = framework::OpRegistry::CreateOp(
+      "fused_seqpool_cvm", {{"X", xs}, {"CVM", {"cvm"}}}, {{"Out", outs}},
+      {{"pooltype", std::string("SUM")}, {"use_cvm", true}});
+  std::vector<std::unique_ptr<framework::OperatorBase>> unfused;
+  for (int i = 0; i < FLAGS_slot_num; ++i) {
+    std::string id = std::to_string(i);
+    CreateOutputs(&scope, {"pool" + id, "max_index" + id, "y" + id});
+    unfused.push_back(framework::OpRegistry::CreateOp(
+        "sequence_pool", {{"X", {xs[i]}}},
+        {{"Out", {"pool" + id}}, {"MaxIndex", {"max_index" + id}}},
+        {{"pooltype", std::string("SUM")}, {"is_test", true}}));
+    unfused.push_back(framework::OpRegistry::CreateOp(
+        "cvm", {{"X", {"pool" + id}}, {"CVM", {"cvm"}}}, {{"Y", {"y" + id}}},
+        {{"use_cvm", true}}));
+  }
+  double fused_cost = Best([&]() { fused->Run(scope, place); });
+  double unfused_cost = Best([&]() {
+    for (auto& op : unfused) {
+      op->Run(scope, place);
+    }
+  });
+  for (int i = 0; i < FLAGS_slot_num; ++i) {
+    auto& out = scope.FindVar(outs[i])->Get<framework::LoDTensor>();
+    auto& y = scope.FindVar("y" + std::to_string(i))->Get<framework::LoDTensor>();
+    CHECK_EQ(out.numel(), y.numel());
+    const float* a = out.data<float>();
+    const float* b = y.data<float>();
+    for (int64_t k = 0; k < out.numel(); ++k) {
+      CHECK_LE(std::fabs(a[k] - b[k]), 1e-4 * (1 + std::fabs(b[k])))
+          << "slot " << i << " index " << k;
+    }
+  }
+  LOG(INFO) << "slots: " << FLAGS_slot_num << ", batch: " << FLAGS_batch_size
+            << ", width: " << width;
+  LOG(INFO) << "sequence_pool + cvm: " << unfused_cost * 1e3 << " ms";
+  LOG(INFO) << "fused_seqpool_cvm: " << fused_cost * 1e3 << " ms, speedup "
+            << unfused_cost / fused_cost;
+
+  const int embedx = FLAGS_embedx_dim;
+  std::vector<FusedCase> cases = {
+      {"fused_seqpool_cvm", "CVM", 2, 2 + embedx, {}},
+      {"fused_seqpool_cvm_with_conv", "CVM", 3, 3 + embedx, {}},
+      {"fused_seqpool_cvm_with_credit", "CVM", 4, 4 + embedx, {}},
+      {"fused_seqpool_cvm_with_diff_thres",
+       "CVM",
+       2,
+       2 + embedx,
+       {{"need_filter", true}, {"quant_ratio", 128}}},
+      {"fused_seqpool_cvm_with_pcoc", "CVMWithPCOC", 7, 7 + embedx, {}},
+      {"fused_seqpool_cvm_tradew",
+       "CVM",
+       2,
+       2 + 2 + embedx,
+       {{"trade_id", 0}}},
+  };
+  for (auto& c : cases) {
+    c.attrs["pooltype"] = std::string("SUM");
+    RunFused(&scope, c, &rng);
+  }
+  return 0;
+}
@@ -1,10 +1,126 @@
 #include "paddle/fluid/operators/fused/fused_seq_tensor_op.h"
 #include "paddle/fluid/framework/op_registry.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
 #include <string>
+#include <vector>
 
 namespace paddle {
 namespace operators {
 
+// cpu fused_seq_tensor, same layout as the gpu kernels. For every (batch,
+// instance, position) the slots of the position are fea_emb_dim contiguous
+// values, so every output piece is built with whole row copies and element
+// wise loops over fea_emb_dim that vectorize.
+template <typename DeviceContext, typename T>
+class FusedSeqTensorCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto input = ctx.Input<framework::Tensor>("Input");
+    PADDLE_ENFORCE_NOT_NULL(input, platform::errors::NotFound("Input not found"));
+    auto ad_input = ctx.Input<framework::Tensor>("ADInput");
+    PADDLE_ENFORCE_NOT_NULL(ad_input, platform::errors::NotFound("Input not found"));
+
+    auto din_output = ctx.Output<framework::Tensor>("DINOut");
+    PADDLE_ENFORCE_NOT_NULL(din_output,
+                            platform::errors::NotFound("DINOut not found"));
+    T* din_output_data = din_output->mutable_data<T>(ctx.GetPlace());
+    auto mask_output = ctx.Output<framework::Tensor>("MaskOut");
+    PADDLE_ENFORCE_NOT_NULL(mask_output,
+                            platform::errors::NotFound("MaskOut not found"));
+    T* mask_output_data = mask_output->mutable_data<T>(ctx.GetPlace());
+    auto side_info_output = ctx.Output<framework::Tensor>("SideInfoOut");
+    PADDLE_ENFORCE_NOT_NULL(side_info_output,
+                            platform::errors::NotFound("Output not found"));
+    T* side_info_output_data =
+        side_info_output->mutable_data<T>(ctx.GetPlace());
+    auto ad_slot_session_output =
+        ctx.Output<framework::Tensor>("ADSlotSessionOut");
+    PADDLE_ENFORCE_NOT_NULL(ad_slot_session_output,
+                            platform::errors::NotFound("Output not found"));
+    T* ad_slot_session_output_data =
+        ad_slot_session_output->mutable_data<T>(ctx.GetPlace());
+
+    const size_t batch_count = ctx.Attr<int64_t>("batch_count");
+    const size_t max_length = ctx.Attr<int64_t>("max_length");
+    const size_t slot_num = ctx.Attr<int64_t>("slot_num");
+    const size_t fea_emb_dim = ctx.Attr<int64_t>("fea_emb_dim");
+    const size_t ad_slot_num = ctx.Attr<int64_t>("ad_slot_num");
+    const size_t ad_slot_offset = ctx.Attr<int64_t>("ad_slot_offset");
+
+    const size_t ins_num = input->dims()[0];
+    const size_t sideinfo_slot_offset = ad_slot_offset == 0 ? ad_slot_num : 0;
+    const size_t sideinfo_slot_num = slot_num - ad_slot_num;
+
+    const size_t one_slot_dim = max_length * fea_emb_dim;
+    const size_t one_seq_dim = slot_num * one_slot_dim;
+    const size_t piece_of_ad_seq_dim = ad_slot_num * fea_emb_dim;
+    const size_t piece_of_sideinfo_seq_dim = sideinfo_slot_num * fea_emb_dim;
+    const size_t emb_bytes = fea_emb_dim * sizeof(T);
+
+    const T* input_data = input->data<T>();
+    const T* ad_input_data = ad_input->data<T>();
+    std::vector<T> mask_sum(fea_emb_dim);
+    for (size_t batch_idx = 0; batch_idx < batch_count; ++batch_idx) {
+      for (size_t ins_idx = 0; ins_idx < ins_num; ++ins_idx) {
+        const T* seq = input_data + ins_idx * (batch_count * one_seq_dim) +
+                       batch_idx * one_seq_dim;
+        const T* ad_seq = ad_input_data +
+                          ins_idx * (batch_count * piece_of_ad_seq_dim) +
+                          batch_idx * piece_of_ad_seq_dim;
+        for (size_t fea_idx = 0; fea_idx < max_length; ++fea_idx) {
+          // [batch_count, ins_num, max_length, ...] row of every output
+          const size_t out_row =
+              (batch_idx * ins_num + ins_idx) * max_length + fea_idx;
+          const T* pos = seq + fea_idx * fea_emb_dim;
+
+          T* din = din_output_data + out_row * piece_of_ad_seq_dim * 4;
+          T* session =
+              ad_slot_session_output_data + out_row * piece_of_ad_seq_dim;
+          for (size_t slot_idx = 0; slot_idx < ad_slot_num; ++slot_idx) {
+            const T* in_val = pos + (slot_idx + ad_slot_offset) * one_slot_dim;
+            const T* ad_val = ad_seq + slot_idx * fea_emb_dim;
+            T* concat = din + slot_idx * fea_emb_dim;
+            T* diff = concat + piece_of_ad_seq_dim * 2;
+            T* prod = concat + piece_of_ad_seq_dim * 3;
+            std::memcpy(concat, in_val, emb_bytes);
+            std::memcpy(concat + piece_of_ad_seq_dim, ad_val, emb_bytes);
+            for (size_t d = 0; d < fea_emb_dim; ++d) {
+              diff[d] = in_val[d] - ad_val[d];
+              prod[d] = in_val[d] * ad_val[d];
+            }
+            std::memcpy(session + slot_idx * fea_emb_dim, in_val, emb_bytes);
+          }
+
+          T* side_info =
+              side_info_output_data + out_row * piece_of_sideinfo_seq_dim;
+          for (size_t slot_idx = 0; slot_idx < sideinfo_slot_num; ++slot_idx) {
+            std::memcpy(
+                side_info + slot_idx * fea_emb_dim,
+                pos + (slot_idx + sideinfo_slot_offset) * one_slot_dim,
+                emb_bytes);
+          }
+
+          // the position is padding when all its slots sum to 0
+          std::fill(mask_sum.begin(), mask_sum.end(), static_cast<T>(0));
+          for (size_t slot_idx = 0; slot_idx < slot_num; ++slot_idx) {
+            const T* in_val = pos + slot_idx * one_slot_dim;
+            for (size_t d = 0; d < fea_emb_dim; ++d) {
+              mask_sum[d] += in_val[d];
+            }
+          }
+          T sum = std::accumulate(mask_sum.begin(), mask_sum.end(),
+                                  static_cast<T>(0));
+          mask_output_data[out_row] = std::fabs(sum) > 1e-8 ? 1 : 0;
+        }
+      }
+    }
+  }
+};
+
+
 class FusedSeqTensorOp : public framework::OperatorWithKernel {
  public:
   using framework::OperatorWithKernel::OperatorWithKernel;
@@ -129,4 +245,5 @@ REGISTER_OPERATOR(fused_seq_tensor,
 
 REGISTER_OP_CPU_KERNEL(
   fused_seq_tensor,
-  ops::FusedSeqTensorCPUKernel<phi::CPUContext, float>);
+  ops::FusedSeqTensorCPUKernel<phi::CPUContext, float>,
+  ops::FusedSeqTensorCPUKernel<phi::CPUContext, double>);
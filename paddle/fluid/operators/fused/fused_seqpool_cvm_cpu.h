@@ -0,0 +1,137 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+   http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#pragma once
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "paddle/fluid/framework/lod_tensor.h"
+#include "paddle/fluid/framework/op_registry.h"
+#ifdef PADDLE_WITH_BOX_PS
+#include "paddle/fluid/framework/fleet/box_wrapper.h"
+#else
+#include "paddle/fluid/framework/threadpool.h"
+#endif
+
+// shared cpu core of the fused_seqpool_cvm op family: the slots run in
+// parallel, every instance pools its rows into a per slot buffer with whole
+// row adds so the inner loops vectorize, then the op writes its cvm columns
+// from the pooled row. The grads build one row per instance and copy it to
+// all rows of the instance.
+
+namespace paddle {
+namespace operators {
+
+// runs func(slot) for every slot, on the boxps threads of the place
+template <typename Func>
+inline void FusedSeqpoolRunSlots(const platform::Place& place,
+                                 size_t slot_num,
+                                 Func&& func) {
+#ifdef PADDLE_WITH_BOX_PS
+  framework::BoxWrapper::GetInstance()->ExecuteFunc(place, slot_num, func);
+#else
+  framework::parallel_run_dynamic(slot_num, func);
+#endif
+}
+
+// batch size of the lod inputs, all slots must have the same
+template <typename TensorPtr>
+inline int FusedSeqpoolBatchSize(const std::vector<TensorPtr>& inputs) {
+  int batch_size = -1;
+  for (auto* input : inputs) {
+    CHECK(input->lod().size() == 1);
+    int cur_batch = static_cast<int>(input->lod()[0].size()) - 1;
+    if (batch_size == -1) {
+      batch_size = cur_batch;
+    } else {
+      CHECK(batch_size == cur_batch)
+          << "batch: " << batch_size << ", current: " << cur_batch;
+    }
+  }
+  return batch_size;
+}
+
+// drops the rows where (show - click) * show_coeff + click * clk_coeff is
+// below threshold
+struct SeqpoolShowClkFilter {
+  bool enable = false;
+  float show_coeff = 0;
+  float clk_coeff = 0;
+  float threshold = 0;
+
+  template <typename T>
+  bool Skip(const T* row) const {
+    return enable &&
+           (row[0] - row[1]) * show_coeff + row[1] * clk_coeff < threshold;
+  }
+};
+
+// sum[d] = pad_value + the sum of column d over the rows [start, end) the
+// filter keeps, the columns from quant_begin are quantized by quant_ratio
+// when it is positive
+template <typename T, typename AccT>
+inline void SeqpoolSumRows(const T* input,
+                           int width,
+                           size_t start,
+                           size_t end,
+                           float pad_value,
+                           const SeqpoolShowClkFilter& filter,
+                           int quant_ratio,
+                           int quant_begin,
+                           AccT* sum) {
+  std::fill(sum, sum + width, static_cast<AccT>(pad_value));
+  const int begin = std::min(quant_ratio > 0 ? quant_begin : width, width);
+  const float ratio = static_cast<float>(quant_ratio);
+  for (size_t k = start; k < end; ++k) {
+    const T* row = input + k * width;
+    if (filter.Skip(row)) {
+      continue;
+    }
+    for (int d = 0; d < begin; ++d) {
+      sum[d] += row[d];
+    }
+    for (int d = begin; d < width; ++d) {
+      sum[d] += static_cast<int>(row[d] * quant_ratio + 0.5) / ratio;
+    }
+  }
+}
+
+// gradient row of one instance: the first cvm_offset columns from cvm, the
+// others from out_grad where column d is out_grad[d - skip]
+template <typename T>
+inline void SeqpoolCVMGradRow(const T* cvm,
+                              const T* out_grad,
+                              int width,
+                              int cvm_offset,
+                              int skip,
+                              T* grad_row) {
+  std::copy(cvm, cvm + cvm_offset, grad_row);
+  std::copy(out_grad + cvm_offset - skip, out_grad + width - skip,
+            grad_row + cvm_offset);
+}
+
+// copies grad_row to the rows [start, end) of in_grad
+template <typename T>
+inline void SeqpoolBroadcastRow(const T* grad_row,
+                                int width,
+                                size_t start,
+                                size_t end,
+                                T* in_grad) {
+  for (size_t k = start; k < end; ++k) {
+    std::memcpy(in_grad + k * width, grad_row, width * sizeof(T));
+  }
+}
+
+}  // namespace operators
+}  // namespace paddle
@@ -13,12 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License. */
 
 #include "paddle/fluid/operators/fused/fused_seqpool_cvm_op.h"
-#ifdef PADDLE_WITH_BOX_PS
-#include "paddle/fluid/framework/fleet/box_wrapper.h"
-#else
-#include "paddle/fluid/framework/threadpool.h"
-#endif
 #include <string>
+#include "paddle/fluid/operators/fused/fused_seqpool_cvm_cpu.h"
 namespace paddle {
 namespace operators {
 
@@ -247,32 +243,6 @@ class FusedSeqpoolCVMGradOpMaker : public framework::SingleGradOpMaker<T> {
 
 using LoDTensor = framework::LoDTensor;
 
-#define CHECK_USE_QUANT  \
-    if (need_filter && quant_ratio > 0) { \
-     auto &show = input_data[k * embedding_size]; \
-     auto &click = input_data[k * embedding_size + 1]; \
-     if ((show - click) * show_coeff + click * clk_coeff < threshold) { \
-        continue; \
-     } \
-    }
-
-#define QUANT_VALUE(val)  \
-    (static_cast<int>(val * quant_ratio + 0.5) / static_cast<float>(quant_ratio));
-
-#define CHECK_QUANT_AND_GETVAL(in_val)  \
-    if (quant_ratio > 0) {  \
-      if (need_filter) { \
-        auto &show = input_data[k * embedding_size]; \
-        auto &click = input_data[k * embedding_size + 1]; \
-        if ((show - click) * show_coeff + click * clk_coeff < threshold) {  \
-           continue;  \
-        }  \
-      } \
-      val += QUANT_VALUE(in_val); \
-    } else { \
-      val += in_val; \
-    }
-
 template <typename T>
 class FusedSeqpoolCVMOpCPUKernel : public framework::OpKernel<T> {
  public:
@@ -283,113 +253,51 @@ class FusedSeqpoolCVMOpCPUKernel : public framework::OpKernel<T> {
     const auto slot_size = inputs.size();
     auto padding_value = ctx.Attr<float>("pad_value");
     auto use_cvm = ctx.Attr<bool>("use_cvm");
-    bool need_filter = ctx.Attr<bool>("need_filter");
-    float show_coeff = ctx.Attr<float>("show_coeff");
-    float clk_coeff = ctx.Attr<float>("clk_coeff");
-    float threshold = ctx.Attr<float>("threshold");
+    SeqpoolShowClkFilter filter;
+    filter.show_coeff = ctx.Attr<float>("show_coeff");
+    filter.clk_coeff = ctx.Attr<float>("clk_coeff");
+    filter.threshold = ctx.Attr<float>("threshold");
     const int cvm_offset = ctx.Attr<int>("cvm_offset");
     const int quant_ratio = ctx.Attr<int>("quant_ratio");
     bool clk_filter = ctx.Attr<bool>("clk_filter");
+    // the cpu kernel only filters the quantized embeddings
+    filter.enable = ctx.Attr<bool>("need_filter") && quant_ratio > 0;
+    const int quant_begin = use_cvm ? 2 : cvm_offset;
 
     auto place = ctx.GetPlace();
 
-    int batch_size = -1;
+    const int batch_size = FusedSeqpoolBatchSize(inputs);
     int embedding_size = inputs[0]->numel() / inputs[0]->dims()[0];
-#ifdef PADDLE_WITH_BOX_PS
-    auto box_ptr = paddle::framework::BoxWrapper::GetInstance();
-    box_ptr->ExecuteFunc(place, slot_size, [&](const size_t &i) {
-#else
-    paddle::framework::parallel_run_dynamic(slot_size, [&](const size_t &i) {
-#endif
+    int dim_size = embedding_size;
+    if (!use_cvm) {
+      dim_size = embedding_size - cvm_offset;
+    } else if (clk_filter) {
+      dim_size = embedding_size - 1;
+    }
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
       const auto *input = inputs[i];
-      CHECK(input->lod().size() == 1);
-
-      auto lod_data = input->lod()[0];
-      int cur_batch = lod_data.size() - 1;
-      if (batch_size == -1) {
-        batch_size = cur_batch;
-      } else {
-        CHECK(batch_size == cur_batch) << "batch: " << batch_size
-            << ", current: " << cur_batch;
-      }
-
-      const T *input_data = reinterpret_cast<const T*>(input->data<T>());
+      const auto &lod_data = input->lod()[0];
+      const T *input_data = input->data<T>();
       auto *output = outputs[i];
-      if (use_cvm) {
-        if (clk_filter) {
-          int dim_size = embedding_size - 1;
-          output->Resize({cur_batch, dim_size});
-          T *out_data = reinterpret_cast<T*>(output->mutable_data<T>(place));
-          // ins
-          for (int j = 0; j < cur_batch; ++j) {
-            auto &start = lod_data[j];
-            auto &end = lod_data[j + 1];
-            // show, embed, embedx
-            for (int dimx = 0; dimx < dim_size; ++dimx) {
-              double val = padding_value;
-              if (dimx == 0) { // show
-                for (auto k = start; k < end; ++k) {
-                  CHECK_USE_QUANT;
-                  val += input_data[k * embedding_size + dimx];
-                }
-                out_data[j * dim_size + dimx] = log(val + 1);
-              } else {
-                for (auto k = start; k < end; ++k) {
-                  CHECK_QUANT_AND_GETVAL(input_data[k * embedding_size + 1 + dimx]);
-                }
-                out_data[j * dim_size + dimx] = val;
-              }
-            }
-          }
+      output->Resize({batch_size, dim_size});
+      T *out_data = output->mutable_data<T>(place);
+      std::vector<double> sum(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        SeqpoolSumRows(input_data, embedding_size, lod_data[j],
+                       lod_data[j + 1], padding_value, filter, quant_ratio,
+                       quant_begin, sum.data());
+        T *out = out_data + j * dim_size;
+        if (!use_cvm) {
+          std::copy(sum.begin() + cvm_offset, sum.end(), out);
+        } else if (clk_filter) {
+          // show, embed, embedx
+          out[0] = log(sum[0] + 1);
+          std::copy(sum.begin() + 2, sum.end(), out + 1);
         } else {
-          output->Resize({cur_batch, embedding_size});
-          T *out_data = reinterpret_cast<T*>(output->mutable_data<T>(place));
-          // ins
-          for (int j = 0; j < cur_batch; ++j) {
-            auto &start = lod_data[j];
-            auto &end = lod_data[j + 1];
-            // show, click, embed, embedx
-            for (int dimx = 0; dimx < embedding_size; ++dimx) {
-              double val = padding_value;
-              if (dimx == 0) { // show
-                for (auto k = start; k < end; ++k) {
-                  CHECK_USE_QUANT;
-                  val += input_data[k * embedding_size + dimx];
-                }
-                out_data[j * embedding_size + dimx] = log(val + 1);
-              } else if (dimx == 1) { // ctr log(click) - log(show)
-                for (auto k = start; k < end; ++k) {
-                  CHECK_USE_QUANT;
-                  val += input_data[k * embedding_size + dimx];
-                }
-                out_data[j * embedding_size + dimx] = log(val + 1)
-                    - out_data[j * embedding_size];
-              } else {
-                for (auto k = start; k < end; ++k) {
-                  CHECK_QUANT_AND_GETVAL(input_data[k * embedding_size + dimx]);
-                }
-                out_data[j * embedding_size + dimx] = val;
-              }
-            }
-          }
-        }
-      } else {
-        int dim_size = embedding_size - cvm_offset;
-        output->Resize({cur_batch, dim_size});
-        // no cvm
-        T *out_data = reinterpret_cast<T*>(output->mutable_data<T>(place));
-        // ins
-        for (int j = 0; j < cur_batch; ++j) {
-          auto &start = lod_data[j];
-          auto &end = lod_data[j + 1];
-          // show, click, embed, embedx
-          for (int dimx = 0; dimx < dim_size; ++dimx) {
-            double val = padding_value;
-            for (auto k = start; k < end; ++k) {
-              CHECK_QUANT_AND_GETVAL(input_data[k * embedding_size + cvm_offset + dimx]);
-            }
-            out_data[j * dim_size + dimx] = val;
-          }
+          // show, ctr log(click) - log(show), embed, embedx
+          out[0] = log(sum[0] + 1);
+          out[1] = log(sum[1] + 1) - out[0];
+          std::copy(sum.begin() + 2, sum.end(), out + 2);
         }
       }
     });
@@ -404,7 +312,6 @@ class FusedSeqpoolCVMGradOpCPUKernel : public framework::OpKernel<T> {
     auto in_grads = ctx.MultiOutput<LoDTensor>(framework::GradVarName("X"));
     auto *cvm = ctx.Input<LoDTensor>("CVM");
 
-    std::string pooltype = ctx.Attr<std::string>("pooltype");
     auto use_cvm = ctx.Attr<bool>("use_cvm");
     const int cvm_offset = ctx.Attr<int>("cvm_offset");
     bool clk_filter = ctx.Attr<bool>("clk_filter");
@@ -424,41 +331,20 @@ class FusedSeqpoolCVMGradOpCPUKernel : public framework::OpKernel<T> {
       dim_size = embedding_size - cvm_offset;
       dim_off = cvm_offset;
     }
-    int batch_size = -1;
-#ifdef PADDLE_WITH_BOX_PS
-    auto box_ptr = paddle::framework::BoxWrapper::GetInstance();
-    box_ptr->ExecuteFunc(place, slot_size, [&](const size_t i) {
-#else
-    paddle::framework::parallel_run_dynamic(slot_size, [&](const size_t &i) {
-#endif
-//    for (size_t i = 0; i < slot_size; ++i) {
+    const int batch_size = FusedSeqpoolBatchSize(in_grads);
+    const T *cvm_data = cvm->data<T>();
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
       auto *in_grad = in_grads[i];
-
-      auto lod_data = in_grad->lod()[0];
-      int cur_batch = lod_data.size() - 1;
-      if (batch_size == -1) {
-        batch_size = cur_batch;
-      } else {
-        CHECK(batch_size == cur_batch) << "batch: " << batch_size
-            << ", current: " << cur_batch;
-      }
-
-      const T *cvm_data = reinterpret_cast<const T*>(cvm->data<T>());
-      const T *out_grads_value =
-          reinterpret_cast<const T*>(out_grads[i]->data<T>());
-      T *in_grads_value = reinterpret_cast<T*>(in_grad->mutable_data<T>(place));
-
-      for (int j = 0; j < cur_batch; ++j) {
-        auto &start = lod_data[j];
-        auto &end = lod_data[j + 1];
-        for (int dim_id = 0; dim_id < embedding_size; ++dim_id) {
-          const T &val = (dim_id < cvm_offset) ?
-              cvm_data[j * cvm_offset + dim_id] :
-                  out_grads_value[j * dim_size + dim_id - dim_off];
-          for (auto k = start; k < end; ++k) {
-            in_grads_value[k * embedding_size + dim_id] = val;
-          }
-        }
+      const auto &lod_data = in_grad->lod()[0];
+      const T *out_grads_value = out_grads[i]->data<T>();
+      T *in_grads_value = in_grad->mutable_data<T>(place);
+      std::vector<T> grad_row(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        SeqpoolCVMGradRow(cvm_data + j * cvm_offset,
+                          out_grads_value + j * dim_size, embedding_size,
+                          cvm_offset, dim_off, grad_row.data());
+        SeqpoolBroadcastRow(grad_row.data(), embedding_size, lod_data[j],
+                            lod_data[j + 1], in_grads_value);
       }
     });
   }
@@ -14,6 +14,7 @@ limitations under the License. */
 
 #include "paddle/fluid/operators/fused/fused_seqpool_cvm_tradew_op.h"
 #include <string>
+#include "paddle/fluid/operators/fused/fused_seqpool_cvm_cpu.h"
 namespace paddle {
 namespace operators {
 
@@ -202,6 +203,134 @@ class FusedSeqpoolCVMTradeWGradOpMaker
   }
 };
 
+template <typename T>
+class FusedSeqpoolCVMTradeWOpCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto inputs = ctx.MultiInput<LoDTensor>("X");
+    auto outputs = ctx.MultiOutput<framework::Tensor>("Out");
+
+    const auto slot_size = inputs.size();
+    auto padding_value = ctx.Attr<float>("pad_value");
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    const int cvm_offset = ctx.Attr<int>("cvm_offset");
+    const int trade_id = ctx.Attr<int>("trade_id");
+    const int trade_num = ctx.Attr<int>("trade_num");
+
+    auto place = ctx.GetPlace();
+
+    const int batch_size = FusedSeqpoolBatchSize(inputs);
+    // cvm, trade weights, embedx
+    int hidden_size = inputs[0]->numel() / inputs[0]->dims()[0];
+    int embedding_size = hidden_size - trade_num;
+    int dim_size = use_cvm ? embedding_size : embedding_size - cvm_offset;
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      const auto &lod_data = inputs[i]->lod()[0];
+      const T *input_data = inputs[i]->data<T>();
+      auto *output = outputs[i];
+      output->Resize({batch_size, dim_size});
+      T *out_data = output->mutable_data<T>(place);
+      std::vector<double> sum(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        std::fill(sum.begin(), sum.end(), padding_value);
+        for (size_t k = lod_data[j]; k < lod_data[j + 1]; ++k) {
+          const T *row = input_data + k * hidden_size;
+          for (int d = 0; d < cvm_offset; ++d) {
+            sum[d] += row[d];
+          }
+          // embedx weighted by the trade of trade_id
+          const T *embedx = row + trade_num;
+          if (trade_id >= 0) {
+            const T weight = row[cvm_offset + trade_id];
+            for (int d = cvm_offset; d < embedding_size; ++d) {
+              sum[d] += embedx[d] * weight;
+            }
+          } else {
+            for (int d = cvm_offset; d < embedding_size; ++d) {
+              sum[d] += embedx[d];
+            }
+          }
+        }
+        T *out = out_data + j * dim_size;
+        if (!use_cvm) {
+          std::copy(sum.begin() + cvm_offset, sum.end(), out);
+        } else {
+          // show, ctr log(click) - log(show), embedx
+          out[0] = log(sum[0] + 1);
+          out[1] = log(sum[1] + 1) - log(sum[0] + 1);
+          std::copy(sum.begin() + 2, sum.end(), out + 2);
+        }
+      }
+    });
+  }
+};
+
+template <typename T>
+class FusedSeqpoolCVMTradeWGradOpCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto out_grads = ctx.MultiInput<LoDTensor>(framework::GradVarName("Out"));
+    auto in_grads = ctx.MultiOutput<LoDTensor>(framework::GradVarName("X"));
+    auto *cvm = ctx.Input<LoDTensor>("CVM");
+    auto inputs = ctx.MultiInput<LoDTensor>("X");
+
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    const int cvm_offset = ctx.Attr<int>("cvm_offset");
+    const int trade_id = ctx.Attr<int>("trade_id");
+    const int trade_num = ctx.Attr<int>("trade_num");
+
+    const auto slot_size = in_grads.size();
+    auto place = ctx.GetPlace();
+
+    int hidden_size = in_grads[0]->numel() / in_grads[0]->dims()[0];
+    int embedding_size = hidden_size - trade_num;
+    int dim_size = use_cvm ? embedding_size : embedding_size - cvm_offset;
+    // out_grad column of the first embedx
+    int embedx_off = use_cvm ? cvm_offset : 0;
+    int embedx_size = embedding_size - cvm_offset;
+    const int batch_size = FusedSeqpoolBatchSize(in_grads);
+    const T *cvm_data = cvm->data<T>();
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      auto *in_grad = in_grads[i];
+      const auto &lod_data = in_grad->lod()[0];
+      const T *input_data = inputs[i]->data<T>();
+      const T *out_grads_value = out_grads[i]->data<T>();
+      T *in_grads_value = in_grad->mutable_data<T>(place);
+      std::vector<T> grad_row(hidden_size, 0);
+      for (int j = 0; j < batch_size; ++j) {
+        const T *embedx_grad = out_grads_value + j * dim_size + embedx_off;
+        if (trade_id < 0) {
+          // cvm, no trade grad, embedx
+          std::copy(cvm_data + j * cvm_offset,
+                    cvm_data + (j + 1) * cvm_offset, grad_row.begin());
+          std::copy(embedx_grad, embedx_grad + embedx_size,
+                    grad_row.begin() + cvm_offset + trade_num);
+          SeqpoolBroadcastRow(grad_row.data(), hidden_size, lod_data[j],
+                              lod_data[j + 1], in_grads_value);
+          continue;
+        }
+        // the trade weight takes the dot of the embedx grad and the embedx,
+        // the embedx grad is scaled by the weight, show click have no grad
+        for (size_t k = lod_data[j]; k < lod_data[j + 1]; ++k) {
+          const T *row = input_data + k * hidden_size;
+          const T *embedx = row + cvm_offset + trade_num;
+          T *grad = in_grads_value + k * hidden_size;
+          const T weight = row[cvm_offset + trade_id];
+          double sum_val = 0.0;
+          for (int d = 0; d < embedx_size; ++d) {
+            sum_val += embedx_grad[d] * embedx[d];
+          }
+          std::fill(grad, grad + cvm_offset + trade_num, 0);
+          grad[cvm_offset + trade_id] = sum_val;
+          for (int d = 0; d < embedx_size; ++d) {
+            grad[cvm_offset + trade_num + d] = embedx_grad[d] * weight;
+          }
+        }
+      }
+    });
+  }
+};
+
 }  // namespace operators
 }  // namespace paddle
 
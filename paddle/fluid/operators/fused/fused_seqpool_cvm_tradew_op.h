@@ -24,27 +24,5 @@ namespace operators {
 
 using LoDTensor = framework::LoDTensor;
 
-template <typename T>
-class FusedSeqpoolCVMTradeWOpCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMTradeWOp, only support "
-        "GPU "
-        "now.");
-  }
-};
-
-template <typename T>
-class FusedSeqpoolCVMTradeWGradOpCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMTradeWGradOp, only "
-        "support GPU "
-        "now.");
-  }
-};
-
 }  // namespace operators
 }  // namespace paddle
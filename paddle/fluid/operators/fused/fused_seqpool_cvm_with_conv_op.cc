@@ -14,6 +14,7 @@ limitations under the License. */
 
 #include "paddle/fluid/operators/fused/fused_seqpool_cvm_with_conv_op.h"
 #include <string>
+#include "paddle/fluid/operators/fused/fused_seqpool_cvm_cpu.h"
 namespace paddle {
 namespace operators {
 
@@ -209,6 +210,131 @@ class FusedSeqpoolCVMGradOpWithConvMaker : public framework::SingleGradOpMaker<T
   }
 };
 
+template <typename T>
+class FusedSeqpoolCVMOpWithConvCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto inputs = ctx.MultiInput<LoDTensor>("X");
+    auto outputs = ctx.MultiOutput<framework::Tensor>("Out");
+
+    const auto slot_size = inputs.size();
+    auto padding_value = ctx.Attr<float>("pad_value");
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    const int cvm_offset = ctx.Attr<int>("cvm_offset");
+    bool show_filter = ctx.Attr<bool>("show_filter");
+    const int embedx_concate_size = ctx.Attr<int>("embedx_concate_size");
+    SeqpoolShowClkFilter filter;
+    // the concate pools single feasigns, they are not filtered
+    filter.enable = ctx.Attr<bool>("need_filter") && embedx_concate_size == 1;
+    filter.show_coeff = ctx.Attr<float>("show_coeff");
+    filter.clk_coeff = ctx.Attr<float>("clk_coeff");
+    filter.threshold = ctx.Attr<float>("threshold");
+
+    auto place = ctx.GetPlace();
+
+    const int batch_size = FusedSeqpoolBatchSize(inputs);
+    int embedding_size = inputs[0]->numel() / inputs[0]->dims()[0];
+    int dim_size = embedding_size;
+    if (!use_cvm) {
+      dim_size = embedding_size - cvm_offset;
+    } else if (show_filter) {
+      dim_size = embedding_size - 1;
+    }
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      const auto &lod_data = inputs[i]->lod()[0];
+      const T *input_data = inputs[i]->data<T>();
+      auto *output = outputs[i];
+      output->Resize({batch_size, dim_size * embedx_concate_size});
+      T *out_data = output->mutable_data<T>(place);
+      std::vector<double> sum(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        for (int c = 0; c < embedx_concate_size; ++c) {
+          size_t start = lod_data[j];
+          size_t end = lod_data[j + 1];
+          // concate c pools the c-th feasign of the instance
+          if (embedx_concate_size > 1) {
+            start = std::min<size_t>(start + c, end);
+            end = std::min<size_t>(start + 1, end);
+          }
+          SeqpoolSumRows(input_data, embedding_size, start, end,
+                         padding_value, filter, 0, 0, sum.data());
+          T *out = out_data + (j * embedx_concate_size + c) * dim_size;
+          if (!use_cvm) {
+            std::copy(sum.begin() + cvm_offset, sum.end(), out);
+          } else if (show_filter) {
+            // click, conv, embedx
+            out[0] = log(sum[1] + 1);
+            out[1] = log(sum[2] + 1) - log(sum[1] + 1);
+            std::copy(sum.begin() + 3, sum.end(), out + 2);
+          } else {
+            // show, click, conv, embedx
+            out[0] = log(sum[0] + 1);
+            out[1] = log(sum[1] + 1);
+            out[2] = log(sum[2] + 1) - log(sum[1] + 1);
+            std::copy(sum.begin() + 3, sum.end(), out + 3);
+          }
+        }
+      }
+    });
+  }
+};
+
+template <typename T>
+class FusedSeqpoolCVMGradOpWithConvCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto out_grads = ctx.MultiInput<LoDTensor>(framework::GradVarName("Out"));
+    auto in_grads = ctx.MultiOutput<LoDTensor>(framework::GradVarName("X"));
+    auto *cvm = ctx.Input<LoDTensor>("CVM");
+
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    const int cvm_offset = ctx.Attr<int>("cvm_offset");
+    bool show_filter = ctx.Attr<bool>("show_filter");
+    const int embedx_concate_size = ctx.Attr<int>("embedx_concate_size");
+
+    const auto slot_size = in_grads.size();
+    auto place = ctx.GetPlace();
+
+    int embedding_size = in_grads[0]->numel() / in_grads[0]->dims()[0];
+    int dim_size = embedding_size;
+    int dim_off = 0;
+    if (use_cvm) {
+      if (show_filter) {
+        dim_size = embedding_size - 1;
+        dim_off = 1;
+      }
+    } else {
+      dim_size = embedding_size - cvm_offset;
+      dim_off = cvm_offset;
+    }
+    const int batch_size = FusedSeqpoolBatchSize(in_grads);
+    const T *cvm_data = cvm->data<T>();
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      auto *in_grad = in_grads[i];
+      const auto &lod_data = in_grad->lod()[0];
+      const T *out_grads_value = out_grads[i]->data<T>();
+      T *in_grads_value = in_grad->mutable_data<T>(place);
+      std::vector<T> grad_row(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        for (int c = 0; c < embedx_concate_size; ++c) {
+          SeqpoolCVMGradRow(
+              cvm_data + j * cvm_offset,
+              out_grads_value + (j * embedx_concate_size + c) * dim_size,
+              embedding_size, cvm_offset, dim_off, grad_row.data());
+          // the last concate also takes the feasigns after it
+          size_t end = lod_data[j + 1];
+          size_t start = std::min<size_t>(lod_data[j] + c, end);
+          if (c < embedx_concate_size - 1) {
+            end = std::min<size_t>(start + 1, end);
+          }
+          SeqpoolBroadcastRow(grad_row.data(), embedding_size, start, end,
+                              in_grads_value);
+        }
+      }
+    });
+  }
+};
+
 }  // namespace operators
 }  // namespace paddle
 
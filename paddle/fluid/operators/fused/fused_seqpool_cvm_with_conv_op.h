@@ -24,25 +24,5 @@ namespace operators {
 
 using LoDTensor = framework::LoDTensor;
 
-template <typename T>
-class FusedSeqpoolCVMOpWithConvCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMOpWithConv only support GPU "
-        "now.");
-  }
-};
-
-template <typename T>
-class FusedSeqpoolCVMGradOpWithConvCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMGradOpWithConv, only support GPU "
-        "now.");
-  }
-};
-
 }  // namespace operators
 }  // namespace paddle
@@ -14,6 +14,7 @@ limitations under the License. */
 
 #include "paddle/fluid/operators/fused/fused_seqpool_cvm_with_credit_op.h"
 #include <string>
+#include "paddle/fluid/operators/fused/fused_seqpool_cvm_cpu.h"
 namespace paddle {
 namespace operators {
 
@@ -211,6 +212,104 @@ class FusedSeqpoolCVMGradOpWithCreditMaker
   }
 };
 
+template <typename T>
+class FusedSeqpoolCVMOpWithCreditCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto inputs = ctx.MultiInput<LoDTensor>("X");
+    auto outputs = ctx.MultiOutput<framework::Tensor>("Out");
+
+    const auto slot_size = inputs.size();
+    auto padding_value = ctx.Attr<float>("pad_value");
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    const int cvm_offset = ctx.Attr<int>("cvm_offset");
+    bool show_filter = ctx.Attr<bool>("show_filter");
+    SeqpoolShowClkFilter filter;
+
+    auto place = ctx.GetPlace();
+
+    const int batch_size = FusedSeqpoolBatchSize(inputs);
+    int embedding_size = inputs[0]->numel() / inputs[0]->dims()[0];
+    int dim_size = embedding_size;
+    if (!use_cvm) {
+      dim_size = embedding_size - cvm_offset;
+    } else if (show_filter) {
+      dim_size = embedding_size - 1;
+    }
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      const auto &lod_data = inputs[i]->lod()[0];
+      const T *input_data = inputs[i]->data<T>();
+      auto *output = outputs[i];
+      output->Resize({batch_size, dim_size});
+      T *out_data = output->mutable_data<T>(place);
+      std::vector<double> sum(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        SeqpoolSumRows(input_data, embedding_size, lod_data[j],
+                       lod_data[j + 1], padding_value, filter, 0, 0,
+                       sum.data());
+        T *out = out_data + j * dim_size;
+        if (!use_cvm) {
+          std::copy(sum.begin() + cvm_offset, sum.end(), out);
+          continue;
+        }
+        // show filter drops the show column
+        const int skip = show_filter ? 1 : 0;
+        for (int d = 0; d < cvm_offset - skip; ++d) {
+          out[d] = log(sum[d + skip] + 1);
+        }
+        std::copy(sum.begin() + cvm_offset, sum.end(),
+                  out + cvm_offset - skip);
+      }
+    });
+  }
+};
+
+template <typename T>
+class FusedSeqpoolCVMGradOpWithCreditCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto out_grads = ctx.MultiInput<LoDTensor>(framework::GradVarName("Out"));
+    auto in_grads = ctx.MultiOutput<LoDTensor>(framework::GradVarName("X"));
+    auto *cvm = ctx.Input<LoDTensor>("CVM");
+
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    const int cvm_offset = ctx.Attr<int>("cvm_offset");
+    bool show_filter = ctx.Attr<bool>("show_filter");
+
+    const auto slot_size = in_grads.size();
+    auto place = ctx.GetPlace();
+
+    int embedding_size = in_grads[0]->numel() / in_grads[0]->dims()[0];
+    int dim_size = embedding_size;
+    int dim_off = 0;
+    if (use_cvm) {
+      if (show_filter) {
+        dim_size = embedding_size - 1;
+        dim_off = 1;
+      }
+    } else {
+      dim_size = embedding_size - cvm_offset;
+      dim_off = cvm_offset;
+    }
+    const int batch_size = FusedSeqpoolBatchSize(in_grads);
+    const T *cvm_data = cvm->data<T>();
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      auto *in_grad = in_grads[i];
+      const auto &lod_data = in_grad->lod()[0];
+      const T *out_grads_value = out_grads[i]->data<T>();
+      T *in_grads_value = in_grad->mutable_data<T>(place);
+      std::vector<T> grad_row(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        SeqpoolCVMGradRow(cvm_data + j * cvm_offset,
+                          out_grads_value + j * dim_size, embedding_size,
+                          cvm_offset, dim_off, grad_row.data());
+        SeqpoolBroadcastRow(grad_row.data(), embedding_size, lod_data[j],
+                            lod_data[j + 1], in_grads_value);
+      }
+    });
+  }
+};
+
 }  // namespace operators
 }  // namespace paddle
 
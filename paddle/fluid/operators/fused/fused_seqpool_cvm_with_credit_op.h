@@ -24,27 +24,5 @@ namespace operators {
 
 using LoDTensor = framework::LoDTensor;
 
-template <typename T>
-class FusedSeqpoolCVMOpWithCreditCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMOpWithCredit only support "
-        "GPU "
-        "now.");
-  }
-};
-
-template <typename T>
-class FusedSeqpoolCVMGradOpWithCreditCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMGradOpWithCredit, only "
-        "support GPU "
-        "now.");
-  }
-};
-
 }  // namespace operators
 }  // namespace paddle
@@ -14,6 +14,7 @@ limitations under the License. */
 
 #include "paddle/fluid/operators/fused/fused_seqpool_cvm_with_diff_thres_op.h"
 #include <string>
+#include "paddle/fluid/operators/fused/fused_seqpool_cvm_cpu.h"
 namespace paddle {
 namespace operators {
 
@@ -223,6 +224,127 @@ class FusedSeqpoolCVMWithDiffThresGradOpMaker : public framework::SingleGradOpMa
   }
 };
 
+template <typename T>
+class FusedSeqpoolCVMWithDiffThresOpCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto inputs = ctx.MultiInput<LoDTensor>("X");
+    auto outputs = ctx.MultiOutput<framework::Tensor>("Out");
+
+    const auto slot_size = inputs.size();
+    auto padding_value = ctx.Attr<float>("pad_value");
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    bool need_filter = ctx.Attr<bool>("need_filter");
+    float show_coeff = ctx.Attr<float>("show_coeff");
+    float clk_coeff = ctx.Attr<float>("clk_coeff");
+    float threshold = ctx.Attr<float>("threshold");
+    const int cvm_offset = ctx.Attr<int>("cvm_offset");
+    const int quant_ratio = ctx.Attr<int>("quant_ratio");
+    bool clk_filter = ctx.Attr<bool>("clk_filter");
+    bool xbox_diff_thres_filter = ctx.Attr<bool>("xbox_diff_thres_filter");
+    auto threshold_vec = ctx.Attr<std::vector<float>>("threshold_vec");
+    if (need_filter && xbox_diff_thres_filter) {
+      PADDLE_ENFORCE_GE(threshold_vec.size(), slot_size,
+                        platform::errors::InvalidArgument(
+                            "threshold_vec should have a threshold for "
+                            "every slot, but received %d thresholds for %d "
+                            "slots.",
+                            threshold_vec.size(), slot_size));
+    }
+
+    auto place = ctx.GetPlace();
+
+    const int batch_size = FusedSeqpoolBatchSize(inputs);
+    int embedding_size = inputs[0]->numel() / inputs[0]->dims()[0];
+    int dim_size = embedding_size;
+    if (!use_cvm) {
+      dim_size = embedding_size - cvm_offset;
+    } else if (clk_filter) {
+      dim_size = embedding_size - 1;
+    }
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      SeqpoolShowClkFilter filter;
+      filter.enable = need_filter;
+      filter.show_coeff = show_coeff;
+      filter.clk_coeff = clk_coeff;
+      // the xbox filter has a threshold for every slot
+      filter.threshold = xbox_diff_thres_filter ? threshold_vec[i] : threshold;
+
+      const auto &lod_data = inputs[i]->lod()[0];
+      const T *input_data = inputs[i]->data<T>();
+      auto *output = outputs[i];
+      output->Resize({batch_size, dim_size});
+      T *out_data = output->mutable_data<T>(place);
+      std::vector<double> sum(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        SeqpoolSumRows(input_data, embedding_size, lod_data[j],
+                       lod_data[j + 1], padding_value, filter, quant_ratio,
+                       cvm_offset, sum.data());
+        T *out = out_data + j * dim_size;
+        if (!use_cvm) {
+          std::copy(sum.begin() + cvm_offset, sum.end(), out);
+        } else if (clk_filter) {
+          // show, embed, embedx
+          out[0] = log(sum[0] + 1);
+          std::copy(sum.begin() + 2, sum.end(), out + 1);
+        } else {
+          // show, ctr log(click) - log(show), embed, embedx
+          out[0] = log(sum[0] + 1);
+          out[1] = log(sum[1] + 1) - log(sum[0] + 1);
+          std::copy(sum.begin() + 2, sum.end(), out + 2);
+        }
+      }
+    });
+  }
+};
+
+template <typename T>
+class FusedSeqpoolCVMWithDiffThresGradOpCPUKernel
+    : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto out_grads = ctx.MultiInput<LoDTensor>(framework::GradVarName("Out"));
+    auto in_grads = ctx.MultiOutput<LoDTensor>(framework::GradVarName("X"));
+    auto *cvm = ctx.Input<LoDTensor>("CVM");
+
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    const int cvm_offset = ctx.Attr<int>("cvm_offset");
+    bool clk_filter = ctx.Attr<bool>("clk_filter");
+
+    const auto slot_size = in_grads.size();
+    auto place = ctx.GetPlace();
+
+    int embedding_size = in_grads[0]->numel() / in_grads[0]->dims()[0];
+    int dim_size = embedding_size;
+    int dim_off = 0;
+    if (use_cvm) {
+      if (clk_filter) {
+        dim_size = embedding_size - 1;
+        dim_off = 1;
+      }
+    } else {
+      dim_size = embedding_size - cvm_offset;
+      dim_off = cvm_offset;
+    }
+    const int batch_size = FusedSeqpoolBatchSize(in_grads);
+    const T *cvm_data = cvm->data<T>();
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      auto *in_grad = in_grads[i];
+      const auto &lod_data = in_grad->lod()[0];
+      const T *out_grads_value = out_grads[i]->data<T>();
+      T *in_grads_value = in_grad->mutable_data<T>(place);
+      std::vector<T> grad_row(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        SeqpoolCVMGradRow(cvm_data + j * cvm_offset,
+                          out_grads_value + j * dim_size, embedding_size,
+                          cvm_offset, dim_off, grad_row.data());
+        SeqpoolBroadcastRow(grad_row.data(), embedding_size, lod_data[j],
+                            lod_data[j + 1], in_grads_value);
+      }
+    });
+  }
+};
+
 }  // namespace operators
 }  // namespace paddle
 
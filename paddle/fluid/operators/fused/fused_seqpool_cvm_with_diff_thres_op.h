@@ -24,25 +24,5 @@ namespace operators {
 
 using LoDTensor = framework::LoDTensor;
 
-template <typename T>
-class FusedSeqpoolCVMWithDiffThresOpCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMWithDiffThresOp, only support GPU "
-        "now.");
-  }
-};
-
-template <typename T>
-class FusedSeqpoolCVMWithDiffThresGradOpCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMWithDiffThresGradOp, only support GPU "
-        "now.");
-  }
-};
-
 }  // namespace operators
 }  // namespace paddle
@@ -14,6 +14,7 @@ limitations under the License. */
 
 #include "paddle/fluid/operators/fused/fused_seqpool_cvm_with_pcoc_op.h"
 #include <string>
+#include "paddle/fluid/operators/fused/fused_seqpool_cvm_cpu.h"
 namespace paddle {
 namespace operators {
 
@@ -214,6 +215,125 @@ class FusedSeqpoolCVMWithPCOCGradOpMaker : public framework::SingleGradOpMaker<T
   }
 };
 
+template <typename T>
+class FusedSeqpoolCVMWithPCOCOpCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto inputs = ctx.MultiInput<LoDTensor>("X");
+    auto outputs = ctx.MultiOutput<framework::Tensor>("Out");
+
+    const auto slot_size = inputs.size();
+    auto padding_value = ctx.Attr<float>("pad_value");
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    const int used_cvm_offset = ctx.Attr<int>("cvm_offset");
+    const int max_cvm_offset = ctx.Attr<int>("max_cvm_offset");
+    const int quant_ratio = ctx.Attr<int>("quant_ratio");
+    SeqpoolShowClkFilter filter;
+    filter.enable = ctx.Attr<bool>("need_filter");
+    filter.show_coeff = ctx.Attr<float>("show_coeff");
+    filter.clk_coeff = ctx.Attr<float>("clk_coeff");
+    filter.threshold = ctx.Attr<float>("threshold");
+
+    auto place = ctx.GetPlace();
+
+    const int batch_size = FusedSeqpoolBatchSize(inputs);
+    int embedding_size = inputs[0]->numel() / inputs[0]->dims()[0];
+    const int pclk_num = used_cvm_offset - 4;  // 4 : show/clk/show2/clk2
+    const int embed_index_diff = max_cvm_offset - 2 - 2 * pclk_num;
+    int dim_size = use_cvm ? embedding_size - embed_index_diff
+                           : embedding_size - max_cvm_offset;
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      const auto &lod_data = inputs[i]->lod()[0];
+      const T *input_data = inputs[i]->data<T>();
+      auto *output = outputs[i];
+      output->Resize({batch_size, dim_size});
+      T *out_data = output->mutable_data<T>(place);
+      // pcoc pools in T like the gpu kernel
+      std::vector<T> sum(embedding_size);
+      for (int j = 0; j < batch_size; ++j) {
+        SeqpoolSumRows(input_data, embedding_size, lod_data[j],
+                       lod_data[j + 1], padding_value, filter, quant_ratio,
+                       max_cvm_offset, sum.data());
+        T *out = out_data + j * dim_size;
+        if (!use_cvm) {
+          std::copy(sum.begin() + max_cvm_offset, sum.end(), out);
+          continue;
+        }
+        // show, ctr_smooth, log(pclk) - log(show2), log(pclk) - log(clk2)
+        out[0] = log(sum[0] + 1);
+        out[1] = log(sum[1] + 1) - log(sum[0] + 1);
+        for (int d = 2; d < 2 + pclk_num; ++d) {
+          out[d] = log(sum[d + 2] + 1) - log(sum[2] + 1);
+        }
+        for (int d = 2 + pclk_num; d < 2 + 2 * pclk_num; ++d) {
+          out[d] = log(sum[d + 2 - pclk_num] + 1) - log(sum[3] + 1);
+        }
+        std::copy(sum.begin() + 2 + 2 * pclk_num + embed_index_diff,
+                  sum.end(), out + 2 + 2 * pclk_num);
+      }
+    });
+  }
+};
+
+template <typename T>
+class FusedSeqpoolCVMWithPCOCGradOpCPUKernel : public framework::OpKernel<T> {
+ public:
+  void Compute(const framework::ExecutionContext& ctx) const override {
+    auto out_grads = ctx.MultiInput<LoDTensor>(framework::GradVarName("Out"));
+    auto in_grads = ctx.MultiOutput<LoDTensor>(framework::GradVarName("X"));
+    auto *cvm = ctx.Input<LoDTensor>("CVMWithPCOC");
+
+    auto use_cvm = ctx.Attr<bool>("use_cvm");
+    const int used_cvm_offset = ctx.Attr<int>("cvm_offset");
+    const int max_cvm_offset = ctx.Attr<int>("max_cvm_offset");
+
+    const auto slot_size = in_grads.size();
+    auto place = ctx.GetPlace();
+
+    int embedding_size = in_grads[0]->numel() / in_grads[0]->dims()[0];
+    const int pclk_num = used_cvm_offset - 4;  // 4 : show/clk/show2/clk2
+    const int embed_index_diff = max_cvm_offset - 2 - 2 * pclk_num;
+    const int dim_off = use_cvm ? embed_index_diff : max_cvm_offset;
+    const int dim_size = embedding_size - dim_off;
+    const int batch_size = FusedSeqpoolBatchSize(in_grads);
+    const T *cvm_data = cvm->data<T>();
+
+    // the q values are packed with the batch, without them the pclk
+    // columns get no gradient
+    const float *q_values = nullptr;
+#ifdef PADDLE_WITH_BOX_PS
+    auto box_ptr = paddle::framework::BoxWrapper::GetInstance();
+    auto &qvalue_tensor = box_ptr->GetQTensor(box_ptr->GetPlaceDeviceId(place));
+    if (qvalue_tensor.IsInitialized() &&
+        platform::is_cpu_place(qvalue_tensor.place()) &&
+        qvalue_tensor.numel() >= static_cast<int64_t>(batch_size) * pclk_num) {
+      q_values = qvalue_tensor.data<float>();
+    }
+#endif
+    FusedSeqpoolRunSlots(place, slot_size, [&](const size_t &i) {
+      auto *in_grad = in_grads[i];
+      const auto &lod_data = in_grad->lod()[0];
+      const T *out_grads_value = out_grads[i]->data<T>();
+      T *in_grads_value = in_grad->mutable_data<T>(place);
+      std::vector<T> grad_row(embedding_size, 0);
+      for (int j = 0; j < batch_size; ++j) {
+        // show clk show2 clk2, pclk pclk2 pclk3..., unused cvm, embedx
+        std::copy(cvm_data + j * used_cvm_offset,
+                  cvm_data + j * used_cvm_offset + 4, grad_row.begin());
+        if (q_values != nullptr) {
+          std::copy(q_values + j * pclk_num, q_values + (j + 1) * pclk_num,
+                    grad_row.begin() + 4);
+        }
+        std::copy(out_grads_value + j * dim_size + max_cvm_offset - dim_off,
+                  out_grads_value + (j + 1) * dim_size,
+                  grad_row.begin() + max_cvm_offset);
+        SeqpoolBroadcastRow(grad_row.data(), embedding_size, lod_data[j],
+                            lod_data[j + 1], in_grads_value);
+      }
+    });
+  }
+};
+
 }  // namespace operators
 }  // namespace paddle
 
@@ -24,25 +24,5 @@ namespace operators {
 
 using LoDTensor = framework::LoDTensor;
 
-template <typename T>
-class FusedSeqpoolCVMWithPCOCOpCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMOp, only support GPU "
-        "now.");
-  }
-};
-
-template <typename T>
-class FusedSeqpoolCVMWithPCOCGradOpCPUKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_THROW(
-        "Unimplemented CPU kernel for FusedSeqpoolCVMGradOp, only support GPU "
-        "now.");
-  }
-};
-
 }  // namespace operators
 }  // namespace paddle
@@ -11,6 +11,8 @@ limitations under the License. */
 
 #include "paddle/fluid/operators/rank_attention_op.h"
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
@@ -22,94 +24,173 @@ namespace paddle {
 namespace operators {
 using Tensor = framework::Tensor;
 
-template <typename T>
-void rank_attention2_forward_kernel_cpu(const int ins_num,
-                                        const int ins_col,
-                                        const T* input,
-                                        const int max_rank,
-                                        const int* rank_offset,
-                                        const int para_row,
-                                        const int para_col,
-                                        const T* para,
-                                        T* out_val) {
-    int rank_cols = max_rank * 2 + 1;
-
-    // rank offset 2:1:46:2:44:3:45
-    for (int idx = 0; idx < ins_num * para_col; idx++) {
-        int row_id = idx / para_col;
-        int col_id = idx % para_col;
-
-        int lower = rank_offset[row_id * rank_cols] - 1;
+// the pairs of the rank offset grouped by the param block they read: pair
+// p = ins * max_rank + k of an instance with rank lower + 1 takes the input
+// row index[p] through the param block lower * max_rank + faster, where
+// faster + 1 and index are the k-th (rank, index) of the instance
+struct RankAttentionBlocks {
+    int max_rank = 0;
+    std::vector<int> offsets;  // block b owns pairs [offsets[b], offsets[b + 1])
+    std::vector<int> pairs;
+    std::vector<int> index;
+};
+
+inline void GroupRankAttentionPairs(const int* rank_offset,
+                                    int ins_num,
+                                    int max_rank,
+                                    RankAttentionBlocks* blocks) {
+    const int rank_cols = max_rank * 2 + 1;
+    const int block_num = max_rank * max_rank;
+    std::vector<int> pair_block(static_cast<size_t>(ins_num) * max_rank, -1);
+    blocks->max_rank = max_rank;
+    blocks->offsets.assign(block_num + 1, 0);
+    for (int ins = 0; ins < ins_num; ++ins) {
+        const int* row = rank_offset + ins * rank_cols;
+        int lower = row[0] - 1;
         if (lower < 0) {
-            out_val[idx] = 0.0;
             continue;
         }
-        assert(lower < max_rank);
-
-        float sum = 0.0;
+        PADDLE_ENFORCE_LT(lower, max_rank,
+                          platform::errors::InvalidArgument(
+                              "Input(RankOffset) rank %d of instance %d exceeds MaxRank %d.",
+                              row[0], ins, max_rank));
         for (int k = 0; k < max_rank; ++k) {
-            int faster = rank_offset[row_id * rank_cols + 2 * k + 1] - 1;
-            // note look rank_offset to know why
-            assert(faster < max_rank);
+            int faster = row[2 * k + 1] - 1;
             if (faster < 0) {
                 continue;
             }
-            int index = rank_offset[row_id * rank_cols + 2 * k + 2];
-            assert(index < ins_num);
-
-            int start = (lower * max_rank + faster) * ins_col;
-            assert(start + ins_col <= para_row);
+            PADDLE_ENFORCE_LT(faster, max_rank,
+                              platform::errors::InvalidArgument(
+                                  "Input(RankOffset) rank %d of instance %d exceeds MaxRank %d.",
+                                  row[2 * k + 1], ins, max_rank));
+            PADDLE_ENFORCE_LT(row[2 * k + 2], ins_num,
+                              platform::errors::InvalidArgument(
+                                  "Input(RankOffset) index %d of instance %d exceeds the "
+                                  "instance num %d.",
+                                  row[2 * k + 2], ins, ins_num));
+            int b = lower * max_rank + faster;
+            pair_block[ins * max_rank + k] = b;
+            ++blocks->offsets[b + 1];
+        }
+    }
+    for (int b = 0; b < block_num; ++b) {
+        blocks->offsets[b + 1] += blocks->offsets[b];
+    }
+    blocks->pairs.resize(blocks->offsets[block_num]);
+    blocks->index.resize(blocks->offsets[block_num]);
+    std::vector<int> pos(blocks->offsets.begin(), blocks->offsets.end() - 1);
+    for (int p = 0; p < ins_num * max_rank; ++p) {
+        int b = pair_block[p];
+        if (b < 0) {
+            continue;
+        }
+        int ins = p / max_rank;
+        int k = p % max_rank;
+        blocks->pairs[pos[b]] = p;
+        blocks->index[pos[b]] = rank_offset[ins * rank_cols + 2 * k + 2];
+        ++pos[b];
+    }
+}
 
-            for (int j = 0; j < ins_col; ++j) {
-                sum += input[index * ins_col + j] * para[(start + j) * para_col + col_id];
+// out[ins] = sum over the pairs of ins of x[index] * param block, the rows of
+// every param block are gathered and multiplied in one gemm
+template <typename DeviceContext, typename T>
+void RankAttentionBlockedForward(const DeviceContext& dev_ctx,
+                                 const RankAttentionBlocks& blocks,
+                                 const T* x,
+                                 int x_fea_dim,
+                                 const T* param,
+                                 int para_col,
+                                 int ins_num,
+                                 T* out) {
+    const int block_num = static_cast<int>(blocks.offsets.size()) - 1;
+    int max_pairs = 0;
+    for (int b = 0; b < block_num; ++b) {
+        max_pairs = std::max(max_pairs, blocks.offsets[b + 1] - blocks.offsets[b]);
+    }
+    std::vector<T> gathered(static_cast<size_t>(max_pairs) * x_fea_dim);
+    std::vector<T> product(static_cast<size_t>(max_pairs) * para_col);
+    std::fill(out, out + static_cast<size_t>(ins_num) * para_col, static_cast<T>(0));
+
+    auto blas = phi::funcs::GetBlas<DeviceContext, T>(dev_ctx);
+    for (int b = 0; b < block_num; ++b) {
+        const int begin = blocks.offsets[b];
+        const int n = blocks.offsets[b + 1] - begin;
+        if (n == 0) {
+            continue;
+        }
+        for (int j = 0; j < n; ++j) {
+            std::memcpy(&gathered[j * x_fea_dim], x + blocks.index[begin + j] * x_fea_dim,
+                        x_fea_dim * sizeof(T));
+        }
+        blas.GEMM(CblasNoTrans, CblasNoTrans, n, para_col, x_fea_dim, static_cast<T>(1),
+                  gathered.data(), param + static_cast<size_t>(b) * x_fea_dim * para_col,
+                  static_cast<T>(0), product.data());
+        for (int j = 0; j < n; ++j) {
+            T* dst = out + (blocks.pairs[begin + j] / blocks.max_rank) * para_col;
+            const T* src = &product[j * para_col];
+            for (int c = 0; c < para_col; ++c) {
+                dst[c] += src[c];
             }
         }
-        out_val[idx] = sum;
     }
 }
 
-template <typename T>
-void rank_attention2_backward_kernel_cpu(const int para_row,
-                                         const int para_col,
-                                         T* out_para_grad,
-                                         const int ins_num,
-                                         const int ins_col,
-                                         const T* input,
-                                         const int max_rank,
-                                         const int* rank_offset,
-                                         const T* out_grad) {
-    int rank_cols = max_rank * 2 + 1;
-
-    // rank offset 2:1:46:2:44:3:45
-    for (int idx = 0; idx < ins_num * ins_col * para_col * max_rank; idx++) {
-        int ins_id = idx / para_col / ins_col / max_rank;
-        int para_col_id = (idx / ins_col / max_rank) % para_col;
-        int ins_col_id = (idx / para_col / max_rank) % ins_col;
-        int k = (idx / para_col / ins_col) % max_rank;
-
-        int lower = rank_offset[ins_id * rank_cols] - 1;
-        if (lower < 0) {
+// grads of RankAttentionBlockedForward, per param block one gemm for the
+// param grad and one for the input grad when dx is not null. row_of(p) is
+// the input row of pair p.
+template <typename DeviceContext, typename T, typename RowOf>
+void RankAttentionBlockedBackward(const DeviceContext& dev_ctx,
+                                  const RankAttentionBlocks& blocks,
+                                  RowOf&& row_of,
+                                  int x_fea_dim,
+                                  const T* param,
+                                  int para_col,
+                                  const T* dout,
+                                  T* dparam,
+                                  T* dx) {
+    const int block_num = static_cast<int>(blocks.offsets.size()) - 1;
+    int max_pairs = 0;
+    for (int b = 0; b < block_num; ++b) {
+        max_pairs = std::max(max_pairs, blocks.offsets[b + 1] - blocks.offsets[b]);
+    }
+    std::vector<T> gathered(static_cast<size_t>(max_pairs) * x_fea_dim);
+    std::vector<T> gathered_dout(static_cast<size_t>(max_pairs) * para_col);
+    std::fill(dparam, dparam + static_cast<size_t>(block_num) * x_fea_dim * para_col,
+              static_cast<T>(0));
+
+    auto blas = phi::funcs::GetBlas<DeviceContext, T>(dev_ctx);
+    for (int b = 0; b < block_num; ++b) {
+        const int begin = blocks.offsets[b];
+        const int n = blocks.offsets[b + 1] - begin;
+        if (n == 0) {
             continue;
         }
-        assert(lower < max_rank);
-
-        int faster = rank_offset[ins_id * rank_cols + 2 * k + 1] - 1;
-        // note look rank_offset to know why
-        assert(faster < max_rank);
-        if (faster < 0) {
+        for (int j = 0; j < n; ++j) {
+            const int p = blocks.pairs[begin + j];
+            std::memcpy(&gathered[j * x_fea_dim], row_of(begin + j), x_fea_dim * sizeof(T));
+            std::memcpy(&gathered_dout[j * para_col], dout + (p / blocks.max_rank) * para_col,
+                        para_col * sizeof(T));
+        }
+        const size_t block_offset = static_cast<size_t>(b) * x_fea_dim * para_col;
+        // dparam block = gathered^T * gathered_dout
+        blas.GEMM(CblasTrans, CblasNoTrans, x_fea_dim, para_col, n, static_cast<T>(1),
+                  gathered.data(), gathered_dout.data(), static_cast<T>(0),
+                  dparam + block_offset);
+        if (dx == nullptr) {
             continue;
         }
-
-        int index = rank_offset[ins_id * rank_cols + 2 * k + 2];
-        assert(index < ins_num);
-
-        int start = (lower * max_rank + faster) * ins_col;
-        assert(start + ins_col <= para_row);
-
-        float* tmp =
-            reinterpret_cast<float*>(&out_para_grad[(start + ins_col_id) * para_col + para_col_id]);
-        out_para_grad[(start + ins_col_id) * para_col + para_col_id] =
-            *tmp + input[index * ins_col + ins_col_id] * out_grad[ins_id * para_col + para_col_id];
+        // dx rows += gathered_dout * param block^T, gathered is free again
+        blas.GEMM(CblasNoTrans, CblasTrans, n, x_fea_dim, para_col, static_cast<T>(1),
+                  gathered_dout.data(), param + block_offset, static_cast<T>(0),
+                  gathered.data());
+        for (int j = 0; j < n; ++j) {
+            T* dst = dx + blocks.index[begin + j] * x_fea_dim;
+            const T* src = &gathered[j * x_fea_dim];
+            for (int c = 0; c < x_fea_dim; ++c) {
+                dst[c] += src[c];
+            }
+        }
     }
 }
 
@@ -142,9 +223,11 @@ class RankAttention2CPUKernel : public framework::OpKernel<T> {
 
         // get data ptr
         T* out_data = Out->mutable_data<T>(ctx.GetPlace());
-        rank_attention2_forward_kernel_cpu<T>(ins_num, x_fea_dim, X->data<T>(), max_rank,
-                                              rank_offset->data<int>(), para_row, para_col,
-                                              param->data<T>(), out_data);
+        auto& dev_ctx = ctx.template device_context<DeviceContext>();
+        RankAttentionBlocks blocks;
+        GroupRankAttentionPairs(rank_offset->data<int>(), ins_num, max_rank, &blocks);
+        RankAttentionBlockedForward(dev_ctx, blocks, X->data<T>(), x_fea_dim, param->data<T>(),
+                                    para_col, ins_num, out_data);
     }
 };
 
@@ -152,9 +235,9 @@ template <typename DeviceContext, typename T>
 class RankAttention2GradCPUKernel : public framework::OpKernel<T> {
    public:
     void Compute(const framework::ExecutionContext& ctx) const override {
-        auto* X = ctx.Input<Tensor>("X");                     // not use data
-        auto* rank_offset = ctx.Input<Tensor>("RankOffset");  // not use data
-        auto* param = ctx.Input<Tensor>("RankParam");         // not use data
+        auto* X = ctx.Input<Tensor>("X");
+        auto* rank_offset = ctx.Input<Tensor>("RankOffset");
+        auto* param = ctx.Input<Tensor>("RankParam");
         auto* dout = ctx.Input<Tensor>(framework::GradVarName("Out"));
         auto* drank_para = ctx.Output<Tensor>(framework::GradVarName("RankParam"));
 
@@ -162,20 +245,143 @@ class RankAttention2GradCPUKernel : public framework::OpKernel<T> {
         auto x_dims = X->dims();
         auto ins_num = x_dims[0];
         auto x_fea_dim = x_dims[1];
+        auto para_col = param->dims()[1];
+        auto rank_offset_dims = rank_offset->dims();
+        auto max_rank = (rank_offset_dims[1] - 1) / 2;
+
+        auto& dev_ctx = ctx.template device_context<DeviceContext>();
+        T* drank_para_ptr = drank_para->mutable_data<T>(ctx.GetPlace());
+
+        RankAttentionBlocks blocks;
+        GroupRankAttentionPairs(rank_offset->data<int>(), ins_num, max_rank, &blocks);
+        const T* x_data = X->data<T>();
+        RankAttentionBlockedBackward<DeviceContext, T>(
+            dev_ctx, blocks,
+            [&](int j) { return x_data + blocks.index[j] * x_fea_dim; }, x_fea_dim,
+            param->data<T>(), para_col, dout->data<T>(), drank_para_ptr, nullptr);
+    }
+};
+
+// cpu rank_attention: same outputs as the gpu kernel except ParamHelp, the
+// expanded param of every instance only feeds the gpu batched gemm. The cpu
+// forward and grad read the param blocks in place.
+template <typename DeviceContext, typename T>
+class RankAttentionCPUKernel : public framework::OpKernel<T> {
+   public:
+    void Compute(const framework::ExecutionContext& ctx) const override {
+        auto* X = ctx.Input<Tensor>("X");
+        auto* rank_offset = ctx.Input<Tensor>("RankOffset");
+        auto* param = ctx.Input<Tensor>("RankParam");
+        auto* input_help = ctx.Output<Tensor>("InputHelp");
+        auto* param_help = ctx.Output<Tensor>("ParamHelp");
+        auto* ins_rank = ctx.Output<Tensor>("InsRank");
+        int max_rank = ctx.Attr<int>("MaxRank");
+        int64_t max_size = ctx.Attr<int>("MaxSize");
+        auto* Out = ctx.Output<Tensor>("Out");
+
+        // check dims
+        auto x_dims = X->dims();
+        auto ins_num = x_dims[0];
+        auto x_fea_dim = x_dims[1];
         auto para_dims = param->dims();
         auto para_row = para_dims[0];
         auto para_col = para_dims[1];
         auto rank_offset_dims = rank_offset->dims();
-        auto max_rank = (rank_offset_dims[1] - 1) / 2;
+        PADDLE_ENFORCE_EQ(rank_offset_dims[0], ins_num,
+                          platform::errors::InvalidArgument("Input(RankOffset) has wrong rows."));
+        PADDLE_ENFORCE_EQ(
+            (rank_offset_dims[1] - 1) / 2, max_rank,
+            platform::errors::InvalidArgument("Input(RankOffset) has wrong columns."));
+        PADDLE_ENFORCE_EQ(max_rank * max_rank * x_fea_dim, para_row,
+                          platform::errors::InvalidArgument("Input(RankParam) has wrong rows."));
+
+        int block_matrix_row = max_rank * x_fea_dim;
+        int64_t max_ins = std::max(ins_num, max_size);
+        const int rank_cols = rank_offset_dims[1];
+
+        param_help->Resize({0, para_col});
+        input_help->Resize({max_ins, block_matrix_row});
+        ins_rank->Resize({max_ins, 1});
+        T* input_help_data = input_help->mutable_data<T>(ctx.GetPlace());
+        T* ins_rank_data = ins_rank->mutable_data<T>(ctx.GetPlace());
+        T* out_data = Out->mutable_data<T>(ctx.GetPlace());
+
+        // checks the ranks and indexes of the rank offset for the expansion too
+        const int* rank_offset_data = rank_offset->data<int>();
+        RankAttentionBlocks blocks;
+        GroupRankAttentionPairs(rank_offset_data, ins_num, max_rank, &blocks);
+
+        // expand the input rows of every instance, rows past ins_num stay empty
+        const T* x_data = X->data<T>();
+        std::fill(input_help_data, input_help_data + max_ins * block_matrix_row,
+                  static_cast<T>(0));
+        std::fill(ins_rank_data, ins_rank_data + max_ins, static_cast<T>(-1));
+        for (int ins = 0; ins < ins_num; ++ins) {
+            const int* row = rank_offset_data + ins * rank_cols;
+            ins_rank_data[ins] = static_cast<T>(row[0]);
+            if (row[0] - 1 < 0) {
+                continue;
+            }
+            for (int k = 0; k < max_rank; ++k) {
+                if (row[2 * k + 1] - 1 < 0) {
+                    continue;
+                }
+                std::memcpy(input_help_data + ins * block_matrix_row + k * x_fea_dim,
+                            x_data + row[2 * k + 2] * x_fea_dim, x_fea_dim * sizeof(T));
+            }
+        }
+
+        auto& dev_ctx = ctx.template device_context<DeviceContext>();
+        RankAttentionBlockedForward(dev_ctx, blocks, x_data, x_fea_dim, param->data<T>(),
+                                    para_col, ins_num, out_data);
+    }
+};
+
+// the grads of the forward above: the param grad of every block is one gemm
+// over the InputHelp rows of its pairs, so X itself is not needed. For the
+// rank offsets of the data feed, where the k-th (rank, index) of an instance
+// has rank k + 1, these are the same grads as the gpu kernel.
+template <typename DeviceContext, typename T>
+class RankAttentionGradCPUKernel : public framework::OpKernel<T> {
+   public:
+    void Compute(const framework::ExecutionContext& ctx) const override {
+        auto* X = ctx.Input<Tensor>("X");  // not use data
+        auto* rank_offset = ctx.Input<Tensor>("RankOffset");
+        auto* param = ctx.Input<Tensor>("RankParam");
+        auto* input_help = ctx.Input<Tensor>("InputHelp");
+        auto* dout = ctx.Input<Tensor>(framework::GradVarName("Out"));
+        auto* drank_para = ctx.Output<Tensor>(framework::GradVarName("RankParam"));
+        auto* dx = ctx.Output<Tensor>(framework::GradVarName("X"));
+        bool enable_input_bp = ctx.Attr<bool>("EnableInputBp");
+
+        // get dim
+        auto x_dims = X->dims();
+        auto ins_num = x_dims[0];
+        auto x_fea_dim = x_dims[1];
+        auto para_col = param->dims()[1];
+        auto max_rank = (rank_offset->dims()[1] - 1) / 2;
+        int block_matrix_row = max_rank * x_fea_dim;
 
         auto& dev_ctx = ctx.template device_context<DeviceContext>();
-        // initialize out grad
         T* drank_para_ptr = drank_para->mutable_data<T>(ctx.GetPlace());
-        phi::funcs::set_constant(dev_ctx, drank_para, 0.0);
+        T* dx_ptr = nullptr;
+        if (dx != nullptr) {
+            dx_ptr = dx->mutable_data<T>(ctx.GetPlace());
+            phi::funcs::set_constant(dev_ctx, dx, 0.0);
+        }
 
-        rank_attention2_backward_kernel_cpu<T>(para_row, para_col, drank_para_ptr, ins_num,
-                                               x_fea_dim, X->data<T>(), max_rank,
-                                               rank_offset->data<int>(), dout->data<T>());
+        RankAttentionBlocks blocks;
+        GroupRankAttentionPairs(rank_offset->data<int>(), ins_num, max_rank, &blocks);
+        const T* input_help_data = input_help->data<T>();
+        RankAttentionBlockedBackward<DeviceContext, T>(
+            dev_ctx, blocks,
+            [&](int j) {
+                int p = blocks.pairs[j];
+                return input_help_data + (p / max_rank) * block_matrix_row +
+                       (p % max_rank) * x_fea_dim;
+            },
+            x_fea_dim, param->data<T>(), para_col, dout->data<T>(), drank_para_ptr,
+            enable_input_bp ? dx_ptr : nullptr);
     }
 };
 
@@ -296,7 +502,7 @@ class RankAttentionOpMaker : public framework::OpProtoAndCheckerMaker {
     AddComment(R"DOC(
 RankAttention Operator.
 This Op can calculate rank attention between input and rank_param,
-and rank_param gives the organization of data. Notice: It currently supports GPU device.
+and rank_param gives the organization of data. Notice: It supports CPU and GPU device.
 This Op exists in contrib, which means that it is not shown to the public.
 )DOC");
     }
@@ -328,9 +534,7 @@ class RankAttentionGradOpMaker : public framework::SingleGradOpMaker<T> {
 };
 
 DECLARE_NO_NEED_BUFFER_VARS_INFERER(RankAttentionGradOpNoNeedBufferVarsInference,
-                                    "X",
-                                    "RankOffset",
-                                    "RankParam");
+                                    "X");
 
 class RankAttention2Op : public framework::OperatorWithKernel {
    public:
@@ -409,7 +613,7 @@ class RankAttention2OpMaker : public framework::OpProtoAndCheckerMaker {
         AddComment(R"DOC(
 RankAttention Operator.
 This Op can calculate rank attention between input and rank_param,
-and rank_param gives the organization of data. Notice: It currently supports GPU device.
+and rank_param gives the organization of data. Notice: It supports CPU and GPU device.
 This Op exists in contrib, which means that it is not shown to the public.
 )DOC");
     }
@@ -463,13 +667,17 @@ REGISTER_OPERATOR(rank_attention2_grad, ops::RankAttention2GradOp);
 //                   ops::RankAttention2GradOpNoNeedBufferVarsInference);
 
 REGISTER_OP_CPU_KERNEL(rank_attention,
-                       ops::RankAttentionKernel<CPUCtx, float>,
-                       ops::RankAttentionKernel<CPUCtx, double>);
+                       ops::RankAttentionCPUKernel<CPUCtx, float>,
+                       ops::RankAttentionCPUKernel<CPUCtx, double>);
+
+REGISTER_OP_CPU_KERNEL(rank_attention_grad,
+                       ops::RankAttentionGradCPUKernel<CPUCtx, float>,
+                       ops::RankAttentionGradCPUKernel<CPUCtx, double>);
 
 REGISTER_OP_CPU_KERNEL(rank_attention2,
                        ops::RankAttention2CPUKernel<CPUCtx, float>,
-                       ops::RankAttentionKernel<CPUCtx, double>);
+                       ops::RankAttention2CPUKernel<CPUCtx, double>);
 
 REGISTER_OP_CPU_KERNEL(rank_attention2_grad,
                        ops::RankAttention2GradCPUKernel<CPUCtx, float>,
-                       ops::RankAttentionKernel<CPUCtx, double>);
+                       ops::RankAttention2GradCPUKernel<CPUCtx, double>);
@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License. */
 
 #include "paddle/fluid/operators/scaled_fc_op.h"
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include "paddle/phi/kernels/funcs/blas/blas.h"
 
@@ -22,75 +24,16 @@ namespace paddle {
 namespace operators {
 using framework::Tensor;
 
-template <typename T>
-void cast_and_padding_cpu_kernel(const unsigned int rown_ori,
-                                 const unsigned int coln_ori,
-                                 const unsigned int rown_pad,
-                                 const unsigned int coln_pad,
-                                 const T* matrix,
-                                 float* matrix_pad,
-                                 T grad_scale_factor) {
-    int N = rown_pad * coln_pad;
-    for (int i = 0; i < N; i++) {
-        unsigned int col_idx = i % coln_pad;
-        unsigned int row_idx = i / coln_pad;
-        if (row_idx < rown_ori && col_idx < coln_ori) {
-            int idx = row_idx * coln_ori + col_idx;
-            matrix_pad[i] = static_cast<float>(matrix[idx] * grad_scale_factor);
-        } else {
-            matrix_pad[i] = static_cast<float>(0.0);
-        }
-    }
-}
-
-template <typename T>
-void vec_mat_row_add_cpu_kernel(const unsigned int rown,
-                                const unsigned int coln,
-                                T* matrix,
-                                const T* vector,
-                                const T bias_scale_factor_use) {
-    int N = rown * coln;
-    for (int i = 0; i < N; i++) {
-        matrix[i] += vector[i % coln] * bias_scale_factor_use;
-    }
-}
-
-template <typename T>
-void cast_and_cut_cpu_kernel(const unsigned int rown_ori,
-                             const unsigned int coln_ori,
-                             const unsigned int rown_pad,
-                             const unsigned int coln_pad,
-                             T* matrix,
-                             float* matrix_pad,
-                             T scale_factor) {
-    int N = rown_ori * coln_ori;
-    for (int i = 0; i < N; i++) {
-        int col_idx = i % coln_ori;
-        int row_idx = i / coln_ori;
-        int idx = row_idx * coln_pad + col_idx;
-        matrix[i] = static_cast<T>(matrix_pad[idx]);
-        matrix[i] *= scale_factor;
-    }
-}
-
-template <typename T>
-void col_sum_mat_cpu_kernel(const unsigned int rown,
-                            const unsigned int coln,
-                            const T* matrix,
-                            T* vector,
-                            const T bias_scale_factor_use) {
-    for (unsigned int i = 0; i < coln; i++) {
-        for (unsigned int j = 0; j < rown; j++) {
-            vector[i] += matrix[j * coln + i];
-        }
-    }
-}
-
+// the gpu kernels scale the input before the fp16 gemm and unscale the output
+// after it to keep fp16 in range. In T on cpu the two scales cancel, what is
+// left of them is folded into the gemm: the output rows start as the bias
+// times bias_scale_factor / input_scale_factor and the gemm accumulates
+// input * w onto them with beta = 1, no padded or casted copies.
 template <typename DeviceContext, typename T>
 class ScaledFCCPUKernel : public framework::OpKernel<T> {
    public:
     void Compute(const framework::ExecutionContext& ctx) const override {
-        auto* input = ctx.Input<framework::LoDTensor>("Input");  // framework::Tensor*
+        auto* input = ctx.Input<framework::LoDTensor>("Input");
         auto* w = ctx.Input<Tensor>("W");
         auto* bias = ctx.Input<Tensor>("Bias");
         auto* output = ctx.Output<framework::LoDTensor>("Out");
@@ -99,89 +42,36 @@ class ScaledFCCPUKernel : public framework::OpKernel<T> {
 
         auto input_dims = input->dims();
         auto w_dims = w->dims();
-        auto ins_num = input_dims[0];  // oriinput: ins_num*in_feat, oriweight: in_feat* out_fea,
-                                       // output: ins_num* out_feat
-        auto in_feat = input_dims[1];
-        auto out_feat = w_dims[1];
-
-        output->mutable_data<T>(ctx.GetPlace());
-        output->Resize({ins_num, w_dims[1]});
-
-        auto& dev_ctx = ctx.template device_context<CPUCtx>();
-
-        // begin cast and pad
-        const unsigned int insnum_ori = ins_num;
-        const unsigned int infea_ori = in_feat;
-        const unsigned int outfea_ori = out_feat;
-
-        const unsigned int insnum_pad =
-            (insnum_ori % 8) == 0 ? insnum_ori : insnum_ori + (8 - insnum_ori % 8);
-        const unsigned int infea_pad =
-            (infea_ori % 8) == 0 ? infea_ori : infea_ori + (8 - infea_ori % 8);
-        const unsigned int outfea_pad =
-            (outfea_ori % 8) == 0 ? outfea_ori : outfea_ori + (8 - outfea_ori % 8);
-
-        framework::Tensor input_help;
-        input_help = ctx.AllocateTmpTensor<float, DeviceContext>({insnum_pad, infea_pad}, dev_ctx);
-
-        framework::Tensor w_help;
-        w_help = ctx.AllocateTmpTensor<float, DeviceContext>({infea_pad, outfea_pad}, dev_ctx);
-
-        framework::Tensor bias_help;
-        bias_help = ctx.AllocateTmpTensor<float, DeviceContext>({outfea_pad, 1}, dev_ctx);
-
-        framework::Tensor output_help;
-        output_help =
-            ctx.AllocateTmpTensor<float, DeviceContext>({insnum_pad, outfea_pad}, dev_ctx);
-
-        T scale = static_cast<T>(1.0);
-        cast_and_padding_cpu_kernel<T>(insnum_ori, infea_ori, insnum_pad, infea_pad,
-                                       input->data<T>(),
-                                       input_help.mutable_data<float>(ctx.GetPlace()), scale);
-        cast_and_padding_cpu_kernel<T>(infea_ori, outfea_ori, infea_pad, outfea_pad, w->data<T>(),
-                                       w_help.mutable_data<float>(ctx.GetPlace()), scale);
-        cast_and_padding_cpu_kernel<T>(outfea_ori, 1, outfea_pad, 1, bias->data<T>(),
-                                       bias_help.mutable_data<float>(ctx.GetPlace()), scale);
-        VLOG(3) << "input dim0=" << input->dims()[0] << ", input dim1=" << input->dims()[1]
-                << ", input_help dim0=" << input_help.dims()[0]
-                << ", input_help dim1=" << input_help.dims()[1];
-        VLOG(3) << "w dim0=" << w->dims()[0] << ", w dim1=" << w->dims()[1]
-                << ", w_help dim0=" << w_help.dims()[0] << ", w_help dim1=" << w_help.dims()[1];
-        VLOG(3) << "bias dim0=" << bias->dims()[0] << ", bias dim1=" << bias->dims()[1]
-                << ", bias_help dim0=" << bias_help.dims()[0]
-                << ", bias_help dim1=" << bias_help.dims()[1];
-
-        // begin fc
-        CBLAS_TRANSPOSE transA = CblasNoTrans;
-        CBLAS_TRANSPOSE transB = CblasNoTrans;
-        auto blas = phi::funcs::GetBlas<CPUCtx, float>(dev_ctx);
-        float alpha = static_cast<float>(input_scale_factor);
-        float bias_scale_factor_use = static_cast<float>(bias_scale_factor);
-        float beta = static_cast<float>(0.0);
-
-        blas.GEMM(transA, transB, insnum_pad, outfea_pad, infea_pad, alpha,
-                  input_help.data<float>(), w_help.data<float>(), beta,
-                  output_help.mutable_data<float>(ctx.GetPlace()));
-
-        // begin row add
-        vec_mat_row_add_cpu_kernel<float>(insnum_pad, outfea_pad, output_help.data<float>(),
-                                          bias_help.data<float>(), bias_scale_factor_use);
-
-        // begin cast and cut
-        T scale_factor = static_cast<T>(1 / input_scale_factor);
-        cast_and_cut_cpu_kernel<T>(insnum_ori, outfea_ori, insnum_pad, outfea_pad,
-                                   output->data<T>(), output_help.data<float>(), scale_factor);
+        // input: ins_num * in_feat, w: in_feat * out_feat, output: ins_num * out_feat
+        int ins_num = input_dims[0];
+        int in_feat = input_dims[1];
+        int out_feat = w_dims[1];
+
+        output->Resize({ins_num, out_feat});
+        T* out_data = output->mutable_data<T>(ctx.GetPlace());
+
+        T bias_scale = static_cast<T>(bias_scale_factor) / static_cast<T>(input_scale_factor);
+        const T* bias_data = bias->data<T>();
+        for (int c = 0; c < out_feat; ++c) {
+            out_data[c] = bias_data[c] * bias_scale;
+        }
+        for (int i = 1; i < ins_num; ++i) {
+            std::memcpy(out_data + i * out_feat, out_data, out_feat * sizeof(T));
+        }
 
-        VLOG(3) << "input_scale_factor=" << input_scale_factor
-                << ", bias_scale_factor_use=" << bias_scale_factor_use
-                << ", output scale_factor=" << scale_factor;
+        auto& dev_ctx = ctx.template device_context<DeviceContext>();
+        auto blas = phi::funcs::GetBlas<DeviceContext, T>(dev_ctx);
+        blas.GEMM(CblasNoTrans, CblasNoTrans, ins_num, out_feat, in_feat, static_cast<T>(1),
+                  input->data<T>(), w->data<T>(), static_cast<T>(1), out_data);
 
-        VLOG(3) << "output_help dim0=" << output_help.dims()[0]
-                << ", output_help dim1=" << output_help.dims()[1]
-                << ", output dim0=" << output->dims()[0] << ", output dim1=" << output->dims()[1];
+        VLOG(3) << "input_scale_factor=" << input_scale_factor
+                << ", bias_scale_factor=" << bias_scale_factor << ", ins_num=" << ins_num
+                << ", in_feat=" << in_feat << ", out_feat=" << out_feat;
     }
 };
 
+// grad_scale_factor and input_scale_factor cancel the same way: dx = dout *
+// w^T and dw = input^T * dout are single gemms, db the column sums of dout.
 template <typename DeviceContext, typename T>
 class ScaledFCGradCPUKernel : public framework::OpKernel<T> {
    public:
@@ -190,107 +80,38 @@ class ScaledFCGradCPUKernel : public framework::OpKernel<T> {
         auto* w = ctx.Input<Tensor>("W");
         auto* dout = ctx.Input<Tensor>(framework::GradVarName("Out"));  // insnum * outfea
 
-        auto input_scale_factor = ctx.Attr<float>("input_scale_factor");
-        auto bias_scale_factor = ctx.Attr<float>("bias_scale_factor");
-        auto grad_scale_factor = ctx.Attr<float>("grad_scale_factor");
-
-        T bias_scale_factor_use = static_cast<T>(bias_scale_factor);
-        float alpha = static_cast<float>(input_scale_factor);
-        float beta = static_cast<float>(0.0);
-
         auto* dx = ctx.Output<Tensor>(framework::GradVarName("Input"));
         auto* dw = ctx.Output<Tensor>(framework::GradVarName("W"));
         auto* db = ctx.Output<Tensor>(framework::GradVarName("Bias"));
 
         auto input_dims = input->dims();  // ins_num*in_feat
-        auto dout_dims = dout->dims();    // ins_num*out_feat
         auto w_dims = w->dims();          // in_feat*out_feat
+        int ins_num = input_dims[0];
+        int in_feat = input_dims[1];
+        int out_feat = w_dims[1];
 
-        auto dout_coln = dout_dims[1];
-        auto ins_num = dout_dims[0];
-
-        auto& dev_ctx = ctx.template device_context<CPUCtx>();
-
-        // initialize
-        dx->mutable_data<T>(ctx.GetPlace());
-        phi::funcs::set_constant(dev_ctx, dx, 0.0);
-
-        dw->mutable_data<T>(ctx.GetPlace());
-        phi::funcs::set_constant(dev_ctx, dw, 0.0);
-
-        db->mutable_data<T>(ctx.GetPlace());
-        phi::funcs::set_constant(dev_ctx, db, 0.0);
-
-        // get bias grad
-        col_sum_mat_cpu_kernel(ins_num, dout_coln, dout->data<T>(), db->data<T>(),
-                               bias_scale_factor_use);
-
-        // pad
-        const unsigned int insnum_ori = input_dims[0];
-        const unsigned int infea_ori = input_dims[1];
-        const unsigned int outfea_ori = w_dims[1];
-
-        const unsigned int insnum_pad =
-            (insnum_ori % 8) == 0 ? insnum_ori : insnum_ori + (8 - insnum_ori % 8);
-        const unsigned int infea_pad =
-            (infea_ori % 8) == 0 ? infea_ori : infea_ori + (8 - infea_ori % 8);
-        const unsigned int outfea_pad =
-            (outfea_ori % 8) == 0 ? outfea_ori : outfea_ori + (8 - outfea_ori % 8);
-        VLOG(3) << "input dim0=" << input_dims[0] << ", input dim1=" << input_dims[1]
-                << ", dout dim0=" << dout_dims[0] << ", dout dim1=" << dout_dims[1]
-                << ", w dim0=" << w_dims[0] << ", w dim1=" << w_dims[1]
-                << ", insnum_ori=" << insnum_ori << ", insnum_pad=" << insnum_pad
-                << ", infea_ori=" << infea_ori << ", infea_pad=" << infea_pad
-                << ", outfea_ori=" << outfea_ori << ", outfea_pad=" << outfea_pad;
-
-        framework::Tensor dx_help;
-        dx_help = ctx.AllocateTmpTensor<float, DeviceContext>({insnum_pad, infea_pad}, dev_ctx);
-
-        framework::Tensor dw_help;
-        dw_help = ctx.AllocateTmpTensor<float, DeviceContext>({infea_pad, outfea_pad}, dev_ctx);
-
-        framework::Tensor dout_help;
-        dout_help = ctx.AllocateTmpTensor<float, DeviceContext>({insnum_pad, outfea_pad}, dev_ctx);
-
-        framework::Tensor input_help;
-        input_help = ctx.AllocateTmpTensor<float, DeviceContext>({insnum_pad, infea_pad}, dev_ctx);
-
-        framework::Tensor w_help;
-        w_help = ctx.AllocateTmpTensor<float, DeviceContext>({infea_pad, outfea_pad}, dev_ctx);
-
-        T scale = static_cast<T>(1.0);
-        cast_and_padding_cpu_kernel<T>(insnum_ori, infea_ori, insnum_pad, infea_pad,
-                                       input->data<T>(),
-                                       input_help.mutable_data<float>(ctx.GetPlace()), scale);
-        cast_and_padding_cpu_kernel<T>(infea_ori, outfea_ori, infea_pad, outfea_pad, w->data<T>(),
-                                       w_help.mutable_data<float>(ctx.GetPlace()), scale);
-        T dout_grad_scale_factor =
-            static_cast<T>(grad_scale_factor) * static_cast<T>(1 / input_scale_factor);
-        cast_and_padding_cpu_kernel<T>(
-            insnum_ori, outfea_ori, insnum_pad, outfea_pad, dout->data<T>(),
-            dout_help.mutable_data<float>(ctx.GetPlace()), dout_grad_scale_factor);
-
-        auto blas = phi::funcs::GetBlas<CPUCtx, float>(dev_ctx);
+        auto& dev_ctx = ctx.template device_context<DeviceContext>();
+        auto blas = phi::funcs::GetBlas<DeviceContext, T>(dev_ctx);
+        const T* dout_data = dout->data<T>();
 
         // dx = dy * w^T
-        blas.GEMM(CblasNoTrans, CblasTrans, insnum_pad, infea_pad, outfea_pad, alpha,
-                  dout_help.data<float>(), w_help.data<float>(), beta,
-                  dx_help.mutable_data<float>(ctx.GetPlace()));
+        blas.GEMM(CblasNoTrans, CblasTrans, ins_num, in_feat, out_feat, static_cast<T>(1),
+                  dout_data, w->data<T>(), static_cast<T>(0),
+                  dx->mutable_data<T>(ctx.GetPlace()));
         // dw = x^T * dy
-        blas.GEMM(CblasTrans, CblasNoTrans, infea_pad, outfea_pad, insnum_pad, alpha,
-                  input_help.data<float>(), dout_help.data<float>(), beta,
-                  dw_help.mutable_data<float>(ctx.GetPlace()));
-
-        // cast dx dw to fp32 and cut
-        T scale_factor = static_cast<T>(1.0 / grad_scale_factor);
-        cast_and_cut_cpu_kernel<T>(insnum_ori, infea_ori, insnum_pad, infea_pad, dx->data<T>(),
-                                   dx_help.data<float>(), scale_factor);
-        cast_and_cut_cpu_kernel<T>(infea_ori, outfea_ori, infea_pad, outfea_pad, dw->data<T>(),
-                                   dw_help.data<float>(), scale_factor);
-        VLOG(3) << "input_scale_factor=" << input_scale_factor
-                << ", bias_scale_factor_use=" << bias_scale_factor_use
-                << ", dout_grad_scale_factor=" << dout_grad_scale_factor
-                << ", dx_grad dw_grad scale_factor=" << scale_factor;
+        blas.GEMM(CblasTrans, CblasNoTrans, in_feat, out_feat, ins_num, static_cast<T>(1),
+                  input->data<T>(), dout_data, static_cast<T>(0),
+                  dw->mutable_data<T>(ctx.GetPlace()));
+
+        // get bias grad
+        T* db_data = db->mutable_data<T>(ctx.GetPlace());
+        std::fill(db_data, db_data + out_feat, static_cast<T>(0));
+        for (int i = 0; i < ins_num; ++i) {
+            const T* row = dout_data + i * out_feat;
+            for (int c = 0; c < out_feat; ++c) {
+                db_data[c] += row[c];
+            }
+        }
     }
 };
 
@@ -366,7 +187,7 @@ class ScaledFCOpMaker : public framework::OpProtoAndCheckerMaker {
         AddOutput("Out", "Output tensor of scaled_fc_op operator.");
         AddComment(R"DOC(
 ScaledFC Operator.
-Notice: It currently supports GPU device.
+Notice: It supports CPU and GPU device.
 This Op exists in contrib, which means that it is not shown to the public.
 )DOC");
     }
@@ -407,8 +228,8 @@ REGISTER_OPERATOR(scaled_fc_grad, ops::ScaledFCGradOp);
 
 REGISTER_OP_CPU_KERNEL(scaled_fc,
                        ops::ScaledFCCPUKernel<CPUCtx, float>,
-                       ops::ScaledFCKernel<CPUCtx, double>);
+                       ops::ScaledFCCPUKernel<CPUCtx, double>);
 
 REGISTER_OP_CPU_KERNEL(scaled_fc_grad,
                        ops::ScaledFCGradCPUKernel<CPUCtx, float>,
-                       ops::ScaledFCKernel<CPUCtx, double>);
+                       ops::ScaledFCGradCPUKernel<CPUCtx, double>);
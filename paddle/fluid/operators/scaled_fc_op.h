@@ -19,14 +19,5 @@ limitations under the License. */
 namespace paddle {
 namespace operators {
 
-template <typename DeviceContext, typename T>
-class ScaledFCKernel : public framework::OpKernel<T> {
- public:
-  void Compute(const framework::ExecutionContext& ctx) const override {
-    PADDLE_ENFORCE_EQ(
-        platform::is_gpu_place(ctx.GetPlace()), true,
-        platform::errors::Unimplemented("ScaledFC only supports GPU now."));
-  }
-};
 }  // namespace operators
 }  // namespace paddle
@@ -876,6 +876,22 @@ PADDLE_DEFINE_EXPORTED_bool(graph_load_in_parallel,
                             "It controls whether load graph node and edge with "
                             "mutli threads parallely.");
 
+/**
+ * Distributed related FLAG
+ * Name: FLAGS_graph_load_block_size_mb
+ * Since Version: 2.4.0
+ * Value Range: int32, default=8
+ * Example:
+ * Note: The graph node and edge files are cut into blocks of this many MB,
+ *       which are parsed by multi threads. If it is 0, every file is parsed
+ *       line by line by one thread.
+ */
+PADDLE_DEFINE_EXPORTED_int32(
+    graph_load_block_size_mb,
+    8,
+    "The size in MB of the file blocks graph nodes and edges are parsed "
+    "from in parallel, 0 parses the files line by line.");
+
 /**
  * Distributed related FLAG
  * Name: FLAGS_graph_get_neighbor_id
@@ -1012,6 +1028,8 @@ PADDLE_DEFINE_EXPORTED_bool(enable_dense_nccl_barrier, false,
             "enable dense nccl barrier , default false");
 PADDLE_DEFINE_EXPORTED_bool(enable_pullpush_dedup_keys, true,
             "enable pull push dedup keys, default false");
+PADDLE_DEFINE_EXPORTED_bool(padbox_cpu_native_dedup, true,
+            "dedup cpu pull keys in paddle instead of boxps, default true");
 PADDLE_DEFINE_EXPORTED_bool(enable_shuffle_by_searchid, false,
             "enable dualbox shuffle by searchid, default false");
 PADDLE_DEFINE_EXPORTED_bool(enable_pull_box_padding_zero, true,
@@ -1034,6 +1052,12 @@ PADDLE_DEFINE_EXPORTED_int32(padbox_dataset_shuffle_thread_num, 20,
              "PadBoxSlotDataset shuffle thread num");
 PADDLE_DEFINE_EXPORTED_int32(padbox_dataset_merge_thread_num, 20,
              "PadBoxSlotDataset shuffle thread num");
+PADDLE_DEFINE_EXPORTED_int32(padbox_dataset_shuffle_block_size, 0,
+             "PadBoxSlotDataset shuffle message bytes, if > 0 records are "
+             "sent in size prefixed blocks and deserialized by merge threads");
+PADDLE_DEFINE_EXPORTED_int32(padbox_dataset_lock_free_channel_size, 0,
+             "PadBoxSlotDataset input channel records, if > 0 it is a "
+             "bounded lock free channel");
 PADDLE_DEFINE_EXPORTED_bool(padbox_dataset_disable_shuffle, false,
             "if true ,will disable data shuffle");
 PADDLE_DEFINE_EXPORTED_bool(padbox_auc_runner_mode, false, "auc runner mode");
@@ -1049,6 +1073,17 @@ PADDLE_DEFINE_EXPORTED_bool(dump_filed_same_as_aibox, false,
             "abc:1:1, which same as aibox");
 PADDLE_DEFINE_EXPORTED_bool(padbox_dataset_disable_random_update, false,
             "if true ,will feed & update data with the same sequence");
+PADDLE_DEFINE_EXPORTED_bool(padbox_slotrecord_arena, false,
+            "if true ,PadBoxSlotDataset allocates pass records from arena "
+            "and releases them together in ReleaseMemory, built with "
+            "WITH_SLOTRECORD_ARENA their feasigns also grow in the arena");
+PADDLE_DEFINE_EXPORTED_bool(padbox_archive_columnar_format, false,
+            "if true ,PreLoadIntoDisk will write columnar archive file, "
+            "which is loaded by mmap");
+PADDLE_DEFINE_EXPORTED_bool(padbox_slot_text_parser, false,
+            "if true ,SlotPaddleBoxDataFeed parses text lines with the builtin "
+            "vectorized parser when no parser so is configured, and so does "
+            "MultiSlotInMemoryDataFeed reading from pipe");
 
 PADDLE_DEFINE_EXPORTED_bool(
     gpugraph_enable_hbm_table_collision_stat,
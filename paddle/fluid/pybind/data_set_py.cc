@@ -19,6 +19,7 @@ limitations under the License. */
 #ifdef _XOPEN_SOURCE
 #undef _XOPEN_SOURCE
 #endif
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -37,6 +38,7 @@ limitations under the License. */
 #include "paddle/fluid/platform/place.h"
 
 #include "paddle/fluid/pybind/data_set_py.h"
+#include "pybind11/stl.h"
 
 namespace py = pybind11;
 namespace pd = paddle::framework;
@@ -400,6 +402,8 @@ void BindDataset(py::module *m) {
            py::call_guard<py::gil_scoped_release>())
       .def("set_archivefile", &framework::Dataset::SetLoadArchiveFile,
            py::call_guard<py::gil_scoped_release>())
+      .def("get_pipeline_stat", &framework::Dataset::GetPipelineStat,
+           py::call_guard<py::gil_scoped_release>())
       .def("set_gpu_graph_mode",
            &framework::Dataset::SetGpuGraphMode,
            py::call_guard<py::gil_scoped_release>());
@@ -1550,6 +1550,13 @@ class PadBoxSlotDataset(BoxPSDataset):
         """
         self.dataset.set_archivefile(archive)
 
+    def get_pipeline_stat(self):
+        """
+            get load pipeline stat of current pass, a dict of
+            stage.records_per_sec, channel.read_wait_sec, slot_pool.hit etc.
+        """
+        return self.dataset.get_pipeline_stat()
+
 
 class InputTableDataset(PadBoxSlotDataset):
     def __init__(self):
@@ -0,0 +1,103 @@
+#   Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+from __future__ import print_function
+
+import unittest
+import numpy as np
+from op_test import OpTest
+import paddle.fluid.core as core
+
+
+class TestFusedSeqTensorOp(OpTest):
+
+    def config(self):
+        self.ins_num = 3
+        self.batch_count = 1
+        self.max_length = 4
+        self.slot_num = 5
+        self.fea_emb_dim = 6
+        self.ad_slot_num = 2
+        self.ad_slot_offset = 0
+
+    def setUp(self):
+        self.op_type = 'fused_seq_tensor'
+        self.config()
+        ins, bc, length = self.ins_num, self.batch_count, self.max_length
+        slot, emb = self.slot_num, self.fea_emb_dim
+        ad_num, ad_offset = self.ad_slot_num, self.ad_slot_offset
+        x = np.random.uniform(-1, 1,
+                              [ins, bc, slot, length, emb]).astype('float32')
+        # padding positions are all zero
+        x[:, :, :, length - 1, :] = 0
+        ad = np.random.uniform(-1, 1, [ins, bc, ad_num, emb]).astype('float32')
+
+        # [bc, ins, length, slot, emb]
+        seq = x.transpose(1, 0, 3, 2, 4)
+        side_offset = ad_num if ad_offset == 0 else 0
+        ad_seq = seq[:, :, :, ad_offset:ad_offset + ad_num].reshape(
+            [bc, ins, length, ad_num * emb])
+        side = seq[:, :, :, side_offset:side_offset + slot - ad_num].reshape(
+            [bc, ins, length, (slot - ad_num) * emb])
+        ad_val = np.broadcast_to(
+            ad.transpose(1, 0, 2, 3).reshape([bc, ins, 1, ad_num * emb]),
+            ad_seq.shape)
+        din = np.concatenate(
+            [ad_seq, ad_val, ad_seq - ad_val, ad_seq * ad_val], axis=-1)
+        mask = (np.abs(seq.sum(axis=(3, 4))) > 1e-8).astype('float32')
+        if bc > 1:
+            din = din.reshape([bc, ins * length, -1])
+            side = side.reshape([bc, ins * length, -1])
+            session = ad_seq.reshape([bc, ins * length, ad_num, emb])
+        else:
+            din, side, mask = din[0], side[0], mask[0]
+            session = ad_seq[0]
+
+        self.inputs = {
+            'Input': x.reshape([ins, -1]),
+            'ADInput': ad.reshape([ins, -1])
+        }
+        self.attrs = {
+            'batch_count': bc,
+            'max_length': length,
+            'slot_num': slot,
+            'fea_emb_dim': emb,
+            'ad_slot_num': ad_num,
+            'ad_slot_offset': ad_offset
+        }
+        self.outputs = {
+            'DINOut': din,
+            'MaskOut': mask,
+            'SideInfoOut': side,
+            'ADSlotSessionOut': session
+        }
+
+    def test_check_output(self):
+        self.check_output_with_place(core.CPUPlace(), atol=1e-5)
+
+
+class TestFusedSeqTensorOpBatch(TestFusedSeqTensorOp):
+
+    def config(self):
+        self.ins_num = 2
+        self.batch_count = 3
+        self.max_length = 5
+        self.slot_num = 4
+        self.fea_emb_dim = 3
+        self.ad_slot_num = 1
+        self.ad_slot_offset = 3
+
+
+if __name__ == '__main__':
+    unittest.main()
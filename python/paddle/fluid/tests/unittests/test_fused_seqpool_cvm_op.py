@@ -0,0 +1,214 @@
+#   Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+from __future__ import print_function
+
+import unittest
+import numpy as np
+from op_test import OpTest
+from test_reorder_lod_tensor import convert_to_offset
+import paddle.fluid.core as core
+
+
+def seqpool_sum(x, offset, pad_value=0.0):
+    bs = len(offset[0]) - 1
+    out = np.full((bs, x.shape[1]), pad_value, dtype='float64')
+    for i in range(bs):
+        out[i] += np.sum(x[offset[0][i]:offset[0][i + 1]].astype('float64'),
+                         axis=0)
+    return out
+
+
+class TestFusedSeqpoolCVMOp(OpTest):
+    """fused_seqpool_cvm against sequence sum pool + cvm of every slot"""
+
+    def setUp(self):
+        self.op_type = 'fused_seqpool_cvm'
+        self.w = 11
+        self.use_cvm = True
+        self.lods = [[[2, 3, 5]], [[1, 0, 2]], [[4, 1, 1]]]
+        self.cvm_width = 2
+        self.cvm_name = 'CVM'
+        self.attrs = {'pooltype': 'SUM'}
+        self.set_conf()
+        self.attrs['use_cvm'] = self.use_cvm
+        bs = len(self.lods[0][0])
+        inputs = []
+        outs = []
+        for i, lod in enumerate(self.lods):
+            x = np.random.uniform(0.1, 1,
+                                  [sum(lod[0]), self.w]).astype('float32')
+            pooled = seqpool_sum(x, convert_to_offset(lod))
+            inputs.append(('x_{0}'.format(i), (x, lod)))
+            outs.append(('out_{0}'.format(i),
+                         self.compute(x, lod, pooled).astype('float32')))
+        # only the grads read the cvm
+        self.cvm = np.random.uniform(0.1, 1,
+                                     [bs, self.cvm_width]).astype('float32')
+        self.inputs = {'X': inputs, self.cvm_name: self.cvm}
+        self.outputs = {'Out': outs}
+
+    def set_conf(self):
+        pass
+
+    def compute(self, x, lod, pooled):
+        if not self.use_cvm:
+            return pooled[:, 2:]
+        out = pooled.copy()
+        out[:, 0] = np.log(pooled[:, 0] + 1)
+        out[:, 1] = np.log(pooled[:, 1] + 1) - np.log(pooled[:, 0] + 1)
+        return out
+
+    def compute_grad(self, x, lod, out_grad):
+        """grad of x when every out element has the grad out_grad: the cvm
+        columns of a row get the cvm of its instance, the others out_grad"""
+        offset = convert_to_offset(lod)[0]
+        grad = np.full(x.shape, out_grad, dtype='float32')
+        for j in range(len(offset) - 1):
+            grad[offset[j]:offset[j + 1], :self.cvm_width] = self.cvm[j]
+        return grad
+
+    def test_check_output(self):
+        self.check_output_with_place(core.CPUPlace(), atol=1e-5)
+
+    def test_check_grad(self):
+        # the loss is the mean of the slot means
+        names = [name for name, _ in self.inputs['X']]
+        outs = self.outputs['Out']
+        grads = [
+            self.compute_grad(x, lod, 1.0 / (out.size * len(outs)))
+            for (_, (x, lod)), (_, out) in zip(self.inputs['X'], outs)
+        ]
+        self.check_grad_with_place(core.CPUPlace(),
+                                   names,
+                                   [name for name, _ in outs],
+                                   user_defined_grads=grads,
+                                   check_dygraph=False)
+
+
+class TestFusedSeqpoolCVMOpNoCVM(TestFusedSeqpoolCVMOp):
+
+    def set_conf(self):
+        self.use_cvm = False
+
+
+class TestFusedSeqpoolCVMWithConvOp(TestFusedSeqpoolCVMOp):
+
+    def set_conf(self):
+        self.op_type = 'fused_seqpool_cvm_with_conv'
+        self.cvm_width = 3
+
+    def compute(self, x, lod, pooled):
+        if not self.use_cvm:
+            return pooled[:, 3:]
+        out = pooled.copy()
+        out[:, 0] = np.log(pooled[:, 0] + 1)
+        out[:, 1] = np.log(pooled[:, 1] + 1)
+        out[:, 2] = np.log(pooled[:, 2] + 1) - np.log(pooled[:, 1] + 1)
+        return out
+
+
+class TestFusedSeqpoolCVMWithConvOpConcate(TestFusedSeqpoolCVMOp):
+
+    def set_conf(self):
+        self.op_type = 'fused_seqpool_cvm_with_conv'
+        self.cvm_width = 3
+        self.attrs['embedx_concate_size'] = 2
+
+    def compute(self, x, lod, pooled):
+        # the i-th block pools the i-th feasign of the instance
+        offset = convert_to_offset(lod)[0]
+        blocks = []
+        for c in range(2):
+            block = np.zeros((len(offset) - 1, self.w), dtype='float64')
+            for j in range(len(offset) - 1):
+                if offset[j] + c < offset[j + 1]:
+                    block[j] = x[offset[j] + c]
+            out = block.copy()
+            out[:, 0] = np.log(block[:, 0] + 1)
+            out[:, 1] = np.log(block[:, 1] + 1)
+            out[:, 2] = np.log(block[:, 2] + 1) - np.log(block[:, 1] + 1)
+            blocks.append(out)
+        return np.concatenate(blocks, axis=1)
+
+
+class TestFusedSeqpoolCVMWithCreditOp(TestFusedSeqpoolCVMOp):
+
+    def set_conf(self):
+        self.op_type = 'fused_seqpool_cvm_with_credit'
+        self.cvm_width = 4
+        self.attrs['show_filter'] = True
+
+    def compute(self, x, lod, pooled):
+        out = pooled[:, 1:].copy()
+        out[:, :3] = np.log(pooled[:, 1:4] + 1)
+        return out
+
+
+class TestFusedSeqpoolCVMWithPCOCOp(TestFusedSeqpoolCVMOp):
+
+    def set_conf(self):
+        self.op_type = 'fused_seqpool_cvm_with_pcoc'
+        self.cvm_width = 7
+        self.cvm_name = 'CVMWithPCOC'
+        self.w = 15
+
+    def compute(self, x, lod, pooled):
+        # cvm_offset 7 has 3 pclks, the 7 cvm columns become 8
+        log_pooled = np.log(pooled + 1)
+        out = np.zeros((pooled.shape[0], self.w + 1), dtype='float64')
+        out[:, 0] = log_pooled[:, 0]
+        out[:, 1] = log_pooled[:, 1] - log_pooled[:, 0]
+        for p in range(3):
+            out[:, 2 + p] = log_pooled[:, 4 + p] - log_pooled[:, 2]
+            out[:, 5 + p] = log_pooled[:, 4 + p] - log_pooled[:, 3]
+        out[:, 8:] = pooled[:, 7:]
+        return out
+
+    def compute_grad(self, x, lod, out_grad):
+        # show clk show2 clk2 from the cvm, no q values for the pclks
+        grad = super(TestFusedSeqpoolCVMWithPCOCOp,
+                     self).compute_grad(x, lod, out_grad)
+        grad[:, 4:self.cvm_width] = 0
+        return grad
+
+
+class TestFusedSeqpoolCVMTradeWOp(TestFusedSeqpoolCVMOp):
+
+    def set_conf(self):
+        self.op_type = 'fused_seqpool_cvm_tradew'
+        self.attrs['trade_id'] = 1
+        self.attrs['trade_num'] = 2
+
+    def compute(self, x, lod, pooled):
+        # embedx weighted by the trade weight, the trade columns dropped
+        weighted = np.concatenate(
+            [x[:, :2], x[:, 4:] * x[:, 3:4]], axis=1)
+        pooled = seqpool_sum(weighted, convert_to_offset(lod))
+        out = pooled.copy()
+        out[:, 0] = np.log(pooled[:, 0] + 1)
+        out[:, 1] = np.log(pooled[:, 1] + 1) - np.log(pooled[:, 0] + 1)
+        return out
+
+    def compute_grad(self, x, lod, out_grad):
+        # the weight gets the embedx sum, the embedx the weight, show and
+        # click no grad
+        grad = np.zeros(x.shape, dtype='float32')
+        grad[:, 3] = out_grad * np.sum(x[:, 4:], axis=1)
+        grad[:, 4:] = out_grad * x[:, 3:4]
+        return grad
+
+
+if __name__ == '__main__':
+    unittest.main()
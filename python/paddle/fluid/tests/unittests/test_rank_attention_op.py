@@ -219,16 +219,27 @@ class TestRankAttentionOpCpu(OpTest):
         }
 
     def test_check_output_cpu(self):
-        try:
-            self.check_output_with_place(place=core.CPUPlace())
-        except:
-            print("do not support cpu test, skip")
+        self.check_output_with_place(place=core.CPUPlace())
 
     def test_check_grad_cpu(self):
-        try:
-            self.check_grad_with_place(core.CPUPlace(), ["RankParam"], "Out")
-        except:
-            print("do not support cpu test, skip")
+        self.check_grad_with_place(core.CPUPlace(), ["RankParam"], "Out")
+
+
+class TestRankAttentionOpCpuInputBp(TestRankAttentionOpCpu):
+
+    def config(self):
+        self.pv_num = 30
+        self.x_feat = 6
+        self.y_feat = 5
+        self.max_rank = 3
+        self.dtype = "float64"
+
+    def setUp(self):
+        super(TestRankAttentionOpCpuInputBp, self).setUp()
+        self.attrs['EnableInputBp'] = True
+
+    def test_check_grad_cpu(self):
+        self.check_grad_with_place(core.CPUPlace(), ["RankParam", "X"], "Out")
 
 
 if __name__ == "__main__":